@@ -14,3 +14,10 @@ FIND_PACKAGE(Fontconfig REQUIRED)
 FIND_PACKAGE(HarfBuzz REQUIRED)
 
 find_package(glfw3 REQUIRED)
+
+# optional window system bindings of the headless context
+find_path(EGL_INCLUDE_DIR EGL/egl.h)
+find_library(EGL_LIBRARY NAMES EGL)
+
+find_path(OSMESA_INCLUDE_DIR GL/osmesa.h)
+find_library(OSMESA_LIBRARY NAMES OSMesa)
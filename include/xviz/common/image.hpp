@@ -9,9 +9,10 @@ namespace xviz {
 
 enum class ImageType { Raw, Uri, NoImage } ;
 
-enum class ImageFormat { rgb24, rgba32, gray8, gray16, float32, encoded };
+enum class ImageFormat { rgb24, rgba32, gray8, gray16, float32, float32x3, uint32, encoded };
 /* encoded means an encoded image payload  e.g. PNG.
- * In this case width is the data size and height is 0 */
+ * In this case width is the data size and height is 0.
+ * float32x3 holds three floats per pixel (e.g. normals), uint32 one unsigned integer (e.g. ids) */
 
 class ImageData ;
 
@@ -8,6 +8,9 @@
 #include <xviz/scene/scene_fwd.hpp>
 #include <xviz/common/image.hpp>
 
+#include <vector>
+#include <cstdint>
+
 namespace xviz {
 class OffscreenSurface : public QOffscreenSurface
 {
@@ -21,9 +24,26 @@ public:
     ~OffscreenSurface();
 
     Image getImage(bool alpha = true) const ;
+    // Depth linearized on the CPU, in millimetres for getDepthBuffer. Renderer::capture renders linear depth, normals
+    // and ids along with the colors in a single pass instead.
     Image getDepthBuffer(float znear, float zfar) const ;
     Image getDepthBufferFloat(float znear, float zfar) const;
 
+    // Asynchronous readback of the color buffer. requestImage queues the copy of the current contents into one of a
+    // ring of pixel buffer objects and returns at once, fetchImage maps the pixels once the GPU is done with them,
+    // usually one or two frames later, so that capturing every frame does not stall rendering. A request made while
+    // all buffers are in flight adds a buffer to the ring instead of waiting, the ring keeps its size afterwards.
+
+    using ReadbackTicket = uint64_t ;
+
+    // When dst is given the pixels are written there, it should hold width * height * (alpha ? 4 : 3) bytes and stay
+    // valid until the ticket is fetched. Otherwise a new image is allocated.
+    ReadbackTicket requestImage(bool alpha = true, uchar *dst = nullptr) ;
+
+    // Returns false if the ticket is unknown, or if the copy is still in flight and wait is false. Otherwise the
+    // ticket is released and image is set, to a null image when the pixels went to the buffer given to requestImage.
+    bool fetchImage(ReadbackTicket ticket, Image &image, bool wait = false) ;
+
     GLuint fboId() const ;
 
     void use() ;
@@ -31,13 +51,30 @@ public:
 
 
 private:
+    struct Readback {
+        GLuint pbo_ = 0 ;
+        GLsizeiptr capacity_ = 0 ;
+        GLsync fence_ = nullptr ;
+        ReadbackTicket ticket_ = 0 ;    // 0 when the buffer is free
+        bool alpha_ = true ;
+        uchar *dst_ = nullptr ;
+    };
+
     QOpenGLFramebufferObject *fbo_ = nullptr;
     QOpenGLContext *context_ = nullptr;
     QSize size_;
+
+    // single sampled copies of the color buffer, upside down in flip_fbo_, created on first use
+    mutable QOpenGLFramebufferObject *resolve_fbo_ = nullptr, *flip_fbo_ = nullptr ;
+
+    std::vector<Readback> readbacks_ ;
+    ReadbackTicket next_ticket_ = 1 ;
 private:
     void createContext();
     void createFBO();
-    Image readPixels(QOpenGLFramebufferObject *fbo, bool alpha) const;
+    void flipColorBuffer() const ;
+    Image readPixels(bool alpha) const;
+    void completeReadback(Readback &rb, Image &image) ;
 };
 
 }
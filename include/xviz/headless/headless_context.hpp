@@ -0,0 +1,78 @@
+#ifndef XVIZ_HEADLESS_CONTEXT_HPP
+#define XVIZ_HEADLESS_CONTEXT_HPP
+
+#include <xviz/common/image.hpp>
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace xviz {
+
+namespace impl {
+class HeadlessBackend ;
+}
+
+// OpenGL 3.3 core context rendering into a framebuffer object without a window system or Qt, for batch rendering on
+// machines without a display. The context is created with EGL, on the first device exposed by EGL_EXT_device_enumeration
+// or else on the default display, without a surface when EGL_KHR_surfaceless_context is available and with a
+// small pbuffer otherwise. When EGL is not available or fails, OSMesa (llvmpipe) is used instead. The readback
+// methods are those of OffscreenSurface.
+//
+// The context is current and its framebuffer bound after construction, so that a Renderer may be created and used
+// right away.
+
+class HeadlessContext {
+public:
+
+    enum class Backend { Any, EGL, OSMesa } ;
+
+    // A multisampled framebuffer is created for samples > 0. With Backend::Any the EGL backend is tried first.
+    HeadlessContext(uint32_t width, uint32_t height, uint32_t samples = 0, Backend backend = Backend::Any) ;
+    ~HeadlessContext() ;
+
+    HeadlessContext(const HeadlessContext &) = delete ;
+    HeadlessContext &operator = (const HeadlessContext &) = delete ;
+
+    // the context could be created, otherwise errorString tells why
+    bool isValid() const { return backend_ != nullptr ; }
+    const std::string &errorString() const { return error_ ; }
+
+    // backend of a valid context
+    Backend backend() const ;
+
+    uint32_t width() const { return width_ ; }
+    uint32_t height() const { return height_ ; }
+
+    // Rows of all images are ordered from top to bottom. Depth is linearized with the given clipping planes, in
+    // millimetres for getDepthBuffer, pixels at the far plane are set to zero.
+    Image getImage(bool alpha = true) const ;
+    Image getDepthBuffer(float znear, float zfar) const ;
+    Image getDepthBufferFloat(float znear, float zfar) const ;
+
+    unsigned int fboId() const { return fbo_ ; }
+
+    // make the context current and bind its framebuffer
+    void use() ;
+    void release() ;
+
+private:
+
+    bool createBackend(Backend backend) ;
+    bool createFramebuffers() ;
+    void flipBuffers(unsigned int mask) const ;
+    std::unique_ptr<float []> readDepth() const ;
+
+    std::unique_ptr<impl::HeadlessBackend> backend_ ;
+    std::string error_ ;
+    uint32_t width_, height_, samples_ ;
+
+    unsigned int fbo_ = 0, color_ = 0, depth_ = 0 ;
+    // single sampled copies of the buffers, upside down in flip_fbo_
+    unsigned int resolve_fbo_ = 0, resolve_color_ = 0, resolve_depth_ = 0 ;
+    unsigned int flip_fbo_ = 0, flip_color_ = 0, flip_depth_ = 0 ;
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef XVIZ_SCENE_SIMPLIFY_HPP
+#define XVIZ_SCENE_SIMPLIFY_HPP
+
+#include <Eigen/Core>
+
+#include <vector>
+#include <queue>
+#include <limits>
+#include <cstdint>
+
+namespace xviz { namespace detail {
+
+// Triangle mesh simplification by quadric error metrics (Garland & Heckbert). Vertices with the same position are
+// welded first so that seams of normals or texture coordinates do not split the surface. Each step collapses an
+// edge onto one of its end points (half-edge collapse), so that the simplified triangles index the original vertices
+// and all levels of detail can share the vertex buffer. Open boundaries and attribute seams are kept in place by
+// constraint planes perpendicular to them, collapses that would fold a triangle over are rejected.
+
+class MeshSimplifier {
+public:
+
+    // Empty indices stand for a non-indexed triangle list. Normals and texture coordinates may be empty, they are
+    // used to find the seams.
+    MeshSimplifier(const std::vector<Eigen::Vector3f> &vertices, const std::vector<uint32_t> &indices,
+                   const std::vector<Eigen::Vector3f> &normals, const std::vector<Eigen::Vector2f> &tex_coords = {}) ;
+
+    // Collapse edges until at most target triangles remain or the next collapse would exceed max_error, in the units
+    // of the vertices. May be called again with a lower target to continue. Returns the number of triangles left.
+    size_t simplify(size_t target, float max_error = std::numeric_limits<float>::max()) ;
+
+    size_t triangles() const { return remaining_ ; }
+
+    // triangle list of the simplified mesh, indexing the original vertices
+    void getIndices(std::vector<uint32_t> &indices) const ;
+
+    // Geometric error of the simplified mesh: the square root of the largest quadric error of the collapses done so
+    // far, which bounds the distance of the moved vertices from the planes of the triangles they replace.
+    float error() const { return error_ ; }
+
+private:
+
+    // symmetric 4x4 matrix, upper triangle stored by rows
+    struct Quadric {
+        double q_[10] = { 0 } ;
+
+        void addPlane(const Eigen::Vector4d &p, double weight) ;
+        Quadric &operator += (const Quadric &o) ;
+        double evaluate(const Eigen::Vector3f &v) const ;
+    };
+
+    struct Triangle {
+        uint32_t v_[3] ;        // welded vertices
+        uint32_t corner_[3] ;   // original vertices, used to pick the attributes of the output
+        bool removed_ = false ;
+
+        bool contains(uint32_t v) const { return v_[0] == v || v_[1] == v || v_[2] == v ; }
+    };
+
+    // best collapse of a vertex, stale when the stamp of the vertex has changed since it was computed
+    struct Candidate {
+        double cost_ ;
+        uint32_t vertex_, target_, stamp_ ;
+
+        bool operator < (const Candidate &o) const { return cost_ > o.cost_ ; }
+    };
+
+    // the original vertices have the same attributes
+    bool sameWedge(uint32_t a, uint32_t b) const ;
+    void neighbours(uint32_t v, std::vector<uint32_t> &nv) const ;
+    bool canCollapse(uint32_t v, uint32_t target) const ;
+    void updateCandidate(uint32_t v) ;
+    void collapse(uint32_t v, uint32_t target) ;
+
+    std::vector<Eigen::Vector3f> positions_ ;           // welded vertices
+    std::vector<Eigen::Vector3f> normals_ ;             // original vertices
+    std::vector<Eigen::Vector2f> tex_coords_ ;
+    std::vector<uint32_t> welded_ ;                     // welded vertex of each original vertex
+    std::vector<std::vector<uint32_t>> wedges_ ;        // original vertices of each welded vertex
+    std::vector<std::vector<uint32_t>> faces_ ;         // triangles around each welded vertex
+    std::vector<Quadric> quadrics_ ;
+    std::vector<uint32_t> stamps_ ;
+    std::vector<Triangle> triangles_ ;
+    std::priority_queue<Candidate> heap_ ;
+    size_t remaining_ = 0 ;
+    float error_ = 0 ;
+};
+
+}}
+
+#endif
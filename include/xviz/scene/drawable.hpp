@@ -3,9 +3,15 @@
 
 #include <xviz/scene/scene_fwd.hpp>
 #include <xviz/scene/material.hpp>
+#include <xviz/scene/revision.hpp>
 
 namespace xviz {
 
+namespace impl {
+    class InstanceDataManager ;
+    class InstanceData ;
+}
+
 template<typename T>
 class EventDispatcher {
 public:
@@ -63,5 +69,62 @@ private:
     EventDispatcher<MaterialChangedEvent> mc_dispatcher_ ;
 };
 
+// A geometry drawn many times with the same material, each copy (instance) with its own transform and optionally its own color.
+// All instances are rendered with a single draw call. Instance transforms are relative to the node the drawable is attached to.
+// Per-instance colors replace the diffuse color of Phong materials and the color of constant materials.
+
+class InstancedDrawable {
+public:
+
+    InstancedDrawable(const GeometryPtr &geom, const MaterialPtr &material):
+        geometry_(geom), material_(material) {}
+
+    ~InstancedDrawable() ;
+
+    GeometryPtr geometry() const { return geometry_ ; }
+    MaterialPtr material() const { return material_ ; }
+
+    void addInstance(const Eigen::Affine3f &tr) ;
+    // if used then a color should be provided for all instances
+    void addInstance(const Eigen::Affine3f &tr, const Eigen::Vector4f &clr) ;
+
+    // replace all instances, colors should be either empty or of the same size as the transforms
+    void setInstances(const std::vector<Eigen::Affine3f> &trs, const std::vector<Eigen::Vector4f> &colors = {}) ;
+
+    void setInstanceTransform(size_t idx, const Eigen::Affine3f &tr) ;
+    void setInstanceColor(size_t idx, const Eigen::Vector4f &clr) ;
+
+    void clearInstances() ;
+
+    size_t numInstances() const { return transforms_.size() ; }
+    bool hasInstanceColors() const { return !colors_.empty() ; }
+
+    const std::vector<Eigen::Affine3f> &instanceTransforms() const { return transforms_ ; }
+    const std::vector<Eigen::Vector4f> &instanceColors() const { return colors_ ; }
+
+    // set when instances are modified, the renderer clears it after uploading the instance buffer
+    bool instancesUpdated() const { return instances_updated_ ; }
+    void setInstancesUpdated(bool state) {
+        instances_updated_ = state ;
+        if ( state ) { ++revision_ ; touchScene() ; }
+    }
+
+    // incremented whenever the instances are modified
+    uint64_t revision() const { return revision_ ; }
+
+private:
+
+    friend class impl::InstanceDataManager ;
+
+    GeometryPtr geometry_ ;
+    MaterialPtr material_ ;
+    std::vector<Eigen::Affine3f> transforms_ ;
+    std::vector<Eigen::Vector4f> colors_ ;
+    bool instances_updated_ = true ;
+    uint64_t revision_ = 0 ;
+
+    impl::InstanceData *data_ = nullptr ;
+};
+
 } // namespace xviz
 #endif
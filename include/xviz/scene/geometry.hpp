@@ -5,6 +5,8 @@
 #include <xviz/scene/node.hpp>
 #include <xviz/scene/detail/intersect.hpp>
 
+#include <limits>
+
 namespace xviz {
 
 class RayCastResult ;
@@ -93,7 +95,7 @@ public:
     int numUVChannels() const { return MAX_TEXTURES ; }
 
     bool castsShadows() const { return casts_shadows_ ; }
-    void setCastsShadows(bool c) { casts_shadows_ = c ; }
+    void setCastsShadows(bool c) { casts_shadows_ = c ; touchScene() ; }
 
     const std::vector<Bone> &skeleton() const { return skeleton_ ; }
     std::vector<Bone> &skeleton() { return skeleton_ ; }
@@ -105,8 +107,30 @@ public:
 
     bool hasSkeleton() const { return !skeleton_.empty() ; }
 
+    // Copy the posed vertices of a skinned mesh back from the GPU after each rendered frame, so that ray casting
+    // hits the mesh as drawn. The readback waits for the GPU and should be enabled only when needed.
+    void setSkinnedVerticesReadback(bool readback) {
+        skinned_readback_ = readback ;
+        if ( !readback ) skinned_vertices_.clear() ;
+    }
+    bool skinnedVerticesReadback() const { return skinned_readback_ ; }
+
+    // vertices posed in the last rendered frame, in the same coordinates as vertices(), empty without readback
+    const vb3_t &skinnedVertices() const { return skinned_vertices_ ; }
+    vb3_t &skinnedVertices() { return skinned_vertices_ ; }
+
     PrimitiveType ptype() const { return ptype_ ; }
 
+    // Storage of the vertex attributes on the GPU. The packed format uses a single interleaved buffer with normals
+    // stored as GL_INT_2_10_10_10_REV, colors as normalized bytes and texture coordinates as half floats. A vertex with
+    // position, normal, color and texture coordinates takes 24 bytes instead of 44. The default format is selected
+    // by the renderer (see Renderer::setPackedVertexFormat).
+
+    enum VertexFormat { DefaultVertexFormat, FloatVertexFormat, PackedVertexFormat } ;
+
+    VertexFormat vertexFormat() const { return vertex_format_ ; }
+    void setVertexFormat(VertexFormat f) { vertex_format_ = f ; }
+
     // primitive shape factories
 
     static Geometry createWireCube(const Eigen::Vector3f &hs) ;
@@ -161,22 +185,78 @@ public:
 
     bool intersectLines(const Ray &, std::vector<RayLineHit> &hits, float line_thresh_sq) const ;
 
+    // Range of vertices [first_, last_) modified since the last upload to the GPU
+
+    struct DirtyRange {
+        size_t first_ = 0, last_ = 0 ;
+
+        bool empty() const { return first_ >= last_ ; }
+        void clear() { first_ = last_ = 0 ; }
+
+        void extend(size_t first, size_t count) {
+            if ( count == 0 ) return ;
+            size_t last = ( count > std::numeric_limits<size_t>::max() - first ) ? std::numeric_limits<size_t>::max() : first + count ;
+            if ( empty() ) { first_ = first ; last_ = last ; }
+            else { first_ = std::min(first_, first) ; last_ = std::max(last_, last) ; }
+        }
+    };
+
+    // Only the marked vertices are uploaded, unless the number of vertices has changed in which case all of them
+    // are. The set*Updated(true) functions mark the whole buffer.
+
+    void markVerticesDirty(size_t first, size_t count) {
+        dirty_vertices_.extend(first, count) ;
+        box_.reset(nullptr) ;
+        ++revision_ ;
+        touchScene() ;
+    }
+
+    void markNormalsDirty(size_t first, size_t count) { dirty_normals_.extend(first, count) ; }
+    void markColorsDirty(size_t first, size_t count) { dirty_colors_.extend(first, count) ; }
+
+    const DirtyRange &dirtyVertices() const { return dirty_vertices_ ; }
+    const DirtyRange &dirtyNormals() const { return dirty_normals_ ; }
+    const DirtyRange &dirtyColors() const { return dirty_colors_ ; }
+
     void setVerticesUpdated(bool state) {
-        vertices_updated_ = state ;
-        if ( state ) box_.reset(nullptr) ;
+        if ( state ) markVerticesDirty(0, std::numeric_limits<size_t>::max()) ;
+        else dirty_vertices_.clear() ;
     }
 
     void setNormalsUpdated(bool state) {
-        normals_updated_ = state ;
+        if ( state ) markNormalsDirty(0, std::numeric_limits<size_t>::max()) ;
+        else dirty_normals_.clear() ;
     }
 
     void setColorsUpdated(bool state) {
-        colors_updated_ = state ;
+        if ( state ) markColorsDirty(0, std::numeric_limits<size_t>::max()) ;
+        else dirty_colors_.clear() ;
     }
 
-    bool verticesUpdated() const { return vertices_updated_ ; }
-    bool normalsUpdated() const { return normals_updated_ ; }
-    bool colorsUpdated() const { return colors_updated_ ; }
+    bool verticesUpdated() const { return !dirty_vertices_.empty() ; }
+    bool normalsUpdated() const { return !dirty_normals_.empty() ; }
+    bool colorsUpdated() const { return !dirty_colors_.empty() ; }
+
+    // incremented whenever vertices are marked as modified, used to detect changes of cached renderings
+    uint64_t revision() const { return revision_ ; }
+
+    // Level of detail: a simplified triangle list over the same vertices, and its geometric error, i.e. an estimate
+    // of the largest distance from the original surface, in the units of the vertices.
+
+    struct Lod {
+        indices_t indices_ ;
+        float error_ ;
+    };
+
+    // levels in order of decreasing detail, the full geometry being level 0
+    const std::vector<Lod> &lods() const { return lods_ ; }
+
+    // Build up to max_levels levels by quadric error simplification, each with about ratio times the triangles of
+    // the previous one. Simplification stops when the error would exceed max_error times the diagonal of the
+    // bounding box. Only triangle meshes are simplified, the vertices are not modified. The renderer picks a level
+    // from the projected size of the geometry (see Renderer::setLodThreshold).
+    void generateLods(uint32_t max_levels = 4, float ratio = 0.5f, float max_error = 0.05f) ;
+    void clearLods() { lods_.clear() ; }
 
 private:
 
@@ -185,13 +265,18 @@ private:
     vb3_t vertices_, normals_, colors_ ;
     vb2_t tex_coords_[MAX_TEXTURES] ;
     indices_t indices_ ;
+    std::vector<Lod> lods_ ;
     std::vector<BoneWeight> weights_ ;
     std::vector<Bone> skeleton_ ;
     Eigen::Affine3f skeleton_inverse_global_transform_ = Eigen::Affine3f::Identity() ;
+    vb3_t skinned_vertices_ ;
+    bool skinned_readback_ = false ;
     bool casts_shadows_ = true ;
-    bool vertices_updated_ = false, normals_updated_ = false, colors_updated_ = false ;
+    DirtyRange dirty_vertices_, dirty_normals_, dirty_colors_ ;
+    uint64_t revision_ = 0 ;
     std::unique_ptr<detail::AABB> box_ ;
     PrimitiveType ptype_ = Triangles ;
+    VertexFormat vertex_format_ = DefaultVertexFormat ;
 
     impl::MeshData *data_ = nullptr ;
 };
@@ -6,6 +6,7 @@
 #include <memory>
 #include <map>
 #include <cmath>
+#include <algorithm>
 
 #include <Eigen/Core>
 #include <xviz/scene/camera.hpp>
@@ -45,6 +46,10 @@ struct Light {
     void setShadowBias(float v) { shadow_bias_ = v ; }
     float shadowBias() const { return shadow_bias_ ; }
 
+    // resolution of the (square) shadow map, for cascaded lights this is the size of each cascade
+    void setShadowMapSize(uint32_t sz) { shadow_map_size_ = sz ; }
+    uint32_t shadowMapSize() const { return shadow_map_size_ ; }
+
 protected:
 
     std::string name_ ;
@@ -53,6 +58,7 @@ protected:
     Eigen::Vector3f diffuse_color_{0, 0, 0}, specular_color_{0, 0, 0}, ambient_color_{0, 0, 0} ;
 
     float shadow_bias_ = 0.0 ;
+    uint32_t shadow_map_size_ = 2048 ;
 };
 
 
@@ -93,8 +99,29 @@ struct DirectionalLight: public Light {
     void setShadowCamera(const OrthographicCamera &cam) { shadow_cam_ = cam ; }
     const OrthographicCamera &shadowCamera() const { return shadow_cam_ ; }
 
+    static const uint32_t MAX_SHADOW_CASCADES = 4 ;
+
+    // Split the view frustum of the camera in n cascades, each one with its own shadow map fitted to the slice
+    // every frame. Split distances blend logarithmic (lambda = 1) and uniform (lambda = 0) partitions of the
+    // depth range. With n = 0 (default) a single map is rendered with the fixed shadow camera.
+    void setShadowCascades(uint32_t n, float lambda = 0.75f) {
+        shadow_cascades_ = std::min(n, MAX_SHADOW_CASCADES) ;
+        cascade_split_lambda_ = lambda ;
+    }
+
+    uint32_t shadowCascades() const { return shadow_cascades_ ; }
+    float cascadeSplitLambda() const { return cascade_split_lambda_ ; }
+
+    // maximum distance from the camera covered by the cascades, 0 to use the far plane of the camera
+    void setShadowDistance(float d) { shadow_distance_ = d ; }
+    float shadowDistance() const { return shadow_distance_ ; }
+
 protected:
 
+    uint32_t shadow_cascades_ = 0 ;
+    float cascade_split_lambda_ = 0.75f ;
+    float shadow_distance_ = 0 ;
+
     Eigen::Vector3f position_, target_ ; // to correclty casts shadows set this to an absolute position (in this case the light direction is the normalised value)
 
 public:
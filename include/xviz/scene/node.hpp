@@ -25,7 +25,8 @@ public:
 
     using NodePtr = std::shared_ptr<Node> ;
 
-    enum { IMPORT_ANIMATIONS = 0x1, IMPORT_SKELETONS = 0x2, IMPORT_LIGHTS = 0x4 } ;
+    // IMPORT_LODS generates levels of detail for the triangle meshes without bones (see Geometry::generateLods)
+    enum { IMPORT_ANIMATIONS = 0x1, IMPORT_SKELETONS = 0x2, IMPORT_LIGHTS = 0x4, IMPORT_LODS = 0x8 } ;
 
     void load(const std::string &fname, int flags = 0 ) ;
     void load(const aiScene *sc, const std::string &fname, int flags = 0) ;
@@ -40,23 +41,30 @@ public:
 
     void setName(const std::string &name) { name_ = name ; }
 
-    void addDrawable(const Drawable &d) { drawables_.emplace_back(d) ; }
+    void addDrawable(const Drawable &d) { drawables_.emplace_back(d) ; touchScene() ; }
     void addDrawable(const GeometryPtr &geom, const MaterialPtr &material) {
         drawables_.emplace_back(geom, material) ;
+        touchScene() ;
     }
 
+    // geometry rendered multiple times with a single draw call, see InstancedDrawable
+    void addInstancedDrawable(const InstancedDrawablePtr &d) { instanced_drawables_.emplace_back(d) ; touchScene() ; }
+
     void addChild(const NodePtr &n) {
         children_.push_back(n) ;
         n->parent_ = this ;
+        touchScene() ;
     }
 
     void removeChild(const NodePtr &n) {
         auto it = std::find(children_.begin(), children_.end(), n) ;
         if ( it != children_.end() ) children_.erase(it) ;
+        touchScene() ;
     }
 
     void setTransform(const Eigen::Affine3f &tr) {
         mat_ = tr ;
+        touchScene() ;
     }
 
     Eigen::Vector3f positionWorld() const ;
@@ -67,6 +75,8 @@ public:
     const std::vector<Drawable> &drawables() const { return drawables_ ; }
     std::vector<Drawable> &drawables() { return drawables_ ; }
 
+    const std::vector<InstancedDrawablePtr> &instancedDrawables() const { return instanced_drawables_ ; }
+
     const std::vector<NodePtr> &children() const { return children_ ; }
     std::vector<NodePtr> &children() { return children_ ; }
 
@@ -136,6 +146,8 @@ public:
         return nodes ;
     }
 
+    int order() const { return order_ ; }
+
     void setOrder(int order, bool recursive = true) {
         order_ = order ;
         if ( recursive ) {
@@ -188,6 +200,7 @@ public:
 
     void setVisible(bool v, bool recursive = true) {
         visible_ = v ;
+        touchScene() ;
         if ( recursive ) {
             for( auto &c: children_ )
                 c->setVisible(v) ;
@@ -208,6 +221,7 @@ private:
 
     LightPtr light_ ;
     std::vector<Drawable> drawables_ ;
+    std::vector<InstancedDrawablePtr> instanced_drawables_ ;
 
     std::vector<std::unique_ptr<Animation>> animations_ ;
 
@@ -15,6 +15,8 @@ namespace detail {
 struct RayCastResult {
     NodePtr node_ ;
     Drawable *drawable_ = nullptr ;
+    InstancedDrawablePtr instanced_ ; // set instead of drawable_ by Renderer::pick for instanced drawables
+    uint32_t instance_ = 0 ;          // index of the instance within instanced_
 
     float t_ ; // distance from ray origin to geometry hit
 
@@ -4,6 +4,11 @@
 #include <xviz/scene/scene_fwd.hpp>
 #include <xviz/scene/camera.hpp>
 #include <xviz/common/font.hpp>
+#include <xviz/common/image.hpp>
+#include <xviz/scene/raycaster.hpp>
+
+#include <string>
+#include <vector>
 
 namespace xviz {
 
@@ -11,6 +16,74 @@ namespace impl {
 class Renderer ;
 }
 
+// timings of a pass of the renderer (e.g. "opaque", "shadow 0"), in milliseconds
+
+struct PassTiming {
+    std::string name_ ;
+    double cpu_ms_ = 0 ;    // time spent issuing the pass
+    double gpu_ms_ = -1 ;   // GPU time of the pass in the most recent frame whose timer queries have completed,
+                            // usually a few frames earlier, negative if not known yet
+};
+
+// statistics collected during the last call to Renderer::render
+
+struct FrameStats {
+    uint32_t views_ = 0 ;           // cameras the scene was rendered from, see Renderer::renderViews
+    uint32_t scene_walks_ = 0 ;     // number of traversals of the scene graph
+    uint32_t shadow_passes_ = 0 ;   // number of shadow maps rendered
+    uint32_t shadow_maps_cached_ = 0 ;      // shadow maps reused from a previous frame
+    uint32_t draw_calls_ = 0 ;      // draw calls of the color pass
+    uint32_t depth_prepass_draws_ = 0 ;     // draw calls of the depth pre-pass
+    uint32_t instanced_draws_ = 0 ; // draw calls of the color pass that render multiple instances
+    uint32_t lod_draws_ = 0 ;       // drawables drawn with a simplified level of detail
+    uint32_t drawables_drawn_ = 0 ; // drawables that passed the camera frustum test
+    uint32_t drawables_culled_ = 0 ;        // drawables outside the camera frustum
+    uint32_t drawables_occluded_ = 0 ;      // drawables skipped since their node was hidden in the previous frame
+    uint32_t occlusion_queries_ = 0 ;       // node bounds tested for visibility
+    uint32_t shadow_drawables_culled_ = 0 ; // drawables outside the light frustum, summed over the shadow passes
+    uint32_t skinned_meshes_ = 0 ;  // meshes posed by the pre-skinning pass
+    uint32_t fallback_draws_ = 0 ;  // drawables drawn with a placeholder while their program is compiled
+    uint32_t gl_calls_issued_ = 0 ; // state changes and bindings passed to the driver
+    uint32_t gl_calls_skipped_ = 0 ;        // state changes and bindings skipped since the value was already set
+    uint32_t triangles_ = 0 ;       // triangles submitted by all passes
+    uint32_t program_switches_ = 0 ;
+    uint32_t texture_binds_ = 0 ;
+    uint64_t uploaded_bytes_ = 0 ;  // vertex, instance, uniform and texture data transferred to the GPU
+    uint32_t render_targets_allocated_ = 0 ;    // framebuffers created by Renderer::renderImage
+    uint32_t render_targets_reused_ = 0 ;       // framebuffers of Renderer::renderImage taken from its pool instead
+    uint32_t render_targets_freed_ = 0 ;        // pooled framebuffers deleted after staying unused for a few frames
+    std::vector<PassTiming> passes_ ;
+};
+
+// drawable that left the pixels of an id in the id target of a capture
+
+struct CaptureId {
+    NodePtr node_ ;
+    const Drawable *drawable_ = nullptr ;   // one of node_->drawables(), null for instanced drawables
+    InstancedDrawablePtr instanced_ ;       // one of node_->instancedDrawables() otherwise
+    uint32_t instance_ = 0 ;                // index of the instance within instanced_
+};
+
+// Render targets of Renderer::capture, with rows ordered from top to bottom as OffscreenSurface::getImage
+
+struct Capture {
+    Image color_ ;      // rgba32
+    Image depth_ ;      // float32, linear eye depth i.e. distance from the plane of the camera, 0 for the background
+    Image normals_ ;    // float32x3, unit view space normals turned towards the camera, 0 for the background
+    Image ids_ ;        // uint32, 0 for the background, see lookup
+    std::vector<CaptureId> drawables_ ;     // drawable of id i + 1 in element i
+
+    // Drawable of an id, null for the background. The drawable pointers stay valid as long as the drawables of their
+    // node are not modified.
+    const CaptureId *lookup(uint32_t id) const {
+        return ( id == 0 || id > drawables_.size() ) ? nullptr : &drawables_[id - 1] ;
+    }
+};
+
+// filter of the supersampling of Renderer::renderImage
+
+enum class DownsampleFilter { Box, Lanczos } ;
+
 class Renderer {
 public:
 
@@ -23,11 +96,83 @@ public:
 
     void render(const NodePtr &scene, const CameraPtr &cam, bool clear_buffers = true) ;
 
+    // The offscreen functions below (capture, renderViews, renderImage, requestPick) restore the framebuffer bound
+    // by the caller.
+
+    // Render color, linear depth, normals and ids (one per drawable or instance) of the camera viewport in a single
+    // pass without multisampling, and read them back into result.
+    void capture(const NodePtr &scene, const CameraPtr &cam, Capture &result) ;
+
+    // Render the scene from each camera into images[i] as renderImage does, sharing the scene walk, skinning and
+    // shadow maps among the views. Occlusion culling is not applied.
+    void renderViews(const NodePtr &scene, const std::vector<CameraPtr> &cams, std::vector<Image> &images) ;
+
+    // Render offscreen into image (rgba32, rows from top to bottom, of the viewport size, null if it is empty) with
+    // optional multisampling and k x k supersampling reduced on the GPU with filter. The targets are pooled.
+    void renderImage(const NodePtr &scene, const CameraPtr &cam, Image &image, uint32_t samples = 0,
+                     uint32_t supersampling = 1, DownsampleFilter filter = DownsampleFilter::Box) ;
+
+    using PickTicket = uint64_t ;
+
+    // GPU picking of pixel (x, y) of the viewport, rows counted from the top as in Camera::getRay, or of the nearest
+    // covered pixel within radius. The result is read back asynchronously, see fetchPick.
+    PickTicket requestPick(const NodePtr &scene, const CameraPtr &cam, int x, int y, int radius = 2) ;
+
+    // False if the ticket is unknown, or still in flight and wait is false. Otherwise the ticket is released and
+    // result is set as by RayCaster, with a null node_ when nothing was hit.
+    bool fetchPick(PickTicket ticket, RayCastResult &result, bool wait = false) ;
+
+    // requestPick followed by a waiting fetchPick, returns whether a drawable was hit
+    bool pick(const NodePtr &scene, const CameraPtr &cam, int x, int y, RayCastResult &result, int radius = 2) ;
+
     void renderText(const std::string &text, float x, float y, const Font &font, const Eigen::Vector3f &clr);
 
     // transform model coordinates to screen coordinates
     Eigen::Vector2f project(const Eigen::Vector3f &pos) ;
 
+    // store the vertices of geometries that do not select a vertex format in the packed format
+    void setPackedVertexFormat(bool packed) ;
+
+    // Pose skinned meshes once per frame into a vertex buffer that is shared by all passes (enabled by default).
+    // Otherwise each pass skins the vertices in its own vertex shader. Meshes that request the readback of
+    // their skinned vertices (see Geometry::setSkinnedVerticesReadback) are always pre-skinned.
+    void setPreSkinning(bool enable) ;
+
+    // Compile the material programs needed to draw the scene with its current lights and materials, so that the
+    // first frames do not stall on shader compilation.
+    void precompile(const NodePtr &scene) ;
+
+    // When the driver supports GL_KHR_parallel_shader_compile, programs are compiled in the background and drawables
+    // are drawn with a plain color until their program is ready (disabled by default). Otherwise rendering waits
+    // for the compiler.
+    void setAsyncShaderCompile(bool enable) ;
+
+    // Debug aid: compare the GL state cached by the renderer with the actual one after every state change and
+    // report mismatches on std::cerr. This is slow since each check waits for the driver.
+    void setStateValidation(bool enable) ;
+
+    // Render the depth of opaque drawables before the color pass, which then shades only the closest opaque surface
+    // of each pixel (disabled by default). This pays off in scenes with costly materials and much overdraw, e.g.
+    // Phong materials with many lights. Drawables are opaque when drawn as triangles with depth test and full opacity.
+    void setDepthPrePass(bool enable) ;
+
+    // Skip the drawables of nodes whose bounds were hidden behind opaque drawables in the previous frame (disabled by
+    // default). This relies on the depth pre-pass, which is rendered along with it, and on occlusion queries: it has
+    // no effect when the context lacks them. Nodes coming into view from behind an occluder appear one frame late.
+    void setOcclusionCulling(bool enable) ;
+
+    // Draw geometries that have levels of detail (see Geometry::generateLods) with the coarsest level whose error,
+    // projected at the distance of the geometry, stays below the given number of pixels (1 by default). Zero always
+    // draws the full geometry. Shadow maps and instanced drawables always use the full geometry.
+    void setLodThreshold(float pixels) ;
+
+    // Append the CPU and GPU timings of the passes of every frame to a trace-event JSON file, which can be loaded in
+    // chrome://tracing or Perfetto. An empty path stops tracing.
+    void setTraceFile(const std::string &path) ;
+
+    // counters of the last rendered frame
+    const FrameStats &frameStats() const ;
+
 private:
 
     std::unique_ptr<impl::Renderer> impl_ ;
@@ -0,0 +1,18 @@
+#ifndef XVIZ_SCENE_REVISION_HPP
+#define XVIZ_SCENE_REVISION_HPP
+
+#include <cstdint>
+
+namespace xviz {
+
+// Counter shared by all scenes, incremented when nodes are transformed, added, removed or hidden, when drawables
+// are added and when the vertices or instances of geometries are modified. The renderer keeps renderings such as
+// shadow maps across frames while it is unchanged. Modifications made through the references returned by
+// Node::transform() or Node::drawables() are not tracked, use setTransform or call touchScene() after them.
+
+uint64_t sceneRevision() ;
+void touchScene() ;
+
+}
+
+#endif
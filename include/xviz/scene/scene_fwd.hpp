@@ -27,6 +27,9 @@ typedef std::shared_ptr<const Node> ConstNodePtr ;
 class Drawable ;
 typedef std::shared_ptr<Drawable> DrawablePtr ;
 
+class InstancedDrawable ;
+typedef std::shared_ptr<InstancedDrawable> InstancedDrawablePtr ;
+
 class Geometry ;
 typedef std::shared_ptr<Geometry> GeometryPtr ;
 
@@ -0,0 +1,25 @@
+#include "gl_loader.hpp"
+
+namespace xviz { namespace impl {
+
+static bool s_loaded = false ;
+static GL3WGetProcAddressProc s_resolver = nullptr ;
+
+int loadGL(GL3WGetProcAddressProc resolver) {
+    if ( resolver ) {
+        s_resolver = resolver ;
+        s_loaded = true ;
+        return gl3wInit2(resolver) ;
+    }
+
+    if ( s_loaded ) return GL3W_OK ;
+
+    s_loaded = true ;
+    return gl3wInit() ;
+}
+
+GL3WglProc glProcAddress(const char *name) {
+    return s_resolver ? s_resolver(name) : gl3wGetProcAddress(name) ;
+}
+
+}}
@@ -0,0 +1,18 @@
+#ifndef XVIZ_GL_LOADER_HPP
+#define XVIZ_GL_LOADER_HPP
+
+#include "common/gl/gl3w.h"
+
+namespace xviz { namespace impl {
+
+// Load the GL functions through the given resolver, e.g. eglGetProcAddress for a context created without a window
+// system, which is also used by glProcAddress afterwards. Without a resolver the functions are loaded through
+// the window system library found by gl3w, once per process: later calls keep the functions already loaded.
+int loadGL(GL3WGetProcAddressProc resolver = nullptr) ;
+
+// address of a GL function, e.g. of an extension, through the resolver the functions were loaded with
+GL3WglProc glProcAddress(const char *name) ;
+
+}}
+
+#endif
@@ -41,6 +41,10 @@ public:
             return width_ * height_ * 2 ;
         case ImageFormat::float32:
             return width_ * height_ * 4 ;
+        case ImageFormat::float32x3:
+            return width_ * height_ * 12 ;
+        case ImageFormat::uint32:
+            return width_ * height_ * 4 ;
         case ImageFormat::encoded:
             return width_ ;
         }
@@ -1,4 +1,5 @@
 #include "resource_manager.hpp"
+#include "shader_source.hpp"
 
 #include "shaders/common.vs.hpp"
 #include "shaders/phong.fs.hpp"
@@ -8,13 +9,20 @@
 #include "shaders/constant.fs.hpp"
 #include "shaders/per_vertex.fs.hpp"
 #include "shaders/wireframe.hpp"
+#include "shaders/capture.fs.hpp"
 
 #include "shaders/shadow_map.vs.hpp"
 #include "shaders/shadow_map.fs.hpp"
+#include "shaders/occlusion.vs.hpp"
+#include "shaders/downsample.hpp"
 #include "shaders/lights.hpp"
+#include "shaders/blocks.hpp"
+#include "shaders/skinning.hpp"
 
 
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 
 namespace xviz { namespace impl {
 
@@ -33,6 +41,82 @@ std::string OpenGLShaderResourceManager::fetch(const std::string &name) {
 
 void OpenGLShaderResourceManager::setShaderResourceFolder(const std::string &folder) {
     instance_.folder_ = folder ;
+    OpenGLShaderSource::clearCache() ;
+}
+
+void OpenGLShaderResourceManager::setProgramCacheFolder(const std::string &folder) {
+    instance_.cache_folder_ = folder ;
+}
+
+// Layout of a cache entry: magic, key, driver string length and characters, binary format, binary size and data
+
+static const char program_cache_magic[4] = { 'X', 'V', 'P', '1' } ;
+
+static std::string programCachePath(const std::string &folder, uint64_t key) {
+    char name[32] ;
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key) ;
+    return folder + '/' + name ;
+}
+
+bool OpenGLShaderResourceManager::loadProgramBinary(uint64_t key, const std::string &driver, uint32_t &format, std::vector<char> &data) {
+    if ( instance_.cache_folder_.empty() ) return false ;
+
+    std::ifstream strm(programCachePath(instance_.cache_folder_, key), std::ios::binary) ;
+    if ( !strm ) return false ;
+
+    char magic[4] ;
+    uint64_t stored_key ;
+    uint32_t driver_len, size ;
+
+    if ( !strm.read(magic, 4) || memcmp(magic, program_cache_magic, 4) != 0 ) return false ;
+    if ( !strm.read((char *)&stored_key, sizeof(stored_key)) || stored_key != key ) return false ;
+    if ( !strm.read((char *)&driver_len, sizeof(driver_len)) || driver_len != driver.size() ) return false ;
+
+    std::string stored_driver(driver_len, 0) ;
+    if ( !strm.read(&stored_driver[0], driver_len) || stored_driver != driver ) return false ;
+
+    if ( !strm.read((char *)&format, sizeof(format)) || !strm.read((char *)&size, sizeof(size)) || size == 0 ) return false ;
+
+    data.resize(size) ;
+    return (bool)strm.read(data.data(), size) ;
+}
+
+// The entry is written to a temporary file first so that concurrent runs never read a partial entry
+
+void OpenGLShaderResourceManager::storeProgramBinary(uint64_t key, const std::string &driver, uint32_t format, const std::vector<char> &data) {
+    if ( instance_.cache_folder_.empty() || data.empty() ) return ;
+
+    std::string path = programCachePath(instance_.cache_folder_, key) ;
+    std::string tmp_path = path + ".tmp" ;
+
+    {
+        std::ofstream strm(tmp_path, std::ios::binary) ;
+        if ( !strm ) return ;
+
+        uint32_t driver_len = driver.size(), size = data.size() ;
+
+        strm.write(program_cache_magic, 4) ;
+        strm.write((const char *)&key, sizeof(key)) ;
+        strm.write((const char *)&driver_len, sizeof(driver_len)) ;
+        strm.write(driver.data(), driver_len) ;
+        strm.write((const char *)&format, sizeof(format)) ;
+        strm.write((const char *)&size, sizeof(size)) ;
+        strm.write(data.data(), size) ;
+
+        if ( !strm ) {
+            strm.close() ;
+            std::remove(tmp_path.c_str()) ;
+            return ;
+        }
+    }
+
+    // rename does not replace existing files on all platforms
+
+    if ( std::rename(tmp_path.c_str(), path.c_str()) != 0 ) {
+        std::remove(path.c_str()) ;
+        if ( std::rename(tmp_path.c_str(), path.c_str()) != 0 )
+            std::remove(tmp_path.c_str()) ;
+    }
 }
 
 OpenGLShaderResourceManager::OpenGLShaderResourceManager() {
@@ -48,9 +132,16 @@ OpenGLShaderResourceManager::OpenGLShaderResourceManager() {
     addSource("shadow_map_shader_fs", shadow_map_shader_fs) ;
     addSource("shadow_debug_shader_vs", shadow_debug_shader_vs) ;
     addSource("shadow_debug_shader_fs", shadow_debug_shader_fs) ;
+    addSource("occlusion_box_vs", occlusion_box_vs) ;
+    addSource("downsample_vs", downsample_vs) ;
+    addSource("downsample_fs", downsample_fs) ;
     addSource("wireframe_fragment_shader", wireframe_shader_fs) ;
     addSource("wireframe_geometry_shader", wireframe_shader_gs) ;
+    addSource("capture_fragment_shader", capture_fragment_shader) ;
     addSource("light_vars", light_vars) ;
+    addSource("uniform_blocks", uniform_blocks) ;
+    addSource("skinning_vars", skinning_vars) ;
+    addSource("skinning_feedback_vs", skinning_feedback_vs) ;
 }
 
 void OpenGLShaderResourceManager::addSource(const char * name, const char *src) {
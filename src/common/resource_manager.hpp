@@ -3,22 +3,38 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 namespace xviz { namespace impl {
 
 class OpenGLShader ;
+class OpenGLShaderProgram ;
+class OpenGLShaderSource ;
 
 class OpenGLShaderResourceManager {
 public:
 
     static void setShaderResourceFolder(const std::string &folder) ;
 
+    // Existing folder where linked programs are stored with glGetProgramBinary and reloaded by later runs,
+    // instead of compiling their shaders again. An empty folder (the default) disables the cache.
+    static void setProgramCacheFolder(const std::string &folder) ;
+    static const std::string &programCacheFolder() { return instance_.cache_folder_ ; }
+
 private:
     friend class OpenGLShader ;
+    friend class OpenGLShaderProgram ;
+    friend class OpenGLShaderSource ;
 
     // load resource (internal or file)
     static std::string fetch(const std::string &name) ;
 
+    // Read or write the cache entry named after key. The entry records the driver that produced the binary and
+    // the hash of the sources, loading fails if either differs or the file is truncated.
+    static bool loadProgramBinary(uint64_t key, const std::string &driver, uint32_t &format, std::vector<char> &data) ;
+    static void storeProgramBinary(uint64_t key, const std::string &driver, uint32_t format, const std::vector<char> &data) ;
+
     OpenGLShaderResourceManager() ;
 
     void addSource(const char *name, const char *src) ;
@@ -27,6 +43,7 @@ private:
 
     std::map<std::string, std::string> sources_ ;
     std::string folder_ ;
+    std::string cache_folder_ ;
 };
 
 }}
@@ -2,12 +2,14 @@
 
 #include <cstring>
 #include <fstream>
-#include <regex>
+#include <sstream>
 #include <iostream>
 #include <cstdint>
 
 
 #include "common/resource_manager.hpp"
+#include "common/gl_loader.hpp"
+#include "common/shader_source.hpp"
 
 using namespace std ;
 using namespace Eigen ;
@@ -72,145 +74,24 @@ void OpenGLShader::addPreProcDefinition(const string &key, const string &val) {
 
 void OpenGLShader::setSourceCode(const std::string &code) {
     code_ = code ;
-    compile() ;
+    submitted_ = compiled_ = false ;
 }
 
 
-void OpenGLShader::preproc(const std::string &file_name, const OpenGLShaderPreproc &defines, bool version_parsed) {
-    string fragment = OpenGLShaderResourceManager::fetch(file_name) ;
-    if ( fragment.empty() ) throw_error(code_, "Cannot load shader resource string from: ", file_name.c_str()) ;
-
-    std::stringstream is(fragment);
-
-    static const std::regex rx("[ \t]*#include[ \t]+<([@\\w\\d_./]+)>");
-
-    std::smatch match;
-
-    while ( is ) {
-        string line ;
-        std::getline(is, line,'\n') ;
-
-        // append any definition after first #version is encountered
-        if ( !version_parsed && line.find("#version") != string::npos ) {
-
-            code_.append(std::move(line)) ;
-            code_.append("\n") ;
-            for( const auto &dp: defines.defines_ ) {
-                code_.append("#define ") ;
-                code_.append(dp) ;
-                code_.append("\n") ;
-            }
-
-            for( const auto &dp: defines.constants_ ) {
-                code_.append("#define ") ;
-                code_.append(dp.first) ;
-                code_.append(" ") ;
-                code_.append(dp.second) ;
-                code_.append("\n") ;
-            }
-            version_parsed = true ;
-        } else if ( std::regex_match(line, match, rx) ) {
-            if ( match.size() == 2 ) {
-                std::ssub_match sub_match = match[1];
-                std::string include_str = sub_match.str();
-                preproc(include_str, defines, version_parsed) ;
-            }
-        } else if ( line.find("#pragma unroll_loop_start") != string::npos ) {
-            string loop ;
-            while ( is ) {
-                std::getline(is, line,'\n') ;
-                if ( line.find("#pragma unroll_loop_end") != string::npos ) break ;
-                else loop += line + '\n';
-            }
-            unrollLoop(loop, defines.constants_) ;
-
-        } else {
-            code_.append(line) ;
-            code_.append("\n") ;
-        }
-
-    }
-
-
-}
-
-void OpenGLShader::unrollLoop(const string &loop, const std::map<std::string, std::string> &constants )
-{
-
-     static const std::regex for_loop_rx(R"(\s*for\s*\(\s*int\s+i\s*=\s*(\d+)\s*;\s*i\s*<\s*(\w+)\s*;\s*i\s*\+\+\s*\)\s*\{([\S\s]*)$)",
-                                         std::regex_constants::ECMAScript);
-
-    std::smatch match;
-
-    if ( !std::regex_match(loop, match, for_loop_rx) ) {
-        assert("Unsupported for loop construct") ;
-        return ;
-    }
-
-    auto loop_start = match[1].str() ;
-    auto loop_sz = match[2].str() ;
-    auto remaining = match[3].str() ;
-
-    // deal with nested blocks
-    string loop_body ;
-
-    int brackets = 1 ;
-    for( char c : remaining ) {
-        if ( c == '{' ) {
-            ++ brackets ;
-            loop_body.push_back(c) ;
-        } else if ( c == '}' ) {
-            --brackets ;
-            if ( brackets == 0 ) break ;
-            else loop_body.push_back(c) ;
-        } else
-            loop_body.push_back(c) ;
-    }
-
-    // replace loop sz with variable
-
-    for( const auto &cp: constants ) {
-        if ( cp.first == loop_sz ) {
-            loop_sz = cp.second ;
-            break ;
-        }
-    }
-
-
-    int loop_sz_num = 0 ;
-    try {
-        loop_sz_num = stoi(loop_sz) ;
-    } catch ( std::exception &e ) {
-        // if a variable was not defined ignore loop
-    }
-
-
-    // write the unrolled loop
-
-    static regex index_rx("\\[\\s*i\\s*\\]") ;
-    static regex var_rx("UNROLLED_LOOP_INDEX") ;
-    for ( int i=stoi(loop_start) ; i<loop_sz_num ; i++ ) {
-        string unrolled_body = std::regex_replace(loop_body, index_rx, "[" + to_string(i) + "]") ;
-        unrolled_body = std::regex_replace(unrolled_body, var_rx, to_string(i)) ;
-        code_ += "\n{" ;
-        code_ += unrolled_body ;
-        code_ += "\n}\n" ;
-    }
-
-}
-
 void OpenGLShader::setSourceFile(const std::string &file_name, const OpenGLShaderPreproc &defines) {
     resource_name_ = file_name ;
 
-    preproc(file_name, defines, false) ;
+    code_.clear() ;
+    submitted_ = compiled_ = false ;
 
-    compile() ;
+    code_ = OpenGLShaderSource::preprocess(file_name, defines) ;
+    if ( code_.empty() ) throw_error(code_, "Cannot load shader resource string from: ", file_name.c_str()) ;
 }
 
 
-void OpenGLShader::compile() {
+void OpenGLShader::submit() {
 
-    if ( compiled_ ) return ;
+    if ( submitted_ ) return ;
 
     GLint len  ;
     const GLchar *source[1] ;
@@ -221,6 +102,15 @@ void OpenGLShader::compile() {
     glShaderSource(handle_, 1, source, &len);
     glCompileShader(handle_);
 
+    submitted_ = true ;
+}
+
+void OpenGLShader::compile() {
+
+    if ( compiled_ ) return ;
+
+    submit() ;
+
     GLint success;
     glGetShaderiv(handle_, GL_COMPILE_STATUS, &success);
 
@@ -253,51 +143,158 @@ OpenGLShaderProgram::OpenGLShaderProgram(const char *vshader_code, const char *f
     link();
 }
 
+OpenGLShaderStats OpenGLShaderProgram::stats_ ;
+
+void setUniformValue(GLint loc, float v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform1f(loc, v) ;
+}
+
+void setUniformValue(GLint loc, GLint v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform1i(loc, v) ;
+}
+
+void setUniformValue(GLint loc, GLuint v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform1ui(loc, v) ;
+}
+
+void setUniformValue(GLint loc, const Vector2f &v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform2fv(loc, 1, v.data()) ;
+}
+
+void setUniformValue(GLint loc, const Vector3f &v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform3fv(loc, 1, v.data()) ;
+}
+
+void setUniformValue(GLint loc, const Vector4f &v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniform4fv(loc, 1, v.data()) ;
+}
+
+void setUniformValue(GLint loc, const Matrix3f &v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniformMatrix3fv(loc, 1, GL_FALSE, v.data()) ;
+}
+
+void setUniformValue(GLint loc, const Matrix4f &v) {
+    auto &stats = OpenGLShaderProgram::stats() ;
+    ++stats.uniform_sets_ ;
+    if ( loc == -1 ) return ;
+    ++stats.uniform_uploads_ ;
+    glUniformMatrix4fv(loc, 1, GL_FALSE, v.data()) ;
+}
+
+int OpenGLShaderProgram::uniformLocation(const string &name) const {
+    auto it = uniform_locations_.find(name) ;
+    return ( it == uniform_locations_.end() ) ? -1 : it->second ;
+}
+
 void OpenGLShaderProgram::setUniform(const string &name, float v) {
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform1f(loc, v) ;
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, GLuint v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform1ui(loc, v) ;
+void OpenGLShaderProgram::setUniform(const string &name, GLuint v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, GLint v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform1i(loc, v) ;
+void OpenGLShaderProgram::setUniform(const string &name, GLint v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, const Vector3f &v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform3fv(loc, 1, v.data()) ;
+void OpenGLShaderProgram::setUniform(const string &name, const Vector3f &v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, const Vector2f &v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform2fv(loc, 1, v.data()) ;
+void OpenGLShaderProgram::setUniform(const string &name, const Vector2f &v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, const Vector4f &v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniform4fv(loc, 1, v.data()) ;
+void OpenGLShaderProgram::setUniform(const string &name, const Vector4f &v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, const Matrix3f &v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniformMatrix3fv(loc, 1, GL_FALSE, v.data()) ;
+void OpenGLShaderProgram::setUniform(const string &name, const Matrix3f &v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
 }
 
-void OpenGLShaderProgram::setUniform(const string &name, const Matrix4f &v)
-{
-    GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
-    if ( loc != -1 ) glUniformMatrix4fv(loc, 1, GL_FALSE, v.data()) ;
+void OpenGLShaderProgram::setUniform(const string &name, const Matrix4f &v) {
+    ++stats_.name_lookups_ ;
+    setUniformValue(uniformLocation(name), v) ;
+}
+
+// Introspect the linked program and store the location of every active uniform.
+// Array elements are registered individually (e.g. "g_bones[3]") as well as by the array name.
+
+void OpenGLShaderProgram::cacheUniformLocations() {
+    uniform_locations_.clear() ;
+
+    GLint n_uniforms = 0, max_length = 0 ;
+    glGetProgramiv(handle_, GL_ACTIVE_UNIFORMS, &n_uniforms) ;
+    glGetProgramiv(handle_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length) ;
+
+    std::unique_ptr<GLchar []> buffer(new GLchar [max_length + 1]) ;
+
+    for( GLint i=0 ; i<n_uniforms ; i++ ) {
+        GLsizei length ;
+        GLint size ;
+        GLenum type ;
+        glGetActiveUniform(handle_, (GLuint)i, max_length + 1, &length, &size, &type, buffer.get()) ;
+
+        string name(buffer.get(), length) ;
+
+        GLint loc = glGetUniformLocation(handle_, name.c_str()) ;
+        ++stats_.location_queries_ ;
+
+        if ( loc == -1 ) continue ; // uniforms of named blocks have no location
+
+        uniform_locations_.emplace(name, loc) ;
+
+        // arrays are reported once with the name of the first element
+
+        if ( name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0 ) {
+            string base = name.substr(0, name.size() - 3) ;
+            uniform_locations_.emplace(base, loc) ;
+
+            for( GLint k=1 ; k<size ; k++ ) {
+                string elem = base + '[' + std::to_string(k) + ']' ;
+                GLint eloc = glGetUniformLocation(handle_, elem.c_str()) ;
+                ++stats_.location_queries_ ;
+                if ( eloc != -1 ) uniform_locations_.emplace(elem, eloc) ;
+            }
+        }
+    }
 }
 
 OpenGLShaderProgram::~OpenGLShaderProgram() {
@@ -309,44 +306,94 @@ OpenGLShaderProgram::OpenGLShaderProgram() {
 }
 
 void OpenGLShaderProgram::addShader(const OpenGLShaderPtr &shader) {
-    shader->compile() ;
     shaders_.push_back(shader) ;
 }
 
 void OpenGLShaderProgram::addShaderFromCode(OpenGLShaderType t, const string &code) {
     auto shader = std::make_shared<OpenGLShader>(t) ;
     shader->setSourceCode(code) ;
-    shader->compile() ;
     addShader(shader) ;
 }
 
 void OpenGLShaderProgram::addShaderFromFile(OpenGLShaderType t, const string &fname, const OpenGLShaderPreproc &preproc) {
     auto shader = std::make_shared<OpenGLShader>(t) ;
     shader->setSourceFile(fname, preproc) ;
-    shader->compile() ;
     addShader(shader) ;
 }
 
+void OpenGLShaderProgram::setTransformFeedbackVaryings(const std::vector<string> &varyings, GLenum mode) {
+    feedback_varyings_ = varyings ;
+    feedback_mode_ = mode ;
+}
+
 void OpenGLShaderProgram::link(bool validate) {
+    beginLink() ;
+    finishLink(validate) ;
+}
 
-#if 0
-    const GLchar* feedbackVaryings[] = { "gl_Position" };
-    glTransformFeedbackVaryings(handle_, 1, feedbackVaryings, GL_INTERLEAVED_ATTRIBS);
-#endif
+void OpenGLShaderProgram::beginLink() {
+
+    if ( !feedback_varyings_.empty() ) {
+        std::vector<const GLchar *> names ;
+        for( const string &v: feedback_varyings_ )
+            names.push_back(v.c_str()) ;
+        glTransformFeedbackVaryings(handle_, (GLsizei)names.size(), names.data(), feedback_mode_) ;
+    }
+
+    use_cache_ = !OpenGLShaderResourceManager::programCacheFolder().empty() ;
+    binary_key_ = use_cache_ ? binaryKey() : 0 ;
+
+    link_pending_ = true ;
+    from_binary_ = use_cache_ && loadBinary(binary_key_) ;
+
+    if ( from_binary_ ) return ;
+
+    // compile errors are reported by finishLink, querying them here would wait for the compiler
 
-    for( const auto &shader: shaders_ )
+    for( const auto &shader: shaders_ ) {
+        shader->submit() ;
         glAttachShader(handle_, shader->handle()) ;
+    }
 
-    GLchar error_log[1024] = { 0 };
+    if ( use_cache_ )
+        glProgramParameteri(handle_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE) ;
 
     glLinkProgram(handle_) ;
+}
 
+bool OpenGLShaderProgram::linkCompleted() const {
+    if ( !link_pending_ || from_binary_ || !parallelCompileSupported() ) return true ;
+
+    GLint completed = GL_TRUE ;
+    glGetProgramiv(handle_, GL_COMPLETION_STATUS_KHR, &completed) ;
+    return completed != GL_FALSE ;
+}
+
+void OpenGLShaderProgram::finishLink(bool validate) {
+
+    if ( !link_pending_ ) return ;
+    link_pending_ = false ;
+
+    GLchar error_log[1024] = { 0 };
     GLint success;
-    glGetProgramiv(handle_, GL_LINK_STATUS, &success);
 
-    if ( success == 0 ) {
-        glGetProgramInfoLog(handle_, sizeof(error_log), NULL, error_log);
-        throw_error({}, "Error linking shader program", error_log) ;
+    if ( from_binary_ ) {
+        ++stats_.programs_loaded_ ;
+    } else {
+        glGetProgramiv(handle_, GL_LINK_STATUS, &success);
+
+        if ( success == 0 ) {
+            // a shader that failed to compile is the most likely cause
+            for( const auto &shader: shaders_ )
+                shader->compile() ;
+
+            glGetProgramInfoLog(handle_, sizeof(error_log), NULL, error_log);
+            throw_error({}, "Error linking shader program", error_log) ;
+        }
+
+        ++stats_.programs_compiled_ ;
+
+        if ( use_cache_ ) storeBinary(binary_key_) ;
     }
 
     if ( validate ) {
@@ -358,6 +405,132 @@ void OpenGLShaderProgram::link(bool validate) {
             throw_error({}, "Invalid shader program", error_log);
         }
     }
+
+    cacheUniformLocations() ;
+}
+
+bool OpenGLShaderProgram::parallelCompileSupported() {
+    static int supported = -1 ;
+
+    if ( supported < 0 ) {
+        supported = 0 ;
+
+        GLint n = 0 ;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &n) ;
+
+        const char *entry_point = nullptr ;
+
+        for( GLint i=0 ; i<n && !entry_point ; i++ ) {
+            const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i) ;
+            if ( !ext ) continue ;
+            if ( strcmp(ext, "GL_KHR_parallel_shader_compile") == 0 ) entry_point = "glMaxShaderCompilerThreadsKHR" ;
+            else if ( strcmp(ext, "GL_ARB_parallel_shader_compile") == 0 ) entry_point = "glMaxShaderCompilerThreadsARB" ;
+        }
+
+        // the number of compiler threads defaults to an implementation dependent value, which may be zero
+
+        if ( entry_point ) {
+            typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count) ;
+            auto max_threads = (MaxShaderCompilerThreadsProc)glProcAddress(entry_point) ;
+            if ( max_threads ) max_threads(0xFFFFFFFF) ;
+            supported = 1 ;
+        }
+    }
+
+    return supported ;
+}
+
+// The driver that produced a binary, binaries are not portable across drivers or driver versions
+
+static const string &driverIdentity() {
+    static string identity ;
+    if ( identity.empty() ) {
+        for( GLenum name: { GL_VENDOR, GL_RENDERER, GL_VERSION } ) {
+            const GLubyte *str = glGetString(name) ;
+            if ( str ) identity += (const char *)str ;
+            identity += '\n' ;
+        }
+    }
+    return identity ;
+}
+
+// FNV-1a, stable across runs and platforms unlike std::hash
+
+static void hashBytes(uint64_t &h, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data ;
+    for( size_t i=0 ; i<size ; i++ ) {
+        h ^= p[i] ;
+        h *= 1099511628211ull ;
+    }
+}
+
+static void hashString(uint64_t &h, const string &s) {
+    uint64_t len = s.size() ;
+    hashBytes(h, &len, sizeof(len)) ;
+    hashBytes(h, s.data(), s.size()) ;
+}
+
+// Cache key of the program, derived from everything that affects the linked binary
+
+uint64_t OpenGLShaderProgram::binaryKey() const {
+    uint64_t h = 14695981039346656037ull ;
+
+    hashString(h, driverIdentity()) ;
+
+    for( const auto &shader: shaders_ ) {
+        int32_t type = shader->type() ;
+        hashBytes(h, &type, sizeof(type)) ;
+        hashString(h, shader->code()) ;
+    }
+
+    for( const string &v: feedback_varyings_ )
+        hashString(h, v) ;
+    hashBytes(h, &feedback_mode_, sizeof(feedback_mode_)) ;
+
+    return h ;
+}
+
+// A binary that the driver rejects (e.g. after a driver update that did not change the version string) leaves the
+// program unlinked and the caller falls back to compiling from source.
+
+bool OpenGLShaderProgram::loadBinary(uint64_t key) {
+    uint32_t format ;
+    std::vector<char> data ;
+
+    if ( !OpenGLShaderResourceManager::loadProgramBinary(key, driverIdentity(), format, data) ) return false ;
+
+    glProgramBinary(handle_, format, data.data(), (GLsizei)data.size()) ;
+
+    GLint success = 0 ;
+    glGetProgramiv(handle_, GL_LINK_STATUS, &success) ;
+
+    return success != 0 ;
+}
+
+void OpenGLShaderProgram::storeBinary(uint64_t key) {
+    GLint formats = 0, length = 0 ;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats) ;
+    if ( formats == 0 ) return ;
+
+    glGetProgramiv(handle_, GL_PROGRAM_BINARY_LENGTH, &length) ;
+    if ( length <= 0 ) return ;
+
+    std::vector<char> data(length) ;
+    GLenum format = 0 ;
+    GLsizei written = 0 ;
+    glGetProgramBinary(handle_, length, &written, &format, data.data()) ;
+    if ( written <= 0 ) return ;
+
+    data.resize(written) ;
+    OpenGLShaderResourceManager::storeProgramBinary(key, driverIdentity(), format, data) ;
+}
+
+bool OpenGLShaderProgram::bindUniformBlock(const string &block_name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(handle_, block_name.c_str()) ;
+    if ( index == GL_INVALID_INDEX ) return false ;
+
+    glUniformBlockBinding(handle_, index, binding) ;
+    return true ;
 }
 
 void OpenGLShaderProgram::use() {
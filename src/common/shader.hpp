@@ -6,6 +6,7 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <cstdint>
 #include <Eigen/Core>
 #include <memory>
@@ -30,6 +31,7 @@ struct OpenGLShaderPreproc {
 private:
 
     friend class OpenGLShader ;
+    friend class OpenGLShaderSource ;
 
     std::map<std::string, std::string> constants_ ;
     std::vector<std::string> defines_ ;
@@ -43,9 +45,10 @@ public:
     void setHeader(const std::string &header) ;
     void addPreProcDefinition(const std::string &key, const std::string &val = std::string()) ;
 
-    // Compile shader from source code string.
+    // Set the source code. Compilation is deferred until the program is linked, so that it is skipped
+    // when the program is found in the binary cache (see OpenGLShaderResourceManager::setProgramCacheFolder).
     void setSourceCode(const std::string &code) ;
-    // Loads the code from the designated file or internal resource string and calls compile.
+    // Loads the code from the designated file or internal resource string.
     // Internal resources are designated by prepending the filename with '@'.
     // A preprocessor is run on the loaded resource. This will resolve any #include directives,
     // prepend any defines, or replace any defined strings with their value
@@ -54,23 +57,29 @@ public:
 
     ~OpenGLShader() ;
 
+    // pass the source to the driver, which may compile it in the background
+    void submit() ;
+    // wait for the compilation to complete, throws on errors
     void compile() ;
 
     bool isCompiled() const { return compiled_ ; }
 
     unsigned int handle() const { return handle_; }
 
+    OpenGLShaderType type() const { return type_ ; }
+
+    // preprocessed source code
+    const std::string &code() const { return code_ ; }
+
 private:
 
     void create(OpenGLShaderType t) ;
-    void preproc(const std::string &filename, const OpenGLShaderPreproc &defines, bool version_parsed) ;
-    void unrollLoop(const std::string &loop, const std::map<std::string, std::string> &constants) ;
 
     std::string header_ = "#version 330\n" ;
     std::string preproc_ ;
 
     unsigned int handle_ ;
-    bool compiled_ = false ;
+    bool submitted_ = false, compiled_ = false ;
 
     std::string code_ ;
     std::string resource_name_ ;
@@ -79,6 +88,48 @@ private:
 
 using OpenGLShaderPtr = std::shared_ptr<OpenGLShader> ;
 
+// Counters of shader and uniform related driver calls, used for profiling
+
+struct OpenGLShaderStats {
+    uint64_t location_queries_ = 0 ;    // calls to glGetUniformLocation
+    uint64_t uniform_sets_ = 0 ;        // requests to set a uniform (by name or handle)
+    uint64_t uniform_uploads_ = 0 ;     // calls to glUniform*
+    uint64_t name_lookups_ = 0 ;        // uniforms set by name (hash lookup in the location cache)
+    uint64_t programs_compiled_ = 0 ;   // programs compiled and linked from source
+    uint64_t programs_loaded_ = 0 ;     // programs loaded from the binary cache
+
+    void reset() { *this = OpenGLShaderStats() ; }
+};
+
+// upload of a uniform value to the current program given its location
+
+void setUniformValue(GLint loc, float v) ;
+void setUniformValue(GLint loc, GLint v) ;
+void setUniformValue(GLint loc, GLuint v) ;
+void setUniformValue(GLint loc, const Eigen::Vector2f &v) ;
+void setUniformValue(GLint loc, const Eigen::Vector3f &v) ;
+void setUniformValue(GLint loc, const Eigen::Vector4f &v) ;
+void setUniformValue(GLint loc, const Eigen::Matrix3f &v) ;
+void setUniformValue(GLint loc, const Eigen::Matrix4f &v) ;
+
+// Typed handle of a uniform of a linked program. The location is resolved once (see OpenGLShaderProgram::uniform)
+// so that uploading a value does not involve any string building or hashing.
+
+template<typename T>
+class OpenGLUniform {
+public:
+    OpenGLUniform() = default ;
+    explicit OpenGLUniform(GLint loc): location_(loc) {}
+
+    bool isValid() const { return location_ != -1 ; }
+    GLint location() const { return location_ ; }
+
+    void set(const T &v) const { setUniformValue(location_, v) ; }
+
+private:
+    GLint location_ = -1 ;
+};
+
 class OpenGLShaderProgram {
 public:
 
@@ -90,14 +141,38 @@ public:
     void addShaderFromCode(OpenGLShaderType t, const std::string &code) ;
     void addShaderFromFile(OpenGLShaderType t, const std::string &fname, const OpenGLShaderPreproc &preproc = {}) ;
 
+    // outputs of the vertex shader captured by transform feedback, takes effect at the next link
+    void setTransformFeedbackVaryings(const std::vector<std::string> &varyings, GLenum mode = GL_INTERLEAVED_ATTRIBS) ;
+
     void link(bool validate = true) ;
+
+    // Linking in two steps: beginLink submits the shaders and starts the link without waiting for the driver, which
+    // compiles them in background threads when parallelCompileSupported(). linkCompleted polls the progress and
+    // finishLink waits for the outcome and resolves the uniforms.
+    void beginLink() ;
+    bool linkCompleted() const ;
+    void finishLink(bool validate = true) ;
+
+    // GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile is available
+    static bool parallelCompileSupported() ;
+
     void use() ;
     void release() ;
 
     int attributeLocation(const std::string &attr_name) ;
     void bindAttributeLocation(const std::string &attr_name, int loc) ;
 
-    int uniformLocation(const std::string &uni_name) ;
+    // location of the uniform as found in the cache filled at link time, -1 if the uniform is not active
+    int uniformLocation(const std::string &uni_name) const ;
+
+    // pre-resolved handle for the named uniform
+    template<typename T>
+    OpenGLUniform<T> uniform(const std::string &name) const {
+        return OpenGLUniform<T>(uniformLocation(name)) ;
+    }
+
+    // assign the named uniform block to a binding point, returns false if the block is not active
+    bool bindUniformBlock(const std::string &block_name, GLuint binding) ;
 
     OpenGLShaderProgram(const char *vshader, const char *fshader) ;
 
@@ -114,13 +189,25 @@ public:
 
     unsigned int handle() const { return handle_ ; }
 
+    static OpenGLShaderStats &stats() { return stats_ ; }
 
 private:
 
     void throwError(const char *error_str, const char *error_desc) ;
+    void cacheUniformLocations() ;
+    uint64_t binaryKey() const ;
+    bool loadBinary(uint64_t key) ;
+    void storeBinary(uint64_t key) ;
 
     unsigned int handle_ ;
     std::vector<OpenGLShaderPtr> shaders_ ;
+    std::unordered_map<std::string, GLint> uniform_locations_ ;
+    std::vector<std::string> feedback_varyings_ ;
+    GLenum feedback_mode_ = GL_INTERLEAVED_ATTRIBS ;
+    uint64_t binary_key_ = 0 ;
+    bool link_pending_ = false, use_cache_ = false, from_binary_ = false ;
+
+    static OpenGLShaderStats stats_ ;
 };
 
 
@@ -0,0 +1,244 @@
+#include "shader_source.hpp"
+#include "shader.hpp"
+#include "resource_manager.hpp"
+
+#include <sstream>
+#include <cstring>
+#include <cctype>
+
+using namespace std ;
+
+namespace xviz { namespace impl {
+
+std::map<std::string, std::unique_ptr<OpenGLShaderSource>> OpenGLShaderSource::sources_ ;
+std::unordered_map<std::string, std::string> OpenGLShaderSource::variants_ ;
+
+// matches a whole line of the form: [ \t]*#include[ \t]+<name> with name made of [@\w./]
+
+static bool parseInclude(const string &line, string &name) {
+    size_t pos = line.find_first_not_of(" \t") ;
+    if ( pos == string::npos || line.compare(pos, 8, "#include") != 0 ) return false ;
+    pos += 8 ;
+
+    size_t start = line.find_first_not_of(" \t", pos) ;
+    if ( start == string::npos || start == pos || line[start] != '<' ) return false ;
+
+    size_t end = line.find('>', start) ;
+    if ( end == string::npos || end + 1 != line.size() || end == start + 1 ) return false ;
+
+    for( size_t i=start+1 ; i<end ; i++ ) {
+        char c = line[i] ;
+        if ( !isalnum((unsigned char)c) && c != '_' && c != '@' && c != '.' && c != '/' ) return false ;
+    }
+
+    name = line.substr(start + 1, end - start - 1) ;
+    return true ;
+}
+
+const OpenGLShaderSource *OpenGLShaderSource::get(const string &name) {
+    auto it = sources_.find(name) ;
+    if ( it != sources_.end() ) return it->second.get() ;
+
+    string code = OpenGLShaderResourceManager::fetch(name) ;
+    if ( code.empty() ) return nullptr ;
+
+    // registered before parsing so that the includes of the resource may refer back to it
+
+    OpenGLShaderSource *src = new OpenGLShaderSource ;
+    sources_.emplace(name, std::unique_ptr<OpenGLShaderSource>(src)) ;
+    src->parse(code) ;
+
+    return src ;
+}
+
+void OpenGLShaderSource::appendText(const string &text) {
+    if ( segments_.empty() || segments_.back().type_ != Segment::Text ) {
+        Segment seg ;
+        seg.type_ = Segment::Text ;
+        segments_.emplace_back(std::move(seg)) ;
+    }
+
+    segments_.back().text_ += text ;
+}
+
+void OpenGLShaderSource::parse(const string &code) {
+    std::stringstream is(code);
+
+    while ( is ) {
+        string line, include ;
+        std::getline(is, line,'\n') ;
+
+        if ( line.find("#version") != string::npos ) {
+            Segment seg ;
+            seg.type_ = Segment::Version ;
+            seg.text_ = line + '\n' ;
+            segments_.emplace_back(std::move(seg)) ;
+        } else if ( parseInclude(line, include) ) {
+            Segment seg ;
+            seg.type_ = Segment::Include ;
+            seg.include_ = get(include) ;
+            seg.text_ = include ;
+            segments_.emplace_back(std::move(seg)) ;
+        } else if ( line.find("#pragma unroll_loop_start") != string::npos ) {
+            string loop ;
+            while ( is ) {
+                std::getline(is, line,'\n') ;
+                if ( line.find("#pragma unroll_loop_end") != string::npos ) break ;
+                else loop += line + '\n';
+            }
+            parseLoop(loop) ;
+        } else
+            appendText(line + '\n') ;
+    }
+}
+
+// Only loops of the form "for( int i=<start> ; i<<bound> ; i++ ) { ... }" are supported, where the bound is a
+// number or a constant of the variant. Other loops are dropped.
+
+void OpenGLShaderSource::parseLoop(const string &loop) {
+    size_t pos = 0 ;
+
+    auto space = [&]() {
+        size_t start = pos ;
+        while ( pos < loop.size() && isspace((unsigned char)loop[pos]) ) ++pos ;
+        return pos > start ;
+    } ;
+
+    auto token = [&](const char *t) {
+        size_t n = strlen(t) ;
+        if ( loop.compare(pos, n, t) != 0 ) return false ;
+        pos += n ;
+        space() ;
+        return true ;
+    } ;
+
+    auto word = [&](bool digits) {
+        size_t start = pos ;
+        while ( pos < loop.size() && ( digits ? isdigit((unsigned char)loop[pos]) : ( isalnum((unsigned char)loop[pos]) || loop[pos] == '_' ) ) ) ++pos ;
+        string w = loop.substr(start, pos - start) ;
+        space() ;
+        return w ;
+    } ;
+
+    space() ;
+    if ( !token("for") || !token("(") ) return ;
+    if ( loop.compare(pos, 3, "int") != 0 ) return ;
+    pos += 3 ;
+    if ( !space() ) return ;
+    if ( !token("i") || !token("=") ) return ;
+    string start = word(true) ;
+    if ( start.empty() || !token(";") || !token("i") || !token("<") ) return ;
+    string bound = word(false) ;
+    if ( bound.empty() || !token(";") || !token("i") || !token("++") || !token(")") ) return ;
+    if ( pos == loop.size() || loop[pos++] != '{' ) return ;
+
+    Segment seg ;
+    seg.type_ = Segment::Loop ;
+    seg.text_ = bound ;
+    seg.loop_start_ = stoi(start) ;
+    seg.body_.emplace_back() ;
+
+    // body up to the matching bracket, split at the index substitutions
+
+    static const string index_var = "UNROLLED_LOOP_INDEX" ;
+
+    int brackets = 1 ;
+    for( size_t i = pos ; i<loop.size() ; i++ ) {
+        char c = loop[i] ;
+
+        if ( c == '{' ) ++brackets ;
+        else if ( c == '}' && --brackets == 0 ) break ;
+
+        if ( c == '[' ) {
+            size_t k = loop.find_first_not_of(" \t\r\n\f\v", i + 1) ;
+            if ( k != string::npos && loop[k] == 'i' ) {
+                size_t e = loop.find_first_not_of(" \t\r\n\f\v", k + 1) ;
+                if ( e != string::npos && loop[e] == ']' ) {
+                    seg.body_.back() += '[' ;
+                    seg.body_.emplace_back("]") ;
+                    i = e ;
+                    continue ;
+                }
+            }
+        } else if ( loop.compare(i, index_var.size(), index_var) == 0 ) {
+            seg.body_.emplace_back() ;
+            i += index_var.size() - 1 ;
+            continue ;
+        }
+
+        seg.body_.back() += c ;
+    }
+
+    segments_.emplace_back(std::move(seg)) ;
+}
+
+void OpenGLShaderSource::generate(string &code, const OpenGLShaderPreproc &defines, const string &definitions, bool version_parsed) const {
+    for( const Segment &seg: segments_ ) {
+        switch ( seg.type_ ) {
+        case Segment::Text:
+            code += seg.text_ ;
+            break ;
+        case Segment::Version:
+            // definitions are inserted after the first #version encountered
+            code += seg.text_ ;
+            if ( !version_parsed ) {
+                code += definitions ;
+                version_parsed = true ;
+            }
+            break ;
+        case Segment::Include:
+            if ( !seg.include_ ) throw OpenGLShaderError("Cannot load shader resource string from: " + seg.text_) ;
+            seg.include_->generate(code, defines, definitions, version_parsed) ;
+            break ;
+        case Segment::Loop: {
+            auto it = defines.constants_.find(seg.text_) ;
+            const string &bound = ( it == defines.constants_.end() ) ? seg.text_ : it->second ;
+
+            // if a variable was not defined ignore loop
+            int count = 0 ;
+            try {
+                count = stoi(bound) ;
+            } catch ( std::exception & ) {
+            }
+
+            for( int i=seg.loop_start_ ; i<count ; i++ ) {
+                const string index = to_string(i) ;
+                code += "\n{" ;
+                code += seg.body_[0] ;
+                for( size_t k=1 ; k<seg.body_.size() ; k++ ) {
+                    code += index ;
+                    code += seg.body_[k] ;
+                }
+                code += "\n}\n" ;
+            }
+            break ;
+        }
+        }
+    }
+}
+
+const string &OpenGLShaderSource::preprocess(const string &name, const OpenGLShaderPreproc &defines) {
+    string definitions ;
+
+    for( const auto &dp: defines.defines_ )
+        definitions += "#define " + dp + '\n' ;
+
+    for( const auto &dp: defines.constants_ )
+        definitions += "#define " + dp.first + ' ' + dp.second + '\n' ;
+
+    auto it = variants_.find(name + '\n' + definitions) ;
+    if ( it != variants_.end() ) return it->second ;
+
+    string code ;
+    if ( const OpenGLShaderSource *src = get(name) )
+        src->generate(code, defines, definitions, false) ;
+
+    return variants_.emplace(name + '\n' + definitions, std::move(code)).first->second ;
+}
+
+void OpenGLShaderSource::clearCache() {
+    sources_.clear() ;
+    variants_.clear() ;
+}
+
+}}
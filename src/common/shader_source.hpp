@@ -0,0 +1,57 @@
+#ifndef XVIZ_GL_SHADER_SOURCE_HPP
+#define XVIZ_GL_SHADER_SOURCE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace xviz { namespace impl {
+
+struct OpenGLShaderPreproc ;
+
+// Shader resource parsed once into segments: plain text, the #version line, #include directives (resolved to the
+// parsed resource) and loops to unroll. The code of a variant is produced from the segments by concatenation only.
+// Both the parsed resources and the code of each variant are cached, until the resource folder changes.
+
+class OpenGLShaderSource {
+public:
+
+    // code of the named resource with the definitions of the variant, see OpenGLShader::setSourceFile.
+    // Returns an empty string if the resource does not exist, throws if one of its includes does not exist.
+    static const std::string &preprocess(const std::string &name, const OpenGLShaderPreproc &defines) ;
+
+    static void clearCache() ;
+
+private:
+
+    struct Segment {
+        enum Type { Text, Version, Include, Loop } ;
+
+        Type type_ ;
+        std::string text_ ;             // text, #version line, name of the included resource or of the loop bound
+        const OpenGLShaderSource *include_ = nullptr ;  // null if the included resource does not exist
+
+        // loop body split where the loop index is substituted, i.e. at "[i]" and UNROLLED_LOOP_INDEX
+        int loop_start_ = 0 ;
+        std::vector<std::string> body_ ;
+    };
+
+    static const OpenGLShaderSource *get(const std::string &name) ;
+
+    void parse(const std::string &code) ;
+    void parseLoop(const std::string &loop) ;
+    void appendText(const std::string &text) ;
+
+    void generate(std::string &code, const OpenGLShaderPreproc &defines, const std::string &definitions, bool version_parsed) const ;
+
+    std::vector<Segment> segments_ ;
+
+    static std::map<std::string, std::unique_ptr<OpenGLShaderSource>> sources_ ;
+    static std::unordered_map<std::string, std::string> variants_ ;
+};
+
+}}
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+// uniform blocks shared by all programs, see renderer/uniform_buffer.hpp for the binding points
+
+static const char *uniform_blocks = R"(
+layout (std140) uniform FrameBlock {
+    mat4 g_view ;
+    mat4 g_proj ;
+    vec4 g_eye_pos ;
+};
+
+layout (std140) uniform ObjectBlock {
+    mat4 g_model ;
+    mat4 g_mv ;
+    mat4 g_mvp ;
+    mat4 g_mvn ;
+    uvec4 g_object_id ;     // x: capture id of the drawable or of its first instance
+};
+)";
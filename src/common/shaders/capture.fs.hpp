@@ -0,0 +1,38 @@
+static const char *capture_fragment_shader = R"(
+#ifdef CAPTURE
+
+// Additional render targets of Renderer::capture and Renderer::requestPick. Depth and normal outputs have full alpha
+// so that blending overwrites them, blending is not applied to the integer id and primitive targets.
+
+in CaptureData {
+    vec3 position ;
+    vec3 normal ;
+    flat uint id ;
+} capture_in ;
+
+layout (location = 1) out vec4 capture_depth ;
+layout (location = 2) out vec4 capture_normal ;
+layout (location = 3) out uint capture_id ;
+layout (location = 4) out uint capture_primitive ;   // triangle, line or point index within the draw call
+
+void writeCapture() {
+    // derivatives have to be taken in uniform control flow
+    vec3 face_normal = cross(dFdx(capture_in.position), dFdy(capture_in.position)) ;
+
+    vec3 n = capture_in.normal ;
+
+    // geometries without normals get the normal of the face, turned towards the camera
+    if ( dot(n, n) == 0.0 ) {
+        n = face_normal ;
+        if ( dot(n, capture_in.position) > 0.0 ) n = -n ;
+    } else if ( !gl_FrontFacing )
+        n = -n ;
+
+    capture_depth = vec4(-capture_in.position.z, 0, 0, 1) ;
+    capture_normal = vec4(normalize(n), 1) ;
+    capture_id = capture_in.id ;
+    capture_primitive = uint(gl_PrimitiveID) ;
+}
+
+#endif
+)";
@@ -2,8 +2,14 @@
 static const char *vertex_shader_code = R"(
 #version 330
 
+#include <@uniform_blocks>
+#include <@light_vars>
+#include <@skinning_vars>
+
 layout (location = 0) in vec3 vposition;
 out vec3 position;
+// shared with the depth pre-pass, see shadow_map_shader_vs
+invariant gl_Position ;
 out vec3 fpos ;
 
 #ifdef HAS_NORMALS
@@ -16,47 +22,43 @@ layout (location = 2) in vec3 vcolor;
 out vec3 color ;
 #endif
 
-#ifdef USE_SKINNING
-layout (location = 3) in ivec4 boneIDs;
-layout (location = 4) in vec4  boneWeights;
-
-const int MAX_BONES = 200;
-uniform mat4 g_bones[MAX_BONES];
-#endif
-
 #ifdef  HAS_UVs
 layout (location = 5) in vec2 vuv;
 out vec2 uv;
 #endif
 
-#ifdef HAS_SHADOWS
-#if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
-    uniform mat4 lsmat_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW] ;
-    out vec4 lspos_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW] ;
+// per-instance attributes, see MeshData::bindInstanceAttributes
+#ifdef USE_INSTANCING
+layout (location = 7) in mat4 instance_matrix;
+#ifdef HAS_INSTANCE_COLORS
+layout (location = 11) in vec4 instance_color;
+out vec4 icolor ;
+#endif
 #endif
+
+// view space position and normal and the id of the drawable for the capture targets, see capture_fragment_shader
+#ifdef CAPTURE
+out CaptureData {
+    vec3 position ;
+    vec3 normal ;
+    flat uint id ;
+} capture_out ;
+#endif
+
+#ifdef HAS_SHADOWS
 #if NUM_SPOT_LIGHTS_WITH_SHADOW > 0
-    uniform mat4 lsmat_s[NUM_SPOT_LIGHTS_WITH_SHADOW] ;
     out vec4 lspos_s[NUM_SPOT_LIGHTS_WITH_SHADOW] ;
 #endif
 #if NUM_POINT_LIGHTS_WITH_SHADOW > 0
-    uniform mat4 lsmat_p[NUM_POINT_LIGHTS_WITH_SHADOW] ;
     out vec4 lspos_p[NUM_POINT_LIGHTS_WITH_SHADOW] ;
 #endif
 
 #endif
 
-uniform mat4 model ;
-uniform mat4 mvp;
-uniform mat4 mv;
-uniform mat3 mvn ;
-
 void main()
 {
 #ifdef USE_SKINNING
-    mat4 BoneTransform = g_bones[boneIDs[0]] * boneWeights[0];
-    BoneTransform     += g_bones[boneIDs[1]] * boneWeights[1];
-    BoneTransform     += g_bones[boneIDs[2]] * boneWeights[2];
-    BoneTransform     += g_bones[boneIDs[3]] * boneWeights[3];
+    mat4 BoneTransform = skinningMatrix() ;
 
     vec4 posl    = BoneTransform * vec4(vposition, 1.0);
 
@@ -73,10 +75,20 @@ void main()
 
 #endif // SKINING
 
-    gl_Position  = mvp * posl;
+#ifdef USE_INSTANCING
+    posl = instance_matrix * posl ;
+#ifdef HAS_NORMALS
+    normall = transpose(inverse(mat3(instance_matrix))) * normall ;
+#endif
+#ifdef HAS_INSTANCE_COLORS
+    icolor = instance_color ;
+#endif
+#endif
+
+    gl_Position  = g_mvp * posl;
 
 #ifdef HAS_NORMALS
-    normal = mvn * normall;
+    normal = mat3(g_mvn) * normall;
 #endif
 
 #ifdef HAS_COLORS
@@ -86,14 +98,23 @@ void main()
 #ifdef HAS_UVs
     uv = vuv ;
 #endif
-    position    = (mv * posl).xyz;
-    fpos = vec3(model * posl);
+    position    = (g_mv * posl).xyz;
+    fpos = vec3(g_model * posl);
+
+#ifdef CAPTURE
+    capture_out.position = position ;
+#ifdef HAS_NORMALS
+    capture_out.normal = normal ;
+#else
+    capture_out.normal = vec3(0) ;
+#endif
+#ifdef USE_INSTANCING
+    capture_out.id = g_object_id.x + uint(gl_InstanceID) ;
+#else
+    capture_out.id = g_object_id.x ;
+#endif
+#endif
 #ifdef HAS_SHADOWS
-#pragma unroll_loop_start
-    for( int i=0 ; i<NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW ; i++ ) {
-       lspos_d[i] = lsmat_d[i] * vec4(fpos, 1);
-    }
-#pragma unroll_loop_end
 #pragma unroll_loop_start
     for( int i=0 ; i<NUM_SPOT_LIGHTS_WITH_SHADOW ; i++ ) {
        lspos_s[i] = lsmat_s[i] * vec4(fpos, 1);
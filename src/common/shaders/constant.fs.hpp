@@ -15,14 +15,24 @@ static const char *constant_fragment_shader = R"(
 #include <@constant_fragment_shader_vars>
 #include <@light_vars>
 #include <@shadows_fragment_shader>
+#include <@capture_fragment_shader>
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+
+#ifdef HAS_INSTANCE_COLORS
+in vec4 icolor ;
+#endif
 
 void main (void) {
 #ifdef HAS_DIFFUSE_MAP
 FragColor = texture(diffuseMap, vec2(map_transform * vec3(uv, 1)));
+#elif defined(HAS_INSTANCE_COLORS)
+FragColor = icolor ;
 #else
 FragColor = color ;
 #endif
+#ifdef CAPTURE
+writeCapture() ;
+#endif
 }
 )";
@@ -0,0 +1,67 @@
+#pragma once
+
+// Supersampled images of Renderer::renderImage are reduced one axis at a time (see Downsampler). The vertex shader
+// draws a triangle covering the target from gl_VertexID alone.
+
+static const char *downsample_vs = R"(
+#version 330
+
+  void main()
+  {
+     vec2 p = vec2(( gl_VertexID << 1 ) & 2, gl_VertexID & 2) ;
+     gl_Position = vec4(2.0 * p - 1.0, 0.0, 1.0) ;
+  }
+)" ;
+
+// Each pixel covers factor texels of the source along the axis. The box filter averages them, the Lanczos kernel
+// (a = 2) spans two pixels on each side of the center of the pixel and weighs the texels falling under it. With flip
+// the pixels are written from the mirrored rows, so that the target holds the rows from top to bottom.
+
+static const char *downsample_fs = R"(
+#version 330
+
+  uniform sampler2D src ;
+  uniform int factor ;
+  uniform int axis ;        // 0 for x, 1 for y
+  uniform int lanczos ;
+  uniform int flip ;
+
+  out vec4 color ;
+
+  const float PI = 3.14159265358979 ;
+
+  float lanczos2(float x) {
+      if ( abs(x) < 1.0e-5 ) return 1.0 ;
+      if ( abs(x) >= 2.0 ) return 0.0 ;
+      float px = PI * x ;
+      return 2.0 * sin(px) * sin(0.5 * px) / ( px * px ) ;
+  }
+
+  void main()
+  {
+      ivec2 size = textureSize(src, 0) ;
+      ivec2 step = ( axis == 0 ) ? ivec2(1, 0) : ivec2(0, 1) ;
+
+      // first source texel under the pixel
+      ivec2 first = ivec2(gl_FragCoord.xy) ;
+      if ( flip != 0 ) first.y = ( axis == 1 ? size.y / factor : size.y ) - 1 - first.y ;
+      first[axis] *= factor ;
+
+      vec4 sum = vec4(0.0) ;
+      float weights = 0.0 ;
+
+      if ( lanczos == 0 ) {
+          for( int i=0 ; i<factor ; i++ )
+              sum += texelFetch(src, first + i * step, 0) ;
+          weights = float(factor) ;
+      } else {
+          for( int i=-2*factor ; i<3*factor ; i++ ) {
+              float w = lanczos2(( float(i) + 0.5 - 0.5 * float(factor) ) / float(factor)) ;
+              sum += w * texelFetch(src, clamp(first + i * step, ivec2(0), size - 1), 0) ;
+              weights += w ;
+          }
+      }
+
+      color = sum / weights ;
+  }
+)" ;
@@ -2,45 +2,68 @@
 
 static const char *light_vars = R"(
 
+// members are ordered so that the std140 layout is tightly packed (see LightBlockData)
+
 struct LightSourceParameters
 {
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 position;
-    vec3 direction;
-    float spot_exponent;
     float spot_inner_cutoff;
+    vec3 diffuse;
     float spot_outer_cutoff;
+    vec3 specular;
     float constant_attenuation;
+    vec3 position;
     float linear_attenuation;
+    vec3 direction;
     float quadratic_attenuation;
-
-    sampler2DShadow shadow_map ;
     float shadow_bias ;
 };
 
+// all lights of the frame together with the light space matrices of the shadow casting ones
+// the arrays are filled in the order they are declared
+
+// must match DirectionalLight::MAX_SHADOW_CASCADES
+#define MAX_SHADOW_CASCADES 4
+
+#ifdef NUM_LIGHTS
+layout (std140) uniform LightsBlock {
 #if NUM_DIRECTIONAL_LIGHTS > 0
-uniform LightSourceParameters g_light_source_dir[NUM_DIRECTIONAL_LIGHTS];
+    LightSourceParameters g_light_source_dir[NUM_DIRECTIONAL_LIGHTS];
 #endif
 
 #if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
-uniform LightSourceParameters g_light_source_dir_shadow[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW];
+    LightSourceParameters g_light_source_dir_shadow[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW];
 #endif
 
 #if NUM_SPOT_LIGHTS > 0
-uniform LightSourceParameters g_light_source_spot[NUM_SPOT_LIGHTS];
+    LightSourceParameters g_light_source_spot[NUM_SPOT_LIGHTS];
 #endif
 
 #if NUM_SPOT_LIGHTS_WITH_SHADOW > 0
-uniform LightSourceParameters g_light_source_spot_shadow[NUM_SPOT_LIGHTS_WITH_SHADOW];
+    LightSourceParameters g_light_source_spot_shadow[NUM_SPOT_LIGHTS_WITH_SHADOW];
 #endif
 
 #if NUM_POINT_LIGHTS > 0
-uniform LightSourceParameters g_light_source_point[NUM_POINT_LIGHTS];
+    LightSourceParameters g_light_source_point[NUM_POINT_LIGHTS];
 #endif
 
 #if NUM_POINT_LIGHTS_WITH_SHADOW > 0
-uniform LightSourceParameters g_light_source_point_shadow[NUM_POINT_LIGHTS_WITH_SHADOW];
+    LightSourceParameters g_light_source_point_shadow[NUM_POINT_LIGHTS_WITH_SHADOW];
+#endif
+
+#if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
+    mat4 lsmat_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW * MAX_SHADOW_CASCADES] ;
+#endif
+#if NUM_SPOT_LIGHTS_WITH_SHADOW > 0
+    mat4 lsmat_s[NUM_SPOT_LIGHTS_WITH_SHADOW] ;
+#endif
+#if NUM_POINT_LIGHTS_WITH_SHADOW > 0
+    mat4 lsmat_p[NUM_POINT_LIGHTS_WITH_SHADOW] ;
+#endif
+#if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
+    // distance from the camera where each cascade of the directional lights ends
+    vec4 cascade_splits_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW] ;
+#endif
+};
 #endif
         )";
@@ -0,0 +1,19 @@
+#pragma once
+
+// Proxy of the occlusion queries (see OcclusionCuller), the vertices of a unit cube are stretched to the world space
+// bounds of a node. It is paired with the empty fragment shader of the shadow maps.
+
+static const char *occlusion_box_vs = R"(
+#version 330
+
+  layout (location = 0) in vec3 aPos;
+
+  uniform mat4 proj_view ;
+  uniform vec3 box_min ;
+  uniform vec3 box_max ;
+
+  void main()
+  {
+     gl_Position = proj_view * vec4(mix(box_min, box_max, aPos), 1.0);
+  }
+)" ;
@@ -1,12 +1,17 @@
 static const char *per_vertex_color_fragment_shader = R"(
 #version 330
 
+#include <@capture_fragment_shader>
+
 in vec3 color ;
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
 uniform float opacity ;
 
 void main (void)
 {
     FragColor = vec4(color, opacity) ;
+#ifdef CAPTURE
+    writeCapture() ;
+#endif
 }
 )";
@@ -5,17 +5,28 @@ static const char *phong_fragment_shader = R"(
 #include <@light_vars>
 #include <@shadows_fragment_shader>
 #include <@phong_fragment_shader_common>
+#include <@capture_fragment_shader>
 
 #ifdef HAS_DIFFUSE_MAP
 in vec2 uv ;
 uniform sampler2D diffuseMap;
 #endif
 
+#ifdef HAS_INSTANCE_COLORS
+in vec4 icolor ;
+#endif
+
 void main (void) {
 #ifdef HAS_DIFFUSE_MAP
     FragColor = phongIllumination(texture(diffuseMap, vec2(map_transform * vec3(uv, 1))).rgb);
+#elif defined(HAS_INSTANCE_COLORS)
+    FragColor = phongIllumination(icolor.rgb);
+    FragColor.a *= icolor.a ;
 #else
     FragColor = phongIllumination(g_material.diffuse);
 #endif
+#ifdef CAPTURE
+    writeCapture() ;
+#endif
 }
 )";
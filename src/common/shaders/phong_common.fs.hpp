@@ -7,7 +7,7 @@ float diffuse(LightSourceParameters ls, vec3 N, vec3 L) {
 }
 
 float specular(LightSourceParameters ls, vec3 N, vec3 L) {
-     vec3 E = normalize(eyePos-fpos);
+     vec3 E = normalize(g_eye_pos.xyz-fpos);
      vec3 R = normalize(reflect(-L,N));
      return pow(max(dot(R,E),0.0f), max(g_material.shininess, 0.1));
 }
@@ -64,7 +64,7 @@ vec4 phongIllumination(vec3 dc) {
 
 #pragma unroll_loop_start
     for( int i=0 ; i<NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW ; i++ ) {
-        float shadow = calcShadow(lspos_d[i], g_light_source_dir_shadow[i].shadow_map, g_light_source_dir_shadow[i].shadow_bias);
+        float shadow = calcCascadedShadow(UNROLLED_LOOP_INDEX, fpos, -(g_view * vec4(fpos, 1)).z, shadow_map_d[i], g_light_source_dir_shadow[i].shadow_bias);
         finalColor += phongDirectional(g_light_source_dir_shadow[i], dc, N, shadow) ;
     }
 #pragma unroll_loop_end
@@ -77,7 +77,7 @@ vec4 phongIllumination(vec3 dc) {
 
 #pragma unroll_loop_start
     for( int i=0 ; i<NUM_SPOT_LIGHTS_WITH_SHADOW ; i++ ) {
-        float shadow = calcShadow(lspos_s[i], g_light_source_spot_shadow[i].shadow_map, g_light_source_spot_shadow[i].shadow_bias);
+        float shadow = calcShadow(lspos_s[i], shadow_map_s[i], g_light_source_spot_shadow[i].shadow_bias);
         finalColor += phongSpot(g_light_source_spot_shadow[i], dc, N, shadow) ;
     }
 #pragma unroll_loop_end
@@ -90,7 +90,7 @@ vec4 phongIllumination(vec3 dc) {
 
 #pragma unroll_loop_start
     for( int i=0 ; i<NUM_POINT_LIGHTS_WITH_SHADOW ; i++ ) {
-        float shadow = calcShadow(lspos_p[i], g_light_source_point_shadow[i].shadow_map, g_light_source_point_shadow[i].shadow_bias);
+        float shadow = calcShadow(lspos_p[i], shadow_map_p[i], g_light_source_point_shadow[i].shadow_bias);
         finalColor += phongPoint(g_light_source_point_shadow[i], dc, N, shadow) ;
     }
 #pragma unroll_loop_end
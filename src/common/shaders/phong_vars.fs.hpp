@@ -1,4 +1,6 @@
 static const char *phong_fragment_shader_vars = R"(
+#include <@uniform_blocks>
+
 in vec3 normal;
 in vec3 fpos;
 
@@ -13,7 +15,6 @@ struct MaterialParameters
 };
 
 uniform MaterialParameters g_material;
-uniform vec3 eyePos ;
 uniform mat3x3 map_transform ;
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
 )";
@@ -1,15 +1,47 @@
 
+// With DEPTH_PREPASS defined the shader renders the depth pre-pass of the camera (see Renderer::depthPrePass). The
+// position is then computed exactly as in the vertex shader of the color pass, from the same object block, so that
+// the latter can test for equal depth.
+
 static const char *shadow_map_shader_vs = R"(
 #version 330
 
   layout (location = 0) in vec3 aPos;
 
+#ifdef USE_INSTANCING
+  layout (location = 7) in mat4 instance_matrix;
+#endif
+
+#include <@skinning_vars>
+
+#ifdef DEPTH_PREPASS
+#include <@uniform_blocks>
+  invariant gl_Position ;
+#else
   uniform mat4 lightSpaceMatrix;
   uniform mat4 model;
+#endif
 
   void main()
   {
+#ifdef DEPTH_PREPASS
+#ifdef USE_SKINNING
+     mat4 BoneTransform = skinningMatrix() ;
+     vec4 posl = BoneTransform * vec4(aPos, 1.0);
+#else
+     vec4 posl = vec4(aPos, 1.0);
+#endif
+#ifdef USE_INSTANCING
+     posl = instance_matrix * posl ;
+#endif
+     gl_Position = g_mvp * posl;
+#elif defined(USE_INSTANCING)
+     gl_Position = lightSpaceMatrix * model * instance_matrix * vec4(aPos, 1.0);
+#elif defined(USE_SKINNING)
+     gl_Position = lightSpaceMatrix * model * skinningMatrix() * vec4(aPos, 1.0);
+#else
      gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+#endif
   }
 )" ;
 
@@ -1,16 +1,23 @@
 static const char *shadows_fragment_shader = R"(
 #ifdef HAS_SHADOWS
 
+// samplers can not be part of a uniform block, they are assigned to consecutive texture units once after linking
+
+// the maps of directional lights have one layer per cascade, the light space position is computed here
+// since the cascade depends on the distance of the fragment from the camera
+
 #if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
-in vec4 lspos_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW] ;
+uniform sampler2DArrayShadow shadow_map_d[NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW] ;
 #endif
 
 #if NUM_SPOT_LIGHTS_WITH_SHADOW > 0
 in vec4 lspos_s[NUM_SPOT_LIGHTS_WITH_SHADOW] ;
+uniform sampler2DShadow shadow_map_s[NUM_SPOT_LIGHTS_WITH_SHADOW] ;
 #endif
 
 #if NUM_POINT_LIGHTS_WITH_SHADOW > 0
 in vec4 lspos_p[NUM_POINT_LIGHTS_WITH_SHADOW] ;
+uniform sampler2DShadow shadow_map_p[NUM_POINT_LIGHTS_WITH_SHADOW] ;
 #endif
 
 float calcShadow(vec4 fragPosLightSpace, sampler2DShadow shadowMap, float shadowBias) {
@@ -30,5 +37,32 @@ float calcShadow(vec4 fragPosLightSpace, sampler2DShadow shadowMap, float shadow
    float shadow = 1 - d ;
    return shadow ;
 }
+
+#if NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW > 0
+float calcCascadedShadow(int light, vec3 pos, float depth, sampler2DArrayShadow shadowMap, float shadowBias) {
+   vec4 splits = cascade_splits_d[light] ;
+
+   int cascade = 0 ;
+   for( int i=0 ; i<MAX_SHADOW_CASCADES ; i++ ) {
+      if ( depth > splits[i] ) cascade ++ ;
+   }
+
+   // beyond the shadow distance
+   if ( cascade >= MAX_SHADOW_CASCADES )
+      return 0.0 ;
+
+   vec4 fragPosLightSpace = lsmat_d[light * MAX_SHADOW_CASCADES + cascade] * vec4(pos, 1) ;
+   vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+
+   projCoords = projCoords * 0.5 + 0.5;
+   projCoords.z -= shadowBias ;
+
+   if (projCoords.z > 1.0)
+      return 0.0;
+
+   float d = texture(shadowMap, vec4(projCoords.xy, cascade, projCoords.z)) ;
+   return 1 - d ;
+}
+#endif
 #endif
 )";
@@ -0,0 +1,48 @@
+#pragma once
+
+// Bone matrices of all skinned meshes of the frame are stored in a buffer texture (see Renderer::updateBonePalettes),
+// one matrix every four texels holding its columns. Each mesh indexes its palette starting from g_bone_offset.
+
+static const char *skinning_vars = R"(
+#ifdef USE_SKINNING
+layout (location = 3) in ivec4 boneIDs;
+layout (location = 4) in vec4  boneWeights;
+
+uniform samplerBuffer g_bone_palette ;
+uniform int g_bone_offset ;
+
+mat4 boneMatrix(int bone) {
+    int idx = 4 * (g_bone_offset + max(bone, 0)) ;
+    return mat4(texelFetch(g_bone_palette, idx), texelFetch(g_bone_palette, idx + 1),
+                texelFetch(g_bone_palette, idx + 2), texelFetch(g_bone_palette, idx + 3)) ;
+}
+
+mat4 skinningMatrix() {
+    return boneMatrix(boneIDs[0]) * boneWeights[0] + boneMatrix(boneIDs[1]) * boneWeights[1] +
+           boneMatrix(boneIDs[2]) * boneWeights[2] + boneMatrix(boneIDs[3]) * boneWeights[3] ;
+}
+#endif
+)";
+
+// Vertex shader of the pre-skinning pass (see Renderer::skinMeshes). Posed positions and normals are captured by
+// transform feedback, interleaved, and then drawn by the other passes as a plain mesh.
+
+static const char *skinning_feedback_vs = R"(
+#version 330
+#define USE_SKINNING
+
+layout (location = 0) in vec3 vposition;
+layout (location = 1) in vec3 vnormal;
+
+#include <@skinning_vars>
+
+out vec3 skinned_position ;
+out vec3 skinned_normal ;
+
+void main()
+{
+    mat4 tf = skinningMatrix() ;
+    skinned_position = (tf * vec4(vposition, 1.0)).xyz ;
+    skinned_normal = mat3(tf) * vnormal ;
+}
+)";
@@ -5,21 +5,38 @@ layout(triangles) in;
 layout(triangle_strip, max_vertices = 3) out;
 out vec3 vBC;
 
-void main()
-{
+#ifdef CAPTURE
+in CaptureData {
+    vec3 position ;
+    vec3 normal ;
+    flat uint id ;
+} capture_in[] ;
 
-    vBC = vec3(1, 0, 0);
-    gl_Position = gl_in[0].gl_Position;
-    EmitVertex();
-
-    vBC = vec3(0, 1, 0);
-    gl_Position = gl_in[1].gl_Position;
-    EmitVertex();
+out CaptureData {
+    vec3 position ;
+    vec3 normal ;
+    flat uint id ;
+} capture_out ;
+#endif
 
-    vBC = vec3(0, 0, 1);
-    gl_Position = gl_in[2].gl_Position;
+void emit(int i, vec3 bc) {
+    vBC = bc ;
+    gl_Position = gl_in[i].gl_Position;
+#ifdef CAPTURE
+    capture_out.position = capture_in[i].position ;
+    capture_out.normal = capture_in[i].normal ;
+    capture_out.id = capture_in[i].id ;
+    // the fragment shader sees the primitive index written here rather than the incoming one
+    gl_PrimitiveID = gl_PrimitiveIDIn ;
+#endif
     EmitVertex();
+}
 
+void main()
+{
+    emit(0, vec3(1, 0, 0)) ;
+    emit(1, vec3(0, 1, 0)) ;
+    emit(2, vec3(0, 0, 1)) ;
 }
 )";
 
@@ -28,6 +45,8 @@ void main()
 static const char *wireframe_shader_fs = R"(
 #version 330
 
+#include <@capture_fragment_shader>
+
 layout (location = 0) out vec4 outColor;
 in vec3 vBC;
 uniform vec4 color ;
@@ -44,6 +63,9 @@ void main(){
     float d = edgeFactor()  ;
     float i = exp2(-2.0*d*d);
     outColor = i*color + (1.0 - i)*fill;
+#ifdef CAPTURE
+    writeCapture() ;
+#endif
 }
 )";
 
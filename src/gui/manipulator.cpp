@@ -314,13 +314,14 @@ void TransformManipulator::updateTransforms()
     tr.translate(position_) ;
     tr.rotate(orientation_) ;
 
-    transform_node_->transform() = orig_ * tr ;
+    transform_node_->setTransform(orig_ * tr) ;
 
     if ( local_ ) {
-        gizmo_->transform() = orig_ * tr ;
+        gizmo_->setTransform(orig_ * tr) ;
     } else {
-        gizmo_->transform().translation() = orig_ * position_ ;
-        gizmo_->transform().linear() = Matrix3f::Identity() ;
+        Affine3f gtr = Affine3f::Identity() ;
+        gtr.translation() = orig_ * position_ ;
+        gizmo_->setTransform(gtr) ;
     }
 
 }
@@ -1,11 +1,14 @@
 #include <xviz/gui/offscreen.hpp>
 #include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 #include <QImage>
 
 #include <xviz/scene/renderer.hpp>
 #include <xviz/common/image.hpp>
 
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 using namespace std ;
 
 namespace xviz {
@@ -65,6 +68,16 @@ void OffscreenSurface::createContext() {
 
 OffscreenSurface::~OffscreenSurface() {
 
+    QOpenGLExtraFunctions *f = context_->extraFunctions() ;
+
+    for( Readback &rb: readbacks_ ) {
+        if ( rb.fence_ ) f->glDeleteSync(rb.fence_) ;
+        if ( rb.pbo_ ) f->glDeleteBuffers(1, &rb.pbo_) ;
+    }
+
+    delete resolve_fbo_ ;
+    delete flip_fbo_ ;
+
     fbo_->release();
     context_->doneCurrent();
 
@@ -73,59 +86,147 @@ OffscreenSurface::~OffscreenSurface() {
 }
 
 
-Image OffscreenSurface::readPixels(QOpenGLFramebufferObject *fbo, bool alpha) const {
+// Copy the color buffer upside down to flip_fbo_, which is left bound for reading, so that rows are read back in
+// top-down order without a pass over the pixels on the CPU. Multisampled buffers are resolved first since they can
+// only be blitted to a rectangle of the same size and orientation.
 
-    bool is_bound = fbo->isBound() ;
+void OffscreenSurface::flipColorBuffer() const {
+    QOpenGLExtraFunctions *f = context_->extraFunctions() ;
 
-    if ( !is_bound ) fbo->bind() ;
+    const int w = size_.width(), h = size_.height() ;
 
-    if ( alpha ) {
-        uchar *bytes = new uchar [size_.width() * size_.height() * 4] ;
+    if ( !flip_fbo_ ) flip_fbo_ = new QOpenGLFramebufferObject(size_, QOpenGLFramebufferObjectFormat()) ;
 
-        glReadPixels(0, 0, size_.width(), size_.height(), GL_RGBA, GL_UNSIGNED_BYTE, bytes);
+    GLuint src = fbo_->handle() ;
 
-        for(int line = 0; line != size_.height()/2; ++line) {
-            std::swap_ranges(
-                        bytes + 4 * size_.width() * line,
-                        bytes + 4 * size_.width() * (line + 1),
-                        bytes + 4 * size_.width() * (size_.height() - line - 1));
-        }
+    if ( format().samples() > 0 ) {
+        if ( !resolve_fbo_ ) resolve_fbo_ = new QOpenGLFramebufferObject(size_, QOpenGLFramebufferObjectFormat()) ;
 
-        if ( !is_bound ) fbo->release() ;
+        f->glBindFramebuffer(GL_READ_FRAMEBUFFER, src) ;
+        f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_fbo_->handle()) ;
+        f->glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST) ;
 
-        return Image(bytes, ImageFormat::rgba32, size_.width(), size_.height()) ;
+        src = resolve_fbo_->handle() ;
+    }
 
-    } else {
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, src) ;
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, flip_fbo_->handle()) ;
+    f->glBlitFramebuffer(0, 0, w, h, 0, h, w, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST) ;
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, flip_fbo_->handle()) ;
+}
 
-        uchar *bytes = new uchar [size_.width() * size_.height() * 3] ;
+Image OffscreenSurface::readPixels(bool alpha) const {
+    QOpenGLExtraFunctions *f = context_->extraFunctions() ;
 
-        glReadPixels(0, 0, size_.width(), size_.height(), GL_RGB, GL_UNSIGNED_BYTE, bytes);
+    bool is_bound = fbo_->isBound() ;
 
-        for(int line = 0; line != size_.height()/2; ++line) {
-            std::swap_ranges(
-                        bytes + 3 * size_.width() * line,
-                        bytes + 3 * size_.width() * (line + 1),
-                        bytes + 3 * size_.width() * (size_.height() - line - 1));
-        }
-        if ( !is_bound ) fbo->release() ;
+    flipColorBuffer() ;
 
-        return Image(bytes, ImageFormat::rgb24, size_.width(), size_.height()) ;
-    }
+    uchar *bytes = new uchar [size_.width() * size_.height() * ( alpha ? 4 : 3 )] ;
 
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 1) ;
+    f->glReadPixels(0, 0, size_.width(), size_.height(), alpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, bytes);
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    // rebind through Qt, which keeps track of the bound framebuffer object
+    if ( is_bound ) fbo_->bind() ;
+    else fbo_->release() ;
+
+    return Image(bytes, alpha ? ImageFormat::rgba32 : ImageFormat::rgb24, size_.width(), size_.height()) ;
 }
 
 
 Image OffscreenSurface::getImage(bool alpha) const {
-    if ( format().samples() > 0 ) {
-        QOpenGLFramebufferObject temp(size(), QOpenGLFramebufferObjectFormat());
+    return readPixels(alpha) ;
+}
+
+// The ring grows when all its buffers are in flight, which happens when more requests are made before fetching
+// than there are buffers, e.g. when capturing several frames in a row.
+
+OffscreenSurface::ReadbackTicket OffscreenSurface::requestImage(bool alpha, uchar *dst) {
+    QOpenGLExtraFunctions *f = context_->extraFunctions() ;
 
-        QRect rect(QPoint(0, 0), size());
+    auto it = std::find_if(readbacks_.begin(), readbacks_.end(), [](const Readback &r) { return r.ticket_ == 0 ; }) ;
+    Readback *rb = ( it != readbacks_.end() ) ? &*it : &readbacks_.emplace_back() ;
 
-        QOpenGLFramebufferObject::blitFramebuffer(&temp, rect, const_cast<QOpenGLFramebufferObject *>(fbo_), rect);
+    const GLsizeiptr size = (GLsizeiptr)size_.width() * size_.height() * ( alpha ? 4 : 3 ) ;
 
-        return readPixels(&temp, alpha) ;
+    bool is_bound = fbo_->isBound() ;
+
+    flipColorBuffer() ;
+
+    if ( !rb->pbo_ ) f->glGenBuffers(1, &rb->pbo_) ;
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo_) ;
+
+    if ( rb->capacity_ < size ) {
+        f->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ) ;
+        rb->capacity_ = size ;
     }
-    else return readPixels(fbo_, alpha) ;
+
+    // with a pack buffer bound the pixels are written to the buffer at the given offset
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 1) ;
+    f->glReadPixels(0, 0, size_.width(), size_.height(), alpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+
+    rb->fence_ = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) ;
+    rb->ticket_ = next_ticket_++ ;
+    rb->alpha_ = alpha ;
+    rb->dst_ = dst ;
+
+    if ( is_bound ) fbo_->bind() ;
+    else fbo_->release() ;
+
+    return rb->ticket_ ;
+}
+
+// waits for the copy of the request to complete and maps its pixels into image, freeing the buffer
+
+void OffscreenSurface::completeReadback(Readback &rb, Image &image) {
+    QOpenGLExtraFunctions *f = context_->extraFunctions() ;
+
+    while ( f->glClientWaitSync(rb.fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED ) ;
+    f->glDeleteSync(rb.fence_) ;
+    rb.fence_ = nullptr ;
+
+    const GLsizeiptr size = (GLsizeiptr)size_.width() * size_.height() * ( rb.alpha_ ? 4 : 3 ) ;
+
+    uchar *bytes = rb.dst_ ? rb.dst_ : new uchar [size] ;
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo_) ;
+
+    if ( void *pixels = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT) ) {
+        memcpy(bytes, pixels, size) ;
+        f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER) ;
+    }
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+
+    if ( rb.dst_ )
+        image = Image() ;
+    else
+        image = Image(bytes, rb.alpha_ ? ImageFormat::rgba32 : ImageFormat::rgb24, size_.width(), size_.height()) ;
+
+    rb.ticket_ = 0 ;
+    rb.dst_ = nullptr ;
+}
+
+bool OffscreenSurface::fetchImage(ReadbackTicket ticket, Image &image, bool wait) {
+    if ( ticket == 0 ) return false ;
+
+    auto it = std::find_if(readbacks_.begin(), readbacks_.end(), [ticket](const Readback &r) { return r.ticket_ == ticket ; }) ;
+    if ( it == readbacks_.end() ) return false ;
+
+    if ( !wait ) {
+        GLenum status = context_->extraFunctions()->glClientWaitSync(it->fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 0) ;
+        if ( status == GL_TIMEOUT_EXPIRED ) return false ;
+    }
+
+    completeReadback(*it, image) ;
+
+    return true ;
 }
 
 Image OffscreenSurface::getDepthBuffer(float znear, float zfar) const {
@@ -0,0 +1,158 @@
+#include "headless_backend.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+namespace xviz { namespace impl {
+
+static bool hasExtension(const char *extensions, const char *name) {
+    if ( !extensions ) return false ;
+
+    size_t len = strlen(name) ;
+
+    for( const char *p = strstr(extensions, name) ; p ; p = strstr(p + len, name) ) {
+        if ( ( p == extensions || p[-1] == ' ' ) && ( p[len] == ' ' || p[len] == 0 ) ) return true ;
+    }
+
+    return false ;
+}
+
+class EGLBackend: public HeadlessBackend {
+public:
+
+    ~EGLBackend() {
+        if ( display_ == EGL_NO_DISPLAY ) return ;
+
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) ;
+        if ( context_ != EGL_NO_CONTEXT ) eglDestroyContext(display_, context_) ;
+        if ( surface_ != EGL_NO_SURFACE ) eglDestroySurface(display_, surface_) ;
+        eglTerminate(display_) ;
+    }
+
+    bool create(std::string &error) ;
+
+    HeadlessContext::Backend type() const override { return HeadlessContext::Backend::EGL ; }
+
+    bool makeCurrent() override {
+        return eglMakeCurrent(display_, surface_, surface_, context_) == EGL_TRUE ;
+    }
+
+    void doneCurrent() override {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) ;
+    }
+
+    // EGL 1.5 returns core functions as well
+    Loader loader() const override {
+        return [](const char *name) { return reinterpret_cast<Proc>(eglGetProcAddress(name)) ; } ;
+    }
+
+private:
+
+    bool initialize(EGLDisplay display) ;
+
+    EGLDisplay display_ = EGL_NO_DISPLAY ;
+    EGLSurface surface_ = EGL_NO_SURFACE ;
+    EGLContext context_ = EGL_NO_CONTEXT ;
+};
+
+bool EGLBackend::initialize(EGLDisplay display) {
+    if ( display == EGL_NO_DISPLAY ) return false ;
+
+    EGLint major, minor ;
+    if ( !eglInitialize(display, &major, &minor) ) return false ;
+
+    display_ = display ;
+    return true ;
+}
+
+// Devices are enumerated first since the default display of servers without a display often has no usable
+// driver. The first device is the GPU when there is one and the software rasterizer otherwise.
+
+bool EGLBackend::create(std::string &error) {
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS) ;
+
+    if ( hasExtension(client_extensions, "EGL_EXT_device_enumeration") &&
+         hasExtension(client_extensions, "EGL_EXT_platform_device") ) {
+        auto query_devices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT") ;
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT") ;
+
+        EGLDeviceEXT devices[8] ;
+        EGLint num_devices = 0 ;
+
+        if ( query_devices && get_platform_display && query_devices(8, devices, &num_devices) ) {
+            for( EGLint i=0 ; i<num_devices && display_ == EGL_NO_DISPLAY ; i++ )
+                initialize(get_platform_display(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr)) ;
+        }
+    }
+
+    if ( display_ == EGL_NO_DISPLAY && !initialize(eglGetDisplay(EGL_DEFAULT_DISPLAY)) ) {
+        error = "no EGL display could be initialized" ;
+        return false ;
+    }
+
+    if ( !eglBindAPI(EGL_OPENGL_API) ) {
+        error = "EGL display does not support desktop OpenGL" ;
+        return false ;
+    }
+
+    bool surfaceless = hasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") ;
+
+    // rendering goes to framebuffer objects, the surface only serves to make the context current
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    } ;
+
+    EGLConfig config ;
+    EGLint num_configs = 0 ;
+
+    if ( !eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) || num_configs == 0 ) {
+        error = "no EGL configuration supports OpenGL" ;
+        return false ;
+    }
+
+    if ( !surfaceless ) {
+        const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE } ;
+
+        surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attribs) ;
+        if ( surface_ == EGL_NO_SURFACE ) {
+            error = "EGL pbuffer could not be created" ;
+            return false ;
+        }
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    } ;
+
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs) ;
+
+    if ( context_ == EGL_NO_CONTEXT ) {
+        error = "EGL could not create an OpenGL 3.3 core context" ;
+        return false ;
+    }
+
+    if ( !makeCurrent() ) {
+        error = "EGL context could not be made current" ;
+        return false ;
+    }
+
+    return true ;
+}
+
+std::unique_ptr<HeadlessBackend> createEGLBackend(std::string &error) {
+    std::unique_ptr<EGLBackend> backend(new EGLBackend) ;
+
+    if ( !backend->create(error) ) return nullptr ;
+
+    return backend ;
+}
+
+}}
@@ -0,0 +1,44 @@
+#ifndef XVIZ_HEADLESS_BACKEND_HPP
+#define XVIZ_HEADLESS_BACKEND_HPP
+
+#include <xviz/headless/headless_context.hpp>
+
+#include <memory>
+#include <string>
+
+namespace xviz { namespace impl {
+
+// Window system binding of a HeadlessContext. Each one lives in its own translation unit since the headers of
+// OSMesa pull in GL/gl.h, which clashes with gl3w.
+
+class HeadlessBackend {
+public:
+
+    using Proc = void (*)() ;
+    using Loader = Proc (*)(const char *name) ;
+
+    virtual ~HeadlessBackend() = default ;
+
+    virtual HeadlessContext::Backend type() const = 0 ;
+
+    virtual bool makeCurrent() = 0 ;
+    virtual void doneCurrent() = 0 ;
+
+    // GL function loader of the context, passed to loadGL. It is kept to resolve extensions later on, hence it does
+    // not depend on the lifetime of the backend.
+    virtual Loader loader() const = 0 ;
+};
+
+// Create an OpenGL 3.3 core context and make it current. Return null and set error on failure.
+
+#ifdef HAS_EGL
+std::unique_ptr<HeadlessBackend> createEGLBackend(std::string &error) ;
+#endif
+
+#ifdef HAS_OSMESA
+std::unique_ptr<HeadlessBackend> createOSMesaBackend(std::string &error) ;
+#endif
+
+}}
+
+#endif
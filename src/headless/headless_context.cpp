@@ -0,0 +1,224 @@
+#include <xviz/headless/headless_context.hpp>
+
+#include "common/gl/gl3w.h"
+#include "common/gl_loader.hpp"
+#include "headless_backend.hpp"
+
+#include <cmath>
+
+using namespace std ;
+
+namespace xviz {
+
+HeadlessContext::HeadlessContext(uint32_t width, uint32_t height, uint32_t samples, Backend backend):
+    width_(width), height_(height), samples_(samples) {
+    if ( !createBackend(backend) ) return ;
+
+    // the functions are loaded from the library of the context, Renderer::init then keeps them
+
+    int res = impl::loadGL(backend_->loader()) ;
+
+    if ( res != GL3W_OK || !gl3wIsSupported(3, 3) ) {
+        error_ = "OpenGL 3.3 is not supported by the context" ;
+        backend_.reset() ;
+        return ;
+    }
+
+    if ( !createFramebuffers() ) {
+        error_ = "framebuffer object could not be created" ;
+        backend_.reset() ;
+    }
+}
+
+bool HeadlessContext::createBackend(Backend backend) {
+    error_ = "no headless backend was built" ;
+
+#ifdef HAS_EGL
+    if ( backend == Backend::Any || backend == Backend::EGL ) {
+        backend_ = impl::createEGLBackend(error_) ;
+        if ( backend_ ) return true ;
+    }
+#endif
+
+#ifdef HAS_OSMESA
+    if ( backend == Backend::Any || backend == Backend::OSMesa ) {
+        backend_ = impl::createOSMesaBackend(error_) ;
+        if ( backend_ ) return true ;
+    }
+#endif
+
+    return false ;
+}
+
+HeadlessContext::~HeadlessContext() {
+    if ( !backend_ ) return ;
+
+    backend_->makeCurrent() ;
+
+    GLuint fbos[] = { fbo_, resolve_fbo_, flip_fbo_ } ;
+    GLuint rbs[] = { color_, depth_, resolve_color_, resolve_depth_, flip_color_, flip_depth_ } ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0) ;
+
+    for( GLuint fbo: fbos )
+        if ( fbo ) glDeleteFramebuffers(1, &fbo) ;
+    for( GLuint rb: rbs )
+        if ( rb ) glDeleteRenderbuffers(1, &rb) ;
+
+    backend_->doneCurrent() ;
+}
+
+HeadlessContext::Backend HeadlessContext::backend() const {
+    return backend_ ? backend_->type() : Backend::Any ;
+}
+
+static GLuint createRenderbuffer(GLenum format, GLsizei width, GLsizei height, GLsizei samples) {
+    GLuint rb ;
+    glGenRenderbuffers(1, &rb) ;
+    glBindRenderbuffer(GL_RENDERBUFFER, rb) ;
+
+    if ( samples > 0 )
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height) ;
+    else
+        glRenderbufferStorage(GL_RENDERBUFFER, format, width, height) ;
+
+    return rb ;
+}
+
+static GLuint createFramebuffer(GLuint color, GLuint depth) {
+    GLuint fbo ;
+    glGenFramebuffers(1, &fbo) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth) ;
+
+    return fbo ;
+}
+
+bool HeadlessContext::createFramebuffers() {
+    if ( samples_ > 0 ) {
+        resolve_color_ = createRenderbuffer(GL_RGBA8, width_, height_, 0) ;
+        resolve_depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, width_, height_, 0) ;
+        resolve_fbo_ = createFramebuffer(resolve_color_, resolve_depth_) ;
+    }
+
+    flip_color_ = createRenderbuffer(GL_RGBA8, width_, height_, 0) ;
+    flip_depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, width_, height_, 0) ;
+    flip_fbo_ = createFramebuffer(flip_color_, flip_depth_) ;
+
+    color_ = createRenderbuffer(GL_RGBA8, width_, height_, samples_) ;
+    depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, width_, height_, samples_) ;
+    fbo_ = createFramebuffer(color_, depth_) ;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0) ;
+    glViewport(0, 0, width_, height_) ;
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ;
+}
+
+void HeadlessContext::use() {
+    if ( !backend_ ) return ;
+
+    backend_->makeCurrent() ;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+}
+
+void HeadlessContext::release() {
+    if ( !backend_ ) return ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0) ;
+    backend_->doneCurrent() ;
+}
+
+// Copy the buffers upside down to flip_fbo_, which is left bound for reading, as in OffscreenSurface. Multisampled
+// buffers are resolved first since they can only be blitted to a rectangle of the same size and orientation.
+
+void HeadlessContext::flipBuffers(GLbitfield mask) const {
+    const GLint w = width_, h = height_ ;
+
+    GLuint src = fbo_ ;
+
+    if ( samples_ > 0 ) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, src) ;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_fbo_) ;
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, mask, GL_NEAREST) ;
+
+        src = resolve_fbo_ ;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, src) ;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, flip_fbo_) ;
+    glBlitFramebuffer(0, 0, w, h, 0, h, w, 0, mask, GL_NEAREST) ;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, flip_fbo_) ;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+}
+
+Image HeadlessContext::getImage(bool alpha) const {
+    GLint bound ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound) ;
+
+    flipBuffers(GL_COLOR_BUFFER_BIT) ;
+
+    unsigned char *bytes = new unsigned char [width_ * height_ * ( alpha ? 4 : 3 )] ;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1) ;
+    glReadPixels(0, 0, width_, height_, alpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, bytes) ;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, bound) ;
+
+    return Image(bytes, alpha ? ImageFormat::rgba32 : ImageFormat::rgb24, width_, height_) ;
+}
+
+std::unique_ptr<float []> HeadlessContext::readDepth() const {
+    GLint bound ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound) ;
+
+    flipBuffers(GL_DEPTH_BUFFER_BIT) ;
+
+    std::unique_ptr<float []> data(new float [width_ * height_]) ;
+    glReadPixels(0, 0, width_, height_, GL_DEPTH_COMPONENT, GL_FLOAT, data.get()) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, bound) ;
+
+    return data ;
+}
+
+// undo the perspective mapping of the depth buffer, see OffscreenSurface::getDepthBuffer
+
+static inline float linearDepth(float d, float znear, float zfar) {
+    return 2 * zfar * znear / ( zfar + znear - ( zfar - znear ) * ( 2 * d - 1 ) ) ;
+}
+
+Image HeadlessContext::getDepthBuffer(float znear, float zfar) const {
+    std::unique_ptr<float []> data = readDepth() ;
+
+    const float max_allowed_z = zfar * 0.99 ;
+    const size_t n = width_ * height_ ;
+
+    uint16_t *dst = new uint16_t [n] ;
+
+    for( size_t i=0 ; i<n ; i++ ) {
+        float z = linearDepth(data[i], znear, zfar) ;
+        dst[i] = ( z > max_allowed_z ) ? 0 : std::round(z * 1000) ;
+    }
+
+    return Image((unsigned char *)dst, ImageFormat::gray16, width_, height_) ;
+}
+
+Image HeadlessContext::getDepthBufferFloat(float znear, float zfar) const {
+    std::unique_ptr<float []> data = readDepth() ;
+
+    const float max_allowed_z = zfar * 0.99 ;
+    const size_t n = width_ * height_ ;
+
+    for( size_t i=0 ; i<n ; i++ ) {
+        float z = linearDepth(data[i], znear, zfar) ;
+        data[i] = ( z > max_allowed_z ) ? 0 : z ;
+    }
+
+    return Image((unsigned char *)data.release(), ImageFormat::float32, width_, height_) ;
+}
+
+}
@@ -0,0 +1,71 @@
+#include "headless_backend.hpp"
+
+#include <GL/osmesa.h>
+
+namespace xviz { namespace impl {
+
+// OSMesa renders the default framebuffer into client memory, a single pixel is enough since rendering goes to
+// framebuffer objects
+
+class OSMesaBackend: public HeadlessBackend {
+public:
+
+    ~OSMesaBackend() {
+        if ( context_ ) OSMesaDestroyContext(context_) ;
+    }
+
+    bool create(std::string &error) ;
+
+    HeadlessContext::Backend type() const override { return HeadlessContext::Backend::OSMesa ; }
+
+    bool makeCurrent() override {
+        return OSMesaMakeCurrent(context_, buffer_, GL_UNSIGNED_BYTE, 1, 1) == GL_TRUE ;
+    }
+
+    // OSMesa has no call to release the context, it stays current until another one is made current
+    void doneCurrent() override {}
+
+    Loader loader() const override {
+        return [](const char *name) { return reinterpret_cast<Proc>(OSMesaGetProcAddress(name)) ; } ;
+    }
+
+private:
+
+    OSMesaContext context_ = nullptr ;
+    unsigned char buffer_[4] ;
+};
+
+bool OSMesaBackend::create(std::string &error) {
+    const int attribs[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0
+    } ;
+
+    context_ = OSMesaCreateContextAttribs(attribs, nullptr) ;
+
+    if ( !context_ ) {
+        error = "OSMesa could not create an OpenGL 3.3 core context" ;
+        return false ;
+    }
+
+    if ( !makeCurrent() ) {
+        error = "OSMesa context could not be made current" ;
+        return false ;
+    }
+
+    return true ;
+}
+
+std::unique_ptr<HeadlessBackend> createOSMesaBackend(std::string &error) {
+    std::unique_ptr<OSMesaBackend> backend(new OSMesaBackend) ;
+
+    if ( !backend->create(error) ) return nullptr ;
+
+    return backend ;
+}
+
+}}
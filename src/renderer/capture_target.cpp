@@ -0,0 +1,149 @@
+#include "capture_target.hpp"
+
+#include <iostream>
+
+namespace xviz { namespace impl {
+
+// storage of each target and the format in which it is read back, in the order of the fragment shader outputs
+
+struct TargetFormat {
+    GLenum internal_format_ ;
+    GLenum format_, type_ ;
+    ImageFormat image_format_ ;
+    uint32_t pixel_size_ ;
+};
+
+static const TargetFormat target_formats[CaptureTarget::num_targets_] = {
+    { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, ImageFormat::rgba32, 4 },
+    { GL_R32F, GL_RED, GL_FLOAT, ImageFormat::float32, 4 },
+    { GL_RGBA16F, GL_RGB, GL_FLOAT, ImageFormat::float32x3, 12 },
+    { GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, ImageFormat::uint32, 4 }
+} ;
+
+static const GLenum attachments[CaptureTarget::num_targets_] = {
+    GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
+} ;
+
+CaptureTarget::~CaptureTarget() {
+    release() ;
+}
+
+void CaptureTarget::release() {
+    if ( fbo_ ) glDeleteFramebuffers(1, &fbo_) ;
+    if ( flip_fbo_ ) glDeleteFramebuffers(1, &flip_fbo_) ;
+    if ( targets_[0] ) glDeleteRenderbuffers(num_targets_, targets_) ;
+    if ( flip_targets_[0] ) glDeleteRenderbuffers(num_targets_, flip_targets_) ;
+    if ( depth_ ) glDeleteRenderbuffers(1, &depth_) ;
+
+    fbo_ = flip_fbo_ = depth_ = 0 ;
+    for( int i=0 ; i<num_targets_ ; i++ )
+        targets_[i] = flip_targets_[i] = 0 ;
+
+    width_ = height_ = 0 ;
+}
+
+static GLuint createRenderbuffer(GLenum format, GLsizei width, GLsizei height) {
+    GLuint rb ;
+    glGenRenderbuffers(1, &rb) ;
+    glBindRenderbuffer(GL_RENDERBUFFER, rb) ;
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height) ;
+    return rb ;
+}
+
+void CaptureTarget::create(GLsizei width, GLsizei height) {
+    release() ;
+
+    width_ = width ;
+    height_ = height ;
+
+    glGenFramebuffers(1, &fbo_) ;
+    glGenFramebuffers(1, &flip_fbo_) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, flip_fbo_) ;
+
+    for( int i=0 ; i<num_targets_ ; i++ ) {
+        flip_targets_[i] = createRenderbuffer(target_formats[i].internal_format_, width, height) ;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER, flip_targets_[i]) ;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+
+    for( int i=0 ; i<num_targets_ ; i++ ) {
+        targets_[i] = createRenderbuffer(target_formats[i].internal_format_, width, height) ;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER, targets_[i]) ;
+    }
+
+    depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, width, height) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_) ;
+
+    glDrawBuffers(num_targets_, attachments) ;
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+        std::cerr << "capture framebuffer is not complete" << std::endl ;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0) ;
+}
+
+void CaptureTarget::begin(const Viewport &vp, const Eigen::Vector4f &bg) {
+    GLsizei width = vp.x_ + vp.width_, height = vp.y_ + vp.height_ ;
+
+    if ( width > width_ || height > height_ )
+        create(std::max(width, width_), std::max(height, height_)) ;
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+
+    vp_ = vp ;
+
+    const GLfloat zero[4] = { 0, 0, 0, 0 }, one = 1.0f ;
+    const GLuint zero_id[4] = { 0, 0, 0, 0 } ;
+
+    glDepthMask(GL_TRUE) ;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE) ;
+
+    glClearBufferfv(GL_COLOR, 0, bg.data()) ;
+    glClearBufferfv(GL_COLOR, 1, zero) ;
+    glClearBufferfv(GL_COLOR, 2, zero) ;
+    glClearBufferuiv(GL_COLOR, 3, zero_id) ;
+    glClearBufferfv(GL_DEPTH, 0, &one) ;
+}
+
+// A blit copies the read buffer to all draw buffers, hence the targets are flipped one at a time. Integer targets
+// may only be blitted with nearest filtering.
+
+void CaptureTarget::read(Capture &result) {
+    const GLint x0 = vp_.x_, y0 = vp_.y_, x1 = vp_.x_ + vp_.width_, y1 = vp_.y_ + vp_.height_ ;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_) ;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, flip_fbo_) ;
+
+    for( int i=0 ; i<num_targets_ ; i++ ) {
+        GLenum draw_buffers[num_targets_] = { GL_NONE, GL_NONE, GL_NONE, GL_NONE } ;
+        draw_buffers[i] = attachments[i] ;
+
+        glReadBuffer(attachments[i]) ;
+        glDrawBuffers(num_targets_, draw_buffers) ;
+        glBlitFramebuffer(x0, y0, x1, y1, x0, y1, x1, y0, GL_COLOR_BUFFER_BIT, GL_NEAREST) ;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, flip_fbo_) ;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+    // rows of all targets are a multiple of 4 bytes
+    glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    Image *images[num_targets_] = { &result.color_, &result.depth_, &result.normals_, &result.ids_ } ;
+
+    for( int i=0 ; i<num_targets_ ; i++ ) {
+        const TargetFormat &tf = target_formats[i] ;
+
+        unsigned char *bytes = new unsigned char [vp_.width_ * vp_.height_ * tf.pixel_size_] ;
+
+        glReadBuffer(attachments[i]) ;
+        glReadPixels(x0, y0, vp_.width_, vp_.height_, tf.format_, tf.type_, bytes) ;
+
+        *images[i] = Image(bytes, tf.image_format_, vp_.width_, vp_.height_) ;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0) ;
+}
+
+}}
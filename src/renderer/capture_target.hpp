@@ -0,0 +1,47 @@
+#ifndef XVIZ_RENDERER_CAPTURE_TARGET_HPP
+#define XVIZ_RENDERER_CAPTURE_TARGET_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <xviz/scene/renderer.hpp>
+
+namespace xviz { namespace impl {
+
+// Framebuffer of Renderer::capture with one color attachment per output of capture_fragment_shader: RGBA8 color,
+// R32F linear depth, RGBA16F normals and R32UI ids, plus a depth buffer. The targets are flipped vertically into a
+// second framebuffer by a blit before reading, so that the images come out in top to bottom row order and no pixel
+// is touched on the CPU.
+
+class CaptureTarget {
+public:
+
+    CaptureTarget() = default ;
+    ~CaptureTarget() ;
+
+    CaptureTarget(const CaptureTarget &) = delete ;
+    CaptureTarget &operator = (const CaptureTarget &) = delete ;
+
+    // Bind the framebuffer with all targets enabled and clear them, color to the given background and the rest to
+    // zero. The framebuffer covers the viewport, it is reallocated when the viewport grows.
+    void begin(const Viewport &vp, const Eigen::Vector4f &bg) ;
+
+    // read the viewport of each target into the images of result, leaves the framebuffer unbound
+    void read(Capture &result) ;
+
+    static const int num_targets_ = 4 ;
+
+private:
+
+    void create(GLsizei width, GLsizei height) ;
+    void release() ;
+
+    GLuint fbo_ = 0, flip_fbo_ = 0 ;
+    GLuint targets_[num_targets_] = { 0 }, flip_targets_[num_targets_] = { 0 } ;
+    GLuint depth_ = 0 ;
+    GLsizei width_ = 0, height_ = 0 ;
+    Viewport vp_ ;
+};
+
+}}
+
+#endif
@@ -0,0 +1,52 @@
+#include "downsampler.hpp"
+
+namespace xviz { namespace impl {
+
+Downsampler::~Downsampler() {
+    if ( vao_ ) glDeleteVertexArrays(1, &vao_) ;
+}
+
+// the vertex shader has no inputs but the core profile still needs a vertex array to draw
+
+void Downsampler::init() {
+    if ( shader_ ) return ;
+
+    shader_.reset(new OpenGLShaderProgram) ;
+    shader_->addShaderFromFile(VERTEX_SHADER, "@downsample_vs") ;
+    shader_->addShaderFromFile(FRAGMENT_SHADER, "@downsample_fs") ;
+    shader_->link() ;
+
+    glGenVertexArrays(1, &vao_) ;
+}
+
+void Downsampler::run(const RenderTarget &src, const RenderTarget &tmp, const RenderTarget &dst, uint32_t factor,
+                      bool lanczos, bool flip, GLState &state) {
+    init() ;
+
+    state.useProgram(shader_->handle()) ;
+    shader_->setUniform("src", (GLint)0) ;
+    shader_->setUniform("factor", (GLint)factor) ;
+    shader_->setUniform("lanczos", (GLint)lanczos) ;
+
+    state.bindVertexArray(vao_) ;
+
+    state.disable(GL_DEPTH_TEST) ;
+    state.disable(GL_BLEND) ;
+    state.disable(GL_CULL_FACE) ;
+
+    pass(src.color_, tmp, 0, false, state) ;
+    pass(tmp.color_, dst, 1, flip, state) ;
+}
+
+void Downsampler::pass(GLuint src, const RenderTarget &dst, int axis, bool flip, GLState &state) {
+    glBindFramebuffer(GL_FRAMEBUFFER, dst.fbo_) ;
+    state.viewport(0, 0, dst.desc_.width_, dst.desc_.height_) ;
+    state.bindTexture(0, GL_TEXTURE_2D, src) ;
+
+    shader_->setUniform("axis", (GLint)axis) ;
+    shader_->setUniform("flip", (GLint)flip) ;
+
+    glDrawArrays(GL_TRIANGLES, 0, 3) ;
+}
+
+}}
@@ -0,0 +1,45 @@
+#ifndef XVIZ_RENDERER_DOWNSAMPLER_HPP
+#define XVIZ_RENDERER_DOWNSAMPLER_HPP
+
+#include "common/gl/gl3w.h"
+#include "common/shader.hpp"
+
+#include "gl_state.hpp"
+#include "render_target_pool.hpp"
+
+#include <memory>
+
+namespace xviz { namespace impl {
+
+// Reduction of a supersampled image by an integer factor on the GPU, with a box or a Lanczos filter. The filters
+// are separable: a first pass reduces the width into an intermediate target, a second one the height into the
+// destination. The intermediate target should have a floating point format so that the negative lobes of the
+// Lanczos kernel are not clamped between the passes.
+
+class Downsampler {
+public:
+
+    Downsampler() = default ;
+    ~Downsampler() ;
+
+    Downsampler(const Downsampler &) = delete ;
+    Downsampler &operator = (const Downsampler &) = delete ;
+
+    // src has factor times the width and height of dst, tmp the width of dst and the height of src, both src and
+    // tmp have single sampled color textures. With flip the rows of dst are in the reverse order of those of src.
+    // Leaves dst bound.
+    void run(const RenderTarget &src, const RenderTarget &tmp, const RenderTarget &dst, uint32_t factor, bool lanczos,
+             bool flip, GLState &state) ;
+
+private:
+
+    void init() ;
+    void pass(GLuint src, const RenderTarget &dst, int axis, bool flip, GLState &state) ;
+
+    std::unique_ptr<OpenGLShaderProgram> shader_ ;
+    GLuint vao_ = 0 ;
+};
+
+}}
+
+#endif
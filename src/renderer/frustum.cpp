@@ -0,0 +1,55 @@
+#include "frustum.hpp"
+
+using namespace Eigen ;
+
+namespace xviz { namespace impl {
+
+// J. Arvo, Transforming axis-aligned bounding boxes, Graphics Gems 1990
+
+BoundingBox BoundingBox::transformed(const Affine3f &tf) const {
+    if ( empty() ) return *this ;
+
+    const Matrix3f &m = tf.linear() ;
+    Vector3f bmin = tf.translation(), bmax = tf.translation() ;
+
+    for( int i=0 ; i<3 ; i++ ) {
+        for( int j=0 ; j<3 ; j++ ) {
+            float a = m(i, j) * min_[j] ;
+            float b = m(i, j) * max_[j] ;
+            bmin[i] += std::min(a, b) ;
+            bmax[i] += std::max(a, b) ;
+        }
+    }
+
+    return { bmin, bmax } ;
+}
+
+// G. Gribb, K. Hartmann, Fast extraction of viewing frustum planes from the world-view-projection matrix
+
+Frustum::Frustum(const Matrix4f &m) {
+    Vector4f r0 = m.row(0), r1 = m.row(1), r2 = m.row(2), r3 = m.row(3) ;
+
+    planes_[0] = r3 + r0 ; // left
+    planes_[1] = r3 - r0 ; // right
+    planes_[2] = r3 + r1 ; // bottom
+    planes_[3] = r3 - r1 ; // top
+    planes_[4] = r3 + r2 ; // near
+    planes_[5] = r3 - r2 ; // far
+}
+
+bool Frustum::intersects(const BoundingBox &box) const {
+    if ( box.empty() ) return true ;
+
+    for( const Vector4f &p: planes_ ) {
+        // corner of the box furthest along the plane normal
+        Vector3f v(p.x() >= 0 ? box.max_.x() : box.min_.x(),
+                   p.y() >= 0 ? box.max_.y() : box.min_.y(),
+                   p.z() >= 0 ? box.max_.z() : box.min_.z()) ;
+
+        if ( p.head<3>().dot(v) + p.w() < 0 ) return false ;
+    }
+
+    return true ;
+}
+
+}}
@@ -0,0 +1,45 @@
+#ifndef XVIZ_RENDERER_FRUSTUM_HPP
+#define XVIZ_RENDERER_FRUSTUM_HPP
+
+#include <Eigen/Geometry>
+#include <limits>
+
+namespace xviz { namespace impl {
+
+// axis aligned box used for culling, an empty box is never culled
+
+struct BoundingBox {
+    Eigen::Vector3f min_ = Eigen::Vector3f::Constant(std::numeric_limits<float>::max()) ;
+    Eigen::Vector3f max_ = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max()) ;
+
+    BoundingBox() = default ;
+    BoundingBox(const Eigen::Vector3f &bmin, const Eigen::Vector3f &bmax): min_(bmin), max_(bmax) {}
+
+    bool empty() const { return min_.x() > max_.x() ; }
+
+    void extend(const BoundingBox &other) {
+        min_ = min_.cwiseMin(other.min_) ;
+        max_ = max_.cwiseMax(other.max_) ;
+    }
+
+    // box enclosing the transformed box
+    BoundingBox transformed(const Eigen::Affine3f &tf) const ;
+};
+
+// The six planes of a view volume extracted from the combined projection and view matrix.
+// Plane normals point towards the inside of the volume.
+
+class Frustum {
+public:
+    Frustum(const Eigen::Matrix4f &proj_view) ;
+
+    // false if the box is certainly outside the volume, the test is conservative for boxes near the corners
+    bool intersects(const BoundingBox &box) const ;
+
+private:
+    Eigen::Vector4f planes_[6] ;
+};
+
+}}
+
+#endif
@@ -0,0 +1,213 @@
+#include "gl_state.hpp"
+
+#include <iostream>
+
+namespace xviz { namespace impl {
+
+static const GLenum capabilities[] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_DEPTH_CLAMP, GL_LINE_SMOOTH, GL_RASTERIZER_DISCARD } ;
+static const char *capability_names[] = { "GL_BLEND", "GL_CULL_FACE", "GL_DEPTH_TEST", "GL_DEPTH_CLAMP", "GL_LINE_SMOOTH", "GL_RASTERIZER_DISCARD" } ;
+
+static const GLenum texture_targets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER } ;
+static const GLenum texture_bindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_BUFFER } ;
+
+static int capabilityIndex(GLenum cap) {
+    for( size_t i=0 ; i<sizeof(capabilities)/sizeof(GLenum) ; i++ )
+        if ( capabilities[i] == cap ) return i ;
+    return -1 ;
+}
+
+static int targetIndex(GLenum target) {
+    for( size_t i=0 ; i<sizeof(texture_targets)/sizeof(GLenum) ; i++ )
+        if ( texture_targets[i] == target ) return i ;
+    return -1 ;
+}
+
+void GLState::invalidate() {
+    for( auto &c: capabilities_ ) c.known_ = false ;
+
+    depth_func_.known_ = front_face_.known_ = cull_face_.known_ = false ;
+    depth_mask_.known_ = false ;
+    blend_func_.known_ = false ;
+    line_width_.known_ = false ;
+    viewport_.known_ = false ;
+
+    invalidateBindings() ;
+}
+
+void GLState::invalidateBindings() {
+    program_.known_ = vao_.known_ = active_unit_.known_ = false ;
+
+    for( auto &unit: textures_ )
+        for( auto &t: unit ) t.known_ = false ;
+}
+
+void GLState::invalidateVertexArray() {
+    vao_.known_ = false ;
+}
+
+void GLState::invalidateTexture(GLenum target) {
+    int t = targetIndex(target) ;
+    if ( t < 0 ) return ;
+
+    if ( active_unit_.known_ && active_unit_.value_ < MAX_TEXTURE_UNITS )
+        textures_[active_unit_.value_][t].known_ = false ;
+    else if ( !active_unit_.known_ ) {
+        for( auto &unit: textures_ )
+            unit[t].known_ = false ;
+    }
+}
+
+void GLState::setCapability(GLenum cap, bool enabled) {
+    int c = capabilityIndex(cap) ;
+
+    if ( c < 0 || update(capabilities_[c], enabled) ) {
+        if ( c < 0 ) ++issued_ ;
+        if ( enabled ) glEnable(cap) ;
+        else glDisable(cap) ;
+    }
+
+    checked() ;
+}
+
+void GLState::depthFunc(GLenum func) {
+    if ( update(depth_func_, func) ) glDepthFunc(func) ;
+    checked() ;
+}
+
+void GLState::depthMask(GLboolean mask) {
+    if ( update(depth_mask_, mask) ) glDepthMask(mask) ;
+    checked() ;
+}
+
+void GLState::frontFace(GLenum mode) {
+    if ( update(front_face_, mode) ) glFrontFace(mode) ;
+    checked() ;
+}
+
+void GLState::cullFace(GLenum mode) {
+    if ( update(cull_face_, mode) ) glCullFace(mode) ;
+    checked() ;
+}
+
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+    if ( update(blend_func_, std::make_pair(sfactor, dfactor)) ) glBlendFunc(sfactor, dfactor) ;
+    checked() ;
+}
+
+void GLState::lineWidth(GLfloat width) {
+    if ( update(line_width_, width) ) glLineWidth(width) ;
+    checked() ;
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if ( update(viewport_, std::array<GLint, 4>{x, y, width, height}) ) glViewport(x, y, width, height) ;
+    checked() ;
+}
+
+void GLState::useProgram(GLuint program) {
+    if ( update(program_, program) ) {
+        glUseProgram(program) ;
+        if ( program ) ++program_switches_ ;
+    }
+    checked() ;
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if ( update(vao_, vao) ) glBindVertexArray(vao) ;
+    checked() ;
+}
+
+void GLState::activeTexture(GLuint unit) {
+    if ( update(active_unit_, unit) ) glActiveTexture(GL_TEXTURE0 + unit) ;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int t = targetIndex(target) ;
+
+    if ( t < 0 || unit >= MAX_TEXTURE_UNITS ) {
+        activeTexture(unit) ;
+        glBindTexture(target, texture) ;
+        ++issued_ ;
+        ++texture_binds_ ;
+    } else if ( update(textures_[unit][t], texture) ) {
+        activeTexture(unit) ;
+        glBindTexture(target, texture) ;
+        ++texture_binds_ ;
+    }
+
+    checked() ;
+}
+
+static bool check(const char *name, double shadowed, double actual) {
+    if ( shadowed == actual ) return true ;
+
+    std::cerr << "GL state mismatch: " << name << " is " << actual << ", expected " << shadowed << std::endl ;
+    return false ;
+}
+
+bool GLState::validate() const {
+    bool valid = true ;
+
+    auto integer = [](GLenum pname) {
+        GLint v = 0 ;
+        glGetIntegerv(pname, &v) ;
+        return v ;
+    } ;
+
+    for( int i=0 ; i<NUM_CAPABILITIES ; i++ ) {
+        if ( capabilities_[i].known_ )
+            valid &= check(capability_names[i], capabilities_[i].value_, glIsEnabled(capabilities[i])) ;
+    }
+
+    if ( depth_func_.known_ ) valid &= check("GL_DEPTH_FUNC", depth_func_.value_, integer(GL_DEPTH_FUNC)) ;
+    if ( front_face_.known_ ) valid &= check("GL_FRONT_FACE", front_face_.value_, integer(GL_FRONT_FACE)) ;
+    if ( cull_face_.known_ ) valid &= check("GL_CULL_FACE_MODE", cull_face_.value_, integer(GL_CULL_FACE_MODE)) ;
+
+    if ( depth_mask_.known_ ) {
+        GLboolean mask ;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &mask) ;
+        valid &= check("GL_DEPTH_WRITEMASK", depth_mask_.value_, mask) ;
+    }
+
+    if ( blend_func_.known_ ) {
+        valid &= check("GL_BLEND_SRC_RGB", blend_func_.value_.first, integer(GL_BLEND_SRC_RGB)) ;
+        valid &= check("GL_BLEND_DST_RGB", blend_func_.value_.second, integer(GL_BLEND_DST_RGB)) ;
+    }
+
+    if ( line_width_.known_ ) {
+        GLfloat width ;
+        glGetFloatv(GL_LINE_WIDTH, &width) ;
+        valid &= check("GL_LINE_WIDTH", line_width_.value_, width) ;
+    }
+
+    if ( viewport_.known_ ) {
+        GLint vp[4] ;
+        glGetIntegerv(GL_VIEWPORT, vp) ;
+        for( int i=0 ; i<4 ; i++ )
+            valid &= check("GL_VIEWPORT", viewport_.value_[i], vp[i]) ;
+    }
+
+    if ( program_.known_ ) valid &= check("GL_CURRENT_PROGRAM", program_.value_, integer(GL_CURRENT_PROGRAM)) ;
+    if ( vao_.known_ ) valid &= check("GL_VERTEX_ARRAY_BINDING", vao_.value_, integer(GL_VERTEX_ARRAY_BINDING)) ;
+
+    // the texture bindings are queried per unit, the active unit is restored afterwards
+
+    GLint active = integer(GL_ACTIVE_TEXTURE) ;
+
+    if ( active_unit_.known_ ) valid &= check("GL_ACTIVE_TEXTURE", GL_TEXTURE0 + active_unit_.value_, active) ;
+
+    for( GLuint unit=0 ; unit<MAX_TEXTURE_UNITS ; unit++ ) {
+        for( int t=0 ; t<NUM_TEXTURE_TARGETS ; t++ ) {
+            if ( !textures_[unit][t].known_ ) continue ;
+
+            glActiveTexture(GL_TEXTURE0 + unit) ;
+            valid &= check("texture binding", textures_[unit][t].value_, integer(texture_bindings[t])) ;
+        }
+    }
+
+    glActiveTexture(active) ;
+
+    return valid ;
+}
+
+}}
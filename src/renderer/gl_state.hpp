@@ -0,0 +1,113 @@
+#ifndef XVIZ_RENDERER_GL_STATE_HPP
+#define XVIZ_RENDERER_GL_STATE_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <cstdint>
+#include <array>
+#include <utility>
+
+namespace xviz { namespace impl {
+
+// Shadow copy of the GL state set by the renderer. Each setter issues the GL call only when the value differs from
+// the shadowed one or the latter is unknown. Code changing the state without going through this class (e.g. the
+// creation of buffers and textures, or the application between frames) has to be followed by a call to one of the
+// invalidate functions, after which the affected setters issue their next call unconditionally.
+
+class GLState {
+public:
+
+    GLState() { invalidate() ; }
+
+    // forget all shadowed values
+    void invalidate() ;
+    // forget the bound program, vertex array and textures
+    void invalidateBindings() ;
+    void invalidateVertexArray() ;
+    // forget the texture bound to the target of the active unit
+    void invalidateTexture(GLenum target) ;
+
+    // GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_DEPTH_CLAMP, GL_LINE_SMOOTH and GL_RASTERIZER_DISCARD are shadowed,
+    // other capabilities are always set
+    void enable(GLenum cap) { setCapability(cap, true) ; }
+    void disable(GLenum cap) { setCapability(cap, false) ; }
+    void setCapability(GLenum cap, bool enabled) ;
+
+    void depthFunc(GLenum func) ;
+    void depthMask(GLboolean mask) ;
+    void frontFace(GLenum mode) ;
+    void cullFace(GLenum mode) ;
+    void blendFunc(GLenum sfactor, GLenum dfactor) ;
+    void lineWidth(GLfloat width) ;
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) ;
+
+    void useProgram(GLuint program) ;
+    void bindVertexArray(GLuint vao) ;
+
+    // bind the texture to the unit, switching the active unit only if needed. The 2D, 2D array, cube map and buffer
+    // targets of the first MAX_TEXTURE_UNITS units are shadowed.
+    void bindTexture(GLuint unit, GLenum target, GLuint texture) ;
+
+    // Debug mode, the shadowed state is compared with the one returned by glGet after each call and mismatches are
+    // printed. This stalls the pipeline and is meant to find code that changes the state behind the back of the cache.
+    void setValidation(bool enable) { validate_ = enable ; }
+
+    // compare the known shadowed values with the current GL state, returns false on mismatch
+    bool validate() const ;
+
+    // calls issued and skipped since the last reset, and among the issued ones the program and texture changes
+    uint32_t callsIssued() const { return issued_ ; }
+    uint32_t callsSkipped() const { return skipped_ ; }
+    uint32_t programSwitches() const { return program_switches_ ; }
+    uint32_t textureBinds() const { return texture_binds_ ; }
+    void resetCounters() { issued_ = skipped_ = program_switches_ = texture_binds_ = 0 ; }
+
+    static const GLuint MAX_TEXTURE_UNITS = 16 ;
+
+private:
+
+    template<typename T>
+    struct Value {
+        T value_ ;
+        bool known_ = false ;
+    };
+
+    static const int NUM_CAPABILITIES = 6 ;
+    static const int NUM_TEXTURE_TARGETS = 4 ;
+
+    // records the new value, returns true if the call has to be issued
+    template<typename T>
+    bool update(Value<T> &v, const T &value) {
+        if ( v.known_ && v.value_ == value ) {
+            ++skipped_ ;
+            return false ;
+        }
+
+        v.value_ = value ;
+        v.known_ = true ;
+        ++issued_ ;
+        return true ;
+    }
+
+    void activeTexture(GLuint unit) ;
+
+    void checked() const {
+        if ( validate_ ) validate() ;
+    }
+
+    Value<bool> capabilities_[NUM_CAPABILITIES] ;
+    Value<GLenum> depth_func_, front_face_, cull_face_ ;
+    Value<GLboolean> depth_mask_ ;
+    Value<std::pair<GLenum, GLenum>> blend_func_ ;
+    Value<GLfloat> line_width_ ;
+    Value<std::array<GLint, 4>> viewport_ ;
+    Value<GLuint> program_, vao_, active_unit_ ;
+    Value<GLuint> textures_[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS] ;
+
+    uint32_t issued_ = 0, skipped_ = 0, program_switches_ = 0, texture_binds_ = 0 ;
+    bool validate_ = false ;
+};
+
+}}
+
+#endif
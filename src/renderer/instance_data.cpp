@@ -0,0 +1,113 @@
+#include "instance_data.hpp"
+#include "profiler.hpp"
+
+#include <xviz/scene/geometry.hpp>
+
+using namespace Eigen ;
+
+namespace xviz { namespace impl {
+
+static_assert(sizeof(Affine3f) == sizeof(Matrix4f), "Affine3f should be stored as a 4x4 matrix") ;
+
+InstanceData::~InstanceData() {
+    if ( buffer_ ) glDeleteBuffers(1, &buffer_) ;
+}
+
+void InstanceData::upload(const Matrix4f *matrices, const Vector4f *colors, GLsizei count) {
+    if ( buffer_ == 0 )
+        glGenBuffers(1, &buffer_) ;
+
+    GLsizeiptr matrices_size = count * sizeof(Matrix4f) ;
+    GLsizeiptr colors_size = colors ? count * sizeof(Vector4f) : 0 ;
+    GLsizeiptr size = matrices_size + colors_size ;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_) ;
+
+    if ( size > capacity_ ) {
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW) ;
+        capacity_ = size ;
+    } else {
+        // orphan the previous storage that may still be in use
+        glBufferData(GL_ARRAY_BUFFER, capacity_, nullptr, GL_DYNAMIC_DRAW) ;
+    }
+
+    if ( matrices_size ) glBufferSubData(GL_ARRAY_BUFFER, 0, matrices_size, matrices) ;
+    if ( colors_size ) glBufferSubData(GL_ARRAY_BUFFER, matrices_size, colors_size, colors) ;
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+
+    FrameProfiler::addUploadedBytes(size) ;
+
+    count_ = count ;
+    colors_offset_ = colors ? matrices_size : -1 ;
+}
+
+void InstanceData::release() {
+    manager_->release(drawable_) ;
+}
+
+InstanceDataManager::~InstanceDataManager() {
+    dirty_ = true ;
+    for( auto &p: instances_ ) {
+        InstancedDrawable *drawable = p.first ;
+        drawable->data_ = nullptr ;
+    }
+}
+
+InstanceData *InstanceDataManager::fetch(InstancedDrawable *drawable) {
+    InstanceData *data = nullptr ;
+
+    auto it = instances_.find(drawable) ;
+    if ( it == instances_.end() ) {
+        data = new InstanceData() ;
+        data->manager_ = this ;
+        data->drawable_ = drawable ;
+        drawable->data_ = data ;
+        instances_.emplace(drawable, std::unique_ptr<InstanceData>(data)) ;
+        drawable->setInstancesUpdated(true) ;
+    } else
+        data = (*it).second.get() ;
+
+    if ( drawable->instancesUpdated() ) {
+        const auto &trs = drawable->instanceTransforms() ;
+        const auto &colors = drawable->instanceColors() ;
+
+        data->upload(trs.empty() ? nullptr : &trs[0].matrix(),
+                     colors.empty() ? nullptr : colors.data(),
+                     (GLsizei)trs.size()) ;
+
+        data->bounds_ = BoundingBox() ;
+
+        GeometryPtr geom = drawable->geometry() ;
+
+        if ( geom && !geom->vertices().empty() ) {
+            auto box = geom->getBoundingBox() ;
+            BoundingBox local(box.bounds_[0], box.bounds_[1]) ;
+
+            for( const Affine3f &tr: trs )
+                data->bounds_.extend(local.transformed(tr)) ;
+        }
+
+        drawable->setInstancesUpdated(false) ;
+    }
+
+    return data ;
+}
+
+void InstanceDataManager::release(InstancedDrawable *drawable) {
+    if ( dirty_ ) return ;
+
+    to_delete_.push_back(drawable) ;
+}
+
+void InstanceDataManager::flush() {
+    for( InstancedDrawable *drawable: to_delete_ ) {
+        auto it = instances_.find(drawable) ;
+        if ( it != instances_.end() ) {
+            instances_.erase(it) ;
+        }
+    }
+    to_delete_.clear() ;
+}
+
+}}
@@ -0,0 +1,58 @@
+#ifndef XVIZ_RENDERER_INSTANCE_DATA_HPP
+#define XVIZ_RENDERER_INSTANCE_DATA_HPP
+
+#include <xviz/scene/drawable.hpp>
+
+#include <map>
+#include <vector>
+
+#include "common/gl/gl3w.h"
+#include "frustum.hpp"
+
+namespace xviz { namespace impl {
+
+class InstanceData ;
+
+// GPU copies of the instances of InstancedDrawables, managed the same way as MeshData for geometries
+
+class InstanceDataManager {
+public:
+    ~InstanceDataManager() ;
+    InstanceData *fetch(InstancedDrawable *drawable) ;
+    void release(InstancedDrawable *drawable) ;
+    void flush() ;
+
+private:
+    std::map<InstancedDrawable *, std::unique_ptr<impl::InstanceData>> instances_ ;
+    std::vector<InstancedDrawable *> to_delete_ ;
+    bool dirty_ = false ;
+};
+
+// Buffer holding the model matrices of the instances followed by their colors (if any).
+// The attributes are attached to the vertex array of a mesh with MeshData::bindInstanceAttributes.
+
+class InstanceData {
+public:
+
+    InstanceData() = default ;
+    ~InstanceData() ;
+
+    // replace the contents of the buffer, colors may be null, storage is reallocated only when it has to grow
+    void upload(const Eigen::Matrix4f *matrices, const Eigen::Vector4f *colors, GLsizei count) ;
+
+    void release() ;
+
+    GLuint buffer_ = 0 ;
+    GLsizei count_ = 0 ;
+    GLintptr colors_offset_ = -1 ;      // -1 if there are no per-instance colors
+    GLsizeiptr capacity_ = 0 ;
+
+    BoundingBox bounds_ ;               // bounds of all instances in the coordinates of the node, updated with the instances
+
+    InstanceDataManager *manager_ = nullptr ;
+    InstancedDrawable *drawable_ = nullptr ;
+};
+
+}}
+
+#endif
@@ -6,6 +6,9 @@
 #include "util.hpp"
 #include "texture_data.hpp"
 #include "renderer_impl.hpp"
+#include "uniform_buffer.hpp"
+
+#include <tuple>
 
 using namespace std ;
 using namespace Eigen ;
@@ -23,250 +26,184 @@ PhongMaterialProgram::PhongMaterialProgram(const MaterialProgramParams &params):
     vs_preproc.appendConstant("NUM_SPOT_LIGHTS_WITH_SHADOW", std::to_string(params.num_spot_lights_shadow_), params.enable_shadows_) ;
     vs_preproc.appendConstant("NUM_POINT_LIGHTS", std::to_string(params.num_point_lights_)) ;
     vs_preproc.appendConstant("NUM_POINT_LIGHTS_WITH_SHADOW", std::to_string(params.num_point_lights_shadow_), params.enable_shadows_) ;
+    vs_preproc.appendConstant("NUM_LIGHTS", std::to_string(params.numLights()), params.numLights() > 0) ;
     vs_preproc.appendDefinition("HAS_UVs", params.has_texture_map_) ;
     vs_preproc.appendDefinition("USE_SKINNING", params.enable_skinning_);
+    vs_preproc.appendDefinition("USE_INSTANCING", params.enable_instancing_);
+    vs_preproc.appendDefinition("HAS_INSTANCE_COLORS", params.has_instance_colors_);
+    vs_preproc.appendDefinition("CAPTURE", params.enable_capture_);
 
     addShaderFromFile(VERTEX_SHADER, "@vertex_shader", vs_preproc) ;
 
     OpenGLShaderPreproc fs_preproc ;
 
     fs_preproc.appendDefinition("HAS_DIFFUSE_MAP", params.has_texture_map_) ;
+    fs_preproc.appendDefinition("HAS_INSTANCE_COLORS", params.has_instance_colors_) ;
     fs_preproc.appendDefinition("HAS_SHADOWS", params.enable_shadows_) ;
+    fs_preproc.appendDefinition("CAPTURE", params.enable_capture_) ;
     fs_preproc.appendConstant("NUM_DIRECTIONAL_LIGHTS", std::to_string(params.num_dir_lights_)) ;
     fs_preproc.appendConstant("NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW", std::to_string(params.num_dir_lights_shadow_), params.enable_shadows_) ;
     fs_preproc.appendConstant("NUM_SPOT_LIGHTS", std::to_string(params.num_spot_lights_)) ;
     fs_preproc.appendConstant("NUM_SPOT_LIGHTS_WITH_SHADOW", std::to_string(params.num_spot_lights_shadow_), params.enable_shadows_) ;
     fs_preproc.appendConstant("NUM_POINT_LIGHTS", std::to_string(params.num_point_lights_)) ;
     fs_preproc.appendConstant("NUM_POINT_LIGHTS_WITH_SHADOW", std::to_string(params.num_point_lights_shadow_), params.enable_shadows_) ;
+    fs_preproc.appendConstant("NUM_LIGHTS", std::to_string(params.numLights()), params.numLights() > 0) ;
 
     addShaderFromFile(FRAGMENT_SHADER, "@phong_fragment_shader", fs_preproc) ;
 
-    link() ;
+    beginLink() ;
+}
+
+void PhongMaterialProgram::setup() {
+    setupShadowSamplers(params_) ;
+
+    ambient_ = uniform<Vector3f>("g_material.ambient") ;
+    specular_ = uniform<Vector3f>("g_material.specular") ;
+    shininess_ = uniform<float>("g_material.shininess") ;
+    diffuse_ = uniform<Vector3f>("g_material.diffuse") ;
+    opacity_ = uniform<float>("g_material.opacity") ;
+    diffuse_map_ = uniform<GLint>("diffuseMap") ;
 }
 
 void PhongMaterialProgram::applyParams(const MaterialPtr &mat) {
     const PhongMaterial *material = dynamic_cast<const PhongMaterial *>(mat.get());
     if ( material == nullptr ) return ;
 
-    setUniform("g_material.ambient", material->ambientColor()) ;
-    setUniform("g_material.specular", material->specularColor()) ;
-    setUniform("g_material.shininess", material->shininess());
-    setUniform("g_material.diffuse", material->diffuseColor());
-    setUniform("g_material.opacity", material->opacity());
+    ambient_.set(material->ambientColor()) ;
+    specular_.set(material->specularColor()) ;
+    shininess_.set(material->shininess());
+    diffuse_.set(material->diffuseColor());
+    opacity_.set(material->opacity());
 
-    if ( params_.has_texture_map_ & HAS_DIFFUSE_TEXTURE ) {
-        setUniform("diffuseMap", 0) ;
+    if ( params_.has_texture_map_ ) {
+        diffuse_map_.set(0) ;
     }
 }
 
 
 
-void MaterialProgram::bindTexture(const Texture2D *texture, TextureLoader loader, int slot) {
+void MaterialProgram::bindTexture(const Texture2D *texture, TextureLoader loader, GLState &state, int slot) {
     if ( !texture ) return ;
 
     impl::TextureData *data = loader(texture) ;
 
     if ( data && data->loaded() ) {
-        glActiveTexture(GL_TEXTURE0 + slot);
-        glBindTexture(GL_TEXTURE_2D, data->id());
+        state.bindTexture(slot, GL_TEXTURE_2D, data->id());
 
-        setUniform("map_transform", texture->transform().matrix()) ;
+        map_transform_.set(texture->transform().matrix()) ;
     }
 }
 
-void PhongMaterialProgram::bindTextures(const MaterialPtr &mat, TextureLoader loader)
+void PhongMaterialProgram::bindTextures(const MaterialPtr &mat, TextureLoader loader, GLState &state)
 {
     const PhongMaterial *m = dynamic_cast<const PhongMaterial *>(mat.get()) ;
     assert(m) ;
 
-    bindTexture(m->diffuseTexture(), loader, 0) ;
-}
-
-
-void MaterialProgram::applyBoneTransform(GLuint idx, const Matrix4f &tf)
-{
-    ostringstream name ;
-    name << "g_bones[" << idx << "]" ;
-    setUniform(name.str().c_str(), tf) ;
-}
-
-void MaterialProgram::applyDefaultPerspective(const Matrix4f &cam, const Matrix4f &view, const Matrix4f &model) {
-    Matrix4f mvp =  cam * view * model;
-    Matrix4f mv =   view * model;
-
-    Matrix3f wpi = mv.block<3, 3>(0, 0).transpose().eval() ;
-    Matrix3f wp(wpi.inverse().eval()) ;
-
-    setUniform("mvp", mvp) ;
-    setUniform("mv", mv) ;
-    setUniform("mvn", wp) ;
-    setUniform("model", model) ;
-    setUniform("eyePos", Vector4f(view.inverse() * Vector4f(0, 0, 0, 1)));
+    bindTexture(m->diffuseTexture(), loader, state, 0) ;
 }
 
 
-void MaterialProgram::applyDirectionalLight(GLuint idx, const LightPtr &light, const Affine3f &tf, const Matrix4f &lsmat, GLuint tindex) {
-    const auto &dlight = std::dynamic_pointer_cast<DirectionalLight>(light) ;
-
-    string vname("g_light_source_dir") ;
-    vname += ( light->castsShadows() ? "_shadow[" : "[" ) + std::to_string(idx) + "]" ;
-
-    setUniform(vname + ".ambient", dlight->ambientColor()) ;
-    setUniform(vname + ".diffuse", dlight->diffuseColor()) ;
-    setUniform(vname + ".specular", dlight->specularColor()) ;
+bool MaterialProgram::isReady() {
+    if ( ready_ ) return true ;
+    if ( !linkCompleted() ) return false ;
 
-    setUniform(vname + ".direction", tf * (dlight->position() - dlight->target()).normalized()) ;
-
-    if ( light->castsShadows() ) {
-        setUniform("lsmat_d[" + std::to_string(idx) + "]", Matrix4f(lsmat)) ;
-        setUniform(vname + ".shadowMap", (GLuint)(4+tindex)) ;
-        setUniform(vname + ".shadowBias", light->shadowBias()) ;
-    }
+    wait() ;
+    return true ;
 }
 
-void MaterialProgram::applySpotLight(GLuint idx, const LightPtr &light, const Affine3f &tf, const Matrix4f &lsmat, GLuint tindex) {
-    const auto &slight = std::dynamic_pointer_cast<SpotLight>(light);
-
-    string vname("g_light_source_spot") ;
-    vname += ( light->castsShadows() ? "_shadow[" : "[" ) + std::to_string(idx) + "]" ;
+// validation is skipped, see setupShadowSamplers
 
-    setUniform(vname + ".ambient", slight->ambientColor()) ;
-    setUniform(vname + ".diffuse", slight->diffuseColor()) ;
-    setUniform(vname + ".specular", slight->specularColor()) ;
-    setUniform(vname + ".direction", slight->direction()) ;
-    setUniform(vname + ".position", tf * slight->position()) ;
-    setUniform(vname + ".constant_attenuation", slight->constantAttenuation()) ;
-    setUniform(vname + ".linear_attenuation", slight->linearAttenuation()) ;
-    setUniform(vname + ".quadratic_attenuation", slight->quadraticAttenuation()) ;
+void MaterialProgram::wait() {
+    if ( ready_ ) return ;
 
-    setUniform(vname + ".spot_inner_cutoff", (float)cos(M_PI*slight->innerCutoffAngle()/180.0)) ;
-    setUniform(vname + ".spot_outer_cutoff", (float)cos(M_PI*slight->outerCutoffAngle()/180.0)) ;
-
-    if ( light->castsShadows() ) {
-        setUniform("lsmat_s[" + std::to_string(idx) + "]", Matrix4f(lsmat)) ;
-        setUniform(vname + ".shadowMap", 4+(GLuint)(4+tindex)) ;
-        setUniform(vname + ".shadowBias", light->shadowBias()) ;
-    }
+    finishLink(false) ;
+    resolveDefaultUniforms() ;
+    setup() ;
 
+    ready_ = true ;
 }
 
-void MaterialProgram::applyPointLight(GLuint idx, const LightPtr &light, const Affine3f &tf, const Matrix4f &lsmat, GLuint tindex) {
-    const auto &plight = std::dynamic_pointer_cast<PointLight>(light);
+void MaterialProgram::resolveDefaultUniforms() {
+    bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING) ;
+    bindUniformBlock("ObjectBlock", OBJECT_BLOCK_BINDING) ;
+    bindUniformBlock("LightsBlock", LIGHTS_BLOCK_BINDING) ;
 
-    string vname("g_light_source_point") ;
-    vname += ( light->castsShadows() ? "_shadow[" : "[" ) + std::to_string(idx) + "]" ;
+    map_transform_ = uniform<Matrix3f>("map_transform") ;
 
-    setUniform(vname + ".ambient", plight->ambientColor()) ;
-    setUniform(vname + ".diffuse", plight->diffuseColor()) ;
-    setUniform(vname + ".specular", plight->specularColor()) ;
+    bone_offset_ = uniform<GLint>("g_bone_offset") ;
 
-    setUniform(vname + ".position", tf * plight->position()) ;
-    setUniform(vname + ".constant_attenuation", plight->constantAttenuation()) ;
-    setUniform(vname + ".linear_attenuation", plight->linearAttenuation()) ;
-    setUniform(vname + ".quadratic_attenuation", plight->quadraticAttenuation()) ;
+    // the palette is always bound to the same unit, sampler values are program state hence set once
 
-    if ( light->castsShadows() ) {
-        setUniform("lsmat_p[" + std::to_string(idx) + "]", Matrix4f(lsmat)) ;
-        setUniform(vname + ".shadowMap", (GLuint)(4+tindex)) ;
-        setUniform(vname + ".shadowBias", light->shadowBias()) ;
+    auto palette = uniform<GLint>("g_bone_palette") ;
+    if ( palette.isValid() ) {
+        use() ;
+        palette.set(BONE_PALETTE_UNIT) ;
+        glUseProgram(0) ;
     }
 }
 
-void MaterialProgram::applyDefaultLights(const std::vector<LightData *> &lights) {
-
-    size_t i, k, t=0 ;
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
-
-        if ( dynamic_cast<const DirectionalLight *>(light.get()) && !light->castsShadows() ) {
-            applyDirectionalLight(k++, ld->light_, ld->mat_, ld->ls_mat_, 0) ;
-        }
-    }
-
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
-
-        if ( dynamic_cast<const DirectionalLight *>(light.get()) && light->castsShadows() ) {
-            ld->shadow_map_->bindTexture(GL_TEXTURE0 + 4 + t) ;
-            applyDirectionalLight(k++, ld->light_, ld->mat_, ld->ls_mat_, t) ;
-            ++t ;
-        }
-    }
-
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
+// sampler values are program state, hence they only have to be set once
 
-        if ( dynamic_cast<const SpotLight *>(light.get()) && !light->castsShadows() ) {
-            applySpotLight(k++, ld->light_, ld->mat_, ld->ls_mat_, 0) ;
-        }
-    }
+void MaterialProgram::setupShadowSamplers(const MaterialProgramParams &params) {
+    if ( !params.enable_shadows_ ) return ;
 
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
+    use() ;
 
-        if ( dynamic_cast<const SpotLight *>(light.get()) && light->castsShadows() ) {
-            ld->shadow_map_->bindTexture(GL_TEXTURE0 + 4 + t) ;
-            applySpotLight(k++, ld->light_, ld->mat_, ld->ls_mat_, t) ;
-            ++t ;
-        }
-    }
+    GLint unit = SHADOW_MAP_FIRST_UNIT ;
 
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
+    for( GLuint i=0 ; i<params.num_dir_lights_shadow_ ; i++ )
+        uniform<GLint>("shadow_map_d[" + std::to_string(i) + "]").set(unit++) ;
+    for( GLuint i=0 ; i<params.num_spot_lights_shadow_ ; i++ )
+        uniform<GLint>("shadow_map_s[" + std::to_string(i) + "]").set(unit++) ;
+    for( GLuint i=0 ; i<params.num_point_lights_shadow_ ; i++ )
+        uniform<GLint>("shadow_map_p[" + std::to_string(i) + "]").set(unit++) ;
 
-        if ( dynamic_cast<const PointLight *>(light.get()) && !light->castsShadows() ) {
-            applyPointLight(k++, ld->light_, ld->mat_, ld->ls_mat_, 0) ;
-        }
-    }
-
-    for( i=0, k=0 ; i<lights.size() ; i++ ) {
-        const auto &ld = lights[i] ;
-        const auto &light = ld->light_ ;
-
-        if ( dynamic_cast<const PointLight *>(light.get()) && light->castsShadows() ) {
-            ld->shadow_map_->bindTexture(GL_TEXTURE0 + 4 + t) ;
-            applyPointLight(k++, ld->light_, ld->mat_, ld->ls_mat_, t) ;
-            ++t ;
-        }
-    }
+    glUseProgram(0) ;
+}
 
+void MaterialProgram::applyBonePalette(GLint offset)
+{
+    bone_offset_.set(offset) ;
 }
 
 ConstantMaterialProgram::ConstantMaterialProgram(const MaterialProgramParams &params): params_(params) {
     OpenGLShaderPreproc preproc ;
 
     preproc.appendDefinition("USE_SKINNING", params.enable_skinning_);
+    preproc.appendDefinition("USE_INSTANCING", params.enable_instancing_);
+    preproc.appendDefinition("HAS_INSTANCE_COLORS", params.has_instance_colors_);
     preproc.appendDefinition("HAS_UVs", params.has_texture_map_) ;
     preproc.appendDefinition("HAS_DIFFUSE_MAP", params.has_texture_map_) ;
+    preproc.appendDefinition("CAPTURE", params.enable_capture_) ;
 
     addShaderFromFile(VERTEX_SHADER, "@vertex_shader", preproc) ;
     addShaderFromFile(FRAGMENT_SHADER, "@constant_fragment_shader", preproc) ;
 
-    link() ;
+    beginLink() ;
+}
+
+void ConstantMaterialProgram::setup() {
+    color_ = uniform<Vector4f>("color") ;
+    diffuse_map_ = uniform<GLint>("diffuseMap") ;
 }
 
 void ConstantMaterialProgram::applyParams(const MaterialPtr &mat) {
     const ConstantMaterial *material = dynamic_cast<const ConstantMaterial *>(mat.get());
     assert( material ) ;
 
-    setUniform("color", material->color()) ;
+    color_.set(material->color()) ;
 
-    if ( params_.has_texture_map_ & HAS_DIFFUSE_TEXTURE ) {
-        setUniform("diffuseMap", 0) ;
+    if ( params_.has_texture_map_ ) {
+        diffuse_map_.set(0) ;
     }
 }
 
-void ConstantMaterialProgram::bindTextures(const MaterialPtr &mat, TextureLoader loader)
+void ConstantMaterialProgram::bindTextures(const MaterialPtr &mat, TextureLoader loader, GLState &state)
 {
     const ConstantMaterial *m = dynamic_cast<const ConstantMaterial *>(mat.get()) ;
     assert(m) ;
 
-    bindTexture(m->texture(), loader, 0) ;
+    bindTexture(m->texture(), loader, state, 0) ;
 }
 
 PerVertexColorMaterialProgram::PerVertexColorMaterialProgram(const MaterialProgramParams &params) {
@@ -275,18 +212,24 @@ PerVertexColorMaterialProgram::PerVertexColorMaterialProgram(const MaterialProgr
     preproc.appendDefinition("HAS_COLORS");
 
     preproc.appendDefinition("USE_SKINNING", params.enable_skinning_);
+    preproc.appendDefinition("USE_INSTANCING", params.enable_instancing_);
+    preproc.appendDefinition("CAPTURE", params.enable_capture_);
 
     addShaderFromFile(VERTEX_SHADER, "@vertex_shader", preproc) ;
     addShaderFromFile(FRAGMENT_SHADER, "@per_vertex_color_fragment_shader", preproc) ;
 
-    link() ;
+    beginLink() ;
+}
+
+void PerVertexColorMaterialProgram::setup() {
+    opacity_ = uniform<float>("opacity") ;
 }
 
 void PerVertexColorMaterialProgram::applyParams(const MaterialPtr &mat) {
     const PerVertexColorMaterial *material = dynamic_cast<const PerVertexColorMaterial *>(mat.get());
     assert( material ) ;
 
-    setUniform("opacity", material->opacity()) ;
+    opacity_.set(material->opacity()) ;
 }
 
 
@@ -295,21 +238,29 @@ WireFrameMaterialProgram::WireFrameMaterialProgram(const MaterialProgramParams &
     OpenGLShaderPreproc preproc ;
 
     preproc.appendDefinition("USE_SKINNING", params.enable_skinning_);
+    preproc.appendDefinition("USE_INSTANCING", params.enable_instancing_);
+    preproc.appendDefinition("CAPTURE", params.enable_capture_);
 
     addShaderFromFile(VERTEX_SHADER, "@vertex_shader", preproc) ;
     addShaderFromFile(GEOMETRY_SHADER, "@wireframe_geometry_shader", preproc) ;
     addShaderFromFile(FRAGMENT_SHADER, "@wireframe_fragment_shader", preproc) ;
 
-    link() ;
+    beginLink() ;
+}
+
+void WireFrameMaterialProgram::setup() {
+    color_ = uniform<Vector4f>("color") ;
+    width_ = uniform<float>("width") ;
+    fill_ = uniform<Vector4f>("fill") ;
 }
 
 void WireFrameMaterialProgram::applyParams(const MaterialPtr &mat) {
     const WireFrameMaterial *material = dynamic_cast<const WireFrameMaterial *>(mat.get());
     assert( material ) ;
 
-    setUniform("color", material->lineColor()) ;
-    setUniform("width", material->lineWidth()) ;
-    setUniform("fill", material->fillColor()) ;
+    color_.set(material->lineColor()) ;
+    width_.set(material->lineWidth()) ;
+    fill_.set(material->fillColor()) ;
 }
 
 
@@ -324,10 +275,27 @@ string MaterialProgramParams::key() const {
     strm << (int)enable_shadows_ << ',' ;
     strm << (int)enable_skinning_ << ',' ;
     strm << (int)has_texture_map_ << ',' ;
+    strm << (int)enable_instancing_ << ',' ;
+    strm << (int)has_instance_colors_ << ',' ;
+    strm << (int)enable_capture_ << ',' ;
 
     return strm.str() ;
 }
 
+GLuint MaterialProgramParams::numLights() const {
+    return num_dir_lights_ + num_dir_lights_shadow_ + num_spot_lights_ + num_spot_lights_shadow_ +
+            num_point_lights_ + num_point_lights_shadow_ ;
+}
+
+bool MaterialProgramParams::operator < (const MaterialProgramParams &other) const {
+    return std::tie(num_dir_lights_, num_dir_lights_shadow_, num_point_lights_, num_point_lights_shadow_,
+                    num_spot_lights_, num_spot_lights_shadow_, enable_shadows_, enable_skinning_, has_texture_map_,
+                    enable_instancing_, has_instance_colors_, enable_capture_) <
+           std::tie(other.num_dir_lights_, other.num_dir_lights_shadow_, other.num_point_lights_, other.num_point_lights_shadow_,
+                    other.num_spot_lights_, other.num_spot_lights_shadow_, other.enable_shadows_, other.enable_skinning_, other.has_texture_map_,
+                    other.enable_instancing_, other.has_instance_colors_, other.enable_capture_) ;
+}
+
 } // impl
 
 impl::MaterialProgramPtr PhongMaterial::instantiate(const impl::MaterialProgramParams &params) const {
@@ -16,6 +16,7 @@ enum MaterialProgramFlags { ENABLE_SKINNING = 1, ENABLE_SHADOWS = 2, HAS_DIFFUSE
 namespace xviz { namespace impl {
 
 class TextureData ;
+class GLState ;
 struct LightData ;
 class MaterialProgram ;
 using MaterialProgramPtr = std::shared_ptr<MaterialProgram> ;
@@ -35,8 +36,16 @@ struct MaterialProgramParams {
     bool enable_shadows_ = false ;
     bool enable_skinning_ = false ;
     bool has_texture_map_ = false ;
+    bool enable_instancing_ = false ;
+    bool has_instance_colors_ = false ;
+    bool enable_capture_ = false ;      // also write depth, normal and id targets, see Renderer::capture
 
     std::string key() const ;
+
+    GLuint numLights() const ;
+
+    // ordering used for the program lookup, cheaper than building the string key for every draw
+    bool operator < (const MaterialProgramParams &other) const ;
 };
 
 template<class T>
@@ -46,11 +55,10 @@ public:
     MaterialProgramFactory() = default;
 
      MaterialProgramPtr instance(const MaterialProgramParams &params) {
-        const auto key = params.key() ;
-        auto it = instances_.find(key) ;
+        auto it = instances_.find(params) ;
         if ( it == instances_.end() ) {
             std::shared_ptr<T> instance(new T(params)) ;
-            instances_.emplace(key, instance) ;
+            instances_.emplace(params, instance) ;
             return instance ;
         } else {
             return it->second ;
@@ -58,31 +66,58 @@ public:
     }
 
 private:
-    std::map<std::string, MaterialProgramPtr> instances_ ;
+    std::map<MaterialProgramParams, MaterialProgramPtr> instances_ ;
 
 };
 
 using TextureLoader = std::function<impl::TextureData *(const Texture2D *)> ;
 
+// Programs using the default shaders read the camera, light and per-object transforms from the uniform blocks
+// filled by the renderer (see uniform_buffer.hpp). Programs with their own shaders may still override
+// applyTransform and applyLights to set these as plain uniforms.
+
 class MaterialProgram: public OpenGLShaderProgram {
 public:
 
     virtual void applyParams(const MaterialPtr &mat) = 0 ;
     virtual void applyTransform(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) {}
     virtual void applyLights(const std::vector<LightData *> &lights) {}
-    virtual void applyBoneTransform(GLuint idx, const Eigen::Matrix4f &tf) ;
-    virtual void bindTextures(const MaterialPtr &, TextureLoader) {}
+    // index of the first bone matrix of the mesh in the bone palette of the frame
+    virtual void applyBonePalette(GLint offset) ;
+    virtual void bindTextures(const MaterialPtr &, TextureLoader, GLState &) {}
+
+    // The variants start linking when they are created and may be compiled by the driver in the background (see
+    // OpenGLShaderProgram::beginLink). isReady polls the link and completes the setup of the program when it has
+    // finished, wait blocks until then. The program may be used for drawing only after either returns.
+    bool isReady() ;
+    void wait() ;
+
+    // shadow maps are bound to consecutive texture units starting from this one, first the directional,
+    // then the spot and finally the point lights
+    static const GLuint SHADOW_MAP_FIRST_UNIT = 4 ;
+
+    // texture unit of the buffer texture with the bone matrices of all skinned meshes of the frame
+    static const GLuint BONE_PALETTE_UNIT = 3 ;
 
 protected:
 
-    void applyDefaultPerspective(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) ;
-    void applyDefaultLights(const std::vector<LightData *> &lights) ;
+    // resolve the uniforms of the variant, called once the link has completed
+    virtual void setup() {}
 
-    void applyDirectionalLight(GLuint idx, const LightPtr &light, const Eigen::Affine3f &tf, const Eigen::Matrix4f &lsmat, GLuint tindex) ;
-    void applySpotLight(GLuint idx, const LightPtr &light, const Eigen::Affine3f &tf, const Eigen::Matrix4f &lsmat, GLuint tindex) ;
-    void applyPointLight(GLuint idx, const LightPtr &light, const Eigen::Affine3f &tf, const Eigen::Matrix4f &lsmat, GLuint tindex) ;
-    void bindTexture(const Texture2D *texture, TextureLoader loader, int slot);
+    // bind the uniform blocks and resolve the uniforms used by the default shaders, should be called after linking
+    void resolveDefaultUniforms() ;
+    // assign the shadow map samplers of the variant to their texture units. Until then all samplers refer to unit 0,
+    // which fails validation when their types differ (e.g. 2D and array shadow maps), so the programs are
+    // linked without validation.
+    void setupShadowSamplers(const MaterialProgramParams &params) ;
 
+    void bindTexture(const Texture2D *texture, TextureLoader loader, GLState &state, int slot);
+
+private:
+
+    OpenGLUniform<Eigen::Matrix3f> map_transform_ ;
+    OpenGLUniform<GLint> bone_offset_ ;
+    bool ready_ = false ;
 };
 
 using MaterialProgramPtr = std::shared_ptr<MaterialProgram> ;
@@ -112,20 +147,18 @@ public:
 
     void applyParams(const MaterialPtr &mat) override ;
 
-    void applyTransform(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) override {
-        applyDefaultPerspective(cam, view, model) ;
-    }
-
-    void applyLights(const std::vector<LightData *> &lights) override {
-        applyDefaultLights(lights) ;
-    }
-
-    void bindTextures(const MaterialPtr &, TextureLoader) override ;
+    void bindTextures(const MaterialPtr &, TextureLoader, GLState &) override ;
 
 
 private:
 
+    void setup() override ;
+
     MaterialProgramParams params_ ;
+
+    OpenGLUniform<Eigen::Vector3f> ambient_, specular_, diffuse_ ;
+    OpenGLUniform<float> shininess_, opacity_ ;
+    OpenGLUniform<GLint> diffuse_map_ ;
 };
 
 
@@ -136,16 +169,17 @@ public:
 
     void applyParams(const MaterialPtr &mat) override ;
 
-    void applyTransform(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) override {
-        applyDefaultPerspective(cam, view, model) ;
-    }
-
-    void bindTextures(const MaterialPtr &mat, TextureLoader loader) override ;
+    void bindTextures(const MaterialPtr &mat, TextureLoader loader, GLState &state) override ;
 
      static std::string name() { return "constant" ; }
 private:
 
+    void setup() override ;
+
     MaterialProgramParams params_ ;
+
+    OpenGLUniform<Eigen::Vector4f> color_ ;
+    OpenGLUniform<GLint> diffuse_map_ ;
 };
 
 
@@ -156,12 +190,13 @@ public:
 
     void applyParams(const MaterialPtr &mat) override ;
 
-    void applyTransform(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) override {
-        applyDefaultPerspective(cam, view, model) ;
-    }
-
      static std::string name() { return "per_vertex" ; }
 
+private:
+
+     void setup() override ;
+
+     OpenGLUniform<float> opacity_ ;
 };
 
 class WireFrameMaterialProgram: public MaterialProgram {
@@ -172,12 +207,15 @@ public:
 
     void applyParams(const MaterialPtr &mat) override ;
 
-    void applyTransform(const Eigen::Matrix4f &cam, const Eigen::Matrix4f &view, const Eigen::Matrix4f &model) override {
-        applyDefaultPerspective(cam, view, model) ;
-    }
-
 
      static std::string name() { return "wire_frame" ; }
+
+private:
+
+     void setup() override ;
+
+     OpenGLUniform<Eigen::Vector4f> color_, fill_ ;
+     OpenGLUniform<float> width_ ;
 };
 
 }}
@@ -1,6 +1,9 @@
 #include "mesh_data.hpp"
+#include "profiler.hpp"
 
 #include <iostream>
+#include <cmath>
+#include <cstring>
 
 #define POSITION_LOCATION    0
 #define NORMALS_LOCATION    1
@@ -9,24 +12,40 @@
 #define BONE_WEIGHT_LOCATION    4
 #define UV_LOCATION 5
 
+using namespace Eigen ;
+
 namespace xviz { namespace impl {
 
-MeshData::MeshData(const Geometry &mesh) {
+MeshData::MeshData(const Geometry &mesh, bool packed): packed_(packed) {
 
     glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
 
+    elem_count_ = mesh.vertices().size() ;
+
+    if ( packed_ )
+        createPackedBuffers(mesh) ;
+    else
+        createBuffers(mesh) ;
+
+    createIndexBuffer(mesh) ;
+
+    // unbind the vertex array first so that it keeps the index buffer binding
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+}
+
+void MeshData::createBuffers(const Geometry &mesh) {
     const Geometry::vb3_t &vertices = mesh.vertices() ;
     const Geometry::vb3_t &normals = mesh.normals() ;
     const Geometry::vb3_t &colors = mesh.colors() ;
-    const Geometry::indices_t &indices = mesh.indices() ;
-
-    elem_count_ = vertices.size() ;
-    indices_ = indices.size() ;
 
     glGenBuffers(1, &pos_);
     glBindBuffer(GL_ARRAY_BUFFER, pos_);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat) * 3, &vertices[0], GL_DYNAMIC_DRAW);
+    FrameProfiler::addUploadedBytes(vertices.size() * sizeof(GLfloat) * 3) ;
     glEnableVertexAttribArray(POSITION_LOCATION);
     glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
@@ -34,6 +53,7 @@ MeshData::MeshData(const Geometry &mesh) {
         glGenBuffers(1, &normals_);
         glBindBuffer(GL_ARRAY_BUFFER, normals_);
         glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GLfloat) * 3, (GLfloat *)normals.data(), GL_DYNAMIC_DRAW );
+        FrameProfiler::addUploadedBytes(normals.size() * sizeof(GLfloat) * 3) ;
         glEnableVertexAttribArray(NORMALS_LOCATION);
         glVertexAttribPointer(NORMALS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
     }
@@ -42,15 +62,24 @@ MeshData::MeshData(const Geometry &mesh) {
         glGenBuffers(1, &colors_);
         glBindBuffer(GL_ARRAY_BUFFER, colors_);
         glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat) * 3, (GLfloat *)colors.data(), GL_DYNAMIC_DRAW);
+        FrameProfiler::addUploadedBytes(colors.size() * sizeof(GLfloat) * 3) ;
         glEnableVertexAttribArray(COLORS_LOCATION);
         glVertexAttribPointer(COLORS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
     }
 
+    createStaticBuffers(mesh) ;
+}
+
+// attributes that are not modified after creation, called again with the vertex array bound when the number of
+// vertices changes
+
+void MeshData::createStaticBuffers(const Geometry &mesh) {
     for( int t = 0 ; t<mesh.numUVChannels() ; t++ ) {
         if ( !mesh.texCoords(t).empty() ) {
-            glGenBuffers(1, &tex_coords_[t]);
+            if ( !tex_coords_[t] ) glGenBuffers(1, &tex_coords_[t]);
             glBindBuffer(GL_ARRAY_BUFFER, tex_coords_[t]);
             glBufferData(GL_ARRAY_BUFFER, mesh.texCoords(t).size() * sizeof(GLfloat) * 2, (GLfloat *)mesh.texCoords(t).data(), GL_STATIC_DRAW);
+            FrameProfiler::addUploadedBytes(mesh.texCoords(t).size() * sizeof(GLfloat) * 2) ;
             glEnableVertexAttribArray(UV_LOCATION + t);
             glVertexAttribPointer(UV_LOCATION + t, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
         }
@@ -58,32 +87,267 @@ MeshData::MeshData(const Geometry &mesh) {
 
     const auto &weights = mesh.weights() ;
     if ( !weights.empty() ) {
-        glGenBuffers(1, &weights_);
+        if ( !weights_ ) glGenBuffers(1, &weights_);
         glBindBuffer(GL_ARRAY_BUFFER, weights_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(weights[0]) * weights.size(), weights.data(), GL_STATIC_DRAW);
+        FrameProfiler::addUploadedBytes(sizeof(weights[0]) * weights.size()) ;
         glEnableVertexAttribArray(BONE_ID_LOCATION);
         glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_INT, sizeof(Geometry::BoneWeight), (const GLvoid*)0);
 
         glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
         glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Geometry::BoneWeight), (const GLvoid*)offsetof(Geometry::BoneWeight, weight_));
     }
+}
 
-#if 0
-    glGenBuffers(1, &tf_);
-    glBindBuffer(GL_ARRAY_BUFFER, tf_);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat) * 3, 0, GL_STATIC_READ);
-#endif
+PackedVertexLayout::PackedVertexLayout(const Geometry &mesh): PackedVertexLayout() {
+    GLintptr offset = 3 * sizeof(GLfloat) ;
 
-    if ( !indices.empty() ) {
-        glGenBuffers(1, &index_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), &indices[0], GL_STATIC_DRAW);
+    if ( !mesh.normals().empty() ) {
+        normal_ = offset ;
+        offset += sizeof(uint32_t) ;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    if ( !mesh.colors().empty() ) {
+        color_ = offset ;
+        offset += 4 * sizeof(uint8_t) ;
+    }
+
+    for( int t = 0 ; t<mesh.numUVChannels() ; t++ ) {
+        if ( !mesh.texCoords(t).empty() ) {
+            tex_coords_[t] = offset ;
+            offset += 2 * sizeof(uint16_t) ;
+        }
+    }
+
+    if ( !mesh.weights().empty() ) {
+        bone_ids_ = offset ;
+        offset += Geometry::MAX_BONES_PER_VERTEX * sizeof(int16_t) ;
+        bone_weights_ = offset ;
+        offset += Geometry::MAX_BONES_PER_VERTEX * sizeof(uint16_t) ;
+    }
+
+    stride_ = offset ;
+}
+
+// signed normalized 10 bit components, w = 0
+static uint32_t packNormal(const Vector3f &n) {
+    uint32_t packed = 0 ;
+    for( int i=0 ; i<3 ; i++ ) {
+        int32_t c = (int32_t)std::round(std::max(-1.0f, std::min(1.0f, n[i])) * 511.0f) ;
+        packed |= ((uint32_t)c & 0x3ff) << (10 * i) ;
+    }
+    return packed ;
+}
+
+static uint8_t toUnorm8(float v) {
+    return (uint8_t)std::round(std::max(0.0f, std::min(1.0f, v)) * 255.0f) ;
+}
+
+static uint16_t toUnorm16(float v) {
+    return (uint16_t)std::round(std::max(0.0f, std::min(1.0f, v)) * 65535.0f) ;
+}
+
+// IEEE 754 binary16 with round to nearest even
+static uint16_t toHalf(float f) {
+    uint32_t x ;
+    memcpy(&x, &f, sizeof(x)) ;
+
+    uint32_t sign = (x >> 16) & 0x8000 ;
+    uint32_t fexp = (x >> 23) & 0xff ;
+    uint32_t mant = x & 0x7fffff ;
+
+    if ( fexp == 0xff ) return sign | 0x7c00 | ( mant ? 0x200 : 0 ) ;
+
+    int32_t exp = (int32_t)fexp - 127 + 15 ;
+
+    if ( exp >= 31 ) return sign | 0x7c00 ;
+
+    uint32_t shift = 13 ;
+    uint32_t h = exp << 10 ;
+
+    if ( exp <= 0 ) {
+        // subnormal or zero
+        if ( exp < -10 ) return sign ;
+        mant |= 0x800000 ;
+        shift = 14 - exp ;
+        h = 0 ;
+    }
+
+    h |= mant >> shift ;
+
+    uint32_t rem = mant & ((1u << shift) - 1), halfway = 1u << (shift - 1) ;
+    if ( rem > halfway || ( rem == halfway && (h & 1) ) ) ++h ; // a carry into the exponent is the correct result
+
+    return sign | h ;
+}
+
+void MeshData::packVertices(const Geometry &mesh, size_t first, size_t count, std::vector<uint8_t> &data) const {
+    const auto &vertices = mesh.vertices() ;
+    const auto &normals = mesh.normals() ;
+    const auto &colors = mesh.colors() ;
+    const auto &weights = mesh.weights() ;
+
+    data.resize(count * layout_.stride_) ;
+
+    for( size_t i=first ; i<first + count ; i++ ) {
+        uint8_t *v = &data[(i - first) * layout_.stride_] ;
 
+        memcpy(v, vertices[i].data(), 3 * sizeof(GLfloat)) ;
+
+        if ( layout_.normal_ >= 0 ) {
+            uint32_t n = packNormal(normals[i]) ;
+            memcpy(v + layout_.normal_, &n, sizeof(n)) ;
+        }
+
+        if ( layout_.color_ >= 0 ) {
+            uint8_t *c = v + layout_.color_ ;
+            c[0] = toUnorm8(colors[i].x()) ;
+            c[1] = toUnorm8(colors[i].y()) ;
+            c[2] = toUnorm8(colors[i].z()) ;
+            c[3] = 255 ;
+        }
+
+        for( int t = 0 ; t<mesh.numUVChannels() ; t++ ) {
+            if ( layout_.tex_coords_[t] >= 0 ) {
+                const Vector2f &uv = mesh.texCoords(t)[i] ;
+                uint16_t h[2] = { toHalf(uv.x()), toHalf(uv.y()) } ;
+                memcpy(v + layout_.tex_coords_[t], h, sizeof(h)) ;
+            }
+        }
+
+        if ( layout_.bone_ids_ >= 0 ) {
+            int16_t ids[Geometry::MAX_BONES_PER_VERTEX] ;
+            uint16_t w[Geometry::MAX_BONES_PER_VERTEX] ;
+            for( int j=0 ; j<Geometry::MAX_BONES_PER_VERTEX ; j++ ) {
+                ids[j] = (int16_t)weights[i].bone_[j] ;
+                w[j] = toUnorm16(weights[i].weight_[j]) ;
+            }
+            memcpy(v + layout_.bone_ids_, ids, sizeof(ids)) ;
+            memcpy(v + layout_.bone_weights_, w, sizeof(w)) ;
+        }
+    }
+}
+
+void MeshData::createPackedBuffers(const Geometry &mesh) {
+    layout_ = PackedVertexLayout(mesh) ;
+
+    std::vector<uint8_t> data ;
+    packVertices(mesh, 0, mesh.vertices().size(), data) ;
+
+    glGenBuffers(1, &vertices_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertices_);
+    glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_DYNAMIC_DRAW);
+    FrameProfiler::addUploadedBytes(data.size()) ;
+
+    setPackedAttributes(mesh, 0) ;
+}
+
+// attribute pointers of interleaved vertices starting at offset base of the bound array buffer
+
+void MeshData::setPackedAttributes(const Geometry &mesh, GLintptr base) {
+    const GLsizei stride = layout_.stride_ ;
+
+    glEnableVertexAttribArray(POSITION_LOCATION);
+    glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)base);
+
+    if ( layout_.normal_ >= 0 ) {
+        glEnableVertexAttribArray(NORMALS_LOCATION);
+        glVertexAttribPointer(NORMALS_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid *)(base + layout_.normal_));
+    } else
+        glDisableVertexAttribArray(NORMALS_LOCATION);
+
+    if ( layout_.color_ >= 0 ) {
+        glEnableVertexAttribArray(COLORS_LOCATION);
+        glVertexAttribPointer(COLORS_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid *)(base + layout_.color_));
+    } else
+        glDisableVertexAttribArray(COLORS_LOCATION);
+
+    for( int t = 0 ; t<mesh.numUVChannels() ; t++ ) {
+        if ( layout_.tex_coords_[t] >= 0 ) {
+            glEnableVertexAttribArray(UV_LOCATION + t);
+            glVertexAttribPointer(UV_LOCATION + t, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid *)(base + layout_.tex_coords_[t]));
+        }
+    }
+
+    if ( layout_.bone_ids_ >= 0 ) {
+        glEnableVertexAttribArray(BONE_ID_LOCATION);
+        glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_SHORT, stride, (const GLvoid *)(base + layout_.bone_ids_));
+
+        glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
+        glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const GLvoid *)(base + layout_.bone_weights_));
+    }
+}
+
+static size_t indexCount(const Geometry &mesh) {
+    size_t count = mesh.indices().size() ;
+    for( const Geometry::Lod &lod: mesh.lods() )
+        count += lod.indices_.size() ;
+    return count ;
+}
+
+static size_t indexCount(const MeshData &data) {
+    size_t count = data.indices_ ;
+    for( const MeshData::LodRange &lod: data.lods_ )
+        count += lod.count_ ;
+    return count ;
+}
+
+void MeshData::createIndexBuffer(const Geometry &mesh) {
+    const Geometry::indices_t &indices = mesh.indices() ;
+
+    indices_ = indices.size() ;
+    lods_.clear() ;
+
+    const size_t count = indexCount(mesh) ;
+
+    if ( count == 0 ) return ;
+
+    if ( !index_ ) glGenBuffers(1, &index_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_);
+
+    index_type_ = ( elem_count_ <= 0xffff ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT ;
+    const size_t index_size = ( index_type_ == GL_UNSIGNED_SHORT ) ? sizeof(uint16_t) : sizeof(uint32_t) ;
+
+    std::vector<uint8_t> data(count * index_size) ;
+    size_t offset = 0 ;
+
+    auto append = [&](const Geometry::indices_t &src) {
+        if ( index_type_ == GL_UNSIGNED_SHORT )
+            std::copy(src.begin(), src.end(), (uint16_t *)(data.data() + offset)) ;
+        else if ( !src.empty() )
+            memcpy(data.data() + offset, src.data(), src.size() * sizeof(uint32_t)) ;
+        offset += src.size() * index_size ;
+    } ;
+
+    append(indices) ;
+
+    for( const Geometry::Lod &lod: mesh.lods() ) {
+        lods_.push_back(LodRange{(GLintptr)offset, (GLsizei)lod.indices_.size(), lod.error_}) ;
+        append(lod.indices_) ;
+    }
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+    FrameProfiler::addUploadedBytes(data.size()) ;
+}
+
+void MeshData::bindInstanceAttributes(GLuint buffer, GLintptr matrix_offset, GLintptr colors_offset) const {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    for( GLuint c = 0 ; c<4 ; c++ ) {
+        GLuint loc = instance_matrix_location_ + c ;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 16, (const GLvoid *)(matrix_offset + c * sizeof(GLfloat) * 4));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    if ( colors_offset >= 0 ) {
+        glEnableVertexAttribArray(instance_color_location_);
+        glVertexAttribPointer(instance_color_location_, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)colors_offset);
+        glVertexAttribDivisor(instance_color_location_, 1);
+    } else
+        glDisableVertexAttribArray(instance_color_location_);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void MeshData::release() {
@@ -91,42 +355,260 @@ void MeshData::release() {
 }
 
 
-void MeshData::update(Geometry &geom) {
+// Modified data are written to the next region of the stream buffer, which also receives the changes made since
+// it was last written, so that only the dirty ranges are copied.
 
-    const Geometry::vb3_t &vertices = geom.vertices() ;
-    const Geometry::vb3_t &normals = geom.normals() ;
-    const Geometry::vb3_t &colors = geom.colors() ;
+void MeshData::update(Geometry &geom, uint64_t frame) {
 
-    if ( geom.verticesUpdated() ) {
-        glBindBuffer(GL_ARRAY_BUFFER, pos_);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(GLfloat) * 3, &vertices[0]);
-        glEnableVertexAttribArray(POSITION_LOCATION);
-        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        geom.setVerticesUpdated(false) ;
+    const size_t n = geom.vertices().size() ;
+    const bool resized = n != elem_count_ ;
+    const bool modified = resized || geom.verticesUpdated() || geom.normalsUpdated() || geom.colorsUpdated() ;
+
+    // the indices or the levels of detail have changed
+    const bool reindex = indexCount(geom) != indexCount(*this) || ( index_type_ == GL_UNSIGNED_SHORT && n > 0xffff ) ;
+
+    if ( !modified && !reindex ) return ;
+
+    glBindVertexArray(vao_);
+    skinned_vao_dirty_ = true ;
+
+    if ( resized ) {
+        elem_count_ = n ;
+
+        // grow with some slack for meshes that keep growing, shrink when most of the space is unused
+        if ( !stream_ || n > stream_capacity_ || n < stream_capacity_/4 )
+            allocateStream(geom, n + n/2) ;
+        else {
+            for( auto &region: pending_ )
+                for( auto &range: region )
+                    range.extend(0, n) ;
+        }
+
+        if ( !packed_ ) createStaticBuffers(geom) ;
+    } else if ( modified && !stream_ ) {
+        allocateStream(geom, n) ;
+    } else if ( modified ) {
+        for( auto &region: pending_ ) {
+            region[0].extend(geom.dirtyVertices().first_, geom.dirtyVertices().last_ - geom.dirtyVertices().first_) ;
+            region[1].extend(geom.dirtyNormals().first_, geom.dirtyNormals().last_ - geom.dirtyNormals().first_) ;
+            region[2].extend(geom.dirtyColors().first_, geom.dirtyColors().last_ - geom.dirtyColors().first_) ;
+        }
     }
 
-    if ( !normals.empty() && geom.normalsUpdated()) {
-        glBindBuffer(GL_ARRAY_BUFFER, normals_);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normals.size() * sizeof(GLfloat) * 3, &normals[0]);
-        glEnableVertexAttribArray(NORMALS_LOCATION);
-        glVertexAttribPointer(NORMALS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    if ( reindex ) {
+        if ( indexCount(geom) == 0 && index_ ) {
+            glDeleteBuffers(1, &index_) ;
+            index_ = 0 ;
+        }
+        createIndexBuffer(geom) ;
+    }
+
+    // the ranges stay pending if the stream was already written in this frame
+
+    if ( modified ) {
+        geom.setVerticesUpdated(false) ;
         geom.setNormalsUpdated(false) ;
+        geom.setColorsUpdated(false) ;
+
+        if ( stream_->next(frame) ) {
+            writeStream(geom) ;
+            setStreamAttributes(geom) ;
+        }
     }
 
-    if ( !colors.empty() && geom.colorsUpdated() ) {
-        glBindBuffer(GL_ARRAY_BUFFER, colors_);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, colors.size() * sizeof(GLfloat) * 3, &colors[0]);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshData::allocateStream(const Geometry &mesh, size_t capacity) {
+    GLsizeiptr size ;
+
+    if ( packed_ ) {
+        layout_ = PackedVertexLayout(mesh) ;
+        size = capacity * layout_.stride_ ;
+
+        if ( vertices_ ) {
+            glDeleteBuffers(1, &vertices_) ;
+            vertices_ = 0 ;
+        }
+    } else {
+        const GLsizeiptr attribute_size = capacity * sizeof(GLfloat) * 3 ;
+        size = attribute_size ;
+
+        stream_normals_ = mesh.normals().empty() ? -1 : size ;
+        if ( stream_normals_ >= 0 ) size += attribute_size ;
+
+        stream_colors_ = mesh.colors().empty() ? -1 : size ;
+        if ( stream_colors_ >= 0 ) size += attribute_size ;
+
+        // the buffers created for static meshes are replaced by the stream
+
+        for( GLuint *buffer: { &pos_, &normals_, &colors_ } ) {
+            if ( *buffer ) {
+                glDeleteBuffers(1, buffer) ;
+                *buffer = 0 ;
+            }
+        }
+    }
+
+    if ( !stream_ ) stream_.reset(new StreamBuffer) ;
+
+    stream_->allocate(size) ;
+    stream_capacity_ = capacity ;
+
+    for( auto &region: pending_ )
+        for( auto &range: region )
+            range.extend(0, mesh.vertices().size()) ;
+}
+
+static void clampRange(Geometry::DirtyRange &range, size_t n) {
+    range.first_ = std::min(range.first_, n) ;
+    range.last_ = std::min(range.last_, n) ;
+}
+
+void MeshData::writeStream(const Geometry &mesh) {
+    const size_t n = mesh.vertices().size() ;
+
+    Geometry::DirtyRange *pending = pending_[stream_->region()] ;
+
+    if ( packed_ ) {
+        Geometry::DirtyRange range ;
+        for( int a = 0 ; a<3 ; a++ ) {
+            if ( !pending[a].empty() )
+                range.extend(pending[a].first_, pending[a].last_ - pending[a].first_) ;
+        }
+
+        clampRange(range, n) ;
+
+        if ( !range.empty() ) {
+            std::vector<uint8_t> data ;
+            packVertices(mesh, range.first_, range.last_ - range.first_, data) ;
+            stream_->write(range.first_ * layout_.stride_, data.data(), data.size()) ;
+        }
+    } else {
+        const Geometry::vb3_t *attributes[3] = { &mesh.vertices(), &mesh.normals(), &mesh.colors() } ;
+        const GLintptr offsets[3] = { 0, stream_normals_, stream_colors_ } ;
+
+        for( int a = 0 ; a<3 ; a++ ) {
+            Geometry::DirtyRange range = pending[a] ;
+            clampRange(range, std::min(n, attributes[a]->size())) ;
+
+            if ( offsets[a] < 0 || range.empty() ) continue ;
+
+            stream_->write(offsets[a] + range.first_ * sizeof(GLfloat) * 3, attributes[a]->data() + range.first_,
+                           (range.last_ - range.first_) * sizeof(GLfloat) * 3) ;
+        }
+    }
+
+    for( int a = 0 ; a<3 ; a++ )
+        pending[a].clear() ;
+}
+
+// point the attributes to the current region of the stream, the vertex array should be bound
+
+void MeshData::setStreamAttributes(const Geometry &mesh) {
+    const GLintptr base = stream_->regionOffset() ;
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream_->id());
+
+    if ( packed_ ) {
+        setPackedAttributes(mesh, base) ;
+        return ;
+    }
+
+    glEnableVertexAttribArray(POSITION_LOCATION);
+    glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)base);
+
+    if ( stream_normals_ >= 0 ) {
         glEnableVertexAttribArray(NORMALS_LOCATION);
-        glVertexAttribPointer(NORMALS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        geom.setColorsUpdated(false) ;
+        glVertexAttribPointer(NORMALS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(base + stream_normals_));
+    } else
+        glDisableVertexAttribArray(NORMALS_LOCATION);
+
+    if ( stream_colors_ >= 0 ) {
+        glEnableVertexAttribArray(COLORS_LOCATION);
+        glVertexAttribPointer(COLORS_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(base + stream_colors_));
+    } else
+        glDisableVertexAttribArray(COLORS_LOCATION);
+}
+
+// Attributes other than positions and normals are shared with vao_, their bindings are copied from it so that
+// this works for all vertex formats.
+
+void MeshData::prepareSkinning() {
+    if ( !tf_ ) glGenBuffers(1, &tf_) ;
+
+    if ( elem_count_ > tf_capacity_ ) {
+        glBindBuffer(GL_ARRAY_BUFFER, tf_) ;
+        glBufferData(GL_ARRAY_BUFFER, elem_count_ * skinned_stride_, nullptr, GL_DYNAMIC_COPY) ;
+        glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+        tf_capacity_ = elem_count_ ;
+    }
+
+    if ( !skinned_vao_dirty_ ) return ;
+
+    GLint has_normals = 0 ;
+    glBindVertexArray(vao_) ;
+    glGetVertexAttribiv(NORMALS_LOCATION, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &has_normals) ;
+
+    struct Attribute {
+        GLuint location_ ;
+        GLint enabled_, buffer_, size_, type_, normalized_, stride_, integer_ ;
+        void *pointer_ ;
+    } ;
+
+    std::vector<Attribute> attributes ;
+
+    for( GLuint loc: { (GLuint)COLORS_LOCATION, (GLuint)UV_LOCATION, (GLuint)UV_LOCATION + 1, (GLuint)UV_LOCATION + 2, (GLuint)UV_LOCATION + 3 } ) {
+        Attribute a ;
+        a.location_ = loc ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &a.enabled_) ;
+        if ( !a.enabled_ ) continue ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &a.buffer_) ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_SIZE, &a.size_) ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_TYPE, &a.type_) ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &a.normalized_) ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &a.stride_) ;
+        glGetVertexAttribiv(loc, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &a.integer_) ;
+        glGetVertexAttribPointerv(loc, GL_VERTEX_ATTRIB_ARRAY_POINTER, &a.pointer_) ;
+        attributes.push_back(a) ;
     }
 
+    if ( skinned_vao_ ) glDeleteVertexArrays(1, &skinned_vao_) ;
+    glGenVertexArrays(1, &skinned_vao_) ;
+    glBindVertexArray(skinned_vao_) ;
+
+    glBindBuffer(GL_ARRAY_BUFFER, tf_) ;
+    glEnableVertexAttribArray(POSITION_LOCATION) ;
+    glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, skinned_stride_, nullptr) ;
 
+    if ( has_normals ) {
+        glEnableVertexAttribArray(NORMALS_LOCATION) ;
+        glVertexAttribPointer(NORMALS_LOCATION, 3, GL_FLOAT, GL_FALSE, skinned_stride_, (const GLvoid *)(3 * sizeof(GLfloat))) ;
+    }
+
+    for( const Attribute &a: attributes ) {
+        glBindBuffer(GL_ARRAY_BUFFER, a.buffer_) ;
+        glEnableVertexAttribArray(a.location_) ;
+        if ( a.integer_ )
+            glVertexAttribIPointer(a.location_, a.size_, a.type_, a.stride_, a.pointer_) ;
+        else
+            glVertexAttribPointer(a.location_, a.size_, a.type_, a.normalized_, a.stride_, a.pointer_) ;
+    }
+
+    if ( index_ ) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_) ;
+
+    glBindVertexArray(0) ;
+    glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) ;
+
+    skinned_vao_dirty_ = false ;
 }
 
 MeshData::~MeshData() {
 
     if ( pos_ ) glDeleteBuffers(1, &pos_) ;
+    if ( vertices_ ) glDeleteBuffers(1, &vertices_) ;
     if ( normals_ ) glDeleteBuffers(1, &normals_) ;
     if ( colors_ ) glDeleteBuffers(1, &colors_) ;
 
@@ -141,12 +623,21 @@ MeshData::~MeshData() {
     if ( index_ )
         glDeleteBuffers(1, &index_);
 
+    if ( tf_ )
+        glDeleteBuffers(1, &tf_);
+
     glDeleteVertexArrays(1, &vao_) ;
 
+    if ( skinned_vao_ )
+        glDeleteVertexArrays(1, &skinned_vao_) ;
+
 }
 
 MeshDataManager::~MeshDataManager() {
 //    flush() ;
+    for( GLsync fence: fences_ )
+        if ( fence ) glDeleteSync(fence) ;
+
     dirty_ = true ;
     for( auto &p: meshes_ ) {
         Geometry *geom = p.first ;
@@ -157,9 +648,19 @@ MeshDataManager::~MeshDataManager() {
 MeshData *MeshDataManager::fetch(Geometry*geom) {
     MeshData *data = nullptr ;
 
+    Geometry::VertexFormat format = geom->vertexFormat() ;
+    bool packed = format == Geometry::PackedVertexFormat || ( format == Geometry::DefaultVertexFormat && packed_by_default_ ) ;
+
     auto it = meshes_.find(geom) ;
+
+    // the vertex format was changed after the buffers were created
+    if ( it != meshes_.end() && (*it).second->packed_ != packed ) {
+        meshes_.erase(it) ;
+        it = meshes_.end() ;
+    }
+
     if ( it == meshes_.end() ) {
-        data = new MeshData(*geom) ;
+        data = new MeshData(*geom, packed) ;
         data->manager_ = this ;
         data->geom_ = geom ;
         geom->data_ = data ;
@@ -167,11 +668,32 @@ MeshData *MeshDataManager::fetch(Geometry*geom) {
     } else
         data = (*it).second.get() ;
 
-    data->update(*geom) ;
+    data->update(*geom, frame_) ;
+
+    if ( data->stream_ ) streaming_ = true ;
 
     return data ;
 }
 
+void MeshDataManager::beginFrame() {
+    if ( !streaming_ ) return ;
+
+    GLsync &fence = fences_[frame_ % StreamBuffer::num_regions_] ;
+
+    if ( fence ) {
+        while ( glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED ) ;
+        glDeleteSync(fence) ;
+        fence = nullptr ;
+    }
+}
+
+void MeshDataManager::endFrame() {
+    if ( streaming_ )
+        fences_[frame_ % StreamBuffer::num_regions_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) ;
+
+    ++frame_ ;
+}
+
 void MeshDataManager::release(Geometry *geom) {
     if ( dirty_ ) return ;
 
@@ -4,6 +4,7 @@
 #include <xviz/scene/geometry.hpp>
 
 #include "common/gl/gl3w.h"
+#include "stream_buffer.hpp"
 
 namespace xviz { namespace impl {
 
@@ -14,32 +15,113 @@ public:
     void release(Geometry *geom) ;
     void flush() ;
 
+    // vertex format of geometries with Geometry::DefaultVertexFormat
+    void setPackedByDefault(bool packed) { packed_by_default_ = packed ; }
+
+    // Called at the start and end of each rendered frame. The stream buffer region written in a frame is not
+    // written again before num_regions_ frames, so beginFrame waits for the frame that preceded them to complete.
+    void beginFrame() ;
+    void endFrame() ;
+
 private:
     std::map<Geometry *, std::unique_ptr<impl::MeshData>> meshes_ ;
     std::vector<Geometry *> to_delete_ ;
     bool dirty_ = false ;
+    bool packed_by_default_ = false ;
+    bool streaming_ = false ;           // some mesh uses a stream buffer
+    uint64_t frame_ = 0 ;
+    GLsync fences_[StreamBuffer::num_regions_] = {} ;
+};
+
+// byte offsets of the attributes within an interleaved vertex of the packed format, -1 if the attribute is missing
+
+struct PackedVertexLayout {
+    GLsizei stride_ = 0 ;
+    GLintptr normal_ = -1, color_ = -1, tex_coords_[MAX_TEXTURES], bone_ids_ = -1, bone_weights_ = -1 ;
+
+    PackedVertexLayout() { std::fill(tex_coords_, tex_coords_ + MAX_TEXTURES, -1) ; }
+    PackedVertexLayout(const Geometry &mesh) ;
 };
 
 class MeshData {
 public:
 
     MeshData() ;
-    MeshData(const Geometry &mesh) ;
+    MeshData(const Geometry &mesh, bool packed = false) ;
 
     void destroy() ;
     void release() ;
-    void update(Geometry &mesh) ;
+    // upload modified vertex data, frame is the index of the frame being rendered
+    void update(Geometry &mesh, uint64_t frame) ;
 
     static const int max_textures_ = 4 ;
 
-    GLuint pos_ = 0, normals_ = 0, colors_ = 0, weights_ = 0, tex_coords_[max_textures_] = {0}, tf_ = 0, index_ = 0;
+    // vertex array slots of the per-instance attributes, the model matrix takes four consecutive slots
+    static const GLuint instance_matrix_location_ = 7 ;
+    static const GLuint instance_color_location_ = 11 ;
+
+    // attach the per-instance attributes stored in buffer to the vertex array, which should be bound.
+    // colors_offset is -1 if there are no per-instance colors
+    void bindInstanceAttributes(GLuint buffer, GLintptr matrix_offset, GLintptr colors_offset) const ;
+
+    GLuint pos_ = 0, normals_ = 0, colors_ = 0, weights_ = 0, tex_coords_[max_textures_] = {0}, index_ = 0;
     GLuint vao_ ;
     GLuint elem_count_, indices_  ;
+    GLenum index_type_ = GL_UNSIGNED_INT ;  // GL_UNSIGNED_SHORT when all indices fit in 16 bits
+
+    // Levels of detail of the geometry, their indices follow those of the full geometry in the index buffer. The
+    // offset is in bytes.
+    struct LodRange {
+        GLintptr offset_ ;
+        GLsizei count_ ;
+        float error_ ;
+    };
+
+    std::vector<LodRange> lods_ ;
+
+    // packed format, all attributes interleaved in a single buffer
+    bool packed_ = false ;
+    GLuint vertices_ = 0 ;
+    PackedVertexLayout layout_ ;
+
+    // Positions, normals and colors (all attributes in the packed format) of meshes that are modified after
+    // creation are moved to a stream buffer. Each region holds the attributes one after the other.
+    std::unique_ptr<StreamBuffer> stream_ ;
+    size_t stream_capacity_ = 0 ;                       // vertices that fit in a region
+    GLintptr stream_normals_ = -1, stream_colors_ = -1 ; // offsets within a region, -1 if missing
+
+    // ranges of vertices, normals and colors not yet written in each region
+    Geometry::DirtyRange pending_[StreamBuffer::num_regions_][3] ;
+
+    // Skinned meshes are posed once per frame by transform feedback into tf_, which holds interleaved positions
+    // and normals (skinned_stride_ bytes per vertex). skinned_vao_ draws them together with the remaining
+    // attributes of vao_ and is rebuilt by prepareSkinning when vao_ has changed.
+    static const GLsizei skinned_stride_ = 6 * sizeof(GLfloat) ;
+
+    GLuint tf_ = 0, skinned_vao_ = 0 ;
+
+    // allocate the feedback buffer and update skinned_vao_, leaves no vertex array bound
+    void prepareSkinning() ;
 
     ~MeshData() ;
 
     MeshDataManager *manager_ = nullptr ;
     Geometry *geom_ ;
+
+private:
+
+    void createBuffers(const Geometry &mesh) ;
+    void createStaticBuffers(const Geometry &mesh) ;
+    void createPackedBuffers(const Geometry &mesh) ;
+    void setPackedAttributes(const Geometry &mesh, GLintptr base) ;
+    void createIndexBuffer(const Geometry &mesh) ;
+    void packVertices(const Geometry &mesh, size_t first, size_t count, std::vector<uint8_t> &data) const ;
+    void allocateStream(const Geometry &mesh, size_t capacity) ;
+    void writeStream(const Geometry &mesh) ;
+    void setStreamAttributes(const Geometry &mesh) ;
+
+    size_t tf_capacity_ = 0 ;           // vertices that fit in tf_
+    bool skinned_vao_dirty_ = true ;
 } ;
 
 
@@ -0,0 +1,183 @@
+#include "occlusion_culler.hpp"
+
+#include <cstring>
+
+using namespace Eigen ;
+
+namespace xviz { namespace impl {
+
+OcclusionCuller::~OcclusionCuller() {
+    for( auto &n: nodes_ )
+        glDeleteQueries(2, n.second.queries_) ;
+
+    if ( vao_ ) glDeleteVertexArrays(1, &vao_) ;
+    if ( vbo_ ) glDeleteBuffers(1, &vbo_) ;
+    if ( ibo_ ) glDeleteBuffers(1, &ibo_) ;
+}
+
+bool OcclusionCuller::supported() {
+    return glGenQueries && glBeginQuery && glGetQueryObjectuiv && glBeginConditionalRender && glEndConditionalRender ;
+}
+
+// GL_ANY_SAMPLES_PASSED_CONSERVATIVE lets the driver answer from a coarser depth test, it is core since 4.3
+
+static bool conservativeQueriesSupported() {
+    GLint major = 0, minor = 0 ;
+    glGetIntegerv(GL_MAJOR_VERSION, &major) ;
+    glGetIntegerv(GL_MINOR_VERSION, &minor) ;
+
+    if ( major > 4 || ( major == 4 && minor >= 3 ) ) return true ;
+
+    GLint n = 0 ;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n) ;
+
+    for( GLint i=0 ; i<n ; i++ ) {
+        const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i) ;
+        if ( ext && strcmp(ext, "GL_ARB_ES3_compatibility") == 0 ) return true ;
+    }
+
+    return false ;
+}
+
+void OcclusionCuller::init() {
+    if ( box_shader_ ) return ;
+
+    target_ = conservativeQueriesSupported() ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED ;
+
+    box_shader_.reset(new OpenGLShaderProgram) ;
+    box_shader_->addShaderFromFile(VERTEX_SHADER, "@occlusion_box_vs") ;
+    box_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
+    box_shader_->link() ;
+
+    box_min_ = box_shader_->uniform<Vector3f>("box_min") ;
+    box_max_ = box_shader_->uniform<Vector3f>("box_max") ;
+
+    // unit cube, the faces are not culled so their winding does not matter
+
+    static const GLfloat vertices[] = {
+        0, 0, 0,   1, 0, 0,   1, 1, 0,   0, 1, 0,
+        0, 0, 1,   1, 0, 1,   1, 1, 1,   0, 1, 1
+    } ;
+
+    static const GLubyte indices[] = {
+        0, 1, 2,  0, 2, 3,      // z = 0
+        4, 5, 6,  4, 6, 7,      // z = 1
+        0, 1, 5,  0, 5, 4,      // y = 0
+        3, 2, 6,  3, 6, 7,      // y = 1
+        0, 3, 7,  0, 7, 4,      // x = 0
+        1, 2, 6,  1, 6, 5       // x = 1
+    } ;
+
+    glGenVertexArrays(1, &vao_) ;
+    glBindVertexArray(vao_) ;
+
+    glGenBuffers(1, &vbo_) ;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_) ;
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW) ;
+    glEnableVertexAttribArray(0) ;
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr) ;
+
+    glGenBuffers(1, &ibo_) ;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_) ;
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW) ;
+
+    glBindVertexArray(0) ;
+    glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+}
+
+void OcclusionCuller::beginFrame() {
+    ++frame_ ;
+    queries_ = 0 ;
+
+    // nodes that were not considered in the previous frame have left the view or the scene
+
+    for( auto it = nodes_.begin() ; it != nodes_.end() ; ) {
+        if ( it->second.frame_ + 1 < frame_ ) {
+            glDeleteQueries(2, it->second.queries_) ;
+            it = nodes_.erase(it) ;
+        } else
+            ++it ;
+    }
+}
+
+// Queries of the previous frame are still referenced by conditional rendering until the end of the current one, so
+// each node alternates between two query objects.
+
+OcclusionCuller::Visibility OcclusionCuller::visibility(const Node *node, GLuint &query) const {
+    auto it = nodes_.find(node) ;
+    if ( it == nodes_.end() || it->second.frame_ + 1 != frame_ ) return Visibility::Visible ;
+
+    const NodeQueries &nq = it->second ;
+    uint32_t idx = ( frame_ - 1 ) % 2 ;
+
+    if ( !nq.issued_[idx] ) return Visibility::Visible ;
+
+    GLuint available = 0 ;
+    glGetQueryObjectuiv(nq.queries_[idx], GL_QUERY_RESULT_AVAILABLE, &available) ;
+
+    if ( !available ) {
+        query = nq.queries_[idx] ;
+        return Visibility::Pending ;
+    }
+
+    GLuint passed = 0 ;
+    glGetQueryObjectuiv(nq.queries_[idx], GL_QUERY_RESULT, &passed) ;
+
+    return passed ? Visibility::Visible : Visibility::Hidden ;
+}
+
+void OcclusionCuller::beginQueries(const Matrix4f &proj_view, GLState &state) {
+    init() ;
+    state.invalidateVertexArray() ;
+
+    proj_view_ = proj_view ;
+
+    state.useProgram(box_shader_->handle()) ;
+    box_shader_->setUniform("proj_view", proj_view) ;
+
+    state.bindVertexArray(vao_) ;
+
+    state.enable(GL_DEPTH_TEST) ;
+    state.depthFunc(GL_LEQUAL) ;
+    state.depthMask(GL_FALSE) ;
+    state.disable(GL_CULL_FACE) ;
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE) ;
+}
+
+bool OcclusionCuller::query(const Node *node, const BoundingBox &box) {
+    NodeQueries &nq = nodes_[node] ;
+    uint32_t idx = frame_ % 2 ;
+
+    nq.frame_ = frame_ ;
+    nq.issued_[idx] = false ;
+
+    // the faces of a box crossing the near plane are clipped and may leave no sample although the node is visible
+
+    for( int i=0 ; i<8 ; i++ ) {
+        Vector4f corner((i & 1) ? box.max_.x() : box.min_.x(), (i & 2) ? box.max_.y() : box.min_.y(),
+                        (i & 4) ? box.max_.z() : box.min_.z(), 1.0f) ;
+        Vector4f clip = proj_view_ * corner ;
+        if ( clip.w() <= 0 || clip.z() < -clip.w() ) return false ;
+    }
+
+    if ( nq.queries_[0] == 0 ) glGenQueries(2, nq.queries_) ;
+
+    box_min_.set(box.min_) ;
+    box_max_.set(box.max_) ;
+
+    glBeginQuery(target_, nq.queries_[idx]) ;
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr) ;
+    glEndQuery(target_) ;
+
+    nq.issued_[idx] = true ;
+    ++queries_ ;
+
+    return true ;
+}
+
+void OcclusionCuller::endQueries() {
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE) ;
+}
+
+}}
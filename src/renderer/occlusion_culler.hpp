@@ -0,0 +1,79 @@
+#ifndef XVIZ_RENDERER_OCCLUSION_CULLER_HPP
+#define XVIZ_RENDERER_OCCLUSION_CULLER_HPP
+
+#include "common/gl/gl3w.h"
+#include "common/shader.hpp"
+
+#include "frustum.hpp"
+#include "gl_state.hpp"
+
+#include <xviz/scene/scene_fwd.hpp>
+
+#include <memory>
+#include <unordered_map>
+
+namespace xviz { namespace impl {
+
+// Occlusion culling of nodes from the visibility of their bounds in the previous frame. Once the occluders are in the
+// depth buffer, the world space box of each candidate node is drawn with an occlusion query, writing neither color
+// nor depth. In the next frame the drawables of a node whose box left no sample are skipped: on the CPU when the
+// result is already available, otherwise on the GPU by conditional rendering on the query, which does not wait for
+// it: the node is drawn if the query is still in flight. Nodes that come into view from behind an occluder hence
+// appear one frame late.
+
+class OcclusionCuller {
+public:
+
+    OcclusionCuller() = default ;
+    ~OcclusionCuller() ;
+
+    OcclusionCuller(const OcclusionCuller &) = delete ;
+    OcclusionCuller &operator = (const OcclusionCuller &) = delete ;
+
+    // occlusion queries and conditional rendering are available in the current context
+    static bool supported() ;
+
+    enum class Visibility { Visible, Hidden, Pending } ;
+
+    // to be called at every frame, also when culling is disabled, releases the queries of nodes that were not
+    // considered in the previous frame
+    void beginFrame() ;
+
+    // Outcome of the query of the node in the previous frame. Nodes that were not queried are visible. For a pending
+    // query, query is set to the object to be passed to glBeginConditionalRender.
+    Visibility visibility(const Node *node, GLuint &query) const ;
+
+    // draw the boxes of the current frame between beginQueries and endQueries
+    void beginQueries(const Eigen::Matrix4f &proj_view, GLState &state) ;
+    // Returns false when no query was issued because the box reaches the near plane, the node is then visible.
+    bool query(const Node *node, const BoundingBox &box) ;
+    void endQueries() ;
+
+    // number of queries issued in the current frame
+    uint32_t queries() const { return queries_ ; }
+
+private:
+
+    struct NodeQueries {
+        GLuint queries_[2] = { 0, 0 } ;     // used in even and odd frames
+        bool issued_[2] = { false, false } ;
+        uint64_t frame_ = 0 ;               // last frame in which the node was considered
+    };
+
+    void init() ;
+
+    std::unordered_map<const Node *, NodeQueries> nodes_ ;
+    uint64_t frame_ = 0 ;
+    uint32_t queries_ = 0 ;
+
+    Eigen::Matrix4f proj_view_ ;
+    GLenum target_ = GL_ANY_SAMPLES_PASSED ;
+
+    std::unique_ptr<OpenGLShaderProgram> box_shader_ ;
+    OpenGLUniform<Eigen::Vector3f> box_min_, box_max_ ;
+    GLuint vao_ = 0, vbo_ = 0, ibo_ = 0 ;
+};
+
+}}
+
+#endif
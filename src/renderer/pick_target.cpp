@@ -0,0 +1,188 @@
+#include "pick_target.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace xviz { namespace impl {
+
+// the targets follow the attachment index of the matching fragment shader output, the color output is dropped
+
+static const GLenum internal_formats[PickTarget::num_targets_] = { GL_R32F, GL_R32UI, GL_R32UI } ;
+
+static const GLenum attachments[PickTarget::num_targets_] = {
+    GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4
+} ;
+
+static const GLenum draw_buffers[] = {
+    GL_NONE, GL_COLOR_ATTACHMENT1, GL_NONE, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4
+} ;
+
+PickTarget::~PickTarget() {
+    release() ;
+
+    for( Readback &rb: readbacks_ ) {
+        if ( rb.fence_ ) glDeleteSync(rb.fence_) ;
+        if ( rb.pbo_ ) glDeleteBuffers(1, &rb.pbo_) ;
+    }
+}
+
+void PickTarget::release() {
+    if ( fbo_ ) glDeleteFramebuffers(1, &fbo_) ;
+    if ( targets_[0] ) glDeleteRenderbuffers(num_targets_, targets_) ;
+    if ( depth_ ) glDeleteRenderbuffers(1, &depth_) ;
+
+    fbo_ = depth_ = 0 ;
+    for( int i=0 ; i<num_targets_ ; i++ )
+        targets_[i] = 0 ;
+
+    size_ = 0 ;
+}
+
+static GLuint createRenderbuffer(GLenum format, GLsizei width, GLsizei height) {
+    GLuint rb ;
+    glGenRenderbuffers(1, &rb) ;
+    glBindRenderbuffer(GL_RENDERBUFFER, rb) ;
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height) ;
+    return rb ;
+}
+
+void PickTarget::create(GLsizei size) {
+    release() ;
+
+    size_ = size ;
+
+    glGenFramebuffers(1, &fbo_) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+
+    for( int i=0 ; i<num_targets_ ; i++ ) {
+        targets_[i] = createRenderbuffer(internal_formats[i], size, size) ;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER, targets_[i]) ;
+    }
+
+    depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, size, size) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_) ;
+
+    glDrawBuffers(5, draw_buffers) ;
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+        std::cerr << "pick framebuffer is not complete" << std::endl ;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0) ;
+}
+
+void PickTarget::begin(GLsizei size) {
+    if ( size > size_ )
+        create(size) ;
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+
+    const GLfloat zero[4] = { 0, 0, 0, 0 }, one = 1.0f ;
+    const GLuint zero_id[4] = { 0, 0, 0, 0 } ;
+
+    glDepthMask(GL_TRUE) ;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE) ;
+
+    // buffers are indexed by draw buffer
+    glClearBufferfv(GL_COLOR, 1, zero) ;
+    glClearBufferuiv(GL_COLOR, 3, zero_id) ;
+    glClearBufferuiv(GL_COLOR, 4, zero_id) ;
+    glClearBufferfv(GL_DEPTH, 0, &one) ;
+}
+
+// The targets are read one after the other into the same buffer, each window is a multiple of 4 bytes per row.
+
+uint64_t PickTarget::read(PickRequest &&req) {
+    Readback *rb = &readbacks_[0] ;
+    for( Readback &r: readbacks_ )
+        if ( r.ticket_ < rb->ticket_ ) rb = &r ;
+
+    if ( rb->ticket_ ) complete(*rb) ;
+
+    const GLsizei size = 2 * req.radius_ + 1 ;
+    const GLsizeiptr target_size = size * size * 4 ;
+
+    if ( !rb->pbo_ ) glGenBuffers(1, &rb->pbo_) ;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo_) ;
+
+    if ( rb->capacity_ < num_targets_ * target_size ) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, num_targets_ * target_size, nullptr, GL_STREAM_READ) ;
+        rb->capacity_ = num_targets_ * target_size ;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_) ;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    glReadBuffer(attachments[0]) ;
+    glReadPixels(0, 0, size, size, GL_RED, GL_FLOAT, nullptr) ;
+
+    for( int i=1 ; i<num_targets_ ; i++ ) {
+        glReadBuffer(attachments[i]) ;
+        glReadPixels(0, 0, size, size, GL_RED_INTEGER, GL_UNSIGNED_INT, (void *)( i * target_size )) ;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0) ;
+
+    rb->fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) ;
+    rb->ticket_ = next_ticket_++ ;
+    rb->req_ = std::move(req) ;
+
+    return rb->ticket_ ;
+}
+
+// waits for the copy of the request to complete and moves it to completed_, freeing the buffer
+
+void PickTarget::complete(Readback &rb) {
+    while ( glClientWaitSync(rb.fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED ) ;
+    glDeleteSync(rb.fence_) ;
+    rb.fence_ = nullptr ;
+
+    PickRequest &req = rb.req_ ;
+
+    const size_t n = ( 2 * req.radius_ + 1 ) * ( 2 * req.radius_ + 1 ) ;
+
+    req.depth_.resize(n) ;
+    req.ids_.resize(n) ;
+    req.primitives_.resize(n) ;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo_) ;
+
+    if ( const char *pixels = (const char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, num_targets_ * n * 4, GL_MAP_READ_BIT) ) {
+        memcpy(req.depth_.data(), pixels, n * 4) ;
+        memcpy(req.ids_.data(), pixels + n * 4, n * 4) ;
+        memcpy(req.primitives_.data(), pixels + 2 * n * 4, n * 4) ;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER) ;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+
+    completed_[rb.ticket_] = std::move(req) ;
+
+    rb.req_ = PickRequest() ;
+    rb.ticket_ = 0 ;
+}
+
+bool PickTarget::fetch(uint64_t ticket, PickRequest &req, bool wait) {
+    auto it = completed_.find(ticket) ;
+
+    if ( it == completed_.end() ) {
+        Readback *rb = nullptr ;
+        for( Readback &r: readbacks_ )
+            if ( ticket != 0 && r.ticket_ == ticket ) rb = &r ;
+
+        if ( !rb ) return false ;
+
+        if ( !wait && glClientWaitSync(rb->fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED )
+            return false ;
+
+        complete(*rb) ;
+        it = completed_.find(ticket) ;
+    }
+
+    req = std::move(it->second) ;
+    completed_.erase(it) ;
+
+    return true ;
+}
+
+}}
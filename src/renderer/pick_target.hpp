@@ -0,0 +1,80 @@
+#ifndef XVIZ_RENDERER_PICK_TARGET_HPP
+#define XVIZ_RENDERER_PICK_TARGET_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <xviz/scene/renderer.hpp>
+
+#include <map>
+#include <vector>
+
+namespace xviz { namespace impl {
+
+// what Renderer::fetchPick needs to turn the pixels of a pick into a RayCastResult
+
+struct PickRequest {
+    std::vector<CaptureId> drawables_ ;     // drawable of id i + 1 in element i
+    Eigen::Matrix4f proj_, view_ ;          // camera matrices, without the pick window
+    Viewport vp_ ;                          // camera viewport
+    int x_, y_ ;                            // picked pixel, relative to the viewport with rows from the top
+    int radius_ ;                           // the window spans 2 * radius + 1 pixels centered on the picked one
+
+    // pixels of the window with rows from the bottom, filled when the readback completes
+    std::vector<float> depth_ ;
+    std::vector<uint32_t> ids_, primitives_ ;
+};
+
+// Framebuffer of Renderer::requestPick, covering only the few pixels around the cursor: R32F linear depth, R32UI
+// ids and R32UI primitive indices bound to the outputs 1, 3 and 4 of capture_fragment_shader, plus a depth buffer.
+// The pixels are copied into a ring of pixel pack buffers behind a fence and mapped when fetched, as in
+// OffscreenSurface::requestImage.
+
+class PickTarget {
+public:
+
+    PickTarget() = default ;
+    ~PickTarget() ;
+
+    PickTarget(const PickTarget &) = delete ;
+    PickTarget &operator = (const PickTarget &) = delete ;
+
+    // bind the framebuffer, reallocated when smaller than size x size pixels, and clear it
+    void begin(GLsizei size) ;
+
+    // Queue the copy of the window rendered for the request and return its ticket. The buffer of the oldest request
+    // is recycled when none is free. Leaves the framebuffer unbound.
+    uint64_t read(PickRequest &&req) ;
+
+    // Returns false if the ticket is unknown, or if the copy is still in flight and wait is false. Otherwise the
+    // ticket is released and req is set.
+    bool fetch(uint64_t ticket, PickRequest &req, bool wait) ;
+
+    static const int num_targets_ = 3 ;
+    static const int num_readbacks_ = 3 ;
+
+private:
+
+    struct Readback {
+        GLuint pbo_ = 0 ;
+        GLsizeiptr capacity_ = 0 ;
+        GLsync fence_ = nullptr ;
+        uint64_t ticket_ = 0 ;      // 0 when the buffer is free
+        PickRequest req_ ;
+    };
+
+    void create(GLsizei size) ;
+    void release() ;
+    void complete(Readback &rb) ;
+
+    GLuint fbo_ = 0, depth_ = 0 ;
+    GLuint targets_[num_targets_] = { 0 } ;
+    GLsizei size_ = 0 ;
+
+    Readback readbacks_[num_readbacks_] ;
+    std::map<uint64_t, PickRequest> completed_ ;    // requests whose buffer was recycled before they were fetched
+    uint64_t next_ticket_ = 1 ;
+};
+
+}}
+
+#endif
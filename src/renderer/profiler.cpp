@@ -0,0 +1,136 @@
+#include "profiler.hpp"
+
+#include <iomanip>
+
+using namespace std ;
+
+namespace xviz { namespace impl {
+
+uint64_t FrameProfiler::uploaded_bytes_ = 0 ;
+
+FrameProfiler::FrameProfiler(): origin_(std::chrono::steady_clock::now()) {
+}
+
+FrameProfiler::~FrameProfiler() {
+    for( FrameQueries &frame: frames_ ) {
+        if ( !frame.pool_.empty() )
+            glDeleteQueries(frame.pool_.size(), frame.pool_.data()) ;
+    }
+
+    setTraceFile({}) ;
+}
+
+double FrameProfiler::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin_).count() ;
+}
+
+void FrameProfiler::beginFrame() {
+    // read the results of the previous frames, oldest first. The slot of the new frame is the oldest one and its
+    // results are dropped if still not available, rather than waited for.
+
+    for( uint64_t i = NUM_FRAMES ; i > 0 ; i-- ) {
+        if ( frame_ >= i )
+            collect(frames_[(frame_ - i) % NUM_FRAMES]) ;
+    }
+
+    FrameQueries &frame = frames_[frame_ % NUM_FRAMES] ;
+    frame.passes_.clear() ;
+    frame.pending_ = false ;
+
+    passes_.clear() ;
+    frame_start_ = now() ;
+}
+
+void FrameProfiler::endFrame(std::vector<PassTiming> &passes) {
+    FrameQueries &frame = frames_[frame_ % NUM_FRAMES] ;
+    frame.pending_ = !frame.passes_.empty() ;
+
+    for( PassTiming &pass: passes_ ) {
+        auto it = gpu_times_.find(pass.name_) ;
+        pass.gpu_ms_ = ( it == gpu_times_.end() ) ? -1.0 : it->second ;
+    }
+
+    passes = passes_ ;
+
+    traceEvent("frame", 0, frame_start_, now() - frame_start_) ;
+
+    ++frame_ ;
+}
+
+void FrameProfiler::beginPass(const std::string &name) {
+    if ( depth_++ > 0 ) return ;
+
+    FrameQueries &frame = frames_[frame_ % NUM_FRAMES] ;
+
+    size_t i = frame.passes_.size() ;
+    if ( i == frame.pool_.size() ) {
+        GLuint query ;
+        glGenQueries(1, &query) ;
+        frame.pool_.push_back(query) ;
+    }
+
+    frame.passes_.push_back({name, frame.pool_[i], now()}) ;
+
+    glBeginQuery(GL_TIME_ELAPSED, frame.pool_[i]) ;
+}
+
+void FrameProfiler::endPass() {
+    if ( --depth_ > 0 ) return ;
+
+    glEndQuery(GL_TIME_ELAPSED) ;
+
+    const PassQuery &query = frames_[frame_ % NUM_FRAMES].passes_.back() ;
+    double duration = now() - query.start_ ;
+
+    PassTiming pass ;
+    pass.name_ = query.name_ ;
+    pass.cpu_ms_ = duration / 1000.0 ;
+    passes_.push_back(pass) ;
+
+    traceEvent(query.name_, 0, query.start_, duration) ;
+}
+
+// queries complete in order, so all results are available once the one of the last pass is
+
+bool FrameProfiler::collect(FrameQueries &frame) {
+    if ( !frame.pending_ ) return true ;
+
+    GLuint available = 0 ;
+    glGetQueryObjectuiv(frame.passes_.back().query_, GL_QUERY_RESULT_AVAILABLE, &available) ;
+    if ( !available ) return false ;
+
+    for( const PassQuery &pass: frame.passes_ ) {
+        GLuint64 elapsed = 0 ;
+        glGetQueryObjectui64v(pass.query_, GL_QUERY_RESULT, &elapsed) ;
+
+        gpu_times_[pass.name_] = elapsed * 1.0e-6 ;
+        traceEvent(pass.name_, 1, pass.start_, elapsed * 1.0e-3) ;
+    }
+
+    frame.pending_ = false ;
+    return true ;
+}
+
+void FrameProfiler::setTraceFile(const std::string &path) {
+    if ( trace_.is_open() ) {
+        trace_ << "\n]\n" ;
+        trace_.close() ;
+    }
+
+    if ( path.empty() ) return ;
+
+    trace_.open(path) ;
+    trace_ << std::fixed << std::setprecision(3) ;
+
+    trace_ << "[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},"
+              "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}" ;
+}
+
+void FrameProfiler::traceEvent(const std::string &name, int track, double start, double duration) {
+    if ( !trace_.is_open() ) return ;
+
+    trace_ << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << track
+           << ",\"ts\":" << start << ",\"dur\":" << duration << "}" ;
+}
+
+}}
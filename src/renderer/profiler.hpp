@@ -0,0 +1,97 @@
+#ifndef XVIZ_RENDERER_PROFILER_HPP
+#define XVIZ_RENDERER_PROFILER_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <xviz/scene/renderer.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+namespace xviz { namespace impl {
+
+// CPU and GPU timings of the passes of a frame. The CPU time of a pass is measured with steady_clock, the GPU time
+// with a GL_TIME_ELAPSED query. Queries are taken from a ring covering the last NUM_FRAMES frames and the results
+// of a frame are only read once available, usually a couple of frames later, so that profiling never stalls the
+// pipeline. Since a single GL_TIME_ELAPSED query may be active at a time, passes begun within another pass are
+// not timed separately but counted in the enclosing one.
+
+class FrameProfiler {
+public:
+
+    FrameProfiler() ;
+    ~FrameProfiler() ;
+
+    FrameProfiler(const FrameProfiler &) = delete ;
+    FrameProfiler &operator = (const FrameProfiler &) = delete ;
+
+    void beginFrame() ;
+    // timings of the passes of the frame, the GPU time is the one of the most recent frame with available results
+    void endFrame(std::vector<PassTiming> &passes) ;
+
+    void beginPass(const std::string &name) ;
+    void endPass() ;
+
+    // times the enclosing block as a pass
+    class Scope {
+    public:
+        Scope(FrameProfiler &profiler, const std::string &name): profiler_(profiler) { profiler_.beginPass(name) ; }
+        ~Scope() { profiler_.endPass() ; }
+    private:
+        FrameProfiler &profiler_ ;
+    };
+
+    // Append the passes of every frame to a Chrome trace-event JSON file. GPU passes are placed on their own track
+    // at the CPU start time of the pass, since the queries only provide durations. An empty path stops tracing.
+    void setTraceFile(const std::string &path) ;
+
+    // bytes transferred to buffers and textures, summed over all renderers until the counter is reset
+    static void addUploadedBytes(uint64_t bytes) { uploaded_bytes_ += bytes ; }
+    static uint64_t uploadedBytes() { return uploaded_bytes_ ; }
+    static void resetUploadedBytes() { uploaded_bytes_ = 0 ; }
+
+    static const uint32_t NUM_FRAMES = 4 ;
+
+private:
+
+    struct PassQuery {
+        std::string name_ ;
+        GLuint query_ ;
+        double start_ ;     // CPU time when the pass started, microseconds since the creation of the profiler
+    };
+
+    struct FrameQueries {
+        std::vector<PassQuery> passes_ ;
+        std::vector<GLuint> pool_ ;     // query objects reused by the passes
+        bool pending_ = false ;         // results not read yet
+    };
+
+    double now() const ;
+
+    // read the results of the frame if available, returns false otherwise
+    bool collect(FrameQueries &frame) ;
+
+    // complete event on the CPU (0) or GPU (1) track, times in microseconds
+    void traceEvent(const std::string &name, int track, double start, double duration) ;
+
+    FrameQueries frames_[NUM_FRAMES] ;
+    uint64_t frame_ = 0 ;
+
+    std::vector<PassTiming> passes_ ;               // passes of the current frame
+    uint32_t depth_ = 0 ;                           // nesting level of the active pass, 0 outside passes
+    std::map<std::string, double> gpu_times_ ;      // latest GPU time of each pass
+    double frame_start_ = 0 ;
+
+    std::chrono::steady_clock::time_point origin_ ;
+
+    std::ofstream trace_ ;
+
+    static uint64_t uploaded_bytes_ ;
+};
+
+}}
+
+#endif
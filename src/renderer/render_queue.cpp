@@ -0,0 +1,16 @@
+#include "render_queue.hpp"
+#include "material_program.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace xviz { namespace impl {
+
+void RenderQueue::sort() {
+    std::stable_sort(items_.begin(), items_.end(), [](const RenderItem &a, const RenderItem &b) {
+        return std::make_tuple(a.order_, a.prog_.get(), a.material_.get(), a.texture_, a.vao_) <
+               std::make_tuple(b.order_, b.prog_.get(), b.material_.get(), b.texture_, b.vao_) ;
+    }) ;
+}
+
+}}
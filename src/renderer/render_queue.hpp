@@ -0,0 +1,74 @@
+#ifndef XVIZ_RENDERER_RENDER_QUEUE_HPP
+#define XVIZ_RENDERER_RENDER_QUEUE_HPP
+
+#include <vector>
+#include <Eigen/Geometry>
+
+#include <xviz/scene/scene_fwd.hpp>
+#include <xviz/scene/drawable.hpp>
+
+#include "common/gl/gl3w.h"
+
+namespace xviz { namespace impl {
+
+class MeshData ;
+class MaterialProgram ;
+using MaterialProgramPtr = std::shared_ptr<MaterialProgram> ;
+
+// A draw call collected during scene traversal together with the state it requires
+
+struct RenderItem {
+    int order_ = 0 ;                        // node drawing order (see Node::setOrder)
+    MaterialProgramPtr prog_ ;              // program instantiated for the material
+    MaterialPtr material_ ;
+    const Texture2D *texture_ = nullptr ;   // main texture of the material if any
+    GLuint vao_ = 0 ;
+    bool skinning_ = false ;                // the program poses the mesh with the bone palette
+    bool opaque_ = false ;                  // depth tested solid triangles without transparency, see Renderer::depthPrePass
+    GLuint occlusion_query_ = 0 ;           // drawn only if the pending query of the node found it visible
+    uint32_t lod_ = 0 ;                     // level of detail of the geometry, 0 for the full geometry
+
+    // source of the item and its capture id (of the first instance), see Renderer::capture
+    size_t node_index_ = 0 ;                // position of the node in FrameContext::nodes_
+    const Drawable *drawable_ = nullptr ;
+    const InstancedDrawable *instanced_ = nullptr ;
+    uint32_t id_ = 0 ;
+
+    GeometryPtr geom_ ;
+    const MeshData *data_ = nullptr ;
+    Eigen::Affine3f transform_ ;            // world transform of the drawable
+
+    // instanced drawing, instances_ is zero for a plain draw call
+    GLsizei instances_ = 0 ;
+    GLuint instance_buffer_ = 0 ;
+    GLintptr instance_offset_ = 0 ;         // offset of the model matrices in the instance buffer
+    GLintptr instance_colors_offset_ = -1 ; // offset of the colors, -1 if there are none
+};
+
+// The queue is rebuilt every frame and sorted so that consecutive items share as much GL state as possible.
+// Items are sorted by (order, program, material, texture, vao), hence the Node::setOrder semantics are retained.
+// Ties are kept in scene traversal order.
+
+class RenderQueue {
+public:
+
+    void clear() { items_.clear() ; }
+
+    void add(RenderItem &&item) { items_.emplace_back(std::move(item)) ; }
+
+    void sort() ;
+
+    const std::vector<RenderItem> &items() const { return items_ ; }
+    std::vector<RenderItem> &items() { return items_ ; }
+
+    size_t size() const { return items_.size() ; }
+    bool empty() const { return items_.empty() ; }
+
+private:
+
+    std::vector<RenderItem> items_ ;
+};
+
+}}
+
+#endif
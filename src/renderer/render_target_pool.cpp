@@ -0,0 +1,120 @@
+#include "render_target_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace xviz { namespace impl {
+
+RenderTargetPool::~RenderTargetPool() {
+    for( auto &target: targets_ )
+        destroy(*target) ;
+}
+
+static GLuint createRenderbuffer(GLenum format, GLsizei width, GLsizei height, GLsizei samples) {
+    GLuint rb ;
+    glGenRenderbuffers(1, &rb) ;
+    glBindRenderbuffer(GL_RENDERBUFFER, rb) ;
+
+    if ( samples > 0 )
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height) ;
+    else
+        glRenderbufferStorage(GL_RENDERBUFFER, format, width, height) ;
+
+    return rb ;
+}
+
+// Color textures are only ever read with texelFetch, they have a single level and nearest filtering to be complete.
+
+void RenderTargetPool::create(RenderTarget &target) {
+    const RenderTargetDesc &desc = target.desc_ ;
+
+    glGenFramebuffers(1, &target.fbo_) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo_) ;
+
+    if ( desc.color_format_ != GL_NONE ) {
+        if ( desc.samples_ > 0 ) {
+            target.color_ = createRenderbuffer(desc.color_format_, desc.width_, desc.height_, desc.samples_) ;
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color_) ;
+        } else {
+            glGenTextures(1, &target.color_) ;
+            glBindTexture(GL_TEXTURE_2D, target.color_) ;
+            // the format and type only describe pixel data, of which there is none
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.color_format_, desc.width_, desc.height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) ;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) ;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) ;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0) ;
+            glBindTexture(GL_TEXTURE_2D, 0) ;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color_, 0) ;
+        }
+    }
+
+    if ( desc.depth_format_ != GL_NONE ) {
+        target.depth_ = createRenderbuffer(desc.depth_format_, desc.width_, desc.height_, desc.samples_) ;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth_) ;
+    }
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+        std::cerr << "render target framebuffer is not complete" << std::endl ;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0) ;
+}
+
+void RenderTargetPool::destroy(RenderTarget &target) {
+    if ( target.fbo_ ) glDeleteFramebuffers(1, &target.fbo_) ;
+
+    if ( target.color_ ) {
+        if ( target.desc_.samples_ > 0 )
+            glDeleteRenderbuffers(1, &target.color_) ;
+        else
+            glDeleteTextures(1, &target.color_) ;
+    }
+
+    if ( target.depth_ ) glDeleteRenderbuffers(1, &target.depth_) ;
+
+    target.fbo_ = target.color_ = target.depth_ = 0 ;
+}
+
+RenderTarget *RenderTargetPool::acquire(const RenderTargetDesc &desc) {
+    for( auto &target: targets_ ) {
+        if ( !target->in_use_ && target->desc_ == desc ) {
+            target->in_use_ = true ;
+            target->last_used_ = frame_ ;
+            ++counters_.reused_ ;
+            return target.get() ;
+        }
+    }
+
+    std::unique_ptr<RenderTarget> target(new RenderTarget) ;
+    target->desc_ = desc ;
+    target->in_use_ = true ;
+    target->last_used_ = frame_ ;
+    create(*target) ;
+
+    ++counters_.allocated_ ;
+
+    targets_.emplace_back(std::move(target)) ;
+    return targets_.back().get() ;
+}
+
+RenderTargetPool::Counters RenderTargetPool::endFrame() {
+    auto idle = [this](const std::unique_ptr<RenderTarget> &target) {
+        return !target->in_use_ && frame_ - target->last_used_ >= max_idle_frames_ ;
+    } ;
+
+    for( auto &target: targets_ ) {
+        if ( idle(target) ) {
+            destroy(*target) ;
+            ++counters_.freed_ ;
+        }
+    }
+
+    targets_.erase(std::remove_if(targets_.begin(), targets_.end(), idle), targets_.end()) ;
+
+    ++frame_ ;
+
+    Counters counters = counters_ ;
+    counters_ = Counters() ;
+    return counters ;
+}
+
+}}
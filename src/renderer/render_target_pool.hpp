@@ -0,0 +1,79 @@
+#ifndef XVIZ_RENDERER_RENDER_TARGET_POOL_HPP
+#define XVIZ_RENDERER_RENDER_TARGET_POOL_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <memory>
+#include <vector>
+
+namespace xviz { namespace impl {
+
+// size and formats of a render target, GL_NONE for a missing attachment
+
+struct RenderTargetDesc {
+    GLsizei width_ = 0, height_ = 0 ;
+    GLenum color_format_ = GL_RGBA8 ;
+    GLenum depth_format_ = GL_NONE ;
+    GLsizei samples_ = 0 ;
+
+    bool operator == (const RenderTargetDesc &other) const {
+        return width_ == other.width_ && height_ == other.height_ && color_format_ == other.color_format_ &&
+                depth_format_ == other.depth_format_ && samples_ == other.samples_ ;
+    }
+};
+
+// Framebuffer with a color and a depth attachment. The color attachment is a texture when single sampled, so that
+// it can be read by a shader, and a renderbuffer otherwise. The depth attachment is always a renderbuffer.
+
+struct RenderTarget {
+    RenderTargetDesc desc_ ;
+    GLuint fbo_ = 0, color_ = 0, depth_ = 0 ;
+    bool in_use_ = false ;
+    uint64_t last_used_ = 0 ;   // frame in which the target was last acquired
+};
+
+// Render targets of Renderer::renderImage kept from one frame to the next, so that rendering the same kind of image
+// repeatedly does not create framebuffers. A target is handed out by acquire when it matches the requested
+// description exactly and is not already in use. Targets that were not acquired for max_idle_frames_ frames are
+// deleted.
+
+class RenderTargetPool {
+public:
+
+    RenderTargetPool() = default ;
+    ~RenderTargetPool() ;
+
+    RenderTargetPool(const RenderTargetPool &) = delete ;
+    RenderTargetPool &operator = (const RenderTargetPool &) = delete ;
+
+    // a free target with the given description, created if there is none
+    RenderTarget *acquire(const RenderTargetDesc &desc) ;
+
+    // return the target to the pool
+    void release(RenderTarget *target) { target->in_use_ = false ; }
+
+    struct Counters {
+        uint32_t allocated_ = 0 ;   // targets created
+        uint32_t reused_ = 0 ;      // targets taken from the pool
+        uint32_t freed_ = 0 ;       // idle targets deleted
+    };
+
+    // Delete the idle targets and return the counters of the frame, which are then reset. To be called at every
+    // frame.
+    Counters endFrame() ;
+
+    static const uint64_t max_idle_frames_ = 8 ;
+
+private:
+
+    static void create(RenderTarget &target) ;
+    static void destroy(RenderTarget &target) ;
+
+    std::vector<std::unique_ptr<RenderTarget>> targets_ ;
+    uint64_t frame_ = 0 ;
+    Counters counters_ ;
+};
+
+}}
+
+#endif
@@ -7,6 +7,8 @@
 #include "material_program.hpp"
 #include "texture_data.hpp"
 
+#include "common/gl_loader.hpp"
+
 #include <xviz/scene/scene.hpp>
 #include <xviz/scene/node.hpp>
 #include <xviz/scene/drawable.hpp>
@@ -16,6 +18,10 @@
 #include <xviz/scene/material.hpp>
 
 #include <iostream>
+#include <cstring>
+#include <string_view>
+#include <functional>
+#include <algorithm>
 
 #include "mesh_data.hpp"
 
@@ -27,13 +33,13 @@ namespace xviz {
 
 namespace impl {
 
-static bool gl_initialized_ = false ;
-
 Renderer::Renderer() {
     PhongMaterial *mat = new PhongMaterial() ;
     mat->setDiffuseColor({0.5, 0.5, 0.5}) ;
     default_material_.reset(mat) ;
 
+    fallback_material_.reset(new ConstantMaterial({0.5, 0.5, 0.5, 1.0})) ;
+
     init() ;
 
 }
@@ -42,433 +48,2064 @@ Renderer::Renderer() {
 impl::TextureData *Renderer::fetchTextureData(const Texture2D *texture) {
     if ( !texture ) return nullptr ;
 
-    return textures_.fetch(texture->image().get(), texture->sampler()) ;
+    // a texture created by the cache is left bound to the active unit
+    TextureData *data = textures_.fetch(texture->image().get(), texture->sampler()) ;
+    state_.invalidateTexture(GL_TEXTURE_2D) ;
+
+    return data ;
 
 }
 
-MaterialProgramPtr Renderer::instantiateMaterial(const Material *mat, const std::vector<LightData *> &lights, bool has_skeleton) {
+// program parameters depending on the lights of the scene
+
+static void addLightParams(MaterialProgramParams &params, const Light *light) {
+    if ( light->castsShadows() ) params.enable_shadows_ = true ;
+    if ( dynamic_cast<const DirectionalLight *>(light) ) {
+        if ( light->castsShadows() ) params.num_dir_lights_shadow_ ++ ;
+        else params.num_dir_lights_ ++ ;
+    } else if ( dynamic_cast<const SpotLight *>(light) ) {
+        if ( light->castsShadows() ) params.num_spot_lights_shadow_ ++ ;
+        else params.num_spot_lights_ ++ ;
+    } else if ( dynamic_cast<const PointLight *>(light) ) {
+        if ( light->castsShadows() ) params.num_point_lights_shadow_ ++ ;
+        else params.num_point_lights_ ++ ;
+    }
+}
 
-    MaterialProgramParams params ;
+MaterialProgramPtr Renderer::instantiateMaterial(const Material *mat, const MaterialProgramParams &frame_params, bool has_skeleton,
+                                                 bool instancing, bool instance_colors) {
 
-    bool has_shadows = false ;
-
-    for( const auto &ld: lights ) {
-        const LightPtr &light = ld->light_ ;
-        if ( light->castsShadows() ) has_shadows = true ;
-        if ( dynamic_cast<const DirectionalLight *>(light.get()) ) {
-            if ( light->castsShadows() ) params.num_dir_lights_shadow_ ++ ;
-            else params.num_dir_lights_ ++ ;
-        } else if ( dynamic_cast<const SpotLight *>(light.get()) ) {
-            if ( light->castsShadows() ) params.num_spot_lights_shadow_ ++ ;
-            else params.num_spot_lights_ ++ ;
-        } else if ( dynamic_cast<const PointLight *>(light.get()) ) {
-            if ( light->castsShadows() ) params.num_point_lights_shadow_ ++ ;
-            else params.num_point_lights_ ++ ;
-        }
-    }
+    // light related parameters are common to all drawables of the frame
+
+    MaterialProgramParams params(frame_params) ;
 
-    params.enable_shadows_ = has_shadows ;
     params.enable_skinning_ = has_skeleton ;
 
     params.has_texture_map_ = mat->hasTexture() ;
 
+    params.enable_instancing_ = instancing ;
+    params.has_instance_colors_ = instance_colors ;
+
     return mat->instantiate(params) ;
 }
 
-void Renderer::init() {
-    if ( !gl_initialized_ ) {
-        gl3wInit();
-        gl_initialized_ = true ;
+// Without asynchronous compilation the program is waited for, as is the case when the driver compiles in the
+// calling thread anyway.
+
+bool Renderer::programReady(const MaterialProgramPtr &prog) {
+    if ( async_compile_ && OpenGLShaderProgram::parallelCompileSupported() )
+        return prog->isReady() ;
+
+    prog->wait() ;
+    return true ;
+}
+
+// Items whose program is not ready are drawn with a constant color. Its variants depend only on the vertex inputs,
+// so there are a few of them and they are compiled synchronously.
+
+void Renderer::useFallbackProgram(RenderItem &item, bool instancing, bool instance_colors) {
+    MaterialProgramParams params ;
+    params.enable_capture_ = capture_ != nullptr ;
+
+    item.prog_ = instantiateMaterial(fallback_material_.get(), params, item.skinning_, instancing, instance_colors) ;
+    item.prog_->wait() ;
+    item.material_ = fallback_material_ ;
+    item.texture_ = nullptr ;
+}
+
+void Renderer::pollPrograms() {
+    pending_programs_.erase(std::remove_if(pending_programs_.begin(), pending_programs_.end(),
+                                           [](const MaterialProgramPtr &prog) { return prog->isReady() ; }),
+                            pending_programs_.end()) ;
+}
+
+// The variants are derived as in setupFrame and buildRenderQueue. With asynchronous compilation the programs are
+// left to the driver and polled at every frame, otherwise they are compiled before returning.
+
+void Renderer::precompile(const NodePtr &scene) {
+    initShadowMapRenderer() ;
+
+    std::vector<NodePtr> nodes = scene->getOrderedNodes() ;
+
+    MaterialProgramParams params ;
+
+    for( const NodePtr &node: nodes ) {
+        if ( LightPtr l = node->light() )
+            addLightParams(params, l.get()) ;
+    }
+
+    std::vector<MaterialProgramPtr> programs ;
+    std::map<std::pair<const Geometry *, const Material *>, uint32_t> uses ;
+
+    auto add = [&](const Material *mat, bool skinning, bool instancing, bool instance_colors) {
+        programs.push_back(instantiateMaterial(mat, params, skinning, instancing, instance_colors)) ;
+        programs.push_back(instantiateMaterial(fallback_material_.get(), MaterialProgramParams(), skinning, instancing, instance_colors)) ;
+    } ;
+
+    for( const NodePtr &node: nodes ) {
+        for( const auto &drawable: node->drawables() ) {
+            GeometryPtr mesh = drawable.geometry() ;
+            if ( !mesh ) continue ;
+
+            const Material *mat = drawable.material() ? drawable.material().get() : default_material_.get() ;
+            bool skinning = mesh->hasSkeleton() && !isPreSkinned(*mesh) ;
+
+            add(mat, skinning, false, false) ;
+
+            // repeated drawables are batched in instanced draws (see batchRenderQueue)
+            if ( ++uses[{mesh.get(), mat}] == min_instance_batch_ )
+                add(mat, skinning, true, false) ;
+        }
+
+        for( const auto &drawable: node->instancedDrawables() ) {
+            GeometryPtr mesh = drawable->geometry() ;
+            if ( !mesh ) continue ;
+
+            const Material *mat = drawable->material() ? drawable->material().get() : default_material_.get() ;
+            add(mat, mesh->hasSkeleton(), true, drawable->hasInstanceColors()) ;
+        }
     }
+
+    for( const MaterialProgramPtr &prog: programs ) {
+        if ( async_compile_ && OpenGLShaderProgram::parallelCompileSupported() ) {
+            if ( !prog->isReady() ) pending_programs_.push_back(prog) ;
+        } else
+            prog->wait() ;
+    }
+}
+
+// main texture of the material, used to group draw calls
+
+static const Texture2D *materialTexture(const Material *mat) {
+    if ( const PhongMaterial *m = dynamic_cast<const PhongMaterial *>(mat) )
+        return m->diffuseTexture() ;
+    else if ( const ConstantMaterial *m = dynamic_cast<const ConstantMaterial *>(mat) )
+        return m->texture() ;
+    else
+        return nullptr ;
+}
+
+void Renderer::init() {
+    loadGL() ;
 }
 
 Renderer::~Renderer() {
 
 }
 
+// Items that hide whatever lies behind them, i.e. solid triangles tested against the depth buffer and drawn with
+// full opacity. Every fragment they leave in the depth pre-pass is then shaded by the color pass.
+
+static bool isOpaque(const Material *mat, const Geometry &geom, bool instance_colors) {
+    // instance colors may carry their own alpha
+    if ( geom.ptype() != Geometry::Triangles || !mat->hasDepthTest() || instance_colors ) return false ;
+
+    if ( const PhongMaterial *m = dynamic_cast<const PhongMaterial *>(mat) )
+        return m->opacity() >= 1.0f ;
+    else if ( const ConstantMaterial *m = dynamic_cast<const ConstantMaterial *>(mat) )
+        return !m->hasTexture() && m->color()[3] >= 1.0f ;
+    else if ( const PerVertexColorMaterial *m = dynamic_cast<const PerVertexColorMaterial *>(mat) )
+        return m->opacity() >= 1.0f ;
+    else
+        return false ;
+}
+
 void Renderer::initState(const Material *mat) {
 
-    glDepthFunc(GL_LEQUAL);
+    state_.frontFace(GL_CCW) ;
+    state_.enable(GL_BLEND);
+
+    // antialiased lines scale the alpha of all outputs, which is undefined for the integer id target of captures
+    state_.setCapability(GL_LINE_SMOOTH, capture_ == nullptr) ;
+    state_.lineWidth(1.0) ;
+
+    setCullMode(mat->side()) ;
 
-    glFrontFace(GL_CCW) ;
-    glEnable (GL_BLEND);
+    state_.setCapability(GL_DEPTH_TEST, mat->hasDepthTest()) ;
 
-    glEnable(GL_LINE_SMOOTH) ;
-    glLineWidth(1.0) ;
+    state_.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
 
-    switch ( mat->side() ) {
+void Renderer::setCullMode(Material::Side side) {
+    switch ( side ) {
     case Material::Side::Front:
-        glEnable(GL_CULL_FACE) ;
-        glCullFace(GL_BACK) ;
+        state_.enable(GL_CULL_FACE) ;
+        state_.cullFace(GL_BACK) ;
         break ;
     case Material::Side::Back:
-        glEnable(GL_CULL_FACE) ;
-        glCullFace(GL_FRONT) ;
+        state_.enable(GL_CULL_FACE) ;
+        state_.cullFace(GL_FRONT) ;
         break ;
     case Material::Side::Both:
-        glDisable(GL_CULL_FACE) ;
+        state_.disable(GL_CULL_FACE) ;
         break ;
     }
-
-    if ( mat->hasDepthTest() )
-        glEnable(GL_DEPTH_TEST) ;
-    else
-        glDisable(GL_DEPTH_TEST) ;
-
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void Renderer::updateShadows(LightData &ld) {
+void Renderer::updateShadows(const FrameContext &frame, LightData &ld) {
 
     const auto light = ld.light_ ;
 
     if ( const DirectionalLight *dl = dynamic_cast<const DirectionalLight *>(light.get()) ) {
-        Matrix4f lightProjection = dl->shadowCamera().getProjectionMatrix() ;
-        Matrix4f lightView = lookAt(dl->position(), dl->target(), Vector3f(0.0, 1.0, 0.0));
+        if ( dl->shadowCascades() == 0 || !computeCascades(frame, *dl, ld) ) {
+            Matrix4f lightProjection = dl->shadowCamera().getProjectionMatrix() ;
+            Matrix4f lightView = lookAt(dl->position(), dl->target(), Vector3f(0.0, 1.0, 0.0));
 
-        ld.ls_mat_ = lightProjection * lightView;
-
-        renderShadowMap(ld);
+            ld.ls_mats_.assign(1, lightProjection * lightView) ;
+            ld.cascade_splits_.setConstant(std::numeric_limits<float>::max()) ;
+        }
     } else if ( const SpotLight *sl = dynamic_cast<const SpotLight *>(light.get()) ) {
         Matrix4f lightProjection = sl->shadowCamera().getProjectionMatrix() ;
         Matrix4f lightView = lookAt(sl->position(), {0, 0, 0}, Vector3f(0.0, 1.0, 0.0));
 
-        ld.ls_mat_ = lightProjection * lightView;
+        ld.ls_mats_.assign(1, lightProjection * lightView) ;
+    } else
+        return ;
+
+    // the map of the previous frame is still valid if neither the light nor the casters have changed
+
+    size_t key = shadowKey(ld) ;
 
-        renderShadowMap(ld);
+    if ( ld.shadow_valid_ && key == ld.shadow_key_ ) {
+        ++stats_.shadow_maps_cached_ ;
+        return ;
     }
+
+    // passes are named after the index of the light in the frame
+
+    size_t index = std::find(frame.lights_.begin(), frame.lights_.end(), &ld) - frame.lights_.begin() ;
+    FrameProfiler::Scope pass(profiler_, "shadow " + std::to_string(index)) ;
+
+    for( uint32_t layer = 0 ; layer < ld.ls_mats_.size() ; layer++ )
+        renderShadowMap(frame, ld, layer);
+
+    ld.shadow_key_ = key ;
+    ld.shadow_valid_ = true ;
 }
 
-void Renderer::renderShadowMap(const LightData &sd) {
+// Split the view frustum along the depth axis and fit an orthographic light volume to each slice. Each volume is
+// the bounding sphere of the slice, so that its size does not change when the camera rotates, with the center
+// snapped to the texel grid of the map so that the shadow edges do not shimmer when the camera moves. The near
+// plane is pulled towards the light to include all casters of the scene. Returns false if the camera type
+// is not supported.
+
+bool Renderer::computeCascades(const FrameContext &frame, const DirectionalLight &dl, LightData &ld) {
+    float znear, zfar ;
+
+    if ( const PerspectiveCamera *pc = dynamic_cast<const PerspectiveCamera *>(frame.cam_.get()) ) {
+        znear = pc->zNear() ; zfar = pc->zFar() ;
+    } else if ( const OrthographicCamera *oc = dynamic_cast<const OrthographicCamera *>(frame.cam_.get()) ) {
+        znear = oc->znear() ; zfar = oc->zfar() ;
+    } else
+        return false ;
+
+    const uint32_t n_cascades = dl.shadowCascades() ;
+    const float lambda = dl.cascadeSplitLambda() ;
+    const float max_dist = ( dl.shadowDistance() > 0 ) ? std::min(dl.shadowDistance(), zfar) : zfar ;
+
+    // corners of the near and far planes of the view frustum in world space
+
+    Matrix4f inv_vp = ( perspective_ * proj_ ).inverse() ;
+    Vector3f near_corners[4], far_corners[4] ;
+
+    for( int k=0 ; k<4 ; k++ ) {
+        float x = ( k & 1 ) ? 1 : -1, y = ( k & 2 ) ? 1 : -1 ;
+        Vector4f pn = inv_vp * Vector4f(x, y, -1, 1) ;
+        Vector4f pf = inv_vp * Vector4f(x, y, 1, 1) ;
+        near_corners[k] = pn.head<3>() / pn.w() ;
+        far_corners[k] = pf.head<3>() / pf.w() ;
+    }
 
-    sd.shadow_map_->bind();
+    // rotation only view looking along the light direction
 
-    glViewport(0, 0, shadow_map_width_, shadow_map_height_);
+    Vector3f dir = ( dl.target() - dl.position() ).normalized() ;
+    Vector3f up = ( std::fabs(dir.y()) > 0.99f ) ? Vector3f(1, 0, 0) : Vector3f(0, 1, 0) ;
+    Matrix4f light_view = lookAt(Vector3f(Vector3f::Zero()), dir, up) ;
 
-    sd.shadow_map_->bindTexture(GL_TEXTURE0) ;
+    // closest point of the scene to the light
 
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glCullFace(GL_FRONT);
+    BoundingBox scene_bounds ;
+    for( const BoundingBox &box: frame.bounds_ )
+        scene_bounds.extend(box) ;
 
-    shadow_map_shader_->use() ;
-    shadow_map_shader_->setUniform("lightSpaceMatrix", sd.ls_mat_);
+    float scene_near = std::numeric_limits<float>::max() ;
 
-    for ( const ConstNodePtr &node: scene_->getNodesRecursive() ) {
-        for( const auto &dr: node->drawables() ) {
-            GeometryPtr geom = dr.geometry() ;
+    if ( !scene_bounds.empty() ) {
+        BoundingBox lbox = scene_bounds.transformed(Affine3f(light_view)) ;
+        scene_near = -lbox.max_.z() ;
+    }
 
-            if ( !geom || !geom->castsShadows()) continue ;
+    const float map_size = ld.shadow_map_->width() ;
 
-            const MeshData *data = meshes_.fetch(geom.get()) ;
+    ld.ls_mats_.clear() ;
+    ld.cascade_splits_.setZero() ;
 
-            if ( !data ) continue ;
+    float split_near = znear ;
 
-            shadow_map_shader_->setUniform("model", node->globalTransform().matrix()) ;
-            drawMeshData(*data, geom, true) ;
+    for( uint32_t i=0 ; i<n_cascades ; i++ ) {
+        // practical split scheme: blend of logarithmic and uniform partitions
+
+        float t = ( i + 1 ) / float(n_cascades) ;
+        float split_far = lambda * znear * std::pow(max_dist / znear, t) + ( 1 - lambda ) * ( znear + ( max_dist - znear ) * t ) ;
+
+        Vector3f corners[8] ;
+        Vector3f center = Vector3f::Zero() ;
+
+        for( int k=0 ; k<4 ; k++ ) {
+            Vector3f edge = far_corners[k] - near_corners[k] ;
+            corners[k] = near_corners[k] + edge * ( split_near - znear ) / ( zfar - znear ) ;
+            corners[k+4] = near_corners[k] + edge * ( split_far - znear ) / ( zfar - znear ) ;
+            center += corners[k] + corners[k+4] ;
         }
-    }
 
-    sd.shadow_map_->unbind(default_fbo_) ;
-}
+        center /= 8 ;
 
-void Renderer::render(const NodePtr &scene, const CameraPtr &cam, bool cb) {
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &default_fbo_);
+        float radius = 0 ;
+        for( const Vector3f &c: corners )
+            radius = std::max(radius, ( c - center ).norm()) ;
 
-    scene_ = scene ;
-    // render background
+        // quantize the radius so that round-off does not change the projection from frame to frame
+        radius = std::ceil(radius * 16.0f) / 16.0f ;
 
-    meshes_.flush() ;
+        Vector3f lc = ( light_view * center.homogeneous() ).head<3>() ;
 
-    Vector4f bg_clr = cam->bgColor() ;
+        float texel = 2 * radius / map_size ;
+        lc.x() = std::floor(lc.x() / texel) * texel ;
+        lc.y() = std::floor(lc.y() / texel) * texel ;
 
-    if ( cb ) {
-        glClearColor(bg_clr.x(), bg_clr.y(), bg_clr.z(), bg_clr.w()) ;
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-    }
+        float cnear = std::min(-lc.z() - radius, scene_near) ;
+        float cfar = -lc.z() + radius ;
 
-    // setup camera matrices
+        Matrix4f light_proj = ortho(lc.x() - radius, lc.x() + radius, lc.y() - radius, lc.y() + radius, cnear, cfar) ;
 
-    perspective_ = cam->getProjectionMatrix() ;
+        ld.ls_mats_.push_back(light_proj * light_view) ;
+        ld.cascade_splits_[i] = split_far ;
 
-    proj_ = cam->getViewMatrix() ;
+        split_near = split_far ;
+    }
 
-    renderScene(cam) ;
+    for( uint32_t i=n_cascades ; i<DirectionalLight::MAX_SHADOW_CASCADES ; i++ )
+        ld.cascade_splits_[i] = ld.cascade_splits_[n_cascades-1] ;
 
-    //  glFlush() ;
+    return true ;
 }
 
-void Renderer::renderText(const std::string &text, float x, float y, const Font &font, const Vector3f &clr) {
-/*    if ( text.empty() ) return ;
-
-    GLint viewport[4];
-    glGetIntegerv( GL_VIEWPORT, viewport );
+static void hashCombine(size_t &seed, size_t v) {
+    seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2) ;
+}
 
-    OpenGLText ti(text, font, clr) ;
-    ti.render(x, viewport[3] - y) ;
-    */
+static size_t hashMatrix(const Matrix4f &m) {
+    return std::hash<std::string_view>()(std::string_view((const char *)m.data(), sizeof(float) * 16)) ;
 }
 
-Vector2f Renderer::project(const Vector3f &pos) {
-    Vector3f p = Affine3f(perspective_ * proj_) * pos ;
+// Key of everything the shadow map depends on: the light space matrices and the scene with its revision, which
+// changes whenever a node is transformed or the vertices of a geometry are modified (see sceneRevision). This
+// keeps the check constant time instead of visiting the casters of each light every frame.
 
-    GLint vp[4] ;
-    glGetIntegerv (GL_VIEWPORT, vp) ;
+size_t Renderer::shadowKey(const LightData &ld) const {
+    size_t key = 0 ;
 
-    float xn = p.x()/p.z(), yn = p.y()/p.z() ;
-    float x = (xn + 1.0) * (vp[2]/2.0) + vp[0] ;
-    float y = (yn + 1.0) * (vp[3]/2.0) + vp[1];
+    for( const Matrix4f &m: ld.ls_mats_ )
+        hashCombine(key, hashMatrix(m)) ;
 
-    return { x, vp[3] - y } ;
+    hashCombine(key, (size_t)scene_.get()) ;
+    hashCombine(key, sceneRevision()) ;
+
+    return key ;
 }
 
+void Renderer::renderShadowMap(const FrameContext &frame, const LightData &sd, uint32_t layer) {
 
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
+    ++stats_.shadow_passes_ ;
 
-void Renderer::renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
+    const Matrix4f &ls_mat = sd.ls_mats_[layer] ;
 
+    sd.shadow_map_->bind(layer);
 
-void Renderer::renderShadowDebug(const LightData &sd) {
+    // programs and meshes created since the previous pass have changed the bindings
+    state_.invalidateBindings() ;
 
-    shadow_map_debug_shader_->use() ;
-    shadow_map_debug_shader_->setUniform("depthMap", 0);
-    shadow_map_debug_shader_->setUniform("near_plane", -10.f) ;
-    shadow_map_debug_shader_->setUniform("far_plane", 7.0f) ;
+    state_.viewport(0, 0, sd.shadow_map_->width(), sd.shadow_map_->height());
 
-    sd.shadow_map_->bindTexture(GL_TEXTURE0) ;
-    renderQuad() ;
-}
+    state_.bindTexture(0, sd.shadow_map_->target(), sd.shadow_map_->texture()) ;
 
-void Renderer::renderScene(const CameraPtr &cam) {
-    for ( ConstNodePtr node: scene_->getOrderedNodes() ) {
-        for( const auto &drawable: node->drawables() ) {
-            GeometryPtr mesh = drawable.geometry() ;
-            if ( !mesh ) continue ;
+    // without depth test nothing is written to the map
+    state_.enable(GL_DEPTH_TEST) ;
+    state_.depthMask(GL_TRUE) ;
+    state_.enable(GL_CULL_FACE) ;
 
-            // prefetch fetch vbo
-            meshes_.fetch(mesh.get()) ;
+    glClear(GL_DEPTH_BUFFER_BIT);
+    state_.cullFace(GL_FRONT);
 
-            if ( !node->isVisible() ) continue  ;
-            render(cam, drawable, node->globalTransform() ) ;
-        }
+    // casters between the light and the near plane of a cascade are flattened on it instead of being clipped
+    state_.setCapability(GL_DEPTH_CLAMP, sd.shadow_map_->layers() > 0) ;
+
+    // nodes outside the light volume cannot cast shadows on the map
+
+    Frustum frustum(ls_mat) ;
+
+    std::vector<bool> culled(frame.nodes_.size()) ;
+
+    for( size_t i=0 ; i<frame.nodes_.size() ; i++ ) {
+        culled[i] = !frustum.intersects(frame.bounds_[i]) ;
+        if ( culled[i] )
+            stats_.shadow_drawables_culled_ += frame.nodes_[i]->drawables().size() + frame.nodes_[i]->instancedDrawables().size() ;
     }
-}
 
+    OpenGLShaderProgram *current_shader = nullptr ;
 
-LightData &Renderer::getLightData(const LightPtr &l) {
+    for ( size_t i=0 ; i<frame.nodes_.size() ; i++ ) {
+        if ( culled[i] ) continue ;
 
-    LightData &data = light_data_[l] ;
+        for( const auto &dr: frame.nodes_[i]->drawables() ) {
+            GeometryPtr geom = dr.geometry() ;
 
-    initShadowMapRenderer();
+            if ( !geom || !geom->castsShadows()) continue ;
 
-    if ( !data.shadow_map_ ) {
-        data.shadow_map_.reset(new ShadowMap()) ;
-        data.shadow_map_->init(shadow_map_width_, shadow_map_height_) ;
-        data.shadow_map_->unbind(default_fbo_);
-    }
+            // uploading the mesh binds its vertex array
+            const MeshData *data = meshes_.fetch(geom.get()) ;
+            state_.invalidateVertexArray() ;
 
-    return data ;
-}
+            if ( !data ) continue ;
 
-std::vector<LightData *> Renderer::getLights() {
-    std::vector<LightData *> lights ;
-    for ( NodePtr &node: scene_->getNodesRecursive() ) {
-        LightPtr l = node->light() ;
-        if ( l ) {
-            LightData &ld = getLightData(l) ;
-            ld.light_ = l ;
-            ld.mat_ = node->globalTransform() ;
+            // skinned meshes are posed with the palette of the frame as in the color pass, unless they have been
+            // posed already by skinMeshes
 
-            if ( l->castsShadows() ) {
-               updateShadows(ld) ;
+            bool pre_skinned = isPreSkinned(*geom) ;
+            auto pose = geom->hasSkeleton() && !pre_skinned ? frame.bone_offsets_.find(geom.get()) : frame.bone_offsets_.end() ;
+            bool skinned = pose != frame.bone_offsets_.end() ;
+
+            OpenGLShaderProgram *shader = skinned ? shadow_map_skinned_shader_.get() : shadow_map_shader_.get() ;
+
+            if ( shader != current_shader ) {
+                state_.useProgram(shader->handle()) ;
+                shader->setUniform("lightSpaceMatrix", ls_mat);
+                current_shader = shader ;
             }
 
-            lights.push_back(&ld) ;
+            if ( skinned )
+                shader->setUniform("g_bone_offset", pose->second) ;
+
+            shader->setUniform("model", frame.transforms_[i].matrix()) ;
+            state_.bindVertexArray(pre_skinned ? data->skinned_vao_ : data->vao_) ;
+            drawMeshData(*data, geom, true) ;
         }
     }
 
-    return lights ;
-}
+    bool instanced_shader_bound = false ;
 
-void Renderer::render(const CameraPtr &cam, const Drawable &dr, const Affine3f &mat)
-{
-    GeometryPtr mesh = dr.geometry() ;
-    if ( !mesh ) return ;
+    for ( size_t i=0 ; i<frame.nodes_.size() ; i++ ) {
+        if ( culled[i] ) continue ;
 
-    // fetch vbo
-    const MeshData *data = meshes_.fetch(mesh.get()) ;
+        for( const auto &dr: frame.nodes_[i]->instancedDrawables() ) {
+            GeometryPtr geom = dr->geometry() ;
 
-    // get material
-    MaterialPtr material = dr.material() ;
+            if ( !geom || !geom->castsShadows() || dr->numInstances() == 0 ) continue ;
+
+            const MeshData *data = meshes_.fetch(geom.get()) ;
+            const InstanceData *idata = instances_.fetch(dr.get()) ;
+            state_.invalidateVertexArray() ;
 
-    if ( !material )
-        material = default_material_ ;
+            if ( !data ) continue ;
 
-    MaterialProgramPtr prog ;
+            if ( !instanced_shader_bound ) {
+                state_.useProgram(shadow_map_instanced_shader_->handle()) ;
+                shadow_map_instanced_shader_->setUniform("lightSpaceMatrix", ls_mat);
+                instanced_shader_bound = true ;
+            }
 
-    // collect lights and associated data
+            shadow_map_instanced_shader_->setUniform("model", frame.transforms_[i].matrix()) ;
+            state_.bindVertexArray(data->vao_) ;
+            data->bindInstanceAttributes(idata->buffer_, 0, -1) ;
+            drawMeshData(*data, geom, true, idata->count_) ;
+        }
+    }
 
-    std::vector<LightData *> lights = getLights() ;
+    state_.disable(GL_DEPTH_CLAMP) ;
 
-    // create or load program for material
-    prog = instantiateMaterial(material.get(), lights, mesh->hasSkeleton()) ;
+    sd.shadow_map_->unbind(default_fbo_) ;
+}
 
-    // init GL state
+void Renderer::beginFrame(const NodePtr &scene) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &default_fbo_);
 
-    initState(material.get()) ;
+    scene_ = scene ;
+    stats_ = FrameStats() ;
 
-    // apply uniforms to material
-    prog->use() ;
-    prog->applyParams(material) ;
-    prog->applyTransform(perspective_, proj_, mat.matrix()) ;
-    prog->applyLights(lights) ;
-    prog->bindTextures(material, [this](const Texture2D *t) {
-        return fetchTextureData(t) ;
-    }) ;
+    // the application may have changed any state since the last frame
+    state_.invalidate() ;
+    state_.resetCounters() ;
 
-    if ( mesh && mesh->hasSkeleton() )
-        setPose(mesh, prog) ;
+    profiler_.beginFrame() ;
+    FrameProfiler::resetUploadedBytes() ;
+    occlusion_.beginFrame() ;
 
-    // do rendering
+    meshes_.flush() ;
+    meshes_.beginFrame() ;
+    instances_.flush() ;
 
-    const Viewport &vp = cam->getViewport() ;
-    glViewport(vp.x_, vp.y_, vp.width_, vp.height_);
+    pollPrograms() ;
+}
 
-#if 0
+// setup camera matrices
 
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, data.tf_);
+void Renderer::setCamera(FrameContext &frame, const CameraPtr &cam, const Viewport &vp) {
+    frame.cam_ = cam ;
+    frame.vp_ = vp ;
 
-    glEnable(GL_RASTERIZER_DISCARD);
+    perspective_ = cam->getProjectionMatrix() ;
 
-    glBeginTransformFeedback(GL_TRIANGLES);
+    proj_ = cam->getViewMatrix() ;
 
-    drawMeshData(*data, geom->geometry()) ;
+    updateFrameBlock() ;
 
-    glEndTransformFeedback();
+    ++stats_.views_ ;
+}
 
-    glDisable(GL_RASTERIZER_DISCARD);
+void Renderer::endFrame(const FrameContext &frame) {
+    readSkinnedVertices(frame) ;
 
-    vector<GLfloat> fdata(36, 0) ;
+    meshes_.endFrame() ;
 
-    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 36*sizeof(GLfloat), fdata.data());
+    state_.bindVertexArray(0) ;
+    state_.useProgram(0) ;
+    // the color pass leaves depth writes off after opaque items, which would also mask glClear
+    state_.depthMask(GL_TRUE) ;
 
-    glBindVertexArray(0) ;
-#else
-    drawMeshData(*data, mesh, false) ;
+    stats_.gl_calls_issued_ = state_.callsIssued() ;
+    stats_.gl_calls_skipped_ = state_.callsSkipped() ;
+    stats_.program_switches_ = state_.programSwitches() ;
+    stats_.texture_binds_ = state_.textureBinds() ;
+    stats_.uploaded_bytes_ = FrameProfiler::uploadedBytes() ;
 
-#endif
+    RenderTargetPool::Counters targets = render_targets_.endFrame() ;
+    stats_.render_targets_allocated_ = targets.allocated_ ;
+    stats_.render_targets_reused_ = targets.reused_ ;
+    stats_.render_targets_freed_ = targets.freed_ ;
 
-/*
-    glBlendFunc(GL_ONE, GL_ZERO);
-          glViewport(0, 0, 256, 256);
-       //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-         renderShadowDebug(*lights[1]) ;
-      glBindTexture(GL_TEXTURE_2D, 0);
-*/
-    glUseProgram(0) ;
+    profiler_.endFrame(stats_.passes_) ;
 }
 
-void Renderer::initShadowMapRenderer() {
-    if ( shadow_map_shader_ ) return ;
-
-    shadow_map_shader_.reset(new OpenGLShaderProgram) ;
-    shadow_map_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_map_shader_vs") ;
-    shadow_map_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
-    shadow_map_shader_->link() ;
+void Renderer::render(const NodePtr &scene, const CameraPtr &cam, bool cb) {
+    beginFrame(scene) ;
 
-    shadow_map_debug_shader_.reset(new OpenGLShaderProgram) ;
-    shadow_map_debug_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_debug_shader_vs") ;
-    shadow_map_debug_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_debug_shader_fs") ;
-    shadow_map_debug_shader_->link() ;
-}
+    // render background
 
+    Vector4f bg_clr = cam->bgColor() ;
 
-void Renderer::setPose(const GeometryPtr &mesh, const MaterialProgramPtr &mat) {
-    const auto &skeleton = mesh->skeleton() ;
-    for( unsigned int i=0 ; i<skeleton.size() ; i++ ) {
-        const Geometry::Bone &b = skeleton[i] ;
-        mat->applyBoneTransform(i, ( b.node_->globalTransform() * b.offset_).matrix()) ;
+    if ( cb ) {
+        glClearColor(bg_clr.x(), bg_clr.y(), bg_clr.z(), bg_clr.w()) ;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     }
-}
 
-void Renderer::drawMeshData(const MeshData &data, GeometryPtr mesh, bool solid) {
+    // gather lights and render shadow maps once for the whole frame
 
-    glBindVertexArray(data.vao_);
+    FrameContext frame ;
+    setCamera(frame, cam, cam->getViewport()) ;
 
-    if ( mesh ) {
-        if ( mesh->ptype() == Geometry::Triangles ) {
-            if ( data.index_ ) {
-                // bind index buffer if you want to render indexed data
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.index_);
-                // indexed draw call
-                glDrawElements(GL_TRIANGLES, data.indices_, GL_UNSIGNED_INT, nullptr);
-            }
-            else
-                glDrawArrays(GL_TRIANGLES, 0, data.elem_count_) ;
-        }
-        else if ( mesh->ptype() == Geometry::Lines && !solid ) {
-            if ( data.index_ ) {
-                // bind index buffer if you want to render indexed data
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.index_);
-                // indexed draw call
-                glDrawElements(GL_LINES, data.indices_, GL_UNSIGNED_INT, nullptr);
-            }
-            else
-                glDrawArrays(GL_LINES, 0, data.elem_count_) ;
-        }
-        else if ( mesh->ptype() == Geometry::Points ) {
-            glDrawArrays(GL_POINTS, 0, data.elem_count_) ;
-        }
+    setupFrame(frame) ;
 
-    } else {
-        glDrawArrays(GL_TRIANGLES, 0, data.elem_count_) ;
-    }
+    renderScene(frame) ;
 
-    glBindVertexArray(0) ;
-}
+    endFrame(frame) ;
 
+    //  glFlush() ;
 }
 
-Renderer::Renderer(): impl_(new impl::Renderer()) {
+// The capture framebuffer is bound before rendering, hence it is taken as the default framebuffer of the frame
 
-}
+void Renderer::capture(const NodePtr &scene, const CameraPtr &cam, Capture &result) {
+    GLint fbo ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo) ;
 
-Renderer::~Renderer() {}
+    result.drawables_.clear() ;
 
-void Renderer::init() {
-    impl_->init() ;
-}
+    capture_ = &result ;
+    capture_target_.begin(cam->getViewport(), cam->bgColor()) ;
+    render(scene, cam, false) ;
+    capture_target_.read(result) ;
+    capture_ = nullptr ;
 
-void Renderer::render(const NodePtr &scene, const CameraPtr &cam, bool clear_buffers) {
-    impl_->render(scene, cam, clear_buffers) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo) ;
 }
 
-void Renderer::renderText(const string &text, float x, float y, const Font &font, const Vector3f &clr)
+// All views form a single frame: the frame context of the first view, i.e. the scene walk, the transforms, the
+// skinned meshes and the shadow maps, is kept for the others, which only replace the camera matrices and the
+// cascaded shadow maps. Each view is drawn in a tile of the atlas.
+
+void Renderer::renderViews(const NodePtr &scene, const std::vector<CameraPtr> &cams, std::vector<Image> &images) {
+    images.assign(cams.size(), Image()) ;
+
+    // cameras with an empty viewport are skipped and keep a null image
+
+    auto isEmpty = [](const CameraPtr &cam) {
+        return cam->getViewport().width_ == 0 || cam->getViewport().height_ == 0 ;
+    } ;
+
+    GLsizei tile_width = 0, tile_height = 0 ;
+    size_t first = cams.size(), views = 0 ;
+    for( size_t i=0 ; i<cams.size() ; i++ ) {
+        if ( isEmpty(cams[i]) ) continue ;
+        tile_width = std::max<GLsizei>(tile_width, cams[i]->getViewport().width_) ;
+        tile_height = std::max<GLsizei>(tile_height, cams[i]->getViewport().height_) ;
+        first = std::min(first, i) ;
+        ++views ;
+    }
+
+    if ( views == 0 ) return ;
+
+    GLint fbo ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo) ;
+
+    view_atlas_.begin(tile_width, tile_height, views) ;
+
+    // the visibility of the nodes in the previous frame says nothing about another camera
+    bool occlusion_culling = occlusion_culling_ ;
+    occlusion_culling_ = false ;
+
+    // the part of its tile covered by a camera
+    auto tileViewport = [this](size_t slot, const CameraPtr &cam) {
+        Viewport vp = view_atlas_.tile(slot) ;
+        vp.width_ = cam->getViewport().width_ ;
+        vp.height_ = cam->getViewport().height_ ;
+        return vp ;
+    } ;
+
+    beginFrame(scene) ;
+
+    FrameContext frame ;
+    setCamera(frame, cams[first], tileViewport(0, cams[first])) ;
+    setupFrame(frame) ;
+
+    {
+        FrameProfiler::Scope pass(profiler_, "views") ;
+
+        std::vector<ViewAtlas::View> page ;
+        Vector4f page_bg ;
+
+        for( size_t i=first ; i<cams.size() ; i++ ) {
+            const CameraPtr &cam = cams[i] ;
+
+            if ( isEmpty(cam) ) continue ;
+
+            if ( i > first ) {
+                setCamera(frame, cam, tileViewport(page.size(), cam)) ;
+                updateViewShadows(frame) ;
+            }
+
+            const Viewport &vp = frame.vp_ ;
+            const Vector4f bg_clr = cam->bgColor() ;
+
+            // a page is cleared at once with the background of its first view, which is much cheaper than clearing
+            // each tile, only tiles of views with another background are cleared again
+
+            if ( page.empty() ) {
+                page_bg = bg_clr ;
+                state_.depthMask(GL_TRUE) ;
+                glClearColor(bg_clr.x(), bg_clr.y(), bg_clr.z(), bg_clr.w()) ;
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) ;
+            } else if ( bg_clr != page_bg ) {
+                state_.enable(GL_SCISSOR_TEST) ;
+                glScissor(vp.x_, vp.y_, vp.width_, vp.height_) ;
+                glClearColor(bg_clr.x(), bg_clr.y(), bg_clr.z(), bg_clr.w()) ;
+                glClear(GL_COLOR_BUFFER_BIT) ;
+                state_.disable(GL_SCISSOR_TEST) ;
+            }
+
+            renderScene(frame) ;
+
+            // the GPU starts on the view while the next one is prepared, software rasterizers also bin the commands
+            // of a single view much more efficiently than those of a whole page
+            glFlush() ;
+
+            page.push_back({&images[i], (GLsizei)vp.width_, (GLsizei)vp.height_}) ;
+
+            if ( page.size() == view_atlas_.tiles() ) {
+                view_atlas_.read(page) ;
+                page.clear() ;
+            }
+        }
+
+        if ( !page.empty() ) view_atlas_.read(page) ;
+
+        view_atlas_.finish() ;
+    }
+
+    endFrame(frame) ;
+
+    occlusion_culling_ = occlusion_culling ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo) ;
+}
+
+// All targets are acquired before the frame begins, since creating them changes GL state behind state_. The scene
+// target is taken as the default framebuffer of the frame. The supersampling factor is lowered when the scene target
+// would exceed the maximum renderbuffer or texture size. The rows are flipped on the GPU, by the downsampler or by a
+// last blit, so that the result is read back synchronously straight into the image.
+
+void Renderer::renderImage(const NodePtr &scene, const CameraPtr &cam, Image &image, uint32_t samples,
+                           uint32_t supersampling, DownsampleFilter filter) {
+    const GLsizei width = cam->getViewport().width_, height = cam->getViewport().height_ ;
+
+    if ( width == 0 || height == 0 ) {
+        image = Image() ;
+        return ;
+    }
+
+    GLint fbo ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo) ;
+
+    GLint max_size, max_texture_size, max_samples ;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size) ;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size) ;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples) ;
+    max_size = std::min(max_size, max_texture_size) ;
+
+    const GLsizei factor = std::max<GLsizei>(1, std::min<GLsizei>(supersampling, max_size / std::max(width, height))) ;
+    const GLsizei scene_width = factor * width, scene_height = factor * height ;
+
+    samples = std::min<uint32_t>(samples, max_samples) ;
+
+    RenderTargetDesc desc ;
+    desc.width_ = scene_width ;
+    desc.height_ = scene_height ;
+    desc.depth_format_ = GL_DEPTH_COMPONENT24 ;
+    desc.samples_ = samples ;
+
+    std::vector<RenderTarget *> targets ;
+
+    RenderTarget *scene_target = render_targets_.acquire(desc) ;
+    targets.push_back(scene_target) ;
+
+    desc.depth_format_ = GL_NONE ;
+    desc.samples_ = 0 ;
+
+    RenderTarget *resolved = scene_target, *tmp = nullptr ;
+
+    if ( samples > 0 ) {
+        resolved = render_targets_.acquire(desc) ;
+        targets.push_back(resolved) ;
+    }
+
+    if ( factor > 1 ) {
+        desc.width_ = width ;
+        desc.color_format_ = GL_RGBA16F ;
+        tmp = render_targets_.acquire(desc) ;
+        targets.push_back(tmp) ;
+    }
+
+    desc.width_ = width ;
+    desc.height_ = height ;
+    desc.color_format_ = GL_RGBA8 ;
+
+    RenderTarget *result = render_targets_.acquire(desc) ;
+    targets.push_back(result) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_target->fbo_) ;
+
+    beginFrame(scene) ;
+
+    const Vector4f bg_clr = cam->bgColor() ;
+    glClearColor(bg_clr.x(), bg_clr.y(), bg_clr.z(), bg_clr.w()) ;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) ;
+
+    Viewport vp ;
+    vp.width_ = scene_width ;
+    vp.height_ = scene_height ;
+
+    FrameContext frame ;
+    setCamera(frame, cam, vp) ;
+    setupFrame(frame) ;
+    renderScene(frame) ;
+
+    if ( samples > 0 ) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_target->fbo_) ;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolved->fbo_) ;
+        glBlitFramebuffer(0, 0, scene_width, scene_height, 0, 0, scene_width, scene_height, GL_COLOR_BUFFER_BIT, GL_NEAREST) ;
+    }
+
+    if ( factor > 1 ) {
+        FrameProfiler::Scope pass(profiler_, "downsample") ;
+        downsampler_.run(*resolved, *tmp, *result, factor, filter == DownsampleFilter::Lanczos, true, state_) ;
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolved->fbo_) ;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, result->fbo_) ;
+        glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST) ;
+    }
+
+    endFrame(frame) ;
+
+    unsigned char *bytes = new unsigned char [size_t(width) * height * 4] ;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, result->fbo_) ;
+    glReadBuffer(GL_COLOR_ATTACHMENT0) ;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, bytes) ;
+
+    image = Image(bytes, ImageFormat::rgba32, width, height) ;
+
+    for( RenderTarget *target: targets )
+        render_targets_.release(target) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo) ;
+}
+
+// The pick window is rendered as a frame of its own with the capture programs. The projection is narrowed to the
+// window only after setupFrame, so that frustum culling keeps just the nodes under the cursor while the shadow
+// cascades still follow the whole view. Levels of detail are turned off since primitive indices have to refer to
+// the full geometry, and occlusion culling since its queries would be issued for the window.
+
+uint64_t Renderer::requestPick(const NodePtr &scene, const CameraPtr &cam, int x, int y, int radius) {
+    GLint fbo ;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo) ;
+
+    radius = std::max(radius, 0) ;
+    const GLsizei size = 2 * radius + 1 ;
+
+    Capture ids ;
+    capture_ = &ids ;
+
+    bool occlusion_culling = occlusion_culling_ ;
+    float lod_threshold = lod_threshold_ ;
+    occlusion_culling_ = false ;
+    lod_threshold_ = 0 ;
+
+    pick_target_.begin(size) ;
+
+    beginFrame(scene) ;
+
+    Viewport vp ;
+    vp.width_ = vp.height_ = size ;
+
+    FrameContext frame ;
+    setCamera(frame, cam, vp) ;
+    setupFrame(frame) ;
+
+    // scale and shift clip space so that the window, centered on the picked pixel, covers it entirely
+
+    const float w = cam->getViewport().width_, h = cam->getViewport().height_ ;
+    const float cx = x + 0.5f, cy = h - y - 0.5f ;
+
+    Matrix4f window = Matrix4f::Identity() ;
+    window(0, 0) = w / size ;
+    window(1, 1) = h / size ;
+    window(0, 3) = ( w - 2 * cx ) / size ;
+    window(1, 3) = ( h - 2 * cy ) / size ;
+
+    const Matrix4f proj = perspective_ ;
+    perspective_ = window * proj ;
+    updateFrameBlock() ;
+
+    renderScene(frame) ;
+
+    perspective_ = proj ;
+
+    endFrame(frame) ;
+
+    capture_ = nullptr ;
+    occlusion_culling_ = occlusion_culling ;
+    lod_threshold_ = lod_threshold ;
+
+    PickRequest req ;
+    req.drawables_ = std::move(ids.drawables_) ;
+    req.proj_ = proj ;
+    req.view_ = proj_ ;
+    req.vp_ = cam->getViewport() ;
+    req.x_ = x ;
+    req.y_ = y ;
+    req.radius_ = radius ;
+
+    uint64_t ticket = pick_target_.read(std::move(req)) ;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo) ;
+
+    return ticket ;
+}
+
+// The hit point lies on the ray through the center of the pixel, at the eye depth written by the capture shader.
+// The drawable is looked up among those of its node, which may have changed since the pick was requested.
+
+static void resolvePick(const PickRequest &req, RayCastResult &result) {
+    const int size = 2 * req.radius_ + 1 ;
+    const int width = req.vp_.width_, height = req.vp_.height_ ;
+
+    // lower left pixel of the window, rows counted from the bottom
+    const int x0 = req.x_ - req.radius_, y0 = height - 1 - req.y_ - req.radius_ ;
+
+    int best = -1, best_dist = 0 ;
+
+    for( int j=0 ; j<size ; j++ ) {
+        for( int i=0 ; i<size ; i++ ) {
+            const int idx = j * size + i ;
+
+            if ( req.ids_[idx] == 0 || req.ids_[idx] > req.drawables_.size() ) continue ;
+
+            // the window may extend past the viewport, where it shows what the camera does not see
+            if ( x0 + i < 0 || x0 + i >= width || y0 + j < 0 || y0 + j >= height ) continue ;
+
+            const int dist = ( i - req.radius_ ) * ( i - req.radius_ ) + ( j - req.radius_ ) * ( j - req.radius_ ) ;
+
+            if ( best < 0 || dist < best_dist || ( dist == best_dist && req.depth_[idx] < req.depth_[best] ) ) {
+                best = idx ;
+                best_dist = dist ;
+            }
+        }
+    }
+
+    if ( best < 0 ) return ;
+
+    const CaptureId &id = req.drawables_[req.ids_[best] - 1] ;
+
+    result.node_ = id.node_ ;
+
+    GeometryPtr geom ;
+
+    if ( id.instanced_ ) {
+        result.instanced_ = id.instanced_ ;
+        result.instance_ = id.instance_ ;
+        geom = id.instanced_->geometry() ;
+    } else {
+        for( Drawable &d: id.node_->drawables() )
+            if ( &d == id.drawable_ ) result.drawable_ = &d ;
+
+        if ( result.drawable_ ) geom = result.drawable_->geometry() ;
+    }
+
+    if ( geom ) {
+        const uint32_t primitive = req.primitives_[best] ;
+        const auto &indices = geom->indices() ;
+
+        auto vertex = [&indices](uint32_t k) -> uint32_t {
+            return ( k < indices.size() ) ? indices[k] : k ;
+        } ;
+
+        if ( geom->ptype() == Geometry::Triangles ) {
+            for( uint32_t k=0 ; k<3 ; k++ )
+                result.triangle_idx_[k] = vertex(3 * primitive + k) ;
+        } else if ( geom->ptype() == Geometry::Lines ) {
+            for( uint32_t k=0 ; k<2 ; k++ )
+                result.line_idx_[k] = vertex(2 * primitive + k) ;
+        } else
+            result.point_idx_ = primitive ;
+    }
+
+    const float px = x0 + best % size + 0.5f, py = y0 + best / size + 0.5f ;
+    const float nx = 2 * px / width - 1, ny = 2 * py / height - 1 ;
+
+    const Matrix4f inv_proj = req.proj_.inverse() ;
+    const Vector4f p_near = inv_proj * Vector4f(nx, ny, -1, 1), p_far = inv_proj * Vector4f(nx, ny, 1, 1) ;
+    const Vector3f near_pt = p_near.head<3>() / p_near.w(), far_pt = p_far.head<3>() / p_far.w() ;
+
+    const float s = ( -req.depth_[best] - near_pt.z() ) / ( far_pt.z() - near_pt.z() ) ;
+    const Vector3f p = near_pt + s * ( far_pt - near_pt ) ;
+
+    result.pt_ = ( req.view_.inverse() * p.homogeneous() ).head<3>() ;
+
+    // rays of perspective cameras start at the camera position, those of orthographic cameras on the near plane
+    result.t_ = ( req.proj_(3, 3) == 0 ) ? p.norm() : ( p - near_pt ).norm() ;
+}
+
+bool Renderer::fetchPick(uint64_t ticket, RayCastResult &result, bool wait) {
+    PickRequest req ;
+    if ( !pick_target_.fetch(ticket, req, wait) ) return false ;
+
+    result = RayCastResult() ;
+    resolvePick(req, result) ;
+
+    return true ;
+}
+
+void Renderer::renderText(const std::string &text, float x, float y, const Font &font, const Vector3f &clr) {
+/*    if ( text.empty() ) return ;
+
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+
+    OpenGLText ti(text, font, clr) ;
+    ti.render(x, viewport[3] - y) ;
+    */
+}
+
+Vector2f Renderer::project(const Vector3f &pos) {
+    Vector3f p = Affine3f(perspective_ * proj_) * pos ;
+
+    GLint vp[4] ;
+    glGetIntegerv (GL_VIEWPORT, vp) ;
+
+    float xn = p.x()/p.z(), yn = p.y()/p.z() ;
+    float x = (xn + 1.0) * (vp[2]/2.0) + vp[0] ;
+    float y = (yn + 1.0) * (vp[3]/2.0) + vp[1];
+
+    return { x, vp[3] - y } ;
+}
+
+
+unsigned int quadVAO = 0;
+unsigned int quadVBO;
+
+void Renderer::renderQuad()
+{
+    if (quadVAO == 0)
+    {
+        float quadVertices[] = {
+            // positions        // texture Coords
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        };
+        // setup plane VAO
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    }
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+
+void Renderer::renderShadowDebug(const LightData &sd) {
+
+    shadow_map_debug_shader_->use() ;
+    shadow_map_debug_shader_->setUniform("depthMap", 0);
+    shadow_map_debug_shader_->setUniform("near_plane", -10.f) ;
+    shadow_map_debug_shader_->setUniform("far_plane", 7.0f) ;
+
+    sd.shadow_map_->bindTexture(GL_TEXTURE0) ;
+    renderQuad() ;
+}
+
+void Renderer::renderScene(const FrameContext &frame) {
+    GLsizeiptr object_stride ;
+
+    {
+        FrameProfiler::Scope pass(profiler_, "queue") ;
+
+        buildRenderQueue(frame) ;
+        queue_.sort() ;
+        if ( capture_ ) assignCaptureIds(frame) ;
+        batchRenderQueue(frame) ;
+        object_stride = updateObjectBlocks() ;
+    }
+
+    if ( usesDepthPrePass() ) {
+        FrameProfiler::Scope pass(profiler_, "depth prepass") ;
+        depthPrePass(frame, object_stride) ;
+    }
+
+    if ( occlusion_culling_ ) {
+        FrameProfiler::Scope pass(profiler_, "occlusion") ;
+        occlusionPass(frame) ;
+    }
+
+    FrameProfiler::Scope pass(profiler_, "opaque") ;
+    drawRenderQueue(frame, object_stride) ;
+}
+
+void Renderer::buildRenderQueue(const FrameContext &frame) {
+    queue_.clear() ;
+
+    Frustum frustum(perspective_ * proj_) ;
+
+    const Vector3f eye = proj_.inverse().block<3, 1>(0, 3) ;
+    const Viewport &vp = frame.vp_ ;
+
+    for ( size_t i=0 ; i<frame.nodes_.size() ; i++ ) {
+        const NodePtr &node = frame.nodes_[i] ;
+
+        if ( !frustum.intersects(frame.bounds_[i]) ) {
+            stats_.drawables_culled_ += node->drawables().size() + node->instancedDrawables().size() ;
+            continue ;
+        }
+
+        // drawables without depth test are never occluded
+
+        GLuint occlusion_query = 0 ;
+        bool occluded = occlusion_culling_ &&
+                occlusion_.visibility(node.get(), occlusion_query) == OcclusionCuller::Visibility::Hidden ;
+
+        for( const auto &drawable: node->drawables() ) {
+            GeometryPtr mesh = drawable.geometry() ;
+            if ( !mesh ) continue ;
+
+            // prefetch fetch vbo
+            const MeshData *data = meshes_.fetch(mesh.get()) ;
+
+            if ( !node->isVisible() ) continue  ;
+
+            MaterialPtr material = drawable.material() ;
+
+            if ( !material )
+                material = default_material_ ;
+
+            if ( occluded && material->hasDepthTest() ) {
+                ++stats_.drawables_occluded_ ;
+                continue ;
+            }
+
+            // pre-skinned meshes are drawn from the posed vertices as static meshes
+
+            bool pre_skinned = isPreSkinned(*mesh) ;
+
+            RenderItem item ;
+            item.order_ = node->order() ;
+            item.skinning_ = mesh->hasSkeleton() && !pre_skinned ;
+            item.prog_ = instantiateMaterial(material.get(), frame.params_, item.skinning_) ;
+            item.texture_ = materialTexture(material.get()) ;
+            item.material_ = material ;
+            item.vao_ = pre_skinned ? data->skinned_vao_ : data->vao_ ;
+            item.geom_ = mesh ;
+            item.data_ = data ;
+            item.transform_ = frame.transforms_[i] ;
+            item.node_index_ = i ;
+            item.drawable_ = &drawable ;
+
+            if ( !programReady(item.prog_) ) {
+                useFallbackProgram(item, false, false) ;
+                ++stats_.fallback_draws_ ;
+            }
+
+            item.opaque_ = isOpaque(item.material_.get(), *mesh, false) ;
+            if ( material->hasDepthTest() ) item.occlusion_query_ = occlusion_query ;
+
+            // the bounds of skinned meshes do not follow their pose
+            if ( !mesh->hasSkeleton() ) {
+                item.lod_ = selectLod(node.get(), *mesh, *data, item.transform_, eye, vp) ;
+                if ( item.lod_ > 0 ) ++stats_.lod_draws_ ;
+            }
+
+            queue_.add(std::move(item)) ;
+            ++stats_.drawables_drawn_ ;
+        }
+
+        for( const auto &drawable: node->instancedDrawables() ) {
+            GeometryPtr mesh = drawable->geometry() ;
+            if ( !mesh ) continue ;
+
+            const MeshData *data = meshes_.fetch(mesh.get()) ;
+            const InstanceData *idata = instances_.fetch(drawable.get()) ;
+
+            if ( !node->isVisible() || idata->count_ == 0 ) continue  ;
+
+            MaterialPtr material = drawable->material() ;
+
+            if ( !material )
+                material = default_material_ ;
+
+            if ( occluded && material->hasDepthTest() ) {
+                ++stats_.drawables_occluded_ ;
+                continue ;
+            }
+
+            bool has_colors = idata->colors_offset_ >= 0 ;
+
+            RenderItem item ;
+            item.order_ = node->order() ;
+            item.skinning_ = mesh->hasSkeleton() ;
+            item.prog_ = instantiateMaterial(material.get(), frame.params_, item.skinning_, true, has_colors) ;
+            item.texture_ = materialTexture(material.get()) ;
+            item.material_ = material ;
+            item.vao_ = data->vao_ ;
+            item.geom_ = mesh ;
+            item.data_ = data ;
+            item.transform_ = frame.transforms_[i] ;
+            item.instances_ = idata->count_ ;
+            item.instance_buffer_ = idata->buffer_ ;
+            item.instance_colors_offset_ = idata->colors_offset_ ;
+            item.node_index_ = i ;
+            item.instanced_ = drawable.get() ;
+
+            if ( !programReady(item.prog_) ) {
+                useFallbackProgram(item, true, has_colors) ;
+                ++stats_.fallback_draws_ ;
+            }
+
+            item.opaque_ = isOpaque(item.material_.get(), *mesh, has_colors) ;
+            if ( material->hasDepthTest() ) item.occlusion_query_ = occlusion_query ;
+
+            queue_.add(std::move(item)) ;
+            ++stats_.drawables_drawn_ ;
+        }
+    }
+
+    // forget the levels of geometries that were not drawn
+
+    for( auto it = lod_states_.begin() ; it != lod_states_.end() ; ) {
+        if ( !it->second.used_ ) it = lod_states_.erase(it) ;
+        else {
+            it->second.used_ = false ;
+            ++it ;
+        }
+    }
+}
+
+// The geometric error of each level is projected at the point of the bounding sphere closest to the eye. A coarser
+// level is taken only when its error falls below the threshold by the hysteresis margin, and kept while it does
+// not exceed the threshold, so that geometries close to a switching distance do not flicker between levels.
+
+uint32_t Renderer::selectLod(const Node *node, Geometry &geom, const MeshData &data, const Affine3f &tf,
+                             const Vector3f &eye, const Viewport &vp) {
+    if ( lod_threshold_ <= 0 || data.lods_.empty() ) return 0 ;
+
+    const detail::AABB box = geom.getBoundingBox() ;
+    const float scale = tf.linear().colwise().norm().maxCoeff() ;
+    const Vector3f center = tf * ( 0.5f * ( box.bounds_[0] + box.bounds_[1] ) ) ;
+    const float radius = 0.5f * ( box.bounds_[1] - box.bounds_[0] ).norm() * scale ;
+
+    // pixels per unit of the geometry, perspective_(3, 3) is 1 for orthographic projections
+
+    float pixels = perspective_(1, 1) * vp.height_ * 0.5f * scale ;
+
+    if ( perspective_(3, 3) != 1.0f ) {
+        float distance = ( center - eye ).norm() - radius ;
+        if ( distance <= 0 ) return 0 ;
+        pixels /= distance ;
+    }
+
+    LodState &state = lod_states_[std::make_pair(node, &geom)] ;
+    state.used_ = true ;
+
+    uint32_t lod = 0 ;
+
+    for( uint32_t l = 1 ; l <= data.lods_.size() ; l++ ) {
+        float threshold = ( l <= state.lod_ ) ? lod_threshold_ : lod_threshold_ * ( 1.0f - lod_hysteresis_ ) ;
+        if ( data.lods_[l - 1].error_ * pixels > threshold ) break ;
+        lod = l ;
+    }
+
+    state.lod_ = lod ;
+    return lod ;
+}
+
+// Ids are consecutive in the sorted queue, so that the runs merged by batchRenderQueue draw their instances with
+// the id of the first item plus the instance index, as instanced drawables do.
+
+void Renderer::assignCaptureIds(const FrameContext &frame) {
+    auto &table = capture_->drawables_ ;
+
+    for( RenderItem &item: queue_.items() ) {
+        item.id_ = table.size() + 1 ;
+
+        const NodePtr &node = frame.nodes_[item.node_index_] ;
+
+        if ( item.instanced_ ) {
+            auto it = std::find_if(node->instancedDrawables().begin(), node->instancedDrawables().end(),
+                                   [&item](const InstancedDrawablePtr &d) { return d.get() == item.instanced_ ; }) ;
+
+            for( GLsizei k=0 ; k<item.instances_ ; k++ ) {
+                CaptureId id ;
+                id.node_ = node ;
+                id.instanced_ = *it ;
+                id.instance_ = k ;
+                table.emplace_back(std::move(id)) ;
+            }
+        } else {
+            CaptureId id ;
+            id.node_ = node ;
+            id.drawable_ = item.drawable_ ;
+            table.emplace_back(std::move(id)) ;
+        }
+    }
+}
+
+// After sorting, drawables sharing the geometry and the material end up next to each other. Runs of such items are
+// replaced by a single instanced draw call whose instance matrices are the world transforms of the original items.
+// The instance matrices of all runs are uploaded to a single buffer.
+
+void Renderer::batchRenderQueue(const FrameContext &frame) {
+    auto &items = queue_.items() ;
+
+    std::vector<RenderItem> batched ;
+    std::vector<Matrix4f> matrices ;
+
+    auto same_batch = [](const RenderItem &a, const RenderItem &b) {
+        return a.instances_ == 0 && b.instances_ == 0 &&
+                a.order_ == b.order_ && a.prog_ == b.prog_ && a.material_ == b.material_ && a.geom_ == b.geom_ &&
+                a.occlusion_query_ == b.occlusion_query_ && a.lod_ == b.lod_ ;
+    } ;
+
+    for( size_t i=0 ; i<items.size() ; ) {
+        size_t j = i + 1 ;
+        while ( j < items.size() && same_batch(items[i], items[j]) ) ++j ;
+
+        if ( items[i].instances_ == 0 && j - i >= min_instance_batch_ ) {
+            RenderItem item = items[i] ;
+
+            // runs of items drawn with the fallback program are batched with its instanced variant
+
+            if ( item.material_ == fallback_material_ )
+                useFallbackProgram(item, true, false) ;
+            else {
+                item.prog_ = instantiateMaterial(item.material_.get(), frame.params_, item.skinning_, true, false) ;
+                if ( !programReady(item.prog_) ) useFallbackProgram(item, true, false) ;
+            }
+
+            item.instances_ = j - i ;
+            item.instance_offset_ = matrices.size() * sizeof(Matrix4f) ;
+            item.transform_ = Affine3f::Identity() ;
+
+            for( size_t k=i ; k<j ; k++ )
+                matrices.push_back(items[k].transform_.matrix()) ;
+
+            batched.emplace_back(std::move(item)) ;
+        } else {
+            for( size_t k=i ; k<j ; k++ )
+                batched.emplace_back(std::move(items[k])) ;
+        }
+
+        i = j ;
+    }
+
+    items.swap(batched) ;
+
+    if ( matrices.empty() ) return ;
+
+    batch_instances_.upload(matrices.data(), nullptr, matrices.size()) ;
+
+    for( RenderItem &item: items ) {
+        if ( item.instances_ > 0 && item.instance_buffer_ == 0 )
+            item.instance_buffer_ = batch_instances_.buffer_ ;
+    }
+}
+
+// Depth only pass over the opaque items of the queue, drawn with the shadow map shaders from the object blocks of
+// the color pass. The latter then shades each pixel covered by opaque items once, instead of once per overlapping
+// surface, by testing for equal depth.
+
+void Renderer::depthPrePass(const FrameContext &frame, GLsizeiptr object_stride) {
+    const Viewport &vp = frame.vp_ ;
+
+    state_.invalidateBindings() ;
+    state_.viewport(vp.x_, vp.y_, vp.width_, vp.height_);
+
+    state_.frontFace(GL_CCW) ;
+    state_.enable(GL_DEPTH_TEST) ;
+    state_.depthFunc(GL_LEQUAL) ;
+    state_.depthMask(GL_TRUE) ;
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE) ;
+
+    GLintptr object_offset = 0 ;
+
+    for( const RenderItem &item: queue_.items() ) {
+        GLintptr offset = object_offset ;
+        object_offset += object_stride ;
+
+        if ( !item.opaque_ ) continue ;
+
+        OpenGLShaderProgram *shader = depthPrePassShader(item.skinning_, item.instances_ > 0) ;
+        state_.useProgram(shader->handle()) ;
+
+        setCullMode(item.material_->side()) ;
+
+        object_block_.bindRange(offset, sizeof(ObjectBlockData)) ;
+
+        if ( item.skinning_ ) {
+            auto pose = frame.bone_offsets_.find(item.geom_.get()) ;
+            if ( pose != frame.bone_offsets_.end() )
+                shader->setUniform("g_bone_offset", pose->second) ;
+        }
+
+        state_.bindVertexArray(item.vao_) ;
+
+        if ( item.instances_ > 0 )
+            item.data_->bindInstanceAttributes(item.instance_buffer_, item.instance_offset_, item.instance_colors_offset_) ;
+
+        if ( item.occlusion_query_ ) glBeginConditionalRender(item.occlusion_query_, GL_QUERY_NO_WAIT) ;
+        drawMeshData(*item.data_, item.geom_, true, item.instances_, item.lod_) ;
+        if ( item.occlusion_query_ ) glEndConditionalRender() ;
+
+        ++stats_.depth_prepass_draws_ ;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE) ;
+}
+
+// The bounds of the nodes in view are tested against the depth of the opaque drawables left by the pre-pass, the
+// results are used by the next frame (see OcclusionCuller)
+
+void Renderer::occlusionPass(const FrameContext &frame) {
+    const Matrix4f proj_view = perspective_ * proj_ ;
+
+    Frustum frustum(proj_view) ;
+
+    occlusion_.beginQueries(proj_view, state_) ;
+
+    for ( size_t i=0 ; i<frame.nodes_.size() ; i++ ) {
+        const NodePtr &node = frame.nodes_[i] ;
+
+        // empty bounds, e.g. of skinned meshes, are never culled
+        if ( !node->isVisible() || frame.bounds_[i].empty() ) continue ;
+        if ( node->drawables().empty() && node->instancedDrawables().empty() ) continue ;
+        if ( !frustum.intersects(frame.bounds_[i]) ) continue ;
+
+        occlusion_.query(node.get(), frame.bounds_[i]) ;
+    }
+
+    occlusion_.endQueries() ;
+
+    stats_.occlusion_queries_ = occlusion_.queries() ;
+}
+
+// State changes are issued only when they differ from the previous item of the sorted queue.
+// Uniforms are stored per program so lights and material parameters have to be re-applied after a program switch.
+
+void Renderer::drawRenderQueue(const FrameContext &frame, GLsizeiptr object_stride) {
+    const Viewport &vp = frame.vp_ ;
+
+    state_.invalidateBindings() ;
+    state_.viewport(vp.x_, vp.y_, vp.width_, vp.height_);
+
+    GLintptr object_offset = 0 ;
+
+    const MaterialProgram *current_prog = nullptr ;
+    const Material *current_material = nullptr ;
+    const Texture2D *current_texture = nullptr ;
+
+    for( const RenderItem &item: queue_.items() ) {
+        const MaterialProgramPtr &prog = item.prog_ ;
+
+        bool prog_changed = ( prog.get() != current_prog ) ;
+
+        if ( prog_changed ) {
+            state_.useProgram(prog->handle()) ;
+            prog->applyLights(frame.lights_) ;
+            current_prog = prog.get() ;
+        }
+
+        if ( prog_changed || item.material_.get() != current_material ) {
+            initState(item.material_.get()) ;
+            prog->applyParams(item.material_) ;
+            current_material = item.material_.get() ;
+        }
+
+        // after the pre-pass the depth buffer already holds the closest opaque surfaces
+
+        bool equal_depth = usesDepthPrePass() && item.opaque_ ;
+        state_.depthFunc(equal_depth ? GL_EQUAL : GL_LEQUAL) ;
+        state_.depthMask(equal_depth ? GL_FALSE : GL_TRUE) ;
+
+        if ( prog_changed || item.texture_ != current_texture ) {
+            prog->bindTextures(item.material_, [this](const Texture2D *t) {
+                return fetchTextureData(t) ;
+            }, state_) ;
+            current_texture = item.texture_ ;
+        }
+
+        object_block_.bindRange(object_offset, sizeof(ObjectBlockData)) ;
+        object_offset += object_stride ;
+
+        prog->applyTransform(perspective_, proj_, item.transform_.matrix()) ;
+
+        if ( item.skinning_ )
+            setPose(frame, item.geom_, prog) ;
+
+        state_.bindVertexArray(item.vao_) ;
+
+        if ( item.instances_ > 0 ) {
+            item.data_->bindInstanceAttributes(item.instance_buffer_, item.instance_offset_, item.instance_colors_offset_) ;
+            ++stats_.instanced_draws_ ;
+        }
+
+        // the query was issued in the previous frame, waiting for it does not stall the GPU
+        if ( item.occlusion_query_ ) glBeginConditionalRender(item.occlusion_query_, GL_QUERY_NO_WAIT) ;
+        drawMeshData(*item.data_, item.geom_, false, item.instances_, item.lod_) ;
+        if ( item.occlusion_query_ ) glEndConditionalRender() ;
+
+        ++stats_.draw_calls_ ;
+    }
+
+/*
+    glBlendFunc(GL_ONE, GL_ZERO);
+          glViewport(0, 0, 256, 256);
+       //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+         renderShadowDebug(*frame.lights_[1]) ;
+      glBindTexture(GL_TEXTURE_2D, 0);
+*/
+}
+
+
+LightData &Renderer::getLightData(const LightPtr &l) {
+
+    LightData &data = light_data_[l] ;
+
+    initShadowMapRenderer();
+
+    // directional lights use an array texture with one layer per cascade
+
+    GLuint layers = 0 ;
+    if ( const DirectionalLight *dl = dynamic_cast<const DirectionalLight *>(l.get()) )
+        layers = std::max(dl->shadowCascades(), 1u) ;
+
+    GLuint size = l->shadowMapSize() ;
+
+    if ( !data.shadow_map_ || data.shadow_map_->width() != size || data.shadow_map_->layers() != layers ) {
+        data.shadow_map_.reset(new ShadowMap()) ;
+        data.shadow_map_->init(size, size, layers) ;
+        data.shadow_map_->unbind(default_fbo_);
+        data.shadow_valid_ = false ;
+    }
+
+    return data ;
+}
+
+void Renderer::setupFrame(FrameContext &frame) {
+
+    // single traversal of the scene graph, the result is shared by all passes
+
+    frame.nodes_ = scene_->getOrderedNodes() ;
+    ++stats_.scene_walks_ ;
+
+    const size_t n_nodes = frame.nodes_.size() ;
+
+    for( size_t i=0 ; i<n_nodes ; i++ )
+        frame.node_index_.emplace(frame.nodes_[i].get(), i) ;
+
+    // global transforms are composed with the one of the parent rather than walking the parent chain of every node
+
+    frame.transforms_.resize(n_nodes) ;
+    std::vector<bool> done(n_nodes, false) ;
+
+    std::function<const Affine3f &(size_t)> globalTransform = [&](size_t i) -> const Affine3f & {
+        if ( !done[i] ) {
+            const Node *node = frame.nodes_[i].get() ;
+            auto it = node->parent() ? frame.node_index_.find(node->parent()) : frame.node_index_.end() ;
+            if ( it != frame.node_index_.end() )
+                frame.transforms_[i] = globalTransform(it->second) * node->transform() ;
+            else
+                frame.transforms_[i] = node->globalTransform() ;
+            done[i] = true ;
+        }
+        return frame.transforms_[i] ;
+    } ;
+
+    frame.bounds_.reserve(n_nodes) ;
+
+    for ( size_t i=0 ; i<n_nodes ; i++ ) {
+        const NodePtr &node = frame.nodes_[i] ;
+        const Affine3f &tf = globalTransform(i) ;
+
+        frame.bounds_.push_back(nodeBounds(node, tf)) ;
+
+        LightPtr l = node->light() ;
+        if ( l ) {
+            LightData &ld = getLightData(l) ;
+            ld.light_ = l ;
+            ld.mat_ = tf ;
+
+            frame.lights_.push_back(&ld) ;
+        }
+    }
+
+    // program variant parameters that depend on the lights
+
+    for( const auto &ld: frame.lights_ )
+        addLightParams(frame.params_, ld->light_.get()) ;
+
+    frame.params_.enable_capture_ = capture_ != nullptr ;
+
+    updateBonePalettes(frame) ;
+
+    if ( !frame.bone_offsets_.empty() ) {
+        FrameProfiler::Scope pass(profiler_, "skinning") ;
+        skinMeshes(frame) ;
+    }
+
+    for( LightData *ld: frame.lights_ ) {
+        if ( ld->light_->castsShadows() )
+            updateShadows(frame, *ld) ;
+    }
+
+    updateLightsBlock(frame) ;
+}
+
+// Shadow maps that depend on the camera, i.e. the cascaded ones, for a view of renderViews after the first
+
+void Renderer::updateViewShadows(const FrameContext &frame) {
+    bool updated = false ;
+
+    for( LightData *ld: frame.lights_ ) {
+        const DirectionalLight *dl = dynamic_cast<const DirectionalLight *>(ld->light_.get()) ;
+
+        if ( dl && dl->castsShadows() && dl->shadowCascades() > 0 ) {
+            updateShadows(frame, *ld) ;
+            updated = true ;
+        }
+    }
+
+    if ( updated ) updateLightsBlock(frame) ;
+}
+
+// The bone matrices of all skinned meshes are computed once per frame from the global transforms of the frame
+// and uploaded with a single call to a buffer texture, which is shared by the shadow and color passes. Each draw
+// then only sets the offset of its mesh in the palette.
+
+void Renderer::updateBonePalettes(FrameContext &frame) {
+    for( const NodePtr &node: frame.nodes_ ) {
+        for( const auto &dr: node->drawables() ) {
+            const GeometryPtr &geom = dr.geometry() ;
+            if ( !geom || !geom->hasSkeleton() ) continue ;
+
+            // meshes drawn by several nodes have the same pose, since it depends only on the bone nodes
+            if ( !frame.bone_offsets_.emplace(geom.get(), (GLint)frame.bone_palette_.size()).second ) continue ;
+
+            for( const Geometry::Bone &b: geom->skeleton() ) {
+                auto it = frame.node_index_.find(b.node_.get()) ;
+                const Affine3f tf = ( it != frame.node_index_.end() ) ? frame.transforms_[it->second] : b.node_->globalTransform() ;
+                frame.bone_palette_.push_back(( tf * b.offset_ ).matrix()) ;
+            }
+        }
+    }
+
+    if ( frame.bone_palette_.empty() ) return ;
+
+    bone_palette_.upload(frame.bone_palette_.data(), frame.bone_palette_.size() * sizeof(Matrix4f)) ;
+    state_.invalidateTexture(GL_TEXTURE_BUFFER) ;
+    state_.bindTexture(MaterialProgram::BONE_PALETTE_UNIT, GL_TEXTURE_BUFFER, bone_palette_.texture()) ;
+}
+
+bool Renderer::isPreSkinned(const Geometry &geom) const {
+    return geom.hasSkeleton() && ( pre_skinning_ || geom.skinnedVerticesReadback() ) ;
+}
+
+// Skinned meshes are posed once per frame by a vertex shader whose output is captured with transform feedback,
+// instead of repeating the skinning in the vertex shader of every pass that draws them. The shadow and color
+// passes then draw the posed vertices with the programs of static meshes.
+
+void Renderer::skinMeshes(const FrameContext &frame) {
+    bool found = false ;
+
+    for( const auto &p: frame.bone_offsets_ ) {
+        Geometry *geom = p.first ;
+        if ( !isPreSkinned(*geom) ) continue ;
+
+        MeshData *data = meshes_.fetch(geom) ;
+        state_.invalidateVertexArray() ;
+        if ( !data || data->elem_count_ == 0 ) continue ;
+
+        if ( !found ) {
+            if ( !skinning_shader_ ) {
+                skinning_shader_.reset(new OpenGLShaderProgram) ;
+                skinning_shader_->addShaderFromFile(VERTEX_SHADER, "@skinning_feedback_vs") ;
+                skinning_shader_->setTransformFeedbackVaryings({"skinned_position", "skinned_normal"}) ;
+                skinning_shader_->link() ;
+                skinning_shader_->use() ;
+                skinning_shader_->setUniform("g_bone_palette", (GLint)MaterialProgram::BONE_PALETTE_UNIT) ;
+                state_.invalidateBindings() ;
+            }
+
+            state_.useProgram(skinning_shader_->handle()) ;
+            state_.enable(GL_RASTERIZER_DISCARD) ;
+            found = true ;
+        }
+
+        data->prepareSkinning() ;
+        state_.invalidateVertexArray() ;
+
+        skinning_shader_->setUniform("g_bone_offset", p.second) ;
+
+        // every vertex is skinned once regardless of the indices
+
+        state_.bindVertexArray(data->vao_) ;
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, data->tf_) ;
+        glBeginTransformFeedback(GL_POINTS) ;
+        glDrawArrays(GL_POINTS, 0, data->elem_count_) ;
+        glEndTransformFeedback() ;
+
+        ++stats_.skinned_meshes_ ;
+    }
+
+    if ( !found ) return ;
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0) ;
+    state_.disable(GL_RASTERIZER_DISCARD) ;
+}
+
+// Copy the posed vertices back to the geometries that requested it. This waits for the GPU to finish skinning.
+
+void Renderer::readSkinnedVertices(const FrameContext &frame) {
+    bool readback = std::any_of(frame.bone_offsets_.begin(), frame.bone_offsets_.end(), [](const std::pair<Geometry * const, GLint> &p) {
+        return p.first->skinnedVerticesReadback() ;
+    }) ;
+
+    if ( !readback ) return ;
+
+    FrameProfiler::Scope pass(profiler_, "readback") ;
+
+    std::vector<GLfloat> buffer ;
+
+    for( const auto &p: frame.bone_offsets_ ) {
+        Geometry *geom = p.first ;
+        if ( !geom->skinnedVerticesReadback() ) continue ;
+
+        const MeshData *data = meshes_.fetch(geom) ;
+        if ( !data || !data->tf_ ) continue ;
+
+        const size_t n = data->elem_count_ ;
+        buffer.resize(n * 6) ;
+
+        glBindBuffer(GL_ARRAY_BUFFER, data->tf_) ;
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, n * MeshData::skinned_stride_, buffer.data()) ;
+
+        Geometry::vb3_t &vertices = geom->skinnedVertices() ;
+        vertices.resize(n) ;
+        for( size_t i=0 ; i<n ; i++ )
+            vertices[i] = Vector3f(buffer[6*i], buffer[6*i+1], buffer[6*i+2]) ;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+}
+
+// World space box enclosing all drawables of the node. Skinned meshes are deformed by the bones on the GPU
+// so the box of the bind pose is not valid and an empty box is returned, which is never culled.
+
+BoundingBox Renderer::nodeBounds(const NodePtr &node, const Affine3f &tf) {
+    BoundingBox bounds ;
+
+    for( const auto &drawable: node->drawables() ) {
+        GeometryPtr geom = drawable.geometry() ;
+        if ( !geom || geom->vertices().empty() ) continue ;
+        if ( geom->hasSkeleton() ) return BoundingBox() ;
+
+        auto box = geom->getBoundingBox() ;
+        bounds.extend(BoundingBox(box.bounds_[0], box.bounds_[1]).transformed(tf)) ;
+    }
+
+    for( const auto &drawable: node->instancedDrawables() ) {
+        GeometryPtr geom = drawable->geometry() ;
+        if ( !geom || geom->vertices().empty() ) continue ;
+        if ( geom->hasSkeleton() ) return BoundingBox() ;
+
+        const InstanceData *idata = instances_.fetch(drawable.get()) ;
+        if ( !idata->bounds_.empty() )
+            bounds.extend(idata->bounds_.transformed(tf)) ;
+    }
+
+    return bounds ;
+}
+
+void Renderer::updateFrameBlock() {
+    FrameBlockData data ;
+    data.view_ = proj_ ;
+    data.proj_ = perspective_ ;
+    data.eye_pos_ = proj_.inverse() * Vector4f(0, 0, 0, 1) ;
+
+    frame_block_.upload(&data, sizeof(data)) ;
+}
+
+static LightBlockData directionalLightBlock(const DirectionalLight *dl, const Affine3f &tf) {
+    LightBlockData data ;
+    data.ambient_ = dl->ambientColor() ;
+    data.diffuse_ = dl->diffuseColor() ;
+    data.specular_ = dl->specularColor() ;
+    data.direction_ = tf * (dl->position() - dl->target()).normalized() ;
+    return data ;
+}
+
+static LightBlockData spotLightBlock(const SpotLight *sl, const Affine3f &tf) {
+    LightBlockData data ;
+    data.ambient_ = sl->ambientColor() ;
+    data.diffuse_ = sl->diffuseColor() ;
+    data.specular_ = sl->specularColor() ;
+    data.direction_ = sl->direction() ;
+    data.position_ = tf * sl->position() ;
+    data.constant_attenuation_ = sl->constantAttenuation() ;
+    data.linear_attenuation_ = sl->linearAttenuation() ;
+    data.quadratic_attenuation_ = sl->quadraticAttenuation() ;
+    data.spot_inner_cutoff_ = cos(M_PI*sl->innerCutoffAngle()/180.0) ;
+    data.spot_outer_cutoff_ = cos(M_PI*sl->outerCutoffAngle()/180.0) ;
+    return data ;
+}
+
+static LightBlockData pointLightBlock(const PointLight *pl, const Affine3f &tf) {
+    LightBlockData data ;
+    data.ambient_ = pl->ambientColor() ;
+    data.diffuse_ = pl->diffuseColor() ;
+    data.specular_ = pl->specularColor() ;
+    data.position_ = tf * pl->position() ;
+    data.constant_attenuation_ = pl->constantAttenuation() ;
+    data.linear_attenuation_ = pl->linearAttenuation() ;
+    data.quadratic_attenuation_ = pl->quadraticAttenuation() ;
+    return data ;
+}
+
+// The lights are written in the order of the arrays of LightsBlock (see shaders/lights.hpp): first grouped by type
+// and shadow casting, then the light space matrices of the shadow casting lights (MAX_SHADOW_CASCADES for each
+// directional light) and last the cascade splits. All members are multiples
+// of 16 bytes so the std140 offsets are obtained by simple concatenation. The shadow maps are bound here
+// to the texture units expected by MaterialProgram::setupShadowSamplers.
+
+void Renderer::updateLightsBlock(const FrameContext &frame) {
+    std::vector<LightBlockData> dir, dir_shadow, spot, spot_shadow, point, point_shadow ;
+    std::vector<const LightData *> dir_casters, spot_casters, point_casters ;
+
+    for( const LightData *ld: frame.lights_ ) {
+        const Light *light = ld->light_.get() ;
+        bool casts_shadows = light->castsShadows() ;
+
+        if ( const DirectionalLight *dl = dynamic_cast<const DirectionalLight *>(light) ) {
+            LightBlockData data = directionalLightBlock(dl, ld->mat_) ;
+            if ( casts_shadows ) {
+                data.shadow_bias_ = light->shadowBias() ;
+                dir_shadow.push_back(data) ;
+                dir_casters.push_back(ld) ;
+            } else dir.push_back(data) ;
+        } else if ( const SpotLight *sl = dynamic_cast<const SpotLight *>(light) ) {
+            LightBlockData data = spotLightBlock(sl, ld->mat_) ;
+            if ( casts_shadows ) {
+                data.shadow_bias_ = light->shadowBias() ;
+                spot_shadow.push_back(data) ;
+                spot_casters.push_back(ld) ;
+            } else spot.push_back(data) ;
+        } else if ( const PointLight *pl = dynamic_cast<const PointLight *>(light) ) {
+            LightBlockData data = pointLightBlock(pl, ld->mat_) ;
+            if ( casts_shadows ) {
+                data.shadow_bias_ = light->shadowBias() ;
+                point_shadow.push_back(data) ;
+                point_casters.push_back(ld) ;
+            } else point.push_back(data) ;
+        }
+    }
+
+    std::vector<uint8_t> block ;
+
+    auto append = [&block](const void *data, size_t sz) {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data) ;
+        block.insert(block.end(), p, p + sz) ;
+    } ;
+
+    for( const auto &lights: { &dir, &dir_shadow, &spot, &spot_shadow, &point, &point_shadow } )
+        append(lights->data(), lights->size() * sizeof(LightBlockData)) ;
+
+    GLuint unit = MaterialProgram::SHADOW_MAP_FIRST_UNIT ;
+
+    for( const LightData *ld: dir_casters ) {
+        for( uint32_t i=0 ; i<DirectionalLight::MAX_SHADOW_CASCADES ; i++ ) {
+            const Matrix4f &m = ld->ls_mats_[std::min<size_t>(i, ld->ls_mats_.size() - 1)] ;
+            append(m.data(), sizeof(Matrix4f)) ;
+        }
+        state_.bindTexture(unit++, ld->shadow_map_->target(), ld->shadow_map_->texture()) ;
+    }
+
+    for( const auto &casters: { &spot_casters, &point_casters } ) {
+        for( const LightData *ld: *casters ) {
+            const Matrix4f m = ld->ls_mats_.empty() ? Matrix4f::Identity() : ld->ls_mats_[0] ;
+            append(m.data(), sizeof(Matrix4f)) ;
+            state_.bindTexture(unit++, ld->shadow_map_->target(), ld->shadow_map_->texture()) ;
+        }
+    }
+
+    for( const LightData *ld: dir_casters )
+        append(ld->cascade_splits_.data(), sizeof(Vector4f)) ;
+
+    if ( !block.empty() )
+        lights_block_.upload(block.data(), block.size()) ;
+}
+
+// Blocks of all items of the queue are uploaded with a single call, each draw then binds its own range.
+// Returns the distance between consecutive blocks in the buffer.
+
+GLsizeiptr Renderer::updateObjectBlocks() {
+    const GLsizeiptr alignment = UniformBuffer::offsetAlignment() ;
+    const GLsizeiptr stride = ( ( sizeof(ObjectBlockData) + alignment - 1 ) / alignment ) * alignment ;
+
+    const auto &items = queue_.items() ;
+
+    if ( items.empty() ) return stride ;
+
+    object_data_.resize(items.size() * stride) ;
+
+    size_t offset = 0 ;
+    for( const RenderItem &item: items ) {
+        ObjectBlockData data ;
+        data.model_ = item.transform_.matrix() ;
+        data.mv_ = proj_ * data.model_ ;
+        data.mvp_ = perspective_ * data.mv_ ;
+        data.mvn_.setIdentity() ;
+        data.mvn_.block<3, 3>(0, 0) = data.mv_.block<3, 3>(0, 0).transpose().inverse() ;
+        data.object_id_[0] = item.id_ ;
+
+        memcpy(object_data_.data() + offset, &data, sizeof(data)) ;
+        offset += stride ;
+    }
+
+    object_block_.upload(object_data_.data(), object_data_.size()) ;
+
+    return stride ;
+}
+
+void Renderer::initShadowMapRenderer() {
+    if ( shadow_map_shader_ ) return ;
+
+    shadow_map_shader_.reset(new OpenGLShaderProgram) ;
+    shadow_map_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_map_shader_vs") ;
+    shadow_map_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
+    shadow_map_shader_->link() ;
+
+    OpenGLShaderPreproc instancing ;
+    instancing.appendDefinition("USE_INSTANCING") ;
+
+    shadow_map_instanced_shader_.reset(new OpenGLShaderProgram) ;
+    shadow_map_instanced_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_map_shader_vs", instancing) ;
+    shadow_map_instanced_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
+    shadow_map_instanced_shader_->link() ;
+
+    OpenGLShaderPreproc skinning ;
+    skinning.appendDefinition("USE_SKINNING") ;
+
+    shadow_map_skinned_shader_.reset(new OpenGLShaderProgram) ;
+    shadow_map_skinned_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_map_shader_vs", skinning) ;
+    shadow_map_skinned_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
+    shadow_map_skinned_shader_->link() ;
+    shadow_map_skinned_shader_->use() ;
+    shadow_map_skinned_shader_->setUniform("g_bone_palette", (GLint)MaterialProgram::BONE_PALETTE_UNIT) ;
+    glUseProgram(0) ;
+
+    shadow_map_debug_shader_.reset(new OpenGLShaderProgram) ;
+    shadow_map_debug_shader_->addShaderFromFile(VERTEX_SHADER, "@shadow_debug_shader_vs") ;
+    shadow_map_debug_shader_->addShaderFromFile(FRAGMENT_SHADER, "@shadow_debug_shader_fs") ;
+    shadow_map_debug_shader_->link() ;
+}
+
+
+// Variants of the shadow map shader writing the depth of the camera for the pre-pass, created on first use
+
+OpenGLShaderProgram *Renderer::depthPrePassShader(bool skinning, bool instancing) {
+    std::unique_ptr<OpenGLShaderProgram> &shader = depth_prepass_shaders_[( skinning ? 2 : 0 ) + ( instancing ? 1 : 0 )] ;
+    if ( shader ) return shader.get() ;
+
+    OpenGLShaderPreproc preproc ;
+    preproc.appendDefinition("DEPTH_PREPASS") ;
+    preproc.appendDefinition("USE_SKINNING", skinning) ;
+    preproc.appendDefinition("USE_INSTANCING", instancing) ;
+
+    shader.reset(new OpenGLShaderProgram) ;
+    shader->addShaderFromFile(VERTEX_SHADER, "@shadow_map_shader_vs", preproc) ;
+    shader->addShaderFromFile(FRAGMENT_SHADER, "@shadow_map_shader_fs") ;
+    shader->link() ;
+    shader->bindUniformBlock("ObjectBlock", OBJECT_BLOCK_BINDING) ;
+
+    if ( skinning ) {
+        state_.useProgram(shader->handle()) ;
+        shader->setUniform("g_bone_palette", (GLint)MaterialProgram::BONE_PALETTE_UNIT) ;
+    }
+
+    return shader.get() ;
+}
+
+void Renderer::setPose(const FrameContext &frame, const GeometryPtr &mesh, const MaterialProgramPtr &mat) {
+    auto it = frame.bone_offsets_.find(mesh.get()) ;
+    if ( it != frame.bone_offsets_.end() )
+        mat->applyBonePalette(it->second) ;
+}
+
+// the vertex array object of the mesh should be bound by the caller
+
+// plain or instanced draw calls depending on the number of instances
+
+static void drawElements(GLenum mode, GLsizei count, GLenum type, GLsizei instances, GLintptr offset = 0) {
+    if ( instances > 0 )
+        glDrawElementsInstanced(mode, count, type, (const GLvoid *)offset, instances);
+    else
+        glDrawElements(mode, count, type, (const GLvoid *)offset);
+}
+
+static void drawArrays(GLenum mode, GLsizei count, GLsizei instances) {
+    if ( instances > 0 )
+        glDrawArraysInstanced(mode, 0, count, instances);
+    else
+        glDrawArrays(mode, 0, count);
+}
+
+void Renderer::drawMeshData(const MeshData &data, GeometryPtr mesh, bool solid, GLsizei instances, uint32_t lod) {
+
+    const uint32_t copies = std::max<GLsizei>(instances, 1) ;
+
+    if ( mesh ) {
+        if ( mesh->ptype() == Geometry::Triangles ) {
+            if ( lod > 0 && lod <= data.lods_.size() ) {
+                // the levels of detail are ranges of the index buffer following the full geometry
+                const MeshData::LodRange &range = data.lods_[lod - 1] ;
+                stats_.triangles_ += range.count_ / 3 * copies ;
+                drawElements(GL_TRIANGLES, range.count_, data.index_type_, instances, range.offset_) ;
+            }
+            else if ( data.indices_ ) {
+                // indexed draw call, the index buffer is bound with the vertex array
+                stats_.triangles_ += data.indices_ / 3 * copies ;
+                drawElements(GL_TRIANGLES, data.indices_, data.index_type_, instances);
+            }
+            else {
+                stats_.triangles_ += data.elem_count_ / 3 * copies ;
+                drawArrays(GL_TRIANGLES, data.elem_count_, instances) ;
+            }
+        }
+        else if ( mesh->ptype() == Geometry::Lines && !solid ) {
+            if ( data.indices_ ) {
+                drawElements(GL_LINES, data.indices_, data.index_type_, instances);
+            }
+            else
+                drawArrays(GL_LINES, data.elem_count_, instances) ;
+        }
+        else if ( mesh->ptype() == Geometry::Points ) {
+            drawArrays(GL_POINTS, data.elem_count_, instances) ;
+        }
+
+    } else {
+        stats_.triangles_ += data.elem_count_ / 3 * copies ;
+        drawArrays(GL_TRIANGLES, data.elem_count_, instances) ;
+    }
+}
+
+}
+
+Renderer::Renderer(): impl_(new impl::Renderer()) {
+
+}
+
+Renderer::~Renderer() {}
+
+void Renderer::init() {
+    impl_->init() ;
+}
+
+void Renderer::render(const NodePtr &scene, const CameraPtr &cam, bool clear_buffers) {
+    impl_->render(scene, cam, clear_buffers) ;
+}
+
+void Renderer::capture(const NodePtr &scene, const CameraPtr &cam, Capture &result) {
+    impl_->capture(scene, cam, result) ;
+}
+
+void Renderer::renderViews(const NodePtr &scene, const std::vector<CameraPtr> &cams, std::vector<Image> &images) {
+    impl_->renderViews(scene, cams, images) ;
+}
+
+void Renderer::renderImage(const NodePtr &scene, const CameraPtr &cam, Image &image, uint32_t samples,
+                           uint32_t supersampling, DownsampleFilter filter) {
+    impl_->renderImage(scene, cam, image, samples, supersampling, filter) ;
+}
+
+Renderer::PickTicket Renderer::requestPick(const NodePtr &scene, const CameraPtr &cam, int x, int y, int radius) {
+    return impl_->requestPick(scene, cam, x, y, radius) ;
+}
+
+bool Renderer::fetchPick(PickTicket ticket, RayCastResult &result, bool wait) {
+    return impl_->fetchPick(ticket, result, wait) ;
+}
+
+bool Renderer::pick(const NodePtr &scene, const CameraPtr &cam, int x, int y, RayCastResult &result, int radius) {
+    return impl_->fetchPick(impl_->requestPick(scene, cam, x, y, radius), result, true) && result.node_ ;
+}
+
+void Renderer::renderText(const string &text, float x, float y, const Font &font, const Vector3f &clr)
 {
     impl_->renderText(text, x, y, font, clr) ;
 }
@@ -477,5 +2114,45 @@ Vector2f Renderer::project(const Vector3f &pos) {
     return impl_->project(pos) ;
 }
 
+void Renderer::setPackedVertexFormat(bool packed) {
+    impl_->setPackedVertexFormat(packed) ;
+}
+
+void Renderer::setPreSkinning(bool enable) {
+    impl_->setPreSkinning(enable) ;
+}
+
+void Renderer::setAsyncShaderCompile(bool enable) {
+    impl_->setAsyncShaderCompile(enable) ;
+}
+
+void Renderer::setStateValidation(bool enable) {
+    impl_->setStateValidation(enable) ;
+}
+
+void Renderer::setDepthPrePass(bool enable) {
+    impl_->setDepthPrePass(enable) ;
+}
+
+void Renderer::setOcclusionCulling(bool enable) {
+    impl_->setOcclusionCulling(enable) ;
+}
+
+void Renderer::setLodThreshold(float pixels) {
+    impl_->setLodThreshold(pixels) ;
+}
+
+void Renderer::setTraceFile(const std::string &path) {
+    impl_->setTraceFile(path) ;
+}
+
+void Renderer::precompile(const NodePtr &scene) {
+    impl_->precompile(scene) ;
+}
+
+const FrameStats &Renderer::frameStats() const {
+    return impl_->frameStats() ;
+}
+
 
 }
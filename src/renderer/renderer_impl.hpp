@@ -2,6 +2,7 @@
 #define XVIZ_RENDERER_IMPL_HPP
 
 #include <map>
+#include <unordered_map>
 #include <Eigen/Geometry>
 #include <xviz/scene/scene_fwd.hpp>
 #include <xviz/scene/material.hpp>
@@ -11,10 +12,26 @@
 #include "mesh_data.hpp"
 #include "texture_data.hpp"
 #include "material_program.hpp"
+#include "render_queue.hpp"
+#include "uniform_buffer.hpp"
+#include "instance_data.hpp"
+#include "frustum.hpp"
+#include "texture_buffer.hpp"
+#include "gl_state.hpp"
+#include "profiler.hpp"
+#include "occlusion_culler.hpp"
+#include "capture_target.hpp"
+#include "view_atlas.hpp"
+#include "pick_target.hpp"
+#include "render_target_pool.hpp"
+#include "downsampler.hpp"
 
 #include <iostream>
 
 namespace xviz {
+
+struct DirectionalLight ;
+
 namespace impl {
 
 
@@ -29,7 +46,25 @@ struct LightData {
     LightPtr light_ ;
     Eigen::Affine3f mat_ ;
     std::unique_ptr<impl::ShadowMap> shadow_map_ ;
-    Eigen::Matrix4f ls_mat_ ;
+    std::vector<Eigen::Matrix4f> ls_mats_ ;     // light space matrix of each layer of the shadow map
+    Eigen::Vector4f cascade_splits_ ;           // distance from the camera where each cascade ends
+    size_t shadow_key_ = 0 ;            // state of the light and shadow casters when the shadow map was rendered
+    bool shadow_valid_ = false ;
+};
+
+// state gathered once per call to render and shared by the shadow and color passes
+
+struct FrameContext {
+    CameraPtr cam_ ;
+    Viewport vp_ ;                      // area of the framebuffer covered by the camera
+    std::vector<NodePtr> nodes_ ;       // scene nodes sorted by drawing order
+    std::vector<Eigen::Affine3f> transforms_ ;  // global transform of each node in nodes_
+    std::vector<BoundingBox> bounds_ ;  // world space bounds of the drawables of each node in nodes_
+    std::unordered_map<const Node *, size_t> node_index_ ;  // position of each node in nodes_
+    std::vector<Eigen::Matrix4f> bone_palette_ ;            // bone matrices of all skinned meshes
+    std::map<Geometry *, GLint> bone_offsets_ ;             // first matrix of each skinned mesh in bone_palette_
+    std::vector<LightData *> lights_ ;  // lights found in the scene
+    MaterialProgramParams params_ ;     // program parameters derived from the lights
 };
 
 class Renderer {
@@ -46,12 +81,44 @@ public:
 
     void render(const NodePtr &scene, const CameraPtr &cam, bool cb) ;
 
+    void capture(const NodePtr &scene, const CameraPtr &cam, Capture &result) ;
+
+    void renderViews(const NodePtr &scene, const std::vector<CameraPtr> &cams, std::vector<Image> &images) ;
+
+    void renderImage(const NodePtr &scene, const CameraPtr &cam, Image &image, uint32_t samples,
+                     uint32_t supersampling, DownsampleFilter filter) ;
+
+    uint64_t requestPick(const NodePtr &scene, const CameraPtr &cam, int x, int y, int radius) ;
+
+    bool fetchPick(uint64_t ticket, RayCastResult &result, bool wait) ;
+
     void renderText(const Text &t, float x, float y, const Font &f, const Eigen::Vector3f &clr) ;
 
     // transform model coordinates to screen coordinates
     Eigen::Vector2f project(const Eigen::Vector3f &pos) ;
 
     void renderText(const std::string &text, float x, float y, const Font &font, const Eigen::Vector3f &clr);
+
+    const FrameStats &frameStats() const { return stats_ ; }
+
+    void setPackedVertexFormat(bool packed) { meshes_.setPackedByDefault(packed) ; }
+
+    void setPreSkinning(bool enable) { pre_skinning_ = enable ; }
+
+    void setAsyncShaderCompile(bool enable) { async_compile_ = enable ; }
+
+    void precompile(const NodePtr &scene) ;
+
+    void setStateValidation(bool enable) { state_.setValidation(enable) ; }
+
+    void setDepthPrePass(bool enable) { depth_prepass_ = enable ; }
+
+    void setOcclusionCulling(bool enable) { occlusion_culling_ = enable && OcclusionCuller::supported() ; }
+
+    void setLodThreshold(float pixels) { lod_threshold_ = pixels ; }
+
+    void setTraceFile(const std::string &path) { profiler_.setTraceFile(path) ; }
+
 private:
 
     NodePtr scene_;
@@ -61,37 +128,114 @@ private:
     MaterialPtr default_material_ ;
 
     MeshDataManager meshes_ ;
+    InstanceDataManager instances_ ;
+    InstanceData batch_instances_ ;         // instances of the draw calls batched in the render queue
     TextureCache textures_ ;
     GLint default_fbo_ ;
 
-    std::unique_ptr<impl::OpenGLShaderProgram> shadow_map_shader_, shadow_map_debug_shader_ ;
+    std::unique_ptr<impl::OpenGLShaderProgram> shadow_map_shader_, shadow_map_instanced_shader_, shadow_map_skinned_shader_,
+        shadow_map_debug_shader_, skinning_shader_ ;
+
+    // depth pre-pass programs indexed by 2 * skinning + instancing
+    std::unique_ptr<impl::OpenGLShaderProgram> depth_prepass_shaders_[4] ;
+    bool depth_prepass_ = false ;
+
+    OcclusionCuller occlusion_ ;
+    bool occlusion_culling_ = false ;
+
+    CaptureTarget capture_target_ ;
+    Capture *capture_ = nullptr ;           // filled by the frame being rendered, if any
+
+    ViewAtlas view_atlas_ ;
+
+    PickTarget pick_target_ ;
+
+    RenderTargetPool render_targets_ ;
+    Downsampler downsampler_ ;
+
+    bool pre_skinning_ = true ;
 
-    const uint32_t shadow_map_width_ = 2048 ;
-    const uint32_t shadow_map_height_ = 2048 ;
+    bool async_compile_ = false ;
+    MaterialPtr fallback_material_ ;                    // drawn while the program of a material is compiled
+    std::vector<MaterialProgramPtr> pending_programs_ ; // programs of precompile still linked by the driver
+
+    // level of detail selected for each drawn geometry of a node in the last frame
+    struct LodState {
+        uint32_t lod_ = 0 ;
+        bool used_ = false ;
+    };
+
+    std::map<std::pair<const Node *, const Geometry *>, LodState> lod_states_ ;
+    float lod_threshold_ = 1.0f ;           // screen space error in pixels
+    const float lod_hysteresis_ = 0.25f ;   // relative margin below the threshold to switch to a coarser level
+
+    // minimum number of consecutive queue items sharing geometry and material that are merged in an instanced draw
+    const uint32_t min_instance_batch_ = 4 ;
 
     std::map<LightPtr, LightData> light_data_ ;
 
+    FrameStats stats_ ;
+
+    GLState state_ ;
+    FrameProfiler profiler_ ;
+
+    RenderQueue queue_ ;
+
+    UniformBuffer frame_block_{FRAME_BLOCK_BINDING} ;
+    UniformBuffer lights_block_{LIGHTS_BLOCK_BINDING} ;
+    UniformBuffer object_block_{OBJECT_BLOCK_BINDING} ;
+    TextureBuffer bone_palette_ ;
+    std::vector<uint8_t> object_data_ ;     // staging area for the per-object blocks of the frame
+
 private:
 
-    void drawMeshData(const impl::MeshData &data, GeometryPtr mesh, bool solid=false);
+    void drawMeshData(const impl::MeshData &data, GeometryPtr mesh, bool solid=false, GLsizei instances = 0, uint32_t lod = 0);
     void setLights(const impl::MaterialProgramPtr &material);
     void setLights(const NodePtr &node, const Eigen::Affine3f &parent_tf, const impl::MaterialProgramPtr &mat);
     void setupTexture(const Material *mat, const Texture2D *texture, unsigned int slot);
     void initState(const Material *mat);
-    impl::MaterialProgramPtr instantiateMaterial(const Material *mat, const std::vector<LightData *> &lights, bool skinning);
-    void setPose(const GeometryPtr &mesh, const impl::MaterialProgramPtr &mat);
-
-    void renderScene(const CameraPtr &cam);
-    void render(const CameraPtr &cam, const Drawable &dr, const Eigen::Affine3f &mat);
+    void setCullMode(Material::Side side) ;
+    impl::MaterialProgramPtr instantiateMaterial(const Material *mat, const MaterialProgramParams &frame_params, bool skinning,
+                                                 bool instancing = false, bool instance_colors = false);
+    void setPose(const FrameContext &frame, const GeometryPtr &mesh, const impl::MaterialProgramPtr &mat);
+    bool programReady(const impl::MaterialProgramPtr &prog) ;
+    void useFallbackProgram(RenderItem &item, bool instancing, bool instance_colors) ;
+    void pollPrograms() ;
+
+    void beginFrame(const NodePtr &scene) ;
+    void setCamera(FrameContext &frame, const CameraPtr &cam, const Viewport &vp) ;
+    void endFrame(const FrameContext &frame) ;
+    void setupFrame(FrameContext &frame) ;
+    void updateViewShadows(const FrameContext &frame) ;
+    void updateBonePalettes(FrameContext &frame) ;
+    bool isPreSkinned(const Geometry &geom) const ;
+    void skinMeshes(const FrameContext &frame) ;
+    void readSkinnedVertices(const FrameContext &frame) ;
+    void renderScene(const FrameContext &frame);
+    void buildRenderQueue(const FrameContext &frame) ;
+    void batchRenderQueue(const FrameContext &frame) ;
+    void assignCaptureIds(const FrameContext &frame) ;
+    uint32_t selectLod(const Node *node, Geometry &geom, const MeshData &data, const Eigen::Affine3f &tf,
+                       const Eigen::Vector3f &eye, const Viewport &vp) ;
+    bool usesDepthPrePass() const { return depth_prepass_ || occlusion_culling_ ; }
+    void depthPrePass(const FrameContext &frame, GLsizeiptr object_stride) ;
+    void occlusionPass(const FrameContext &frame) ;
+    void drawRenderQueue(const FrameContext &frame, GLsizeiptr object_stride) ;
+    impl::OpenGLShaderProgram *depthPrePassShader(bool skinning, bool instancing) ;
     void initShadowMapRenderer() ;
-    void renderShadowMap(const LightData &l);
-    void updateShadows(LightData &light);
+    void renderShadowMap(const FrameContext &frame, const LightData &l, uint32_t layer);
+    void updateShadows(const FrameContext &frame, LightData &light);
+    bool computeCascades(const FrameContext &frame, const DirectionalLight &dl, LightData &light) ;
+    size_t shadowKey(const LightData &light) const ;
+    void updateFrameBlock() ;
+    void updateLightsBlock(const FrameContext &frame) ;
+    GLsizeiptr updateObjectBlocks() ;
     void renderShadowDebug(const LightData &sd);
     void renderQuad();
     impl::TextureData *fetchTextureData(const Texture2D *tex) ;
     void uploadTexture(impl::TextureData *data, const Material *material, int slot) ;
     LightData &getLightData(const LightPtr &light) ;
-    std::vector<LightData *> getLights();
+    BoundingBox nodeBounds(const NodePtr &node, const Eigen::Affine3f &tf) ;
 } ;
 
 
@@ -19,33 +19,42 @@ ShadowMap::~ShadowMap()
         glDeleteTextures(1, &texture_id_);
 }
 
-bool ShadowMap::init(GLuint width, GLuint height)
+bool ShadowMap::init(GLuint width, GLuint height, GLuint layers)
 {
+    width_ = width ; height_ = height ; layers_ = layers ;
+    target_ = ( layers > 0 ) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D ;
+
     // Create the FBO
     glGenFramebuffers(1, &fbo_);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
 
     // Create the depth buffer texture
     glGenTextures(1, &texture_id_);
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, (GLsizei)width, (GLsizei)height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(target_, texture_id_);
+
+    if ( layers > 0 )
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, (GLsizei)width, (GLsizei)height, (GLsizei)layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, (GLsizei)width, (GLsizei)height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(target_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(target_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(target_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    glTexParameterfv(target_, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(target_, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(target_, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
  //   glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_INTENSITY);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(target_, 0);
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture_id_, 0);
+    if ( layers > 0 )
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0, 0);
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture_id_, 0);
 
   // Disable writes to the color buffer
     glDrawBuffer(GL_NONE);
@@ -55,8 +64,11 @@ bool ShadowMap::init(GLuint width, GLuint height)
 }
 
 
-void ShadowMap::bind() {
+void ShadowMap::bind(GLuint layer) {
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+    if ( layers_ > 0 )
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0, (GLint)layer);
 }
 
 void ShadowMap::unbind(GLuint default_fbo = 0) {
@@ -66,7 +78,7 @@ void ShadowMap::unbind(GLuint default_fbo = 0) {
 
 void ShadowMap::bindTexture(GLenum textureUnit) {
     glActiveTexture(textureUnit);
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glBindTexture(target_, texture_id_);
 }
 
 }}
@@ -10,17 +10,29 @@ public:
     ShadowMap() ;
     ~ShadowMap();
 
-    bool init(GLuint width, GLuint height);
+    // with layers > 0 the depth texture is a GL_TEXTURE_2D_ARRAY (one layer per shadow cascade)
+    bool init(GLuint width, GLuint height, GLuint layers = 0);
 
-    void bind();
+    // attach the given layer of an array texture to the framebuffer and bind it
+    void bind(GLuint layer = 0);
     void unbind(GLuint default_fbo);
 
     void bindTexture(GLenum TextureUnit);
 
     bool ready() const { return fbo_ != 0 ; }
 
+    GLuint width() const { return width_ ; }
+    GLuint height() const { return height_ ; }
+    GLuint layers() const { return layers_ ; }
+
+    // depth texture and its target
+    GLuint texture() const { return texture_id_ ; }
+    GLenum target() const { return target_ ; }
+
 private:
     GLuint fbo_ = 0, texture_id_ = 0 ;
+    GLenum target_ = GL_TEXTURE_2D ;
+    GLuint width_ = 0, height_ = 0, layers_ = 0 ;
 };
 
 }}
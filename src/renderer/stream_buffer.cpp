@@ -0,0 +1,63 @@
+#include "stream_buffer.hpp"
+#include "profiler.hpp"
+
+#include <cstring>
+
+namespace xviz { namespace impl {
+
+StreamBuffer::~StreamBuffer() {
+    if ( id_ ) glDeleteBuffers(1, &id_) ;
+}
+
+void StreamBuffer::allocate(GLsizeiptr size) {
+    if ( id_ ) glDeleteBuffers(1, &id_) ;
+
+    glGenBuffers(1, &id_) ;
+    glBindBuffer(GL_ARRAY_BUFFER, id_) ;
+
+    size_ = size ;
+    region_ = 0 ;
+    frame_ = UINT64_MAX ;
+    ptr_ = nullptr ;
+
+    if ( persistentMappingSupported() ) {
+        // buffers created with glBufferStorage are immutable, so a new buffer is needed for every allocation
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT ;
+        glBufferStorage(GL_ARRAY_BUFFER, size * num_regions_, nullptr, flags) ;
+        ptr_ = (uint8_t *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size * num_regions_, flags) ;
+    }
+
+    if ( !ptr_ )
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW) ;
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+}
+
+bool StreamBuffer::next(uint64_t frame) {
+    if ( frame == frame_ ) return false ;
+
+    frame_ = frame ;
+    region_ = ( region_ + 1 ) % numRegions() ;
+    return true ;
+}
+
+void StreamBuffer::write(GLintptr offset, const void *data, GLsizeiptr size) {
+    if ( ptr_ )
+        memcpy(ptr_ + regionOffset() + offset, data, size) ;
+    else {
+        glBindBuffer(GL_ARRAY_BUFFER, id_) ;
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, data) ;
+        glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+    }
+
+    FrameProfiler::addUploadedBytes(size) ;
+}
+
+bool StreamBuffer::persistentMappingSupported() {
+    static int supported = -1 ;
+    if ( supported < 0 )
+        supported = gl3wIsSupported(4, 4) && glBufferStorage != nullptr ;
+    return supported ;
+}
+
+}}
@@ -0,0 +1,56 @@
+#ifndef XVIZ_RENDERER_STREAM_BUFFER_HPP
+#define XVIZ_RENDERER_STREAM_BUFFER_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <cstdint>
+
+namespace xviz { namespace impl {
+
+// Vertex buffer for data that change frequently. When persistent mapping is supported (GL 4.4) the storage holds
+// num_regions_ copies of the data that are written in turn through a mapping that stays valid for the lifetime of
+// the buffer, so that writing never waits for draw calls still reading the previous copies. The owner should not
+// write a region before the frames that used it have completed (see MeshDataManager::beginFrame).
+// Otherwise there is a single region updated with glBufferSubData.
+
+class StreamBuffer {
+public:
+    static const int num_regions_ = 3 ;
+
+    StreamBuffer() = default ;
+    ~StreamBuffer() ;
+
+    StreamBuffer(const StreamBuffer &) = delete ;
+    StreamBuffer &operator = (const StreamBuffer &) = delete ;
+
+    // (re)allocate storage for regions of the given size, the previous contents are lost
+    void allocate(GLsizeiptr size) ;
+
+    // make the next region current, returns false if a region was already written in this frame
+    bool next(uint64_t frame) ;
+
+    // copy data to the current region
+    void write(GLintptr offset, const void *data, GLsizeiptr size) ;
+
+    GLuint id() const { return id_ ; }
+    GLsizeiptr size() const { return size_ ; }
+
+    int region() const { return region_ ; }
+    int numRegions() const { return ptr_ ? num_regions_ : 1 ; }
+
+    // offset of the current region in the buffer
+    GLintptr regionOffset() const { return region_ * size_ ; }
+
+    static bool persistentMappingSupported() ;
+
+private:
+    GLuint id_ = 0 ;
+    GLsizeiptr size_ = 0 ;
+    uint8_t *ptr_ = nullptr ;
+    int region_ = 0 ;
+    uint64_t frame_ = UINT64_MAX ;
+};
+
+}}
+
+#endif
@@ -0,0 +1,39 @@
+#include "texture_buffer.hpp"
+#include "profiler.hpp"
+
+namespace xviz { namespace impl {
+
+TextureBuffer::~TextureBuffer() {
+    if ( texture_ )
+        glDeleteTextures(1, &texture_) ;
+    if ( buffer_ )
+        glDeleteBuffers(1, &buffer_) ;
+}
+
+void TextureBuffer::upload(const void *data, GLsizeiptr size) {
+    if ( buffer_ == 0 ) {
+        glGenBuffers(1, &buffer_) ;
+        glGenTextures(1, &texture_) ;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_) ;
+
+    if ( size > capacity_ ) {
+        glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW) ;
+        capacity_ = size ;
+
+        // the texture has to be attached again after the storage is reallocated
+        glBindTexture(GL_TEXTURE_BUFFER, texture_) ;
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_) ;
+        glBindTexture(GL_TEXTURE_BUFFER, 0) ;
+    } else {
+        glBufferData(GL_TEXTURE_BUFFER, capacity_, nullptr, GL_DYNAMIC_DRAW) ;
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data) ;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0) ;
+
+    FrameProfiler::addUploadedBytes(size) ;
+}
+
+}}
@@ -0,0 +1,33 @@
+#ifndef XVIZ_RENDERER_TEXTURE_BUFFER_HPP
+#define XVIZ_RENDERER_TEXTURE_BUFFER_HPP
+
+#include "common/gl/gl3w.h"
+
+namespace xviz { namespace impl {
+
+// Buffer object exposed to the shaders as a samplerBuffer of RGBA32F texels, for arrays that do not fit in a
+// uniform block. As with UniformBuffer the storage is reallocated when an upload does not fit, otherwise it is
+// orphaned and refilled.
+
+class TextureBuffer {
+public:
+    TextureBuffer() = default ;
+    ~TextureBuffer() ;
+
+    TextureBuffer(const TextureBuffer &) = delete ;
+    TextureBuffer &operator = (const TextureBuffer &) = delete ;
+
+    // replace the contents of the buffer, size is in bytes and should be a multiple of the texel size (16)
+    void upload(const void *data, GLsizeiptr size) ;
+
+    // buffer texture, to be bound to the GL_TEXTURE_BUFFER target
+    GLuint texture() const { return texture_ ; }
+
+private:
+    GLuint buffer_ = 0, texture_ = 0 ;
+    GLsizeiptr capacity_ = 0 ;
+};
+
+}}
+
+#endif
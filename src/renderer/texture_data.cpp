@@ -1,4 +1,5 @@
 #include "texture_data.hpp"
+#include "profiler.hpp"
 #include <xviz/common/image.hpp>
 #include <xviz/scene/material.hpp>
 
@@ -106,6 +107,7 @@ bool TextureData::create(Image *image, const Sampler2D &sampler)
         glBindTexture(GL_TEXTURE_2D, id_) ;
 
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        FrameProfiler::addUploadedBytes(width * height * 4) ;
 
         if ( sampler.generateMipMaps() )
             glGenerateMipmap(GL_TEXTURE_2D);
@@ -132,6 +134,8 @@ bool TextureData::create(Image *image, const Sampler2D &sampler)
             else if ( channels == 4 )
                 glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 
+            FrameProfiler::addUploadedBytes(width * height * channels) ;
+
             if ( sampler.generateMipMaps() )
                 glGenerateMipmap(GL_TEXTURE_2D);
 
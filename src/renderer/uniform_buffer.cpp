@@ -0,0 +1,45 @@
+#include "uniform_buffer.hpp"
+#include "profiler.hpp"
+
+namespace xviz { namespace impl {
+
+UniformBuffer::~UniformBuffer() {
+    if ( id_ )
+        glDeleteBuffers(1, &id_) ;
+}
+
+void UniformBuffer::upload(const void *data, GLsizeiptr size) {
+    if ( id_ == 0 )
+        glGenBuffers(1, &id_) ;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, id_) ;
+
+    if ( size > capacity_ ) {
+        glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW) ;
+        capacity_ = size ;
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, capacity_, nullptr, GL_DYNAMIC_DRAW) ;
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data) ;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0) ;
+
+    FrameProfiler::addUploadedBytes(size) ;
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_, id_) ;
+}
+
+void UniformBuffer::bindRange(GLintptr offset, GLsizeiptr size) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding_, id_, offset, size) ;
+}
+
+GLint UniformBuffer::offsetAlignment() {
+    static GLint alignment = 0 ;
+    if ( alignment == 0 ) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment) ;
+        if ( alignment <= 0 ) alignment = 256 ;
+    }
+    return alignment ;
+}
+
+}}
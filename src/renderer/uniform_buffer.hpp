@@ -0,0 +1,82 @@
+#ifndef XVIZ_RENDERER_UNIFORM_BUFFER_HPP
+#define XVIZ_RENDERER_UNIFORM_BUFFER_HPP
+
+#include <Eigen/Core>
+
+#include "common/gl/gl3w.h"
+
+namespace xviz { namespace impl {
+
+// Binding points of the uniform blocks declared in shaders/blocks.hpp and shaders/lights.hpp
+
+enum UniformBlockBinding { FRAME_BLOCK_BINDING = 0, LIGHTS_BLOCK_BINDING = 1, OBJECT_BLOCK_BINDING = 2 } ;
+
+// CPU side mirrors of the std140 blocks. Members are grouped so that every vec3 is followed by a float
+// and therefore the C++ layout matches the std140 one without explicit padding.
+
+struct FrameBlockData {
+    Eigen::Matrix4f view_ ;
+    Eigen::Matrix4f proj_ ;
+    Eigen::Vector4f eye_pos_ ;      // world coordinates, w = 1
+};
+
+struct ObjectBlockData {
+    Eigen::Matrix4f model_ ;
+    Eigen::Matrix4f mv_ ;
+    Eigen::Matrix4f mvp_ ;
+    Eigen::Matrix4f mvn_ ;          // normal matrix in the upper 3x3 block
+    uint32_t object_id_[4] = { 0, 0, 0, 0 } ;      // capture id in the first element
+};
+
+// element of the light arrays of LightsBlock, see LightSourceParameters in shaders/lights.hpp
+
+struct LightBlockData {
+    Eigen::Vector3f ambient_ = Eigen::Vector3f::Zero() ;
+    float spot_inner_cutoff_ = 0 ;
+    Eigen::Vector3f diffuse_ = Eigen::Vector3f::Zero() ;
+    float spot_outer_cutoff_ = 0 ;
+    Eigen::Vector3f specular_ = Eigen::Vector3f::Zero() ;
+    float constant_attenuation_ = 1 ;
+    Eigen::Vector3f position_ = Eigen::Vector3f::Zero() ;
+    float linear_attenuation_ = 0 ;
+    Eigen::Vector3f direction_ = Eigen::Vector3f::Zero() ;
+    float quadratic_attenuation_ = 0 ;
+    float shadow_bias_ = 0 ;
+    float padding_[3] = { 0, 0, 0 } ;
+};
+
+static_assert(sizeof(FrameBlockData) == 144, "FrameBlockData does not match the std140 layout") ;
+static_assert(sizeof(ObjectBlockData) == 272, "ObjectBlockData does not match the std140 layout") ;
+static_assert(sizeof(LightBlockData) == 96, "LightBlockData does not match the std140 layout") ;
+
+// Buffer object attached to a uniform buffer binding point. The storage is reallocated when an upload
+// does not fit, otherwise it is orphaned and refilled.
+
+class UniformBuffer {
+public:
+    UniformBuffer(GLuint binding): binding_(binding) {}
+    ~UniformBuffer() ;
+
+    UniformBuffer(const UniformBuffer &) = delete ;
+    UniformBuffer &operator = (const UniformBuffer &) = delete ;
+
+    // replace the contents of the buffer and attach it to the binding point
+    void upload(const void *data, GLsizeiptr size) ;
+
+    // attach part of the buffer to the binding point, offset should be a multiple of offsetAlignment()
+    void bindRange(GLintptr offset, GLsizeiptr size) const ;
+
+    GLuint binding() const { return binding_ ; }
+
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    static GLint offsetAlignment() ;
+
+private:
+    GLuint id_ = 0 ;
+    GLuint binding_ ;
+    GLsizeiptr capacity_ = 0 ;
+};
+
+}}
+
+#endif
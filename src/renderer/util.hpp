@@ -42,9 +42,9 @@ Eigen::Matrix<Scalar,4,4> ortho( Scalar const& left,
     mat(0,0) = Scalar(2) / (right - left);
     mat(1,1) = Scalar(2) / (top - bottom);
     mat(2,2) = - Scalar(2) / (zFar - zNear);
-    mat(3,0) = - (right + left) / (right - left);
-    mat(3,1) = - (top + bottom) / (top - bottom);
-    mat(3,2) = - (zFar + zNear) / (zFar - zNear);
+    mat(0,3) = - (right + left) / (right - left);
+    mat(1,3) = - (top + bottom) / (top - bottom);
+    mat(2,3) = - (zFar + zNear) / (zFar - zNear);
     return mat;
 }
 
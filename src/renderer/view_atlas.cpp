@@ -0,0 +1,167 @@
+#include "view_atlas.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace xviz { namespace impl {
+
+// larger atlases do not render faster but take more memory
+static const GLint max_atlas_size = 4096 ;
+
+ViewAtlas::~ViewAtlas() {
+    release() ;
+
+    for( Readback &rb: readbacks_ ) {
+        if ( rb.fence_ ) glDeleteSync(rb.fence_) ;
+        if ( rb.pbo_ ) glDeleteBuffers(1, &rb.pbo_) ;
+    }
+}
+
+void ViewAtlas::release() {
+    if ( fbo_ ) glDeleteFramebuffers(1, &fbo_) ;
+    if ( color_ ) glDeleteRenderbuffers(1, &color_) ;
+    if ( depth_ ) glDeleteRenderbuffers(1, &depth_) ;
+
+    fbo_ = color_ = depth_ = 0 ;
+}
+
+static GLuint createRenderbuffer(GLenum format, GLsizei width, GLsizei height) {
+    GLuint rb ;
+    glGenRenderbuffers(1, &rb) ;
+    glBindRenderbuffer(GL_RENDERBUFFER, rb) ;
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height) ;
+    return rb ;
+}
+
+void ViewAtlas::create(GLsizei width, GLsizei height) {
+    release() ;
+
+    glGenFramebuffers(1, &fbo_) ;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+
+    color_ = createRenderbuffer(GL_RGBA8, width, height) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_) ;
+
+    depth_ = createRenderbuffer(GL_DEPTH_COMPONENT24, width, height) ;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_) ;
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+        std::cerr << "view atlas framebuffer is not complete" << std::endl ;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0) ;
+}
+
+void ViewAtlas::begin(GLsizei tile_width, GLsizei tile_height, size_t max_tiles) {
+    assert(tile_width > 0 && tile_height > 0) ;
+
+    GLint max_size ;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size) ;
+    max_size = std::min(max_size, max_atlas_size) ;
+
+    size_t cols = std::max<size_t>(1, std::min<size_t>(max_size / tile_width, max_tiles)) ;
+    size_t rows = std::max<size_t>(1, std::min<size_t>(max_size / tile_height, ( max_tiles + cols - 1 ) / cols)) ;
+
+    if ( fbo_ && tile_width == tile_width_ && tile_height == tile_height_ && tiles() >= cols * rows ) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_) ;
+        return ;
+    }
+
+    tile_width_ = tile_width ;
+    tile_height_ = tile_height ;
+    cols_ = cols ;
+    rows_ = rows ;
+
+    create(cols * tile_width, rows * tile_height) ;
+}
+
+Viewport ViewAtlas::tile(size_t index) const {
+    Viewport vp ;
+    vp.x_ = ( index % cols_ ) * tile_width_ ;
+    vp.y_ = ( index / cols_ ) * tile_height_ ;
+    vp.width_ = tile_width_ ;
+    vp.height_ = tile_height_ ;
+    return vp ;
+}
+
+// Each view is read to its own range of the buffer so that its pixels are contiguous. The buffer of the oldest
+// page is reused, after copying out its pixels.
+
+void ViewAtlas::read(const std::vector<View> &views) {
+    Readback &rb = readbacks_[next_readback_] ;
+    next_readback_ = ( next_readback_ + 1 ) % num_readbacks_ ;
+
+    complete(rb) ;
+
+    GLsizeiptr size = 0 ;
+    for( const View &v: views )
+        size += v.width_ * v.height_ * 4 ;
+
+    if ( rb.pbo_ == 0 ) glGenBuffers(1, &rb.pbo_) ;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo_) ;
+
+    if ( size > rb.capacity_ ) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ) ;
+        rb.capacity_ = size ;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_) ;
+    glReadBuffer(GL_COLOR_ATTACHMENT0) ;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4) ;
+
+    GLintptr offset = 0 ;
+
+    for( size_t i=0 ; i<views.size() ; i++ ) {
+        const Viewport vp = tile(i) ;
+        glReadPixels(vp.x_, vp.y_, views[i].width_, views[i].height_, GL_RGBA, GL_UNSIGNED_BYTE, (void *)offset) ;
+        offset += views[i].width_ * views[i].height_ * 4 ;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+
+    rb.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) ;
+    rb.views_ = views ;
+}
+
+void ViewAtlas::complete(Readback &rb) {
+    if ( !rb.fence_ ) return ;
+
+    while ( glClientWaitSync(rb.fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED ) ;
+    glDeleteSync(rb.fence_) ;
+    rb.fence_ = nullptr ;
+
+    GLsizeiptr size = 0 ;
+    for( const View &v: rb.views_ )
+        size += v.width_ * v.height_ * 4 ;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo_) ;
+
+    if ( const unsigned char *pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT) ) {
+        for( const View &v: rb.views_ ) {
+            const size_t stride = v.width_ * 4 ;
+            unsigned char *bytes = new unsigned char [stride * v.height_] ;
+
+            for( GLsizei row=0 ; row<v.height_ ; row++ )
+                memcpy(bytes + row * stride, pixels + ( v.height_ - 1 - row ) * stride, stride) ;
+
+            *v.image_ = Image(bytes, ImageFormat::rgba32, v.width_, v.height_) ;
+            pixels += stride * v.height_ ;
+        }
+
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER) ;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) ;
+
+    rb.views_.clear() ;
+}
+
+void ViewAtlas::finish() {
+    // pages complete in the order they were read
+    for( uint32_t i=0 ; i<num_readbacks_ ; i++ )
+        complete(readbacks_[( next_readback_ + i ) % num_readbacks_]) ;
+}
+
+}}
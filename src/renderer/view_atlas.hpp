@@ -0,0 +1,73 @@
+#ifndef XVIZ_RENDERER_VIEW_ATLAS_HPP
+#define XVIZ_RENDERER_VIEW_ATLAS_HPP
+
+#include "common/gl/gl3w.h"
+
+#include <xviz/scene/camera.hpp>
+#include <xviz/common/image.hpp>
+
+#include <vector>
+
+namespace xviz { namespace impl {
+
+// Framebuffer of Renderer::renderViews, an RGBA8 color and a depth buffer divided into tiles of equal size, one per
+// view. A page of views is rendered into the tiles and read back into a pixel pack buffer, without waiting for the
+// GPU, while the next page is rendered. The pixels of a page are copied to the images when its buffer is needed
+// again or by finish. Rows are flipped during the copy, so that the images come out in top to bottom row order.
+
+class ViewAtlas {
+public:
+
+    ViewAtlas() = default ;
+    ~ViewAtlas() ;
+
+    ViewAtlas(const ViewAtlas &) = delete ;
+    ViewAtlas &operator = (const ViewAtlas &) = delete ;
+
+    // Bind the framebuffer, laid out for at most the given number of tiles of the given (non zero) size within the
+    // maximum renderbuffer size. It is reallocated only when the current one has a different tile size or fewer tiles.
+    void begin(GLsizei tile_width, GLsizei tile_height, size_t max_tiles) ;
+
+    // number of tiles of a page
+    size_t tiles() const { return cols_ * rows_ ; }
+
+    // viewport of the tile with the given index within the page
+    Viewport tile(size_t index) const ;
+
+    struct View {
+        Image *image_ ;             // receives the pixels of the view
+        GLsizei width_, height_ ;   // part of the tile covered by the view, from its lower left corner
+    };
+
+    // start reading a page, views[i] having been rendered in tile i
+    void read(const std::vector<View> &views) ;
+
+    // fill the images of all pages read so far, waiting for the GPU if needed
+    void finish() ;
+
+    static const uint32_t num_readbacks_ = 2 ;
+
+private:
+
+    struct Readback {
+        GLuint pbo_ = 0 ;
+        GLsizeiptr capacity_ = 0 ;
+        GLsync fence_ = nullptr ;
+        std::vector<View> views_ ;
+    };
+
+    void create(GLsizei width, GLsizei height) ;
+    void release() ;
+    void complete(Readback &rb) ;
+
+    GLuint fbo_ = 0, color_ = 0, depth_ = 0 ;
+    GLsizei tile_width_ = 0, tile_height_ = 0 ;
+    size_t cols_ = 0, rows_ = 0 ;
+
+    Readback readbacks_[num_readbacks_] ;
+    uint32_t next_readback_ = 0 ;
+};
+
+}}
+
+#endif
@@ -278,6 +278,9 @@ bool AssimpImporter::importMeshes(const aiScene *sc) {
 
         }
 
+        if ( ( options_ & Node::IMPORT_LODS ) && smesh->ptype() == Geometry::Triangles && !mesh->HasBones() )
+            smesh->generateLods() ;
+
         meshes_[mesh] = smesh ;
     }
 
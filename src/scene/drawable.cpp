@@ -1,6 +1,52 @@
 #include <xviz/scene/drawable.hpp>
 #include <xviz/scene/geometry.hpp>
 
+#include "renderer/instance_data.hpp"
+
+using namespace Eigen ;
+
 namespace xviz {
 
+InstancedDrawable::~InstancedDrawable() {
+    if ( data_ ) data_->release() ;
+}
+
+void InstancedDrawable::addInstance(const Affine3f &tr) {
+    assert( colors_.empty() ) ;
+    transforms_.push_back(tr) ;
+    setInstancesUpdated(true) ;
+}
+
+void InstancedDrawable::addInstance(const Affine3f &tr, const Vector4f &clr) {
+    assert( colors_.size() == transforms_.size() ) ;
+    transforms_.push_back(tr) ;
+    colors_.push_back(clr) ;
+    setInstancesUpdated(true) ;
+}
+
+void InstancedDrawable::setInstances(const std::vector<Affine3f> &trs, const std::vector<Vector4f> &colors) {
+    assert( colors.empty() || colors.size() == trs.size() ) ;
+    transforms_ = trs ;
+    colors_ = colors ;
+    setInstancesUpdated(true) ;
+}
+
+void InstancedDrawable::setInstanceTransform(size_t idx, const Affine3f &tr) {
+    assert( idx < transforms_.size() ) ;
+    transforms_[idx] = tr ;
+    setInstancesUpdated(true) ;
+}
+
+void InstancedDrawable::setInstanceColor(size_t idx, const Vector4f &clr) {
+    assert( idx < colors_.size() ) ;
+    colors_[idx] = clr ;
+    setInstancesUpdated(true) ;
+}
+
+void InstancedDrawable::clearInstances() {
+    transforms_.clear() ;
+    colors_.clear() ;
+    setInstancesUpdated(true) ;
+}
+
 }
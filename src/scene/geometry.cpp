@@ -3,6 +3,7 @@
 #include <xviz/scene/raycaster.hpp>
 #include <xviz/scene/detail/octree.hpp>
 #include <xviz/scene/detail/intersect.hpp>
+#include <xviz/scene/detail/simplify.hpp>
 
 #include "renderer/mesh_data.hpp"
 
@@ -648,20 +649,54 @@ void Geometry::computeBoundingBox(Vector3f &vmin, Vector3f &vmax) const {
     }
 }
 
+// A single simplifier is run with decreasing targets so that each level continues from the previous one. Levels that
+// do not remove at least a quarter of the triangles of the previous one are not worth a switch and end the chain.
+
+void Geometry::generateLods(uint32_t max_levels, float ratio, float max_error) {
+    lods_.clear() ;
+
+    if ( ptype_ != Triangles || vertices_.empty() ) return ;
+
+    detail::AABB box = getBoundingBox() ;
+    const float limit = max_error * ( box.bounds_[1] - box.bounds_[0] ).norm() ;
+
+    detail::MeshSimplifier simplifier(vertices_, indices_, normals_, tex_coords_[0]) ;
+
+    size_t triangles = simplifier.triangles() ;
+
+    for( uint32_t level = 0 ; level < max_levels ; level++ ) {
+        size_t target = triangles * ratio ;
+        if ( target == 0 ) break ;
+
+        size_t remaining = simplifier.simplify(target, limit) ;
+        if ( remaining > triangles * 3 / 4 ) break ;
+
+        triangles = remaining ;
+
+        Lod lod ;
+        simplifier.getIndices(lod.indices_) ;
+        lod.error_ = simplifier.error() ;
+        lods_.emplace_back(std::move(lod)) ;
+    }
+}
+
 
 bool Geometry::intersectTriangles(const Ray &ray, vector<RayTriangleHit> &results, bool back_face_culling) const
 {
     bool hit = false ;
 
+    // skinned meshes are intersected in the pose of the last rendered frame when it has been read back
+    const vb3_t &vertices = skinned_vertices_.size() == vertices_.size() ? skinned_vertices_ : vertices_ ;
+
     if ( !indices_.empty() ) {
         for( unsigned int i=0, ti =0 ; i<indices_.size() ; i+=3, ti++ ) {
             uint32_t idx0 = indices_[i] ;
             uint32_t idx1 = indices_[i+1] ;
             uint32_t idx2 = indices_[i+2] ;
 
-            const Vector3f &v0 = vertices_[idx0] ;
-            const Vector3f &v1 = vertices_[idx1] ;
-            const Vector3f &v2 = vertices_[idx2] ;
+            const Vector3f &v0 = vertices[idx0] ;
+            const Vector3f &v1 = vertices[idx1] ;
+            const Vector3f &v2 = vertices[idx2] ;
 
 
             float t ;
@@ -676,14 +711,14 @@ bool Geometry::intersectTriangles(const Ray &ray, vector<RayTriangleHit> &result
             }
         }
     } else {
-        for( unsigned int i=0, ti =0 ; i<vertices_.size() ; i+=3, ti++ ) {
+        for( unsigned int i=0, ti =0 ; i<vertices.size() ; i+=3, ti++ ) {
             uint32_t idx0 = i ;
             uint32_t idx1 = i+1 ;
             uint32_t idx2 = i+2 ;
 
-            const Vector3f &v0 = vertices_[idx0] ;
-            const Vector3f &v1 = vertices_[idx1] ;
-            const Vector3f &v2 = vertices_[idx2] ;
+            const Vector3f &v0 = vertices[idx0] ;
+            const Vector3f &v1 = vertices[idx1] ;
+            const Vector3f &v2 = vertices[idx2] ;
 
             float t ;
             if ( detail::rayIntersectsTriangle(ray, v0, v1, v2, back_face_culling, t) ) {
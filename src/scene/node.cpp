@@ -2,12 +2,23 @@
 #include <xviz/scene/geometry.hpp>
 
 #include <unordered_set>
+#include <atomic>
 
 using namespace Eigen ;
 using namespace std ;
 
 namespace xviz {
 
+static std::atomic<uint64_t> s_scene_revision{0} ;
+
+uint64_t sceneRevision() {
+    return s_scene_revision.load(std::memory_order_relaxed) ;
+}
+
+void touchScene() {
+    s_scene_revision.fetch_add(1, std::memory_order_relaxed) ;
+}
+
 
 NodePtr Node::findNodeByName(const std::string &name)
 {
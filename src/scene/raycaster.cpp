@@ -43,9 +43,12 @@ bool RayCaster::intersect(const Ray &tr, const GeometryPtr &geom, std::vector<Ra
                 }
             }
         } else { // expensive test
+            // the box encloses the bind pose, which is not the one of skinned vertices read back from the renderer
             float t ;
-            const auto box = geom->getBoundingBox() ;
-            if ( !rayIntersectsAABB(tr, box, t) ) return false ;
+            if ( geom->skinnedVertices().empty() ) {
+                const auto box = geom->getBoundingBox() ;
+                if ( !rayIntersectsAABB(tr, box, t) ) return false ;
+            }
 
             // expensive test
             vector<Geometry::RayTriangleHit> rh ;
@@ -0,0 +1,335 @@
+#include <xviz/scene/detail/simplify.hpp>
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+
+using namespace Eigen ;
+using namespace std ;
+
+namespace xviz { namespace detail {
+
+// weight of the constraint planes along open boundaries and attribute seams
+static const double constraint_weight = 10.0 ;
+
+// smallest cosine between the normals of a triangle before and after a collapse
+static const float min_normal_cosine = 0.2f ;
+
+void MeshSimplifier::Quadric::addPlane(const Vector4d &p, double weight) {
+    int k = 0 ;
+    for( int i=0 ; i<4 ; i++ )
+        for( int j=i ; j<4 ; j++ )
+            q_[k++] += weight * p[i] * p[j] ;
+}
+
+MeshSimplifier::Quadric &MeshSimplifier::Quadric::operator += (const Quadric &o) {
+    for( int k=0 ; k<10 ; k++ ) q_[k] += o.q_[k] ;
+    return *this ;
+}
+
+double MeshSimplifier::Quadric::evaluate(const Vector3f &v) const {
+    const double p[4] = { v.x(), v.y(), v.z(), 1.0 } ;
+
+    double e = 0 ;
+    int k = 0 ;
+    for( int i=0 ; i<4 ; i++ )
+        for( int j=i ; j<4 ; j++ )
+            e += ( i == j ? 1.0 : 2.0 ) * q_[k++] * p[i] * p[j] ;
+
+    return std::max(e, 0.0) ;
+}
+
+static Vector3f faceNormal(const Vector3f &p0, const Vector3f &p1, const Vector3f &p2) {
+    return (p1 - p0).cross(p2 - p0) ;
+}
+
+MeshSimplifier::MeshSimplifier(const vector<Vector3f> &vertices, const vector<uint32_t> &indices,
+                               const vector<Vector3f> &normals, const vector<Vector2f> &tex_coords):
+    normals_(normals), tex_coords_(tex_coords) {
+
+    // weld vertices with the same position
+
+    map<array<float, 3>, uint32_t> unique ;
+    welded_.resize(vertices.size()) ;
+
+    for( uint32_t i=0 ; i<vertices.size() ; i++ ) {
+        const Vector3f &v = vertices[i] ;
+        auto r = unique.emplace(array<float, 3>{v.x(), v.y(), v.z()}, (uint32_t)positions_.size()) ;
+        if ( r.second ) {
+            positions_.push_back(v) ;
+            wedges_.emplace_back() ;
+        }
+        welded_[i] = r.first->second ;
+        wedges_[welded_[i]].push_back(i) ;
+    }
+
+    const size_t n_corners = indices.empty() ? vertices.size() / 3 * 3 : indices.size() / 3 * 3 ;
+
+    for( size_t c=0 ; c<n_corners ; c+=3 ) {
+        Triangle t ;
+        for( int k=0 ; k<3 ; k++ ) {
+            t.corner_[k] = indices.empty() ? c + k : indices[c + k] ;
+            t.v_[k] = welded_[t.corner_[k]] ;
+        }
+
+        // triangles that collapse when welded are dropped
+        if ( t.v_[0] == t.v_[1] || t.v_[1] == t.v_[2] || t.v_[0] == t.v_[2] ) continue ;
+
+        triangles_.push_back(t) ;
+    }
+
+    remaining_ = triangles_.size() ;
+
+    faces_.resize(positions_.size()) ;
+    quadrics_.resize(positions_.size()) ;
+    stamps_.resize(positions_.size(), 0) ;
+
+    // quadrics of the triangle planes and edges shared by each triangle
+
+    map<pair<uint32_t, uint32_t>, vector<pair<uint32_t, int>>> edges ;
+
+    for( uint32_t i=0 ; i<triangles_.size() ; i++ ) {
+        const Triangle &t = triangles_[i] ;
+        Vector3f n = faceNormal(positions_[t.v_[0]], positions_[t.v_[1]], positions_[t.v_[2]]) ;
+
+        if ( n.norm() > 0 ) {
+            n.normalize() ;
+            Vector4d p(n.x(), n.y(), n.z(), -n.dot(positions_[t.v_[0]])) ;
+            for( int k=0 ; k<3 ; k++ )
+                quadrics_[t.v_[k]].addPlane(p, 1.0) ;
+        }
+
+        for( int k=0 ; k<3 ; k++ ) {
+            faces_[t.v_[k]].push_back(i) ;
+            uint32_t a = t.v_[k], b = t.v_[(k + 1) % 3] ;
+            edges[make_pair(std::min(a, b), std::max(a, b))].emplace_back(i, k) ;
+        }
+    }
+
+    // Boundary edges have a single triangle, seams have triangles whose corners differ in their attributes. Both are
+    // constrained by a plane through the edge perpendicular to each adjacent triangle.
+
+    for( const auto &e: edges ) {
+        const auto &adjacent = e.second ;
+        bool constrained = adjacent.size() == 1 ;
+
+        if ( adjacent.size() == 2 ) {
+            const Triangle &t0 = triangles_[adjacent[0].first], &t1 = triangles_[adjacent[1].first] ;
+            uint32_t a0 = t0.corner_[adjacent[0].second], b0 = t0.corner_[(adjacent[0].second + 1) % 3] ;
+            uint32_t a1 = t1.corner_[adjacent[1].second], b1 = t1.corner_[(adjacent[1].second + 1) % 3] ;
+            if ( welded_[a0] != welded_[a1] ) std::swap(a1, b1) ;
+            constrained = !sameWedge(a0, a1) || !sameWedge(b0, b1) ;
+        }
+
+        if ( !constrained ) continue ;
+
+        for( const auto &f: adjacent ) {
+            const Triangle &t = triangles_[f.first] ;
+            const Vector3f &pa = positions_[t.v_[f.second]], &pb = positions_[t.v_[(f.second + 1) % 3]] ;
+            Vector3f n = faceNormal(positions_[t.v_[0]], positions_[t.v_[1]], positions_[t.v_[2]]).cross(pb - pa) ;
+
+            if ( n.norm() == 0 ) continue ;
+            n.normalize() ;
+
+            Vector4d p(n.x(), n.y(), n.z(), -n.dot(pa)) ;
+            quadrics_[e.first.first].addPlane(p, constraint_weight) ;
+            quadrics_[e.first.second].addPlane(p, constraint_weight) ;
+        }
+    }
+
+    for( uint32_t v=0 ; v<positions_.size() ; v++ )
+        updateCandidate(v) ;
+}
+
+bool MeshSimplifier::sameWedge(uint32_t a, uint32_t b) const {
+    if ( a == b ) return true ;
+    if ( !normals_.empty() && normals_[a].dot(normals_[b]) < 0.999f * normals_[a].norm() * normals_[b].norm() ) return false ;
+    if ( !tex_coords_.empty() && ( tex_coords_[a] - tex_coords_[b] ).squaredNorm() > 1.0e-12f ) return false ;
+    return true ;
+}
+
+void MeshSimplifier::neighbours(uint32_t v, vector<uint32_t> &nv) const {
+    nv.clear() ;
+
+    for( uint32_t f: faces_[v] ) {
+        const Triangle &t = triangles_[f] ;
+        if ( t.removed_ ) continue ;
+        for( int k=0 ; k<3 ; k++ )
+            if ( t.v_[k] != v ) nv.push_back(t.v_[k]) ;
+    }
+
+    sort(nv.begin(), nv.end()) ;
+    nv.erase(unique(nv.begin(), nv.end()), nv.end()) ;
+}
+
+bool MeshSimplifier::canCollapse(uint32_t v, uint32_t target) const {
+
+    // link condition, the only vertices adjacent to both ends are the apexes of the triangles on the edge, otherwise
+    // the collapse would make the surface non-manifold
+
+    uint32_t edge_faces = 0 ;
+    for( uint32_t f: faces_[v] ) {
+        const Triangle &t = triangles_[f] ;
+        if ( !t.removed_ && t.contains(target) ) ++edge_faces ;
+    }
+
+    if ( edge_faces == 0 ) return false ;
+
+    vector<uint32_t> nv, nt, shared ;
+    neighbours(v, nv) ;
+    neighbours(target, nt) ;
+    set_intersection(nv.begin(), nv.end(), nt.begin(), nt.end(), back_inserter(shared)) ;
+
+    if ( shared.size() != edge_faces ) return false ;
+
+    // the remaining triangles around v should neither flip nor degenerate
+
+    for( uint32_t f: faces_[v] ) {
+        const Triangle &t = triangles_[f] ;
+        if ( t.removed_ || t.contains(target) ) continue ;
+
+        Vector3f p[3] ;
+        for( int k=0 ; k<3 ; k++ ) p[k] = positions_[t.v_[k]] ;
+
+        Vector3f n0 = faceNormal(p[0], p[1], p[2]) ;
+
+        for( int k=0 ; k<3 ; k++ )
+            if ( t.v_[k] == v ) p[k] = positions_[target] ;
+
+        Vector3f n1 = faceNormal(p[0], p[1], p[2]) ;
+
+        float l0 = n0.norm(), l1 = n1.norm() ;
+        if ( l1 <= 1.0e-6f * l0 ) return false ;
+        if ( l0 > 0 && n0.dot(n1) < min_normal_cosine * l0 * l1 ) return false ;
+    }
+
+    return true ;
+}
+
+// the cheapest valid collapse of v onto one of its neighbours is pushed to the heap
+
+void MeshSimplifier::updateCandidate(uint32_t v) {
+    ++stamps_[v] ;
+
+    vector<uint32_t> nv ;
+    neighbours(v, nv) ;
+
+    vector<pair<double, uint32_t>> costs ;
+
+    for( uint32_t n: nv ) {
+        Quadric q = quadrics_[v] ;
+        q += quadrics_[n] ;
+        costs.emplace_back(q.evaluate(positions_[n]), n) ;
+    }
+
+    sort(costs.begin(), costs.end()) ;
+
+    for( const auto &c: costs ) {
+        if ( canCollapse(v, c.second) ) {
+            heap_.push(Candidate{c.first, v, c.second, stamps_[v]}) ;
+            return ;
+        }
+    }
+}
+
+void MeshSimplifier::collapse(uint32_t v, uint32_t target) {
+    quadrics_[target] += quadrics_[v] ;
+
+    for( uint32_t f: faces_[v] ) {
+        Triangle &t = triangles_[f] ;
+        if ( t.removed_ ) continue ;
+
+        if ( t.contains(target) ) {
+            t.removed_ = true ;
+            --remaining_ ;
+        } else {
+            for( int k=0 ; k<3 ; k++ )
+                if ( t.v_[k] == v ) t.v_[k] = target ;
+            faces_[target].push_back(f) ;
+        }
+    }
+
+    faces_[v].clear() ;
+    ++stamps_[v] ;
+
+    auto &ft = faces_[target] ;
+    ft.erase(remove_if(ft.begin(), ft.end(), [this](uint32_t f) { return triangles_[f].removed_ ; }), ft.end()) ;
+
+    // the quadric of the target and the neighbourhood of the vertices around it have changed
+
+    vector<uint32_t> nv ;
+    neighbours(target, nv) ;
+
+    updateCandidate(target) ;
+    for( uint32_t n: nv )
+        updateCandidate(n) ;
+}
+
+size_t MeshSimplifier::simplify(size_t target, float max_error) {
+    const double max_cost = (double)max_error * (double)max_error ;
+
+    while ( remaining_ > target && !heap_.empty() ) {
+        Candidate c = heap_.top() ;
+
+        if ( c.stamp_ != stamps_[c.vertex_] ) {
+            heap_.pop() ;
+            continue ;
+        }
+
+        if ( c.cost_ > max_cost ) break ;
+
+        heap_.pop() ;
+
+        // the neighbourhood may have changed since the candidate was found without touching the vertex
+        if ( !canCollapse(c.vertex_, c.target_) ) {
+            updateCandidate(c.vertex_) ;
+            continue ;
+        }
+
+        collapse(c.vertex_, c.target_) ;
+        error_ = std::max(error_, (float)sqrt(c.cost_)) ;
+    }
+
+    return remaining_ ;
+}
+
+// A corner whose vertex was collapsed takes the wedge of its new vertex with the closest normal, so that creases and
+// attribute seams that survived keep their split vertices.
+
+void MeshSimplifier::getIndices(vector<uint32_t> &indices) const {
+    indices.clear() ;
+    indices.reserve(remaining_ * 3) ;
+
+    for( const Triangle &t: triangles_ ) {
+        if ( t.removed_ ) continue ;
+
+        for( int k=0 ; k<3 ; k++ ) {
+            uint32_t idx = t.corner_[k] ;
+
+            if ( welded_[idx] != t.v_[k] ) {
+                const auto &wedges = wedges_[t.v_[k]] ;
+                uint32_t best = wedges[0] ;
+
+                if ( !normals_.empty() ) {
+                    float best_dot = -std::numeric_limits<float>::max() ;
+                    for( uint32_t w: wedges ) {
+                        float d = normals_[w].dot(normals_[idx]) ;
+                        if ( d > best_dot ) {
+                            best_dot = d ;
+                            best = w ;
+                        }
+                    }
+                }
+
+                idx = best ;
+            }
+
+            indices.push_back(idx) ;
+        }
+    }
+}
+
+}}
@@ -0,0 +1,68 @@
+#include <xviz/headless/headless_context.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <cstring>
+
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Measures the Qt free headless context, linked without Qt: time until the first frame has been read back (including
+// the creation of the context) and render plus readback time per frame.
+//
+// usage: bench_headless [any|egl|osmesa] [async]
+//
+// async compiles the programs in the background when the driver supports GL_KHR_parallel_shader_compile
+
+using Clock = std::chrono::steady_clock ;
+
+int main(int argc, char *argv[]) {
+    const unsigned int width = 640, height = 480 ;
+    const int frames = 100 ;
+
+    HeadlessContext::Backend backend = HeadlessContext::Backend::Any ;
+    if ( argc > 1 && strcmp(argv[1], "egl") == 0 ) backend = HeadlessContext::Backend::EGL ;
+    else if ( argc > 1 && strcmp(argv[1], "osmesa") == 0 ) backend = HeadlessContext::Backend::OSMesa ;
+
+    bool async = argc > 2 && strcmp(argv[2], "async") == 0 ;
+
+    auto start = Clock::now() ;
+
+    HeadlessContext ctx(width, height, 0, backend) ;
+
+    if ( !ctx.isValid() ) {
+        std::cerr << "headless context: " << ctx.errorString() << std::endl ;
+        return 1 ;
+    }
+
+    ScenePtr scene = makeBoxGrid(20, 0.1f) ;
+    addDirectionalLight(scene, Vector3f(1, 1, 1)) ;
+
+    CameraPtr cam = makePerspectiveCamera(width, height, Vector3f(0, 2, 3)) ;
+
+    Renderer rdr ;
+    rdr.setAsyncShaderCompile(async) ;
+    rdr.precompile(scene) ;
+
+    rdr.render(scene, cam) ;
+    ctx.getImage() ;
+
+    std::cout << "backend: " << ( ctx.backend() == HeadlessContext::Backend::EGL ? "EGL" : "OSMesa" ) << std::endl ;
+    std::cout << "startup: " << msecs(start) << "ms" << std::endl ;
+
+    auto t = Clock::now() ;
+
+    for( int i=0 ; i<frames ; i++ ) {
+        rdr.render(scene, cam) ;
+        ctx.getImage() ;
+    }
+
+    double elapsed = msecs(t) ;
+
+    std::cout << "per frame: " << elapsed / frames << "ms (" << 1000 * frames / elapsed << " fps)" << std::endl ;
+}
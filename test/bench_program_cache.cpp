@@ -0,0 +1,114 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include "common/shader.hpp"
+#include "common/resource_manager.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include "util.hpp"
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders the first frame of a number of light setups, each one requiring new variants of the material programs,
+// and reports the time spent. Run it twice: the first run compiles all programs and fills the binary cache, the
+// second one loads them from the cache. Delete the cache folder to measure a cold start again.
+
+static ScenePtr makeScene(int dir_lights, int spot_lights, int point_lights, bool shadows) {
+    ScenePtr scene(new Scene) ;
+
+    NodePtr ground(new Node) ;
+    ground->addDrawable(GeometryPtr(new Geometry(Geometry::makePlane(4, 4, 8, 8))), MaterialPtr(new PhongMaterial(Vector3f(0.5, 0.5, 0.5)))) ;
+    ground->setTransform(Affine3f(Translation3f(0, -0.5, 0))) ;
+    scene->addChild(ground) ;
+
+    NodePtr sphere(new Node) ;
+    sphere->addDrawable(GeometryPtr(new SphereGeometry(0.4, 32, 24)), MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.3, 0.1)))) ;
+    scene->addChild(sphere) ;
+
+    GeometryPtr torus(new Geometry(Geometry::createSolidTorus(0.3, 0.1, 24, 32))) ;
+    for( const Vector3f &v: torus->vertices() )
+        torus->colors().push_back((v.normalized() + Vector3f::Ones()) * 0.5) ;
+
+    NodePtr tn(new Node) ;
+    tn->addDrawable(torus, MaterialPtr(new PerVertexColorMaterial())) ;
+    tn->setTransform(Affine3f(Translation3f(0.8, 0, 0))) ;
+    scene->addChild(tn) ;
+
+    NodePtr cube(new Node) ;
+    cube->addDrawable(GeometryPtr(new Geometry(Geometry::createSolidCube({0.2f, 0.2f, 0.2f}))), MaterialPtr(new ConstantMaterial(Vector4f(0, 1, 0, 1)))) ;
+    cube->setTransform(Affine3f(Translation3f(-0.8, 0, 0))) ;
+    scene->addChild(cube) ;
+
+    for( int i=0 ; i<dir_lights ; i++ ) {
+        DirectionalLight *dl = new DirectionalLight(Vector3f(1, 2, 1 - i)) ;
+        dl->setDiffuseColor(Vector3f(0.5, 0.5, 0.5)) ;
+        dl->setCastsShadows(shadows) ;
+        scene->addLightNode(LightPtr(dl)) ;
+    }
+
+    for( int i=0 ; i<spot_lights ; i++ ) {
+        SpotLight *sl = new SpotLight(Vector3f(i, 2, 0), Vector3f(0, -1, 0)) ;
+        sl->setDiffuseColor(Vector3f(0.5, 0.5, 0.5)) ;
+        sl->setCastsShadows(shadows) ;
+        scene->addLightNode(LightPtr(sl)) ;
+    }
+
+    for( int i=0 ; i<point_lights ; i++ ) {
+        PointLight *pl = new PointLight(Vector3f(1, 1, i)) ;
+        pl->setDiffuseColor(Vector3f(0.3, 0.3, 0.3)) ;
+        scene->addLightNode(LightPtr(pl)) ;
+    }
+
+    return scene ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("bench_program_cache", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+
+    QString cache_folder = QDir::temp().filePath("xviz_program_cache") ;
+    QDir().mkpath(cache_folder) ;
+
+    impl::OpenGLShaderResourceManager::setProgramCacheFolder(cache_folder.toStdString()) ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 20) ;
+    CameraPtr cam(pcam) ;
+    pcam->lookAt({0, 1, 2.5}, {0, 0, 0}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+
+    Renderer rdr ;
+
+    impl::OpenGLShaderProgram::stats().reset() ;
+
+    auto start = std::chrono::steady_clock::now() ;
+
+    for( int dir=0 ; dir<=2 ; dir++ )
+        for( int spot=0 ; spot<=1 ; spot++ )
+            for( int point=0 ; point<=1 ; point++ )
+                for( bool shadows: { false, true } ) {
+                    rdr.render(makeScene(dir, spot, point, shadows), cam) ;
+                }
+
+    glFinish() ;
+
+    double elapsed = msecs(start) ;
+
+    const impl::OpenGLShaderStats &stats = impl::OpenGLShaderProgram::stats() ;
+
+    std::cout << "cache folder: " << cache_folder.toStdString() << std::endl ;
+    std::cout << "programs compiled: " << stats.programs_compiled_ << std::endl ;
+    std::cout << "programs loaded from cache: " << stats.programs_loaded_ << std::endl ;
+    std::cout << "startup time: " << elapsed << "ms" << std::endl ;
+}
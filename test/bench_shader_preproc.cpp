@@ -0,0 +1,69 @@
+#include "common/shader.hpp"
+#include "common/shader_source.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "bench_util.hpp"
+
+using namespace xviz::impl ;
+using namespace std ;
+
+// Preprocesses all variants of the Phong vertex and fragment shaders, i.e. every combination of light counts and
+// material features, and reports the time spent. The first pass parses the resources and generates each variant,
+// the second one only looks up the variants in the cache.
+
+static size_t preprocessAll() {
+    size_t bytes = 0 ;
+
+    for( int dl=0 ; dl<=2 ; dl++ )
+        for( int dls=0 ; dls<=1 ; dls++ )
+            for( int sl=0 ; sl<=1 ; sl++ )
+                for( int sls=0 ; sls<=1 ; sls++ )
+                    for( int pl=0 ; pl<=1 ; pl++ )
+                        for( int pls=0 ; pls<=1 ; pls++ )
+                            for( int flags=0 ; flags<16 ; flags++ ) {
+                                bool has_shadows = dls + sls + pls > 0 ;
+                                int num_lights = dl + dls + sl + sls + pl + pls ;
+
+                                OpenGLShaderPreproc lights ;
+                                lights.appendConstant("NUM_DIRECTIONAL_LIGHTS", to_string(dl)) ;
+                                lights.appendConstant("NUM_DIRECTIONAL_LIGHTS_WITH_SHADOW", to_string(dls), has_shadows) ;
+                                lights.appendConstant("NUM_SPOT_LIGHTS", to_string(sl)) ;
+                                lights.appendConstant("NUM_SPOT_LIGHTS_WITH_SHADOW", to_string(sls), has_shadows) ;
+                                lights.appendConstant("NUM_POINT_LIGHTS", to_string(pl)) ;
+                                lights.appendConstant("NUM_POINT_LIGHTS_WITH_SHADOW", to_string(pls), has_shadows) ;
+                                lights.appendConstant("NUM_LIGHTS", to_string(num_lights), num_lights > 0) ;
+
+                                OpenGLShaderPreproc vs = lights ;
+                                vs.appendDefinition("HAS_SHADOWS", has_shadows) ;
+                                vs.appendDefinition("HAS_NORMALS") ;
+                                vs.appendDefinition("HAS_UVs", flags & 1) ;
+                                vs.appendDefinition("USE_SKINNING", flags & 2) ;
+                                vs.appendDefinition("USE_INSTANCING", flags & 4) ;
+                                vs.appendDefinition("HAS_INSTANCE_COLORS", flags & 8) ;
+
+                                OpenGLShaderPreproc fs = lights ;
+                                fs.appendDefinition("HAS_DIFFUSE_MAP", flags & 1) ;
+                                fs.appendDefinition("HAS_INSTANCE_COLORS", flags & 8) ;
+                                fs.appendDefinition("HAS_SHADOWS", has_shadows) ;
+
+                                bytes += OpenGLShaderSource::preprocess("@vertex_shader", vs).size() ;
+                                bytes += OpenGLShaderSource::preprocess("@phong_fragment_shader", fs).size() ;
+                            }
+
+    return bytes ;
+}
+
+int main(int argc, char *argv[]) {
+    OpenGLShaderSource::clearCache() ;
+
+    for( const char *pass: { "cold", "cached" } ) {
+        auto start = std::chrono::steady_clock::now() ;
+        size_t bytes = preprocessAll() ;
+        double elapsed = msecs(start) ;
+
+        cout << pass << ": 1536 vertex and fragment shader variants, " << bytes << " bytes, " << elapsed << "ms" << endl ;
+    }
+}
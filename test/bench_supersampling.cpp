@@ -0,0 +1,71 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include <chrono>
+#include <iostream>
+
+#include "util.hpp"
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders images of a grid of rotated boxes with Renderer::renderImage at several quality settings, and reports the
+// time per image and the framebuffers created or reused by the render target pool in the last call.
+
+using Clock = std::chrono::steady_clock ;
+
+int main(int argc, char *argv[]) {
+    TestApplication app("bench_supersampling", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const int grid = 10, frames = 20 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene = makeBoxGrid(grid, 0.15f) ;
+
+    // rotate the boxes of each row so that their edges are not aligned with the pixels
+    for( size_t k=0 ; k<scene->numChildren() ; k++ )
+        scene->getChild(k)->transform().rotate(AngleAxisf(0.3f * (k / grid), Vector3f::UnitY())) ;
+
+    addDirectionalLight(scene, Vector3f(1, 2, 1)) ;
+
+    CameraPtr cam = makePerspectiveCamera(width, height, Vector3f(1.5, 1.2, 1.8)) ;
+
+    struct Setting {
+        const char *name_ ;
+        uint32_t samples_, supersampling_ ;
+        DownsampleFilter filter_ ;
+    };
+
+    const Setting settings[] = {
+        { "plain", 0, 1, DownsampleFilter::Box },
+        { "msaa 4x", 4, 1, DownsampleFilter::Box },
+        { "supersampling 2x box", 0, 2, DownsampleFilter::Box },
+        { "supersampling 3x lanczos", 0, 3, DownsampleFilter::Lanczos },
+        { "msaa 4x + supersampling 2x lanczos", 4, 2, DownsampleFilter::Lanczos }
+    } ;
+
+    Renderer rdr ;
+    Image image ;
+
+    // compile the programs before timing
+    rdr.renderImage(scene, cam, image) ;
+
+    for( const Setting &s: settings ) {
+        auto start = Clock::now() ;
+
+        for( int i=0 ; i<frames ; i++ )
+            rdr.renderImage(scene, cam, image, s.samples_, s.supersampling_, s.filter_) ;
+
+        double elapsed = msecs(start) ;
+
+        const FrameStats &stats = rdr.frameStats() ;
+
+        std::cout << s.name_ << ": " << elapsed / frames << "ms per image, render targets allocated: "
+                  << stats.render_targets_allocated_ << ", reused: " << stats.render_targets_reused_ << std::endl ;
+    }
+}
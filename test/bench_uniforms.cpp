@@ -0,0 +1,74 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include "common/shader.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include "util.hpp"
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders a grid of boxes lit by several lights and reports the uniform related driver calls per frame.
+// Before uniform locations were cached every uniform set resulted in a glGetUniformLocation call, i.e. the
+// number of location queries per frame was equal to the number of uniform sets.
+
+int main(int argc, char *argv[]) {
+    TestApplication app("bench_uniforms", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const int grid = 20, frames = 100 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene = makeBoxGrid(grid, 0.1f) ;
+    addDirectionalLight(scene, Vector3f(1, 1, 1), 0.5) ;
+
+    SpotLight *sl = new SpotLight(Vector3f(0, 2, 0), Vector3f(0, -1, 0)) ;
+    sl->setDiffuseColor(Vector3f(0.5, 0.5, 0.5)) ;
+    scene->addLightNode(LightPtr(sl)) ;
+
+    PointLight *pl = new PointLight(Vector3f(1, 1, 1)) ;
+    pl->setDiffuseColor(Vector3f(0.3, 0.3, 0.3)) ;
+    scene->addLightNode(LightPtr(pl)) ;
+
+    CameraPtr cam = makePerspectiveCamera(width, height, Vector3f(0, 2, 3)) ;
+
+    Renderer rdr ;
+
+    // first frame compiles the programs and resolves the uniform locations
+
+    impl::OpenGLShaderProgram::stats().reset() ;
+    rdr.render(scene, cam) ;
+
+    const impl::OpenGLShaderStats setup = impl::OpenGLShaderProgram::stats() ;
+
+    impl::OpenGLShaderProgram::stats().reset() ;
+
+    auto start = std::chrono::steady_clock::now() ;
+
+    for( int i=0 ; i<frames ; i++ )
+        rdr.render(scene, cam) ;
+
+    glFinish() ;
+
+    double elapsed = msecs(start) ;
+
+    const impl::OpenGLShaderStats &stats = impl::OpenGLShaderProgram::stats() ;
+
+    std::cout << "drawables: " << grid * grid << std::endl ;
+    std::cout << "setup location queries: " << setup.location_queries_ << std::endl ;
+    std::cout << "per frame:" << std::endl ;
+    std::cout << "  location queries: " << stats.location_queries_ / frames << std::endl ;
+    std::cout << "  uniform sets: " << stats.uniform_sets_ / frames
+              << " (location queries without caching)" << std::endl ;
+    std::cout << "  uniform uploads: " << stats.uniform_uploads_ / frames << std::endl ;
+    std::cout << "  name lookups: " << stats.name_lookups_ / frames << std::endl ;
+    std::cout << "  time: " << elapsed / frames << "ms" << std::endl ;
+}
@@ -0,0 +1,44 @@
+#include "bench_util.hpp"
+
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+using namespace xviz ;
+using namespace Eigen ;
+
+double msecs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count() ;
+}
+
+ScenePtr makeBoxGrid(int grid, float spacing, const MaterialPtr &material) {
+    ScenePtr scene(new Scene) ;
+
+    GeometryPtr box_geom(new Geometry(Geometry::createSolidCube({0.04f, 0.04f, 0.04f})));
+
+    for( int i=0 ; i<grid ; i++ )
+        for( int j=0 ; j<grid ; j++ ) {
+            NodePtr box(new Node) ;
+            MaterialPtr mat = material ;
+            if ( !mat ) mat.reset(new PhongMaterial(Vector3f(i/float(grid), j/float(grid), 0.5f))) ;
+            box->addDrawable(box_geom, mat) ;
+            box->setTransform(Affine3f(Translation3f(spacing * (i - grid/2), 0, spacing * (j - grid/2)))) ;
+            scene->addChild(box) ;
+        }
+
+    return scene ;
+}
+
+DirectionalLight *addDirectionalLight(const ScenePtr &scene, const Vector3f &dir, float diffuse) {
+    DirectionalLight *dl = new DirectionalLight(dir) ;
+    dl->setDiffuseColor(Vector3f(diffuse, diffuse, diffuse)) ;
+    scene->addLightNode(LightPtr(dl)) ;
+    return dl ;
+}
+
+CameraPtr makePerspectiveCamera(unsigned int width, unsigned int height, const Vector3f &eye) {
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 20) ;
+    pcam->lookAt(eye, {0, 0, 0}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+    return CameraPtr(pcam) ;
+}
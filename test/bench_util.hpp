@@ -0,0 +1,22 @@
+#pragma once
+
+#include <xviz/scene/scene_fwd.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/light.hpp>
+
+#include <chrono>
+
+// helpers of the benchmarks, free of Qt so that they may also be used with a headless context
+
+// milliseconds elapsed since the given time
+double msecs(std::chrono::steady_clock::time_point since) ;
+
+// Scene of grid x grid boxes of 4cm on the y = 0 plane, spaced by spacing around the origin. The boxes share
+// material when given, otherwise each one is colored by its position in the grid.
+xviz::ScenePtr makeBoxGrid(int grid, float spacing, const xviz::MaterialPtr &material = nullptr) ;
+
+// add a directional light with a gray diffuse color of the given level to the scene
+xviz::DirectionalLight *addDirectionalLight(const xviz::ScenePtr &scene, const Eigen::Vector3f &dir, float diffuse = 1) ;
+
+// camera with a vertical field of view of 50 degrees and a viewport of the given size, looking at the origin from eye
+xviz::CameraPtr makePerspectiveCamera(unsigned int width, unsigned int height, const Eigen::Vector3f &eye) ;
@@ -0,0 +1,77 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <chrono>
+#include <iostream>
+
+#include "util.hpp"
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders a shadowed grid of boxes from cameras placed on a circle, once with a call to render and getImage per
+// camera and once with a single call to renderViews, and reports the number of views rendered per second.
+
+using Clock = std::chrono::steady_clock ;
+
+int main(int argc, char *argv[]) {
+    TestApplication app("bench_views", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const int grid = 20, views = 200 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene = makeBoxGrid(grid, 0.1f, MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.5, 0.2)))) ;
+
+    NodePtr floor(new Node) ;
+    floor->addDrawable(GeometryPtr(new Geometry(Geometry::createSolidCube({3.0f, 0.01f, 3.0f}))),
+                       MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.8, 0.8)))) ;
+    floor->setTransform(Affine3f(Translation3f(0, -0.05f, 0))) ;
+    scene->addChild(floor) ;
+
+    DirectionalLight *dl = addDirectionalLight(scene, Vector3f(1, 2, 1)) ;
+    dl->setShadowCamera(OrthographicCamera(-1.5, 1.5, 1.5, -1.5, 0.01, 10)) ;
+    dl->setCastsShadows(true) ;
+
+    std::vector<CameraPtr> cams ;
+
+    for( int k=0 ; k<views ; k++ ) {
+        float a = 2 * M_PI * k / views ;
+        cams.emplace_back(makePerspectiveCamera(width, height, Vector3f(3 * cos(a), 1.5f, 3 * sin(a)))) ;
+    }
+
+    Renderer rdr ;
+
+    // compile the programs and render the shadow map before timing
+    rdr.render(scene, cams[0]) ;
+
+    auto start = Clock::now() ;
+
+    for( const CameraPtr &cam: cams ) {
+        rdr.render(scene, cam) ;
+        os.getImage() ;
+    }
+
+    double sequential = msecs(start) ;
+
+    std::vector<Image> images ;
+
+    start = Clock::now() ;
+    rdr.renderViews(scene, cams, images) ;
+    double batched = msecs(start) ;
+
+    const FrameStats &stats = rdr.frameStats() ;
+
+    std::cout << "views: " << views << " (" << width << "x" << height << ")" << std::endl ;
+    std::cout << "render + getImage: " << 1000 * views / sequential << " views/s" << std::endl ;
+    std::cout << "renderViews: " << 1000 * views / batched << " views/s" << std::endl ;
+    std::cout << "  scene walks: " << stats.scene_walks_ << ", shadow passes: " << stats.shadow_passes_
+              << ", draw calls: " << stats.draw_calls_ << std::endl ;
+}
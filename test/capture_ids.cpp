@@ -0,0 +1,118 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Captures a scene of plain and instanced drawables and checks that the id found at the projected center of each
+// drawable, or instance, is mapped back to it by Capture::lookup, that the background has no id and that the linear
+// depth is set wherever an id is.
+
+struct Expected {
+    Vector3f center_ ;
+    NodePtr node_ ;
+    const Drawable *drawable_ ;
+    InstancedDrawablePtr instanced_ ;
+    uint32_t instance_ ;
+};
+
+// pixel of a world position, rows counted from the top as in the images of the capture
+static Vector2i project(const CameraPtr &cam, const Vector3f &p) {
+    Vector4f clip = cam->getProjectionMatrix() * cam->getViewMatrix() * p.homogeneous() ;
+    Vector3f ndc = clip.head<3>() / clip.w() ;
+    const Viewport &vp = cam->getViewport() ;
+    return { int(( ndc.x() * 0.5f + 0.5f ) * vp.width_), int(( 0.5f - ndc.y() * 0.5f ) * vp.height_) } ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("capture_ids", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene(new Scene) ;
+    std::vector<Expected> expected ;
+
+    GeometryPtr box(new BoxGeometry({0.2, 0.2, 0.2})) ;
+
+    for( int i=0 ; i<2 ; i++ ) {
+        NodePtr node(new Node) ;
+        node->addDrawable(box, MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.3 * i, 0.1)))) ;
+        node->setTransform(Affine3f(Translation3f(i - 1.0f, 0, 0))) ;
+        scene->addChild(node) ;
+        expected.push_back({ Vector3f(i - 1.0f, 0, 0), node, &node->drawables()[0], nullptr, 0 }) ;
+    }
+
+    InstancedDrawablePtr instanced(new InstancedDrawable(box, MaterialPtr(new PhongMaterial(Vector3f(0.2, 0.5, 0.8))))) ;
+    NodePtr inode(new Node) ;
+    inode->setTransform(Affine3f(Translation3f(1, 0, 0))) ;
+    inode->addInstancedDrawable(instanced) ;
+    scene->addChild(inode) ;
+
+    for( uint32_t i=0 ; i<3 ; i++ ) {
+        Vector3f offset(0, 0, 0.8f * i - 0.8f) ;
+        instanced->addInstance(Affine3f(Translation3f(offset))) ;
+        expected.push_back({ Vector3f(1, 0, 0) + offset, inode, nullptr, instanced, i }) ;
+    }
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(1, 2, 1)) ;
+    dl->setDiffuseColor(Vector3f(0.8, 0.8, 0.8)) ;
+    scene->addLightNode(LightPtr(dl)) ;
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 20) ;
+    CameraPtr cam(pcam) ;
+    pcam->lookAt({0, 2.5, 2.5}, {0, 0, 0}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+
+    Renderer rdr ;
+    Capture capture ;
+    rdr.capture(scene, cam, capture) ;
+
+    const uint32_t *ids = reinterpret_cast<const uint32_t *>(capture.ids_.data()) ;
+    const float *depth = reinterpret_cast<const float *>(capture.depth_.data()) ;
+
+    bool ok = true ;
+
+    if ( capture.ids_.width() != width || capture.ids_.height() != height ) {
+        std::cout << "id target of size " << capture.ids_.width() << "x" << capture.ids_.height() << std::endl ;
+        return 1 ;
+    }
+
+    for( const Expected &e: expected ) {
+        Vector2i px = project(cam, e.center_) ;
+        size_t idx = size_t(px.y()) * width + px.x() ;
+        uint32_t id = ids[idx] ;
+
+        const CaptureId *found = capture.lookup(id) ;
+
+        bool match = found && found->node_ == e.node_ && found->drawable_ == e.drawable_ &&
+                found->instanced_ == e.instanced_ && found->instance_ == e.instance_ ;
+
+        if ( !match || depth[idx] <= 0 ) {
+            std::cout << "wrong id " << id << " or depth " << depth[idx] << " at pixel " << px.x() << ", " << px.y() << std::endl ;
+            ok = false ;
+        }
+    }
+
+    // the top of the view only sees the background
+    if ( ids[0] != 0 || capture.lookup(ids[0]) != nullptr || depth[0] != 0 ) {
+        std::cout << "background pixel has id " << ids[0] << " and depth " << depth[0] << std::endl ;
+        ok = false ;
+    }
+
+    std::cout << capture.drawables_.size() << " ids for " << expected.size() << " drawables and instances" << std::endl ;
+
+    if ( capture.drawables_.size() != expected.size() ) ok = false ;
+
+    return ok ? 0 : 1 ;
+}
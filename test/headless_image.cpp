@@ -0,0 +1,54 @@
+#include <xviz/headless/headless_context.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include <iostream>
+#include <cstring>
+
+#include "image_check.hpp"
+
+using namespace xviz ;
+
+// Renders the reference scene with a headless context and compares it with the reference image, which is also
+// matched by test_offscreen_image with the Qt surface. Exits with a nonzero status on mismatch or when the context
+// cannot be created.
+//
+// usage: test_headless_image [egl|osmesa] [reference folder]
+//
+// Each backend is checked by its own run, since the programs of the renderer are shared by the whole process.
+
+int main(int argc, char *argv[]) {
+    const unsigned int width = 160, height = 120 ;
+
+    HeadlessContext::Backend backend = HeadlessContext::Backend::Any ;
+    if ( argc > 1 && strcmp(argv[1], "egl") == 0 ) backend = HeadlessContext::Backend::EGL ;
+    else if ( argc > 1 && strcmp(argv[1], "osmesa") == 0 ) backend = HeadlessContext::Backend::OSMesa ;
+
+    std::string folder = argc > 2 ? argv[2] : REFERENCE_DIR ;
+
+    HeadlessContext ctx(width, height, 0, backend) ;
+
+    if ( !ctx.isValid() ) {
+        std::cerr << "headless context: " << ctx.errorString() << std::endl ;
+        return 1 ;
+    }
+
+    std::cout << "backend: " << ( ctx.backend() == HeadlessContext::Backend::EGL ? "EGL" : "OSMesa" ) << std::endl ;
+
+    ScenePtr scene ;
+    CameraPtr cam ;
+    makeReferenceView(scene, cam, width, height) ;
+
+    Image image ;
+
+    {
+        Renderer rdr ;
+        rdr.render(scene, cam) ;
+        image = ctx.getImage(false) ;
+    }
+
+    bool ok = compareWithReference(image, readPPM(folder + "boxes.ppm"), "headless_image.ppm") ;
+
+    return ok ? 0 : 1 ;
+}
@@ -0,0 +1,83 @@
+#include "image_check.hpp"
+#include "bench_util.hpp"
+
+#include <xviz/scene/scene.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+
+using namespace xviz ;
+using namespace Eigen ;
+
+void makeReferenceView(ScenePtr &scene, CameraPtr &cam, unsigned int width, unsigned int height) {
+    scene = makeBoxGrid(5, 0.12f) ;
+    addDirectionalLight(scene, Vector3f(1, 2, 1)) ;
+    cam = makePerspectiveCamera(width, height, Vector3f(0.6, 0.6, 0.8)) ;
+}
+
+Image readPPM(const std::string &path) {
+    std::ifstream strm(path, std::ios::binary) ;
+
+    std::string magic ;
+    uint32_t width = 0, height = 0, max_value = 0 ;
+
+    strm >> magic >> width >> height >> max_value ;
+    strm.get() ;
+
+    if ( !strm || magic != "P6" || max_value != 255 || width == 0 || height == 0 ) return Image() ;
+
+    size_t size = size_t(width) * height * 3 ;
+    unsigned char *bytes = new unsigned char [size] ;
+
+    if ( !strm.read((char *)bytes, size) ) {
+        delete [] bytes ;
+        return Image() ;
+    }
+
+    return Image(bytes, ImageFormat::rgb24, width, height) ;
+}
+
+bool writePPM(const std::string &path, const Image &image) {
+    std::ofstream strm(path, std::ios::binary) ;
+    strm << "P6\n" << image.width() << ' ' << image.height() << "\n255\n" ;
+    strm.write((const char *)image.data(), size_t(image.width()) * image.height() * 3) ;
+    return (bool)strm ;
+}
+
+bool compareWithReference(const Image &rendered, const Image &reference, const std::string &failed_path,
+                          int tolerance) {
+    if ( reference.type() != ImageType::Raw ) {
+        std::cerr << "reference image could not be read" << std::endl ;
+        return false ;
+    }
+
+    if ( rendered.width() != reference.width() || rendered.height() != reference.height() ) {
+        std::cerr << "image size differs from the reference" << std::endl ;
+        return false ;
+    }
+
+    const unsigned char *a = rendered.data(), *b = reference.data() ;
+    size_t n = size_t(rendered.width()) * rendered.height() ;
+
+    size_t count = 0 ;
+    int max_diff = 0 ;
+
+    for( size_t i=0 ; i<n ; i++ ) {
+        int d = 0 ;
+        for( int c=0 ; c<3 ; c++ )
+            d = std::max(d, std::abs(int(a[3*i + c]) - int(b[3*i + c]))) ;
+
+        max_diff = std::max(max_diff, d) ;
+        if ( d > tolerance ) ++count ;
+    }
+
+    std::cout << "max difference: " << max_diff << ", pixels above tolerance: " << count << " of " << n << std::endl ;
+
+    if ( count * 100 <= n ) return true ;
+
+    writePPM(failed_path, rendered) ;
+    std::cerr << "rendered image written to " << failed_path << std::endl ;
+
+    return false ;
+}
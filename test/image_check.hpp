@@ -0,0 +1,23 @@
+#pragma once
+
+#include <xviz/common/image.hpp>
+#include <xviz/scene/scene_fwd.hpp>
+
+#include <string>
+
+// helpers of the tests that compare rendered images with the references of test/data/reference, free of Qt
+
+// scene and camera of the reference images: a grid of boxes lit by a directional light, seen from above
+void makeReferenceView(xviz::ScenePtr &scene, xviz::CameraPtr &cam, unsigned int width, unsigned int height) ;
+
+// read a binary PPM file into an rgb24 image, null on failure
+xviz::Image readPPM(const std::string &path) ;
+
+// write an rgb24 image as a binary PPM file
+bool writePPM(const std::string &path, const xviz::Image &image) ;
+
+// Compare rendered with the reference image, which both have to be rgb24 of the same size. At most 1% of the pixels
+// may have a channel differing by more than tolerance, which leaves room for the rasterization of edges by
+// different drivers. On failure the rendered image is written to failed_path.
+bool compareWithReference(const xviz::Image &rendered, const xviz::Image &reference, const std::string &failed_path,
+                          int tolerance = 8) ;
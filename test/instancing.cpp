@@ -0,0 +1,91 @@
+#include <xviz/gui/viewer.hpp>
+
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/node_helpers.hpp>
+#include <random>
+
+#include <QMainWindow>
+#include <QApplication>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+using namespace std ;
+
+std::mt19937 g_rng(1) ;
+
+static float rnd_uniform(float a, float b) {
+   std::uniform_real_distribution<> dis(a, b);
+   return dis(g_rng) ;
+}
+
+// a field of markers drawn through an InstancedDrawable, each with its own color
+
+NodePtr makeMarkers(unsigned int n) {
+    NodePtr node(new Node) ;
+
+    GeometryPtr sphere(new SphereGeometry(0.01)) ;
+    InstancedDrawablePtr markers(new InstancedDrawable(sphere, MaterialPtr(new PhongMaterial()))) ;
+
+    for( unsigned int i=0 ; i<n ; i++ ) {
+        Affine3f tr = Affine3f::Identity() ;
+        tr.translate(Vector3f(rnd_uniform(-0.9, 0.9), rnd_uniform(0.0, 0.5), rnd_uniform(-0.9, 0.9))) ;
+        markers->addInstance(tr, Vector4f(rnd_uniform(0, 1), rnd_uniform(0, 1), rnd_uniform(0, 1), 1)) ;
+    }
+
+    node->addInstancedDrawable(markers) ;
+
+    return node ;
+}
+
+// boxes attached to separate nodes sharing geometry and material, these are batched automatically by the renderer
+
+void addBoxes(ScenePtr &scene, unsigned int n) {
+    GeometryPtr geom(new BoxGeometry({0.02, 0.05, 0.02})) ;
+    MaterialPtr mat(new PhongMaterial({0.5, 0.5, 0.8})) ;
+
+    for( unsigned int i=0 ; i<n ; i++ ) {
+        NodePtr box(new Node) ;
+        box->addDrawable(geom, mat) ;
+        box->transform().translate(Vector3f(rnd_uniform(-0.9, 0.9), -0.25, rnd_uniform(-0.9, 0.9))) ;
+        box->transform().rotate(AngleAxisf(rnd_uniform(0, M_PI), Vector3f::UnitY())) ;
+        scene->addChild(box) ;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    TestApplication app("instancing", argc, argv) ;
+
+    ScenePtr scene(new Scene) ;
+
+    NodePtr ground(new Node) ;
+    ground->transform().translate(Vector3f{0, -0.3, 0}) ;
+    ground->addDrawable(GeometryPtr(new Geometry(Geometry::makePlane(2, 2, 2, 2))), MaterialPtr(new PhongMaterial({0.3, 0.3, 0.3}, 1))) ;
+    scene->addChild(ground) ;
+
+    scene->addChild(makeMarkers(10000)) ;
+    addBoxes(scene, 1000) ;
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(0, 4, 4)) ;
+    dl->setDiffuseColor(Vector3f(0.9, 0.9, 0.9)) ;
+    dl->setShadowCamera(OrthographicCamera(-1.5, 1.5, 1.5, -1.5, 0.01, 10)) ;
+    dl->setShadowBias(0.0005);
+    dl->setCastsShadows(true);
+    scene->addLightNode(LightPtr(dl)) ;
+
+    SceneViewer::initDefaultGLContext();
+
+    QMainWindow window ;
+    SceneViewer *viewer = new SceneViewer(scene) ;
+    viewer->setDefaultCamera() ;
+
+    window.setCentralWidget(viewer) ;
+    window.resize(1024, 1024) ;
+    window.show() ;
+
+    return app.exec();
+}
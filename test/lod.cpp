@@ -0,0 +1,121 @@
+#include <xviz/scene/geometry.hpp>
+
+#include <iostream>
+
+using namespace xviz ;
+using namespace Eigen ;
+using namespace std ;
+
+// Generates the levels of detail of a few shapes and checks that each level has fewer triangles than the previous
+// one and that points of the simplified surface are not farther from the original surface than the reported error.
+
+// closest point of triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static Vector3f closestPointOnTriangle(const Vector3f &p, const Vector3f &a, const Vector3f &b, const Vector3f &c) {
+    Vector3f ab = b - a, ac = c - a, ap = p - a ;
+    float d1 = ab.dot(ap), d2 = ac.dot(ap) ;
+    if ( d1 <= 0 && d2 <= 0 ) return a ;
+
+    Vector3f bp = p - b ;
+    float d3 = ab.dot(bp), d4 = ac.dot(bp) ;
+    if ( d3 >= 0 && d4 <= d3 ) return b ;
+
+    float vc = d1 * d4 - d3 * d2 ;
+    if ( vc <= 0 && d1 >= 0 && d3 <= 0 ) return a + ab * ( d1 / ( d1 - d3 ) ) ;
+
+    Vector3f cp = p - c ;
+    float d5 = ab.dot(cp), d6 = ac.dot(cp) ;
+    if ( d6 >= 0 && d5 <= d6 ) return c ;
+
+    float vb = d5 * d2 - d1 * d6 ;
+    if ( vb <= 0 && d2 >= 0 && d6 <= 0 ) return a + ac * ( d2 / ( d2 - d6 ) ) ;
+
+    float va = d3 * d6 - d5 * d4 ;
+    if ( va <= 0 && ( d4 - d3 ) >= 0 && ( d5 - d6 ) >= 0 ) return b + ( c - b ) * ( ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ) ) ;
+
+    float denom = 1.0f / ( va + vb + vc ) ;
+    return a + ab * ( vb * denom ) + ac * ( vc * denom ) ;
+}
+
+// triangle list of the full geometry, which may not be indexed
+static Geometry::indices_t triangleList(const Geometry &geom) {
+    Geometry::indices_t idx = geom.indices() ;
+    if ( idx.empty() ) {
+        for( uint32_t i=0 ; i<geom.vertices().size() ; i++ )
+            idx.push_back(i) ;
+    }
+    return idx ;
+}
+
+static float distanceToMesh(const Vector3f &p, const Geometry &geom, const Geometry::indices_t &idx) {
+    const auto &v = geom.vertices() ;
+
+    float dist = numeric_limits<float>::max() ;
+    for( size_t i=0 ; i<idx.size() ; i+=3 )
+        dist = std::min(dist, ( p - closestPointOnTriangle(p, v[idx[i]], v[idx[i+1]], v[idx[i+2]]) ).norm()) ;
+    return dist ;
+}
+
+// largest distance from the original surface of the corners, edge midpoints and centroids of the triangles of a level
+static float levelDistance(const Geometry &geom, const Geometry::indices_t &lod) {
+    const auto &v = geom.vertices() ;
+    const Geometry::indices_t full = triangleList(geom) ;
+
+    float dist = 0 ;
+    for( size_t i=0 ; i<lod.size() ; i+=3 ) {
+        const Vector3f &a = v[lod[i]], &b = v[lod[i+1]], &c = v[lod[i+2]] ;
+        for( const Vector3f &p: { a, b, c, Vector3f(( a + b ) / 2), Vector3f(( b + c ) / 2), Vector3f(( a + c ) / 2), Vector3f(( a + b + c ) / 3) } )
+            dist = std::max(dist, distanceToMesh(p, geom, full)) ;
+    }
+    return dist ;
+}
+
+static bool check(const string &name, Geometry geom) {
+    geom.generateLods(4, 0.5f, 0.05f) ;
+
+    const float diagonal = ( geom.getBoundingBox().bounds_[1] - geom.getBoundingBox().bounds_[0] ).norm() ;
+
+    bool ok = !geom.lods().empty() ;
+    size_t triangles = triangleList(geom).size() / 3 ;
+
+    cout << name << ": " << triangles << " triangles" << endl ;
+
+    for( size_t l=0 ; l<geom.lods().size() ; l++ ) {
+        const Geometry::Lod &lod = geom.lods()[l] ;
+        size_t n = lod.indices_.size() / 3 ;
+        float dist = levelDistance(geom, lod.indices_) ;
+
+        cout << "  level " << l + 1 << ": " << n << " triangles, error " << lod.error_ << ", measured " << dist << endl ;
+
+        if ( n >= triangles ) {
+            cerr << name << ": level " << l + 1 << " does not reduce the triangle count" << endl ;
+            ok = false ;
+        }
+
+        if ( dist > lod.error_ + 1.0e-4f * diagonal ) {
+            cerr << name << ": level " << l + 1 << " exceeds its error bound" << endl ;
+            ok = false ;
+        }
+
+        if ( lod.error_ > 0.05f * diagonal ) {
+            cerr << name << ": level " << l + 1 << " exceeds the maximum error" << endl ;
+            ok = false ;
+        }
+
+        triangles = n ;
+    }
+
+    return ok ;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true ;
+
+    ok &= check("sphere", Geometry::createSolidSphere(1.0, 48, 32)) ;
+    ok &= check("torus", Geometry::createSolidTorus(1.0, 0.3, 32, 48)) ;
+    ok &= check("cylinder", Geometry::createSolidCylinder(0.5, 2.0, 32, 16)) ;
+    ok &= check("plane", Geometry::makePlane(2.0, 2.0, 32, 32)) ;
+
+    cout << ( ok ? "passed" : "failed" ) << endl ;
+
+    return ok ? 0 : 1 ;
+}
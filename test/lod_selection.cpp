@@ -0,0 +1,105 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Moves the camera away from a sphere with levels of detail and back, and checks with FrameStats::lod_draws_ that
+// the full geometry is drawn up close, a simplified level far away, and that the level switches back to the full
+// geometry at a shorter distance than it left it, by the hysteresis margin of the renderer.
+
+static bool drawnWithLod(Renderer &rdr, const ScenePtr &scene, PerspectiveCamera *pcam, const CameraPtr &cam, float distance) {
+    pcam->lookAt({0, 0, distance}, {0, 0, 0}, {0, 1, 0}) ;
+    rdr.render(scene, cam) ;
+    return rdr.frameStats().lod_draws_ > 0 ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("lod_selection", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const float d_min = 1.5f, d_max = 200.0f, step = 1.02f ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene(new Scene) ;
+
+    GeometryPtr sphere(new SphereGeometry(0.5, 64, 48)) ;
+    sphere->generateLods() ;
+
+    NodePtr node(new Node) ;
+    node->addDrawable(sphere, MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.3, 0.1)))) ;
+    scene->addChild(node) ;
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(1, 2, 1)) ;
+    dl->setDiffuseColor(Vector3f(0.8, 0.8, 0.8)) ;
+    scene->addLightNode(LightPtr(dl)) ;
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 2 * d_max) ;
+    CameraPtr cam(pcam) ;
+    pcam->setViewport(width, height)  ;
+
+    bool ok = true ;
+
+    if ( sphere->lods().empty() ) {
+        std::cout << "no levels of detail were generated" << std::endl ;
+        return 1 ;
+    }
+
+    Renderer rdr ;
+
+    if ( drawnWithLod(rdr, scene, pcam, cam, d_min) ) {
+        std::cout << "simplified level drawn at distance " << d_min << std::endl ;
+        ok = false ;
+    }
+
+    // moving away, once simplified the geometry stays simplified
+
+    float coarse = 0 ;
+    for( float d = d_min ; d < d_max ; d *= step ) {
+        bool lod = drawnWithLod(rdr, scene, pcam, cam, d) ;
+        if ( lod && coarse == 0 ) coarse = d ;
+        else if ( !lod && coarse != 0 ) {
+            std::cout << "full geometry drawn again at distance " << d << " while moving away" << std::endl ;
+            ok = false ;
+        }
+    }
+
+    // moving back
+
+    float fine = 0 ;
+    for( float d = d_max ; d > d_min ; d /= step ) {
+        if ( !drawnWithLod(rdr, scene, pcam, cam, d) ) {
+            fine = d ;
+            break ;
+        }
+    }
+
+    std::cout << "simplified from distance " << coarse << ", full geometry again from distance " << fine << std::endl ;
+
+    if ( coarse == 0 || fine == 0 ) ok = false ;
+
+    // the margin is 25% of the threshold, leave room for the steps of the camera
+    if ( fine > coarse * 0.9f ) {
+        std::cout << "no hysteresis between the switching distances" << std::endl ;
+        ok = false ;
+    }
+
+    rdr.setLodThreshold(0) ;
+
+    if ( drawnWithLod(rdr, scene, pcam, cam, d_max) ) {
+        std::cout << "simplified level drawn with a zero threshold" << std::endl ;
+        ok = false ;
+    }
+
+    return ok ? 0 : 1 ;
+}
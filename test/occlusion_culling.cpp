@@ -0,0 +1,130 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders boxes hidden behind a wall, one beside it and one outside the view with occlusion culling, and checks
+// FrameStats::drawables_culled_ and drawables_occluded_: the hidden boxes are skipped from the second frame on, and
+// drawn again one frame after the wall moves behind them. The image must not differ from the one rendered without culling.
+
+static bool checkStats(Renderer &rdr, uint32_t culled, uint32_t occluded, const char *when) {
+    const FrameStats &stats = rdr.frameStats() ;
+    if ( stats.drawables_culled_ == culled && stats.drawables_occluded_ == occluded ) return true ;
+
+    std::cout << when << ": " << stats.drawables_culled_ << " culled and " << stats.drawables_occluded_
+              << " occluded drawables, expected " << culled << " and " << occluded << std::endl ;
+    return false ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("occlusion_culling", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const uint32_t hidden = 4 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene(new Scene) ;
+
+    MaterialPtr material(new PhongMaterial(Vector3f(0.8, 0.3, 0.1))) ;
+    GeometryPtr box(new BoxGeometry({0.1, 0.1, 0.1})) ;
+
+    NodePtr wall(new Node) ;
+    wall->addDrawable(GeometryPtr(new BoxGeometry({0.6, 0.4, 0.05})), MaterialPtr(new PhongMaterial(Vector3f(0.5, 0.5, 0.5)))) ;
+    wall->setTransform(Affine3f(Translation3f(0, 0, 0.5))) ;
+    scene->addChild(wall) ;
+
+    for( uint32_t i=0 ; i<hidden ; i++ ) {
+        NodePtr node(new Node) ;
+        node->addDrawable(box, material) ;
+        node->setTransform(Affine3f(Translation3f(0.3f * i - 0.45f, 0, -0.5f))) ;
+        scene->addChild(node) ;
+    }
+
+    NodePtr beside(new Node) ;
+    beside->addDrawable(box, material) ;
+    beside->setTransform(Affine3f(Translation3f(1.2, 0, 0))) ;
+    scene->addChild(beside) ;
+
+    NodePtr outside(new Node) ;
+    outside->addDrawable(box, material) ;
+    outside->setTransform(Affine3f(Translation3f(0, 0, 5))) ;
+    scene->addChild(outside) ;
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(1, 2, 1)) ;
+    dl->setDiffuseColor(Vector3f(0.8, 0.8, 0.8)) ;
+    scene->addLightNode(LightPtr(dl)) ;
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 20) ;
+    CameraPtr cam(pcam) ;
+    pcam->lookAt({0, 0, 2.5}, {0, 0, 0}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+
+    Image ref ;
+    {
+        Renderer rdr ;
+        rdr.render(scene, cam) ;
+        ref = os.getImage() ;
+    }
+
+    Renderer rdr ;
+    rdr.setOcclusionCulling(true) ;
+
+    // reading the image back waits for the queries, whose results are then available to the next frame
+
+    rdr.render(scene, cam) ;
+    os.getImage() ;
+
+    bool ok = checkStats(rdr, 1, 0, "first frame") ;
+
+    if ( rdr.frameStats().occlusion_queries_ == 0 ) {
+        std::cout << "no occlusion queries were issued" << std::endl ;
+        ok = false ;
+    }
+
+    rdr.render(scene, cam) ;
+    Image culled = os.getImage() ;
+
+    ok = checkStats(rdr, 1, hidden, "second frame") && ok ;
+
+    const unsigned char *a = ref.data(), *b = culled.data() ;
+    size_t count = 0 ;
+    for( size_t i=0 ; i<size_t(width) * height * 4 ; i++ )
+        if ( a[i] != b[i] ) ++count ;
+
+    if ( count ) {
+        std::cout << count << " values differ from the image rendered without occlusion culling" << std::endl ;
+        ok = false ;
+    }
+
+    // the boxes appear one frame after the wall has moved behind them
+
+    wall->setTransform(Affine3f(Translation3f(0, 0, -1.5))) ;
+
+    rdr.render(scene, cam) ;
+    os.getImage() ;
+    ok = checkStats(rdr, 1, hidden, "frame after moving the wall") && ok ;
+
+    rdr.render(scene, cam) ;
+    os.getImage() ;
+    ok = checkStats(rdr, 1, 0, "second frame after moving the wall") && ok ;
+
+    if ( ok ) return 0 ;
+
+#ifdef HAS_LIBPNG
+    ref.saveToPNG("without_occlusion_culling.png") ;
+    culled.saveToPNG("occlusion_culling.png") ;
+#endif
+
+    return 1 ;
+}
@@ -0,0 +1,34 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+#include "image_check.hpp"
+
+using namespace xviz ;
+
+// Renders the reference scene with the Qt offscreen surface and compares it with the reference image that
+// test_headless_image matches with the headless context. Exits with a nonzero status on mismatch.
+
+int main(int argc, char *argv[]) {
+    TestApplication app("offscreen_image", argc, argv);
+
+    const unsigned int width = 160, height = 120 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene ;
+    CameraPtr cam ;
+    makeReferenceView(scene, cam, width, height) ;
+
+    Renderer rdr ;
+    rdr.render(scene, cam) ;
+
+    bool ok = compareWithReference(os.getImage(false), readPPM(std::string(REFERENCE_DIR) + "boxes.ppm"),
+                                   "offscreen_image.ppm") ;
+
+    return ok ? 0 : 1 ;
+}
@@ -0,0 +1,71 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/camera.hpp>
+
+#include <iostream>
+#include <cstring>
+
+#include "util.hpp"
+#include "bench_util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Requests the asynchronous readback of more frames than OffscreenSurface keeps buffers for before fetching any of
+// them, and checks that each fetched image, allocated or written to a caller buffer, matches the one read
+// synchronously right after rendering the frame. Exits with a nonzero status on mismatch.
+
+int main(int argc, char *argv[]) {
+    TestApplication app("offscreen_readback", argc, argv);
+
+    const unsigned int width = 320, height = 240 ;
+    const int frames = 8 ;
+    const size_t frame_size = size_t(width) * height * 4 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene = makeBoxGrid(10, 0.1f) ;
+    addDirectionalLight(scene, Vector3f(1, 1, 1)) ;
+
+    Renderer rdr ;
+
+    std::vector<Image> expected ;
+    std::vector<OffscreenSurface::ReadbackTicket> tickets ;
+    std::vector<uchar> buffers(frame_size * frames) ;
+
+    for( int i=0 ; i<frames ; i++ ) {
+        CameraPtr cam = makePerspectiveCamera(width, height, Vector3f(0.2f * i - 0.7f, 1.0f, 1.0f)) ;
+        rdr.render(scene, cam) ;
+
+        expected.push_back(os.getImage()) ;
+
+        // every other frame goes to a buffer of the caller
+        tickets.push_back(os.requestImage(true, ( i % 2 ) ? &buffers[frame_size * i] : nullptr)) ;
+    }
+
+    bool ok = true ;
+
+    for( int i=frames-1 ; i>=0 ; i-- ) {
+        Image image ;
+        if ( !os.fetchImage(tickets[i], image, true) ) {
+            std::cout << "frame " << i << " could not be fetched" << std::endl ;
+            ok = false ;
+            continue ;
+        }
+
+        const uchar *pixels = ( i % 2 ) ? &buffers[frame_size * i] : image.data() ;
+
+        if ( !pixels || memcmp(pixels, expected[i].data(), frame_size) != 0 ) {
+            std::cout << "frame " << i << " differs from the synchronous readback" << std::endl ;
+            ok = false ;
+        }
+
+        if ( os.fetchImage(tickets[i], image, true) ) {
+            std::cout << "frame " << i << " was fetched twice" << std::endl ;
+            ok = false ;
+        }
+    }
+
+    return ok ? 0 : 1 ;
+}
@@ -0,0 +1,93 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders the same scene with float and packed vertex formats and checks that the images differ at most by
+// a small tolerance due to the quantization of normals and colors.
+
+static Image renderScene(OffscreenSurface &os, const ScenePtr &scene, const CameraPtr &cam, bool packed) {
+    Renderer rdr ;
+    rdr.setPackedVertexFormat(packed) ;
+    rdr.render(scene, cam) ;
+    return os.getImage() ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("packed_vertices", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const int tolerance = 4 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene(new Scene) ;
+
+    NodePtr ground(new Node) ;
+    ground->addDrawable(GeometryPtr(new Geometry(Geometry::makePlane(4, 4, 8, 8))), MaterialPtr(new PhongMaterial(Vector3f(0.5, 0.5, 0.5)))) ;
+    ground->setTransform(Affine3f(Translation3f(0, -0.5, 0))) ;
+    scene->addChild(ground) ;
+
+    NodePtr sphere(new Node) ;
+    sphere->addDrawable(GeometryPtr(new SphereGeometry(0.4, 32, 24)), MaterialPtr(new PhongMaterial(Vector3f(0.8, 0.3, 0.1)))) ;
+    sphere->setTransform(Affine3f(Translation3f(-0.5, 0, 0))) ;
+    scene->addChild(sphere) ;
+
+    // per vertex colors
+
+    GeometryPtr torus(new Geometry(Geometry::createSolidTorus(0.3, 0.1, 24, 32))) ;
+    for( const Vector3f &v: torus->vertices() )
+        torus->colors().push_back((v.normalized() + Vector3f::Ones()) * 0.5) ;
+
+    NodePtr tn(new Node) ;
+    tn->addDrawable(torus, MaterialPtr(new PerVertexColorMaterial())) ;
+    tn->setTransform(Affine3f(Translation3f(0.5, 0, 0))) ;
+    scene->addChild(tn) ;
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(1, 2, 1)) ;
+    dl->setDiffuseColor(Vector3f(0.8, 0.8, 0.8)) ;
+    scene->addLightNode(LightPtr(dl)) ;
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.01, 20) ;
+    CameraPtr cam(pcam) ;
+    pcam->lookAt({0, 1, 2.5}, {0, 0, 0}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+
+    Image ref = renderScene(os, scene, cam, false) ;
+
+    // the same geometries are uploaded again by the second renderer
+    Image packed = renderScene(os, scene, cam, true) ;
+
+    const unsigned char *a = ref.data(), *b = packed.data() ;
+    size_t n = size_t(width) * height * 4 ;
+
+    int max_diff = 0 ;
+    size_t count = 0 ;
+    for( size_t i=0 ; i<n ; i++ ) {
+        int d = std::abs(int(a[i]) - int(b[i])) ;
+        max_diff = std::max(max_diff, d) ;
+        if ( d > tolerance ) ++count ;
+    }
+
+    std::cout << "max difference: " << max_diff << ", values above tolerance: " << count << std::endl ;
+
+    if ( count == 0 ) return 0 ;
+
+    // keep both images for inspection
+#ifdef HAS_LIBPNG
+    ref.saveToPNG("float_vertices.png") ;
+    packed.saveToPNG("packed_vertices.png") ;
+#endif
+
+    return 1 ;
+}
@@ -219,10 +219,20 @@ public:
         int x = event->x() ;
         int y = event->y() ;
 
-        Ray ray = camera_->getRay(x, y) ;
-
         RayCastResult result ;
-        if ( ray_caster_.intersectOne(ray, scene_->getNodesRecursive(), result) ) {
+        bool hit ;
+
+        if ( gpu_picking_ ) {
+            makeCurrent() ;
+            hit = rdr_.pick(scene_, camera_, x, y, result) ;
+            doneCurrent() ;
+        } else {
+            Ray ray = camera_->getRay(x, y) ;
+            hit = ray_caster_.intersectOne(ray, scene_->getNodesRecursive(), result) ;
+        }
+
+        // instanced drawables have no drawable_
+        if ( hit && result.drawable_ ) {
             if ( result.drawable_->geometry()->ptype() == Geometry::Triangles ) {
             cout << result.node_->name() << ' '
                  << result.triangle_idx_[0] << ' ' <<
@@ -252,6 +262,16 @@ public:
         SceneViewer::mouseMoveEvent(event) ;
     }
 
+    // G switches between picking with the ray caster and with the renderer
+    void keyPressEvent(QKeyEvent *event) override {
+        if ( event->key() == Qt::Key_G ) {
+            gpu_picking_ = !gpu_picking_ ;
+            cout << ( gpu_picking_ ? "GPU picking" : "ray caster picking" ) << endl ;
+        }
+
+        SceneViewer::keyPressEvent(event) ;
+    }
+
     void mousePressEvent(QMouseEvent *event) override {
         PerspectiveCamera *pcam = dynamic_cast<PerspectiveCamera *>(camera_.get()) ;
         int x = event->x() ;
@@ -350,6 +370,7 @@ public:
 
 private:
     RayCaster ray_caster_ ;
+    bool gpu_picking_ = false ;
     xviz::MaterialPtr highlight_, old_;
     Drawable *selected_ = nullptr ;
     Renderer decorator_ ;
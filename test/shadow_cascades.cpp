@@ -0,0 +1,137 @@
+#include <xviz/gui/offscreen.hpp>
+#include <xviz/scene/renderer.hpp>
+#include <xviz/scene/scene.hpp>
+#include <xviz/scene/light.hpp>
+#include <xviz/scene/camera.hpp>
+#include <xviz/scene/geometry.hpp>
+#include <xviz/scene/material.hpp>
+
+#include <iostream>
+
+#include "util.hpp"
+
+using namespace xviz ;
+using namespace Eigen ;
+
+// Renders a row of boxes receding from the camera over a large ground plane with a cascaded directional light, and
+// compares the image with the one of a single high resolution cascade covering the whole view frustum. Also checks
+// that each cascade is rendered, that the maps are reused while nothing moves and rendered again when the camera
+// moves, since the cascades follow the camera.
+
+static size_t countDifferences(const Image &a, const Image &b, int tolerance) {
+    const unsigned char *pa = a.data(), *pb = b.data() ;
+    size_t count = 0 ;
+    for( size_t i=0 ; i<size_t(a.width()) * a.height() ; i++, pa += 4, pb += 4 ) {
+        for( int c=0 ; c<3 ; c++ ) {
+            if ( std::abs(int(pa[c]) - int(pb[c])) > tolerance ) {
+                ++count ;
+                break ;
+            }
+        }
+    }
+    return count ;
+}
+
+int main(int argc, char *argv[]) {
+    TestApplication app("shadow_cascades", argc, argv);
+
+    const unsigned int width = 640, height = 480 ;
+    const uint32_t cascades = 4 ;
+    const int tolerance = 8 ;
+
+    OffscreenSurface os(QSize(width, height));
+
+    ScenePtr scene(new Scene) ;
+
+    NodePtr ground(new Node) ;
+    ground->addDrawable(GeometryPtr(new Geometry(Geometry::makePlane(24, 24, 8, 8))), MaterialPtr(new PhongMaterial(Vector3f(0.6, 0.6, 0.6)))) ;
+    scene->addChild(ground) ;
+
+    MaterialPtr box_material(new PhongMaterial(Vector3f(0.8, 0.3, 0.1))) ;
+    GeometryPtr box(new BoxGeometry({0.5, 0.5, 0.5})) ;
+
+    for( int i=0 ; i<8 ; i++ ) {
+        NodePtr node(new Node) ;
+        node->addDrawable(box, box_material) ;
+        node->setTransform(Affine3f(Translation3f(0.4f * ( i % 2 ) - 0.2f, 0.25f, 1.0f - 2.0f * i))) ;
+        scene->addChild(node) ;
+    }
+
+    DirectionalLight *dl = new DirectionalLight(Vector3f(1, 1, 0.5)) ;
+    dl->setDiffuseColor(Vector3f(0.8, 0.8, 0.8)) ;
+    dl->setShadowBias(0.0005) ;
+    dl->setCastsShadows(true) ;
+    scene->addLightNode(LightPtr(dl)) ;
+
+    PerspectiveCamera *pcam = new PerspectiveCamera(width/float(height), 50*M_PI/180, 0.1, 30) ;
+    CameraPtr cam(pcam) ;
+    pcam->lookAt({0, 2, 4}, {0, 0, -4}, {0, 1, 0}) ;
+    pcam->setViewport(width, height)  ;
+
+    bool ok = true ;
+
+    // reference: a single high resolution cascade covering the whole view frustum
+
+    dl->setShadowCascades(1) ;
+    dl->setShadowMapSize(4096) ;
+
+    Image ref, cascaded, unshadowed ;
+
+    {
+        Renderer rdr ;
+        rdr.render(scene, cam) ;
+        ref = os.getImage() ;
+    }
+
+    dl->setShadowMapSize(2048) ;
+    dl->setShadowCascades(cascades) ;
+
+    Renderer rdr ;
+    rdr.render(scene, cam) ;
+    cascaded = os.getImage() ;
+
+    if ( rdr.frameStats().shadow_passes_ != cascades ) {
+        std::cout << "shadow passes of the first frame: " << rdr.frameStats().shadow_passes_ << ", expected " << cascades << std::endl ;
+        ok = false ;
+    }
+
+    rdr.render(scene, cam) ;
+
+    if ( rdr.frameStats().shadow_passes_ != 0 || rdr.frameStats().shadow_maps_cached_ != 1 ) {
+        std::cout << "static frame rendered " << rdr.frameStats().shadow_passes_ << " shadow passes" << std::endl ;
+        ok = false ;
+    }
+
+    pcam->lookAt({0.5, 2, 4}, {0, 0, -4}, {0, 1, 0}) ;
+    rdr.render(scene, cam) ;
+
+    if ( rdr.frameStats().shadow_passes_ != cascades ) {
+        std::cout << "shadow passes after moving the camera: " << rdr.frameStats().shadow_passes_ << ", expected " << cascades << std::endl ;
+        ok = false ;
+    }
+
+    // the shadows must be visible for the comparison to mean anything
+
+    pcam->lookAt({0, 2, 4}, {0, 0, -4}, {0, 1, 0}) ;
+    dl->setCastsShadows(false) ;
+    rdr.render(scene, cam) ;
+    unshadowed = os.getImage() ;
+
+    const size_t n = size_t(width) * height ;
+    size_t shadowed = countDifferences(ref, unshadowed, tolerance) ;
+    size_t count = countDifferences(ref, cascaded, tolerance) ;
+
+    std::cout << "shadowed pixels: " << shadowed << ", pixels differing from the reference: " << count << std::endl ;
+
+    // edges are rasterized at a different resolution by each cascade
+    if ( shadowed < n / 50 || count > n / 100 ) ok = false ;
+
+    if ( ok ) return 0 ;
+
+#ifdef HAS_LIBPNG
+    ref.saveToPNG("single_shadow_map.png") ;
+    cascaded.saveToPNG("shadow_cascades.png") ;
+#endif
+
+    return 1 ;
+}